@@ -9,6 +9,7 @@
 #include "shared/glFramework/LineCanvasGL.h"
 #include "shared/glFramework/UtilsGLImGui.h"
 #include "shared/UtilsMath.h"
+#include "shared/OcclusionCuller.h"
 #include "shared/Camera.h"
 #include "shared/scene/VtxData.h"
 #include "Chapter9/GLMesh9.h"
@@ -36,6 +37,7 @@ bool g_FreezeCullingView = false;
 bool g_DrawMeshes = true;
 bool g_DrawBoxes = true;
 bool g_DrawGrid = true;
+bool g_OcclusionCulling = true;
 
 int main(void)
 {
@@ -57,7 +59,8 @@ int main(void)
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glEnable(GL_DEPTH_TEST);
 
-	GLSceneData sceneData("data/meshes/bistro_all.meshes", "data/meshes/bistro_all.scene", "data/meshes/bistro_all.materials");
+	// the first frames are drawn with placeholder textures
+	GLSceneData sceneData("data/meshes/bistro_all.meshes", "data/meshes/bistro_all.scene", "data/meshes/bistro_all.materials", true);
 	GLMesh mesh(sceneData);
 
 	glfwSetCursorPosCallback(
@@ -121,17 +124,29 @@ int main(void)
 	ImGuiGLRenderer rendererUI;
 	CanvasGL canvas;
 
-	// pretransform bounding boxes to world space
+	// pretransform bounding boxes to world space (instances share the boxes of their meshes)
+	std::vector<BoundingBox> shapeBoxes;
+	std::vector<bool> canOcclude;
 	for (const auto& c : sceneData.shapes_)
 	{
-		const mat4 model = sceneData.scene_.globalTransform_[c.transformIndex];
-		sceneData.meshData_.boxes_[c.meshIndex].transform(model);
+		const MaterialDescription& mtl = sceneData.materials_[c.materialIndex];
+		shapeBoxes.push_back(sceneData.meshData_.boxes_[c.meshIndex].getTransformed(sceneData.scene_.globalTransform_[c.transformIndex]));
+		// alpha-tested foliage and transparent shapes do not hide anything
+		canOcclude.push_back(!(mtl.flags_ & sMaterialFlags_Transparent) && mtl.opacityMap_ == INVALID_TEXTURE && mtl.alphaTest_ == 0.0f);
 	}
 
-	const BoundingBox fullScene = combineBoxes(sceneData.meshData_.boxes_);
+	const BoundingBox fullScene = combineBoxes(shapeBoxes);
+
+	OcclusionCuller occlusionCuller;
+	occlusionCuller.setOccluders(gatherOccluderTriangles(sceneData.meshData_, sceneData.shapes_, sceneData.scene_.globalTransform_, shapeBoxes, canOcclude));
+
+	std::vector<uint8_t> occlusionVisible;
 
 	while (!glfwWindowShouldClose(app.getWindow()))
 	{
+		if (sceneData.uploadLoadedTextures())
+			mesh.updateMaterialsBuffer(sceneData);
+
 		positioner.update(app.getDeltaSeconds(), mouseState.pos, mouseState.pressedLeft);
 
 		int width, height;
@@ -156,23 +171,29 @@ int main(void)
 		vec4 frustumCorners[8];
 		getFrustumCorners(proj * g_CullingView, frustumCorners);
 
-		// cull
+		if (g_OcclusionCulling)
+		{
+			occlusionCuller.renderOccluders(proj * g_CullingView);
+			occlusionCuller.cullBoxes(shapeBoxes, occlusionVisible);
+		}
+
+		// cull (one command per shape, grouped by index type: the shape is baseInstance_ >> 16)
 		int numVisibleMeshes = 0;
+		int numFrustumVisibleMeshes = 0;
+		for (auto& cmd : mesh.bufferIndirect_.drawCommands_)
 		{
-			DrawElementsIndirectCommand* cmd = mesh.bufferIndirect_.drawCommands_.data();
-			for (const auto& c : sceneData.shapes_)
-			{
-				cmd->instanceCount_ = isBoxInFrustum(frustumPlanes, frustumCorners, sceneData.meshData_.boxes_[c.meshIndex]) ? 1 : 0;
-				numVisibleMeshes += (cmd++)->instanceCount_;
-			}
-			mesh.bufferIndirect_.uploadIndirectBuffer();
+			const uint32_t i = cmd.baseInstance_ >> 16;
+			const bool inFrustum = isBoxInFrustum(frustumPlanes, frustumCorners, shapeBoxes[i]);
+			numFrustumVisibleMeshes += inFrustum ? 1 : 0;
+			cmd.instanceCount_ = (inFrustum && (!g_OcclusionCulling || occlusionVisible[i])) ? 1 : 0;
+			numVisibleMeshes += cmd.instanceCount_;
 		}
+		mesh.bufferIndirect_.uploadIndirectBuffer();
 
 		if (g_DrawBoxes)
 		{
-			DrawElementsIndirectCommand* cmd = mesh.bufferIndirect_.drawCommands_.data();
-			for (const auto& c : sceneData.shapes_)
-				drawBox3dGL(canvas, mat4(1.0f), sceneData.meshData_.boxes_[c.meshIndex], (cmd++)->instanceCount_ ? vec4(0, 1, 0, 1) : vec4(1, 0, 0, 1));
+			for (const auto& cmd : mesh.bufferIndirect_.drawCommands_)
+				drawBox3dGL(canvas, mat4(1.0f), shapeBoxes[cmd.baseInstance_ >> 16], cmd.instanceCount_ ? vec4(0, 1, 0, 1) : vec4(1, 0, 0, 1));
 			drawBox3dGL(canvas, mat4(1.0f), fullScene, vec4(1, 0, 0, 1));
 		}
 
@@ -211,7 +232,15 @@ int main(void)
 		ImGui::Separator();
 		ImGui::Checkbox("Freeze culling frustum (P)", &g_FreezeCullingView);
 		ImGui::Separator();
-		ImGui::Text("Visible meshes: %i", numVisibleMeshes);
+		ImGui::Checkbox("Occlusion culling", &g_OcclusionCulling);
+		ImGui::Text("Visible meshes: %i (frustum: %i)", numVisibleMeshes, numFrustumVisibleMeshes);
+		if (g_OcclusionCulling)
+		{
+			const OcclusionCullerStats& stats = occlusionCuller.getStats();
+			ImGui::Text("Occluders: %u triangles", stats.numOccluderTriangles_);
+			ImGui::Text("Occluded: %.1f%% of frustum-visible", numFrustumVisibleMeshes ? 100.0f * (1.0f - (float)numVisibleMeshes / numFrustumVisibleMeshes) : 0.0f);
+			ImGui::Text("Rasterization: %.3f ms, tests: %.3f ms", stats.rasterMs_, stats.testMs_);
+		}
 		ImGui::End();
 		ImGui::Render();
 		rendererUI.render(width, height, ImGui::GetDrawData());
@@ -10,6 +10,7 @@
 #include "shared/glFramework/UtilsGLImGui.h"
 #include "shared/UtilsMath.h"
 #include "shared/UtilsFPS.h"
+#include "shared/DrawCompaction.h"
 #include "shared/Camera.h"
 #include "shared/scene/VtxData.h"
 #include "Chapter9/GLMesh9.h"
@@ -38,6 +39,7 @@ Camera camera(positioner);
 mat4 g_CullingView = camera.getViewMatrix();
 bool g_FreezeCullingView = false;
 bool g_EnableGPUCulling = true;
+bool g_BucketByMaterial = false;
 
 int main(void)
 {
@@ -49,7 +51,7 @@ int main(void)
 	GLShader shaderVert("data/shaders/chapter10/GL01_scene_IBL.vert");
 	GLShader shaderFrag("data/shaders/chapter10/GL01_scene_IBL.frag");
 	GLProgram program(shaderVert, shaderFrag);
-	GLShader shaderCulling("data/shaders/chapter10/GL02_FrustumCulling.comp");
+	GLShader shaderCulling("data/shaders/chapter10/GL02_FrustumCullingCompact.comp");
 	GLProgram programCulling(shaderCulling);
 
 	const GLuint kMaxNumObjects = 128 * 1024;
@@ -57,22 +59,50 @@ int main(void)
 	const GLsizeiptr kBoundingBoxesBufferSize = sizeof(BoundingBox) * kMaxNumObjects;
 	const GLuint kBufferIndex_BoundingBoxes = kBufferIndex_PerFrameUniforms + 1;
 	const GLuint kBufferIndex_DrawCommands  = kBufferIndex_PerFrameUniforms + 2;
-	const GLuint kBufferIndex_NumVisibleMeshes = kBufferIndex_PerFrameUniforms + 3;
+	const GLuint kBufferIndex_DrawCounts = kBufferIndex_PerFrameUniforms + 3;
+	const GLuint kBufferIndex_CompactedDrawCommands = kBufferIndex_PerFrameUniforms + 4;
+	const GLuint kBufferIndex_DrawBuckets = kBufferIndex_PerFrameUniforms + 5;
+	const GLuint kBufferIndex_DrawBucketOffsets = kBufferIndex_PerFrameUniforms + 6;
 
 	GLBuffer perFrameDataBuffer(kUniformBufferSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
 	glBindBufferRange(GL_UNIFORM_BUFFER, kBufferIndex_PerFrameUniforms, perFrameDataBuffer.getHandle(), 0, kUniformBufferSize);
 	GLBuffer boundingBoxesBuffer(kBoundingBoxesBufferSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
-	GLBuffer numVisibleMeshesBuffer(sizeof(uint32_t), nullptr, GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
-	volatile uint32_t* numVisibleMeshesPtr = (uint32_t*)glMapNamedBuffer(numVisibleMeshesBuffer.getHandle(), GL_READ_WRITE);
-	assert(numVisibleMeshesPtr);
 
 	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glEnable(GL_DEPTH_TEST);
 
-	GLSceneData sceneData("data/meshes/bistro_all.meshes", "data/meshes/bistro_all.scene", "data/meshes/bistro_all.materials");
+	// the first frames are drawn with placeholder textures
+	GLSceneData sceneData("data/meshes/bistro_all.meshes", "data/meshes/bistro_all.scene", "data/meshes/bistro_all.materials", true);
 	GLMesh mesh(sceneData);
 
+	// culling writes only the visible commands, densely packed per bucket, and counts them for glMultiDrawElementsIndirectCount()
+	const GLuint kMaxNumBuckets = 2 * std::max((GLuint)sceneData.materials_.size(), 2u);
+	GLIndirectBuffer compactedCommands(sceneData.shapes_.size());
+	GLBuffer drawCountsBuffer(sizeof(uint32_t) * kMaxNumBuckets, nullptr, GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+	volatile uint32_t* drawCountsPtr = (uint32_t*)glMapNamedBuffer(drawCountsBuffer.getHandle(), GL_READ_WRITE);
+	assert(drawCountsPtr);
+	GLBuffer drawBucketsBuffer(sizeof(uint32_t) * sceneData.shapes_.size(), nullptr, GL_DYNAMIC_STORAGE_BIT);
+	GLBuffer drawBucketOffsetsBuffer(sizeof(uint32_t) * kMaxNumBuckets, nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+	// opaque/transparent or one bucket per material, split by the index type: even buckets have 16-bit indices, odd ones 32-bit indices
+	auto makeBuckets = [&sceneData, &mesh](bool byMaterial)
+	{
+		const auto& commands = mesh.bufferIndirect_.drawCommands_;
+		std::vector<uint32_t> bucketOfCommand;
+		bucketOfCommand.reserve(commands.size());
+		for (size_t i = 0; i != commands.size(); i++)
+		{
+			const DrawData& c = sceneData.shapes_[commands[i].baseInstance_ >> 16];
+			const uint32_t bucket = byMaterial ? c.materialIndex : ((sceneData.materials_[c.materialIndex].flags_ & sMaterialFlags_Transparent) ? 1 : 0);
+			bucketOfCommand.push_back(2 * bucket + (i < mesh.bufferIndirect_.numShortCommands_ ? 0 : 1));
+		}
+		return makeDrawBuckets(bucketOfCommand, 2 * (byMaterial ? (uint32_t)sceneData.materials_.size() : 2));
+	};
+
+	DrawBuckets buckets;
+	bool bucketsByMaterial = !g_BucketByMaterial;
+
 	glfwSetCursorPosCallback(
 		app.getWindow(),
 		[](auto* window, double x, double y)
@@ -153,6 +183,9 @@ int main(void)
 
 	while (!glfwWindowShouldClose(app.getWindow()))
 	{
+		if (sceneData.uploadLoadedTextures())
+			mesh.updateMaterialsBuffer(sceneData);
+
 		fpsCounter.tick(app.getDeltaSeconds());
 
 		positioner.update(app.getDeltaSeconds(), mouseState.pos, mouseState.pressedLeft);
@@ -183,15 +216,29 @@ int main(void)
 
 		glNamedBufferSubData(perFrameDataBuffer.getHandle(), 0, kUniformBufferSize, &perFrameData);
 
-		// cull
-		*numVisibleMeshesPtr = 0;
-		programCulling.useProgram();
-		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_BoundingBoxes, boundingBoxesBuffer.getHandle());
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_DrawCommands, mesh.bufferIndirect_.getHandle());
-		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_NumVisibleMeshes, numVisibleMeshesBuffer.getHandle());
-		glDispatchCompute(1 + (GLuint)sceneData.shapes_.size() / 64, 1, 1);
-		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+		if (bucketsByMaterial != g_BucketByMaterial)
+		{
+			bucketsByMaterial = g_BucketByMaterial;
+			buckets = makeBuckets(bucketsByMaterial);
+			glNamedBufferSubData(drawBucketsBuffer.getHandle(), 0, buckets.bucketOfCommand_.size() * sizeof(uint32_t), buckets.bucketOfCommand_.data());
+			glNamedBufferSubData(drawBucketOffsetsBuffer.getHandle(), 0, buckets.offsets_.size() * sizeof(uint32_t), buckets.offsets_.data());
+		}
+
+		// cull (the counters are cleared on the GPU: the previous frame's draws may still read them)
+		if (g_EnableGPUCulling)
+		{
+			glClearNamedBufferSubData(drawCountsBuffer.getHandle(), GL_R32UI, 0, buckets.getNumBuckets() * sizeof(uint32_t), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+			programCulling.useProgram();
+			glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_BoundingBoxes, boundingBoxesBuffer.getHandle());
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_DrawCommands, mesh.bufferIndirect_.getHandle());
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_DrawCounts, drawCountsBuffer.getHandle());
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_CompactedDrawCommands, compactedCommands.getHandle());
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_DrawBuckets, drawBucketsBuffer.getHandle());
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_DrawBucketOffsets, drawBucketOffsetsBuffer.getHandle());
+			glDispatchCompute(1 + (GLuint)sceneData.shapes_.size() / 64, 1, 1);
+			glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+		}
 		const GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
 
 		// 1. Render scene
@@ -202,7 +249,16 @@ int main(void)
 		if (g_DrawMeshes)
 		{
 			program.useProgram();
-			mesh.draw(sceneData.shapes_.size());
+			if (g_EnableGPUCulling)
+			{
+				for (uint32_t b = 0; b != buckets.getNumBuckets(); b++)
+					if (buckets.sizes_[b])
+						mesh.drawIndirectCount(compactedCommands, buckets.offsets_[b], buckets.sizes_[b], drawCountsBuffer, b * sizeof(uint32_t), (b % 2) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT);
+			}
+			else
+			{
+				mesh.draw(sceneData.shapes_.size());
+			}
 		}
 
 		// 1.2 Grid
@@ -226,6 +282,11 @@ int main(void)
 		}
 		glDeleteSync(fence);
 
+		uint32_t numVisibleMeshes = g_EnableGPUCulling ? 0 : (uint32_t)sceneData.shapes_.size();
+		if (g_EnableGPUCulling)
+			for (uint32_t b = 0; b != buckets.getNumBuckets(); b++)
+				numVisibleMeshes += drawCountsPtr[b];
+
 		ImGuiIO& io = ImGui::GetIO();
 		io.DisplaySize = ImVec2((float)width, (float)height);
 		ImGui::NewFrame();
@@ -237,7 +298,10 @@ int main(void)
 		ImGui::Checkbox("Enable GPU culling", &g_EnableGPUCulling);
 		ImGui::Checkbox("Freeze culling frustum (P)", &g_FreezeCullingView);
 		ImGui::Separator();
-		ImGui::Text("Visible meshes: %i", *numVisibleMeshesPtr);
+		ImGui::Checkbox("Bucket by material", &g_BucketByMaterial);
+		ImGui::Text("Visible meshes: %u", numVisibleMeshes);
+		if (!bucketsByMaterial && g_EnableGPUCulling)
+			ImGui::Text("Opaque: %u, transparent: %u", drawCountsPtr[0] + drawCountsPtr[1], drawCountsPtr[2] + drawCountsPtr[3]);
 		ImGui::End();
 		ImGui::Render();
 		rendererUI.render(width, height, ImGui::GetDrawData());
@@ -245,7 +309,7 @@ int main(void)
 		app.swapBuffers();
 	}
 
-	glUnmapNamedBuffer(numVisibleMeshesBuffer.getHandle());
+	glUnmapNamedBuffer(drawCountsBuffer.getHandle());
 
 	return 0;
 }
@@ -59,8 +59,9 @@ int main(void)
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	glEnable(GL_DEPTH_TEST);
 
-	GLSceneData sceneData("data/meshes/bistro_all.meshes", "data/meshes/bistro_all.scene", "data/meshes/bistro_all.materials");
-	GLMesh mesh(sceneData);
+	// the first frames are drawn with placeholder textures
+	GLSceneData sceneData("data/meshes/bistro_all.meshes", "data/meshes/bistro_all.scene", "data/meshes/bistro_all.materials", true);
+	GLMesh mesh(sceneData, true);
 
 	glfwSetCursorPosCallback(
 		app.getWindow(),
@@ -168,6 +169,9 @@ int main(void)
 
 	while (!glfwWindowShouldClose(app.getWindow()))
 	{
+		if (sceneData.uploadLoadedTextures())
+			mesh.updateMaterialsBuffer(sceneData);
+
 		positioner.update(app.getDeltaSeconds(), mouseState.pos, mouseState.pressedLeft);
 
 		int width, height;
@@ -232,6 +236,8 @@ int main(void)
 		ImGui::Checkbox("Opaque meshes", &g_DrawOpaque);
 		ImGui::Checkbox("Transparent meshes", &g_DrawTransparent);
 		ImGui::Checkbox("Grid",  &g_DrawGrid);
+		ImGui::Separator();
+		ImGui::Text("%u shapes in %u instanced draw commands", (uint32_t)sceneData.shapes_.size(), (uint32_t)mesh.bufferIndirect_.drawCommands_.size());
 		ImGui::End();
 		ImGui::Render();
 		rendererUI.render(width, height, ImGui::GetDrawData());
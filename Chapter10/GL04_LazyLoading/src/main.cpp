@@ -34,6 +34,8 @@ Camera camera(positioner);
 bool g_DrawOpaque = true;
 bool g_DrawTransparent = true;
 bool g_DrawGrid = true;
+bool g_SpinNode = false;
+int g_SpinShape = 0;
 
 int main(void)
 {
@@ -60,7 +62,7 @@ int main(void)
 	glEnable(GL_DEPTH_TEST);
 
 	GLSceneDataLazy sceneData("data/meshes/bistro_all.meshes", "data/meshes/bistro_all.scene", "data/meshes/bistro_all.materials");
-	GLMesh mesh(sceneData);
+	GLMesh mesh(sceneData, true);
 
 	glfwSetCursorPosCallback(
 		app.getWindow(),
@@ -166,11 +168,41 @@ int main(void)
 		glNamedBufferSubData(oitAtomicCounter.getHandle(), 0, sizeof(uint32_t), &zero);
 	};
 
+	// the node spun around the center of its mesh, only the matrices of its shapes are uploaded
+	int spinNode = -1;
+	mat4 spinNodeTransform(1.0f);
+	float spinAngle = 0.0f;
+
 	while (!glfwWindowShouldClose(app.getWindow()))
 	{
 		if (sceneData.uploadLoadedTextures())
 			mesh.updateMaterialsBuffer(sceneData);
 
+		const int nodeToSpin = g_SpinNode && !sceneData.shapes_.empty() ? (int)sceneData.shapes_[g_SpinShape].transformIndex : -1;
+
+		if (spinNode != nodeToSpin && spinNode >= 0)
+		{
+			sceneData.scene_.localTransform_[spinNode] = spinNodeTransform;
+			markAsChanged(sceneData.scene_, spinNode);
+		}
+		if (spinNode != nodeToSpin && nodeToSpin >= 0)
+			spinNodeTransform = sceneData.scene_.localTransform_[nodeToSpin];
+
+		spinNode = nodeToSpin;
+
+		if (spinNode >= 0)
+		{
+			const BoundingBox& box = sceneData.meshData_.boxes_[sceneData.shapes_[g_SpinShape].meshIndex];
+			const vec3 center = 0.5f * (box.min_ + box.max_);
+			spinAngle += app.getDeltaSeconds();
+			sceneData.scene_.localTransform_[spinNode] = spinNodeTransform *
+				glm::translate(mat4(1.0f), center) * glm::rotate(mat4(1.0f), spinAngle, vec3(0.0f, 1.0f, 0.0f)) * glm::translate(mat4(1.0f), -center);
+			markAsChanged(sceneData.scene_, spinNode);
+		}
+
+		recalculateGlobalTransforms(sceneData.scene_);
+		mesh.updateMatrices(sceneData);
+
 		positioner.update(app.getDeltaSeconds(), mouseState.pos, mouseState.pressedLeft);
 
 		int width, height;
@@ -235,6 +267,12 @@ int main(void)
 		ImGui::Checkbox("Opaque meshes", &g_DrawOpaque);
 		ImGui::Checkbox("Transparent meshes", &g_DrawTransparent);
 		ImGui::Checkbox("Grid",  &g_DrawGrid);
+		ImGui::Separator();
+		ImGui::Text("%u shapes in %u instanced draw commands", (uint32_t)sceneData.shapes_.size(), (uint32_t)mesh.bufferIndirect_.drawCommands_.size());
+		ImGui::Separator();
+		ImGui::Checkbox("Spin node", &g_SpinNode);
+		ImGui::SliderInt("Shape", &g_SpinShape, 0, std::max((int)sceneData.shapes_.size() - 1, 0));
+		ImGui::Text("Transforms: %llu bytes uploaded", (unsigned long long)mesh.getTransformUploadStats().uploadedBytes_);
 		ImGui::End();
 		ImGui::Render();
 		rendererUI.render(width, height, ImGui::GetDrawData());
@@ -6,6 +6,7 @@
 #include "shared/glFramework/GLShader.h"
 #include "shared/glFramework/GLSceneDataLazy.h"
 #include "shared/glFramework/GLFramebuffer.h"
+#include "shared/glFramework/GLSSAOTargets.h"
 #include "shared/glFramework/LineCanvasGL.h"
 #include "shared/glFramework/UtilsGLImGui.h"
 #include "shared/UtilsMath.h"
@@ -101,6 +102,8 @@ int main(void)
 	GLShader shdCombineSSAOFrag("data/shaders/chapter08/GL02_SSAO_combine.frag");
 	GLProgram progSSAO(shdFullScreenQuadVert, shdSSAOFrag);
 	GLProgram progCombineSSAO(shdFullScreenQuadVert, shdCombineSSAOFrag);
+	GLShader shdDownsampleDepthFrag("data/shaders/chapter08/GL02_SSAODownsampleDepth.frag");
+	GLProgram progDownsampleDepth(shdFullScreenQuadVert, shdDownsampleDepthFrag);
 	// blur
 	GLShader shdBlurXFrag("data/shaders/chapter08/GL02_BlurX.frag");
 	GLShader shdBlurYFrag("data/shaders/chapter08/GL02_BlurY.frag");
@@ -240,8 +243,10 @@ int main(void)
 	GLFramebuffer brightPass(256, 256, GL_RGBA16F, 0);
 	GLFramebuffer bloom1(256, 256, GL_RGBA16F, 0);
 	GLFramebuffer bloom2(256, 256, GL_RGBA16F, 0);
-	GLFramebuffer ssao(1024, 1024, GL_RGBA8, 0);
-	GLFramebuffer blur(1024, 1024, GL_RGBA8, 0);
+	// SSAO at half resolution
+	SSAOTargets ssaoTargets(width, height, 2);
+	GLFramebuffer& ssao = ssaoTargets.ssao;
+	GLFramebuffer& blur = ssaoTargets.blur;
 	// create a texture view into the last mip-level (1x1 pixel) of our luminance framebuffer
 	GLuint luminance1x1;
 	glGenTextures(1, &luminance1x1);
@@ -420,9 +425,8 @@ int main(void)
 		}
 		if (g_DrawBoxes)
 		{
-			DrawElementsIndirectCommand* cmd = mesh.bufferIndirect_.drawCommands_.data();
-			for (const auto& c : sceneData.shapes_)
-				drawBox3dGL(canvas, mat4(1.0f), sceneData.meshData_.boxes_[c.meshIndex], vec4(0, 1, 0, 1));
+			for (const auto& b : reorderedBoxes)
+				drawBox3dGL(canvas, mat4(1.0f), b, vec4(0, 1, 0, 1));
 		}
 		drawBox3dGL(canvas, mat4(1.0f), bigBox, vec4(1, 1, 1, 1));
 		if (g_DrawTransparent)
@@ -452,9 +456,10 @@ int main(void)
 			glDisable(GL_DEPTH_TEST);
 			glClearNamedFramebufferfv(ssao.getHandle(), GL_COLOR, 0, glm::value_ptr(vec4(0.0f, 0.0f, 0.0f, 1.0f)));
 			glNamedBufferSubData(perFrameDataBuffer.getHandle(), 0, sizeof(g_SSAOParams), &g_SSAOParams);
+			const GLuint depthSSAO = ssaoTargets.downsampleDepth(progDownsampleDepth, opaqueFramebuffer.getTextureDepth().getHandle());
 			ssao.bind();
 			progSSAO.useProgram();
-			glBindTextureUnit(0, opaqueFramebuffer.getTextureDepth().getHandle());
+			glBindTextureUnit(0, depthSSAO);
 			glBindTextureUnit(1, rotationPattern.getHandle());
 			glDrawArrays(GL_TRIANGLES, 0, 6);
 			ssao.unbind();
@@ -478,6 +483,8 @@ int main(void)
 			progCombineSSAO.useProgram();
 			glBindTextureUnit(0, opaqueFramebuffer.getTextureColor().getHandle());
 			glBindTextureUnit(1, ssao.getTextureColor().getHandle());
+			glBindTextureUnit(2, opaqueFramebuffer.getTextureDepth().getHandle());
+			glBindTextureUnit(3, depthSSAO);
 			glDrawArrays(GL_TRIANGLES, 0, 6);
 			framebuffer.unbind();
 		}
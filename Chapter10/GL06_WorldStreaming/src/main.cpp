@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "shared/glFramework/GLFWApp.h"
+#include "shared/glFramework/GLShader.h"
+#include "shared/glFramework/GLStreamedWorld.h"
+#include "shared/glFramework/UtilsGLImGui.h"
+#include "shared/UtilsMath.h"
+#include "shared/Camera.h"
+#include "Chapter9/GLMesh9.h"
+#include "Chapter10/GLSkyboxRenderer.h"
+
+struct PerFrameData
+{
+	mat4 view;
+	mat4 proj;
+	mat4 light = mat4(0.0f); // unused in this demo
+	vec4 cameraPos;
+};
+
+struct MouseState
+{
+	glm::vec2 pos = glm::vec2(0.0f);
+	bool pressedLeft = false;
+} mouseState;
+
+CameraPositioner_FirstPerson positioner(vec3(0.0f, 3.0f, 0.0f), vec3(0.0f, 0.0f, -1.0f), vec3(0.0f, 1.0f, 0.0f));
+Camera camera(positioner);
+
+bool g_DrawGrid = true;
+
+/**
+	Renders the world written by 'Ch10_Util01_WorldStreaming partition': the sectors around the camera are loaded
+	in the background and only their ranges of the vertex and index pools are uploaded (see GLStreamedWorldBuffers)
+*/
+int main(void)
+{
+	WorldDescription worldDesc;
+	loadWorld("data/meshes/world/bistro.world", worldDesc);
+
+	if (worldDesc.sectors_.empty())
+	{
+		printf("No sectors, run 'Ch10_Util01_WorldStreaming partition' first\n");
+		exit(EXIT_FAILURE);
+	}
+
+	GLApp app;
+
+	GLShader shdGridVert("data/shaders/chapter05/GL01_grid.vert");
+	GLShader shdGridFrag("data/shaders/chapter05/GL01_grid.frag");
+	GLProgram progGrid(shdGridVert, shdGridFrag);
+	GLShader shaderVert("data/shaders/chapter10/GL01_scene_IBL.vert");
+	GLShader shaderFrag("data/shaders/chapter10/GL01_scene_IBL.frag");
+	GLProgram program(shaderVert, shaderFrag);
+
+	const GLsizeiptr kUniformBufferSize = sizeof(PerFrameData);
+	GLBuffer perFrameDataBuffer(kUniformBufferSize, nullptr, GL_DYNAMIC_STORAGE_BIT);
+	glBindBufferRange(GL_UNIFORM_BUFFER, kBufferIndex_PerFrameUniforms, perFrameDataBuffer.getHandle(), 0, kUniformBufferSize);
+
+	glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glEnable(GL_DEPTH_TEST);
+
+	WorldStreamingParams params;
+	StreamedWorld world(worldDesc, params);
+	GLStreamedWorldBuffers worldBuffers(world);
+
+	// start in the middle of the world at the eye height
+	std::vector<BoundingBox> sectorBoxes;
+	for (const auto& s: worldDesc.sectors_)
+		sectorBoxes.push_back(s.box_);
+	const BoundingBox worldBox = combineBoxes(sectorBoxes);
+
+	positioner.setPosition(vec3(0.5f * (worldBox.min_.x + worldBox.max_.x), worldBox.min_.y + 2.0f, 0.5f * (worldBox.min_.z + worldBox.max_.z)));
+	positioner.maxSpeed_ = 5.0f;
+
+	glfwSetCursorPosCallback(
+		app.getWindow(),
+		[](auto* window, double x, double y)
+		{
+			int width, height;
+			glfwGetFramebufferSize(window, &width, &height);
+			mouseState.pos.x = static_cast<float>(x / width);
+			mouseState.pos.y = static_cast<float>(y / height);
+			ImGui::GetIO().MousePos = ImVec2((float)x, (float)y);
+		}
+	);
+
+	glfwSetMouseButtonCallback(
+		app.getWindow(),
+		[](auto* window, int button, int action, int mods)
+		{
+			auto& io = ImGui::GetIO();
+			const int idx = button == GLFW_MOUSE_BUTTON_LEFT ? 0 : button == GLFW_MOUSE_BUTTON_RIGHT ? 2 : 1;
+			io.MouseDown[idx] = action == GLFW_PRESS;
+
+			if (!io.WantCaptureMouse)
+				if (button == GLFW_MOUSE_BUTTON_LEFT)
+					mouseState.pressedLeft = action == GLFW_PRESS;
+		}
+	);
+
+	glfwSetKeyCallback(
+		app.getWindow(),
+		[](GLFWwindow* window, int key, int scancode, int action, int mods)
+		{
+			const bool pressed = action != GLFW_RELEASE;
+			if (key == GLFW_KEY_ESCAPE && pressed)
+				glfwSetWindowShouldClose(window, GLFW_TRUE);
+			if (key == GLFW_KEY_W)
+				positioner.movement_.forward_ = pressed;
+			if (key == GLFW_KEY_S)
+				positioner.movement_.backward_ = pressed;
+			if (key == GLFW_KEY_A)
+				positioner.movement_.left_ = pressed;
+			if (key == GLFW_KEY_D)
+				positioner.movement_.right_ = pressed;
+			if (key == GLFW_KEY_1)
+				positioner.movement_.up_ = pressed;
+			if (key == GLFW_KEY_2)
+				positioner.movement_.down_ = pressed;
+			if (key == GLFW_KEY_LEFT_SHIFT || key == GLFW_KEY_RIGHT_SHIFT)
+				positioner.movement_.fastSpeed_ = pressed;
+			if (key == GLFW_KEY_SPACE)
+				positioner.setUpVector(vec3(0.0f, 1.0f, 0.0f));
+		}
+	);
+
+	GLSkyboxRenderer skybox;
+	ImGuiGLRenderer rendererUI;
+
+	while (!glfwWindowShouldClose(app.getWindow()))
+	{
+		positioner.update(app.getDeltaSeconds(), mouseState.pos, mouseState.pressedLeft);
+
+		// never waits for the disk, the new sectors become visible in the frame they are spliced
+		if (world.update(camera.getPosition()))
+		{
+			recalculateGlobalTransforms(world.scene_);
+			worldBuffers.updateDrawData(world);
+		}
+
+		worldBuffers.upload(world);
+
+		int width, height;
+		glfwGetFramebufferSize(app.getWindow(), &width, &height);
+		const float ratio = width / (float)height;
+
+		glViewport(0, 0, width, height);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		const mat4 proj = glm::perspective(45.0f, ratio, 0.1f, 1000.0f);
+		const mat4 view = camera.getViewMatrix();
+		const PerFrameData perFrameData = { .view = view, .proj = proj, .light = mat4(0.0f), .cameraPos = glm::vec4(camera.getPosition(), 1.0f) };
+
+		glNamedBufferSubData(perFrameDataBuffer.getHandle(), 0, kUniformBufferSize, &perFrameData);
+
+		glDisable(GL_BLEND);
+		skybox.draw();
+
+		program.useProgram();
+		worldBuffers.draw(kBufferIndex_ModelMatrices, kBufferIndex_Materials);
+
+		if (g_DrawGrid)
+		{
+			glEnable(GL_BLEND);
+			progGrid.useProgram();
+			glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, 6, 1, 0);
+			glDisable(GL_BLEND);
+		}
+
+		const WorldStreamingStats& stats = world.getStats();
+		const GLStreamedWorldStats& uploads = worldBuffers.getStats();
+
+		ImGuiIO& io = ImGui::GetIO();
+		io.DisplaySize = ImVec2((float)width, (float)height);
+		ImGui::NewFrame();
+		ImGui::Begin("Control", nullptr);
+		ImGui::Checkbox("Grid", &g_DrawGrid);
+		ImGui::Separator();
+		ImGui::Text("Sectors: %u resident, %u loading of %zu", stats.numResident_, stats.numLoading_, worldDesc.sectors_.size());
+		ImGui::Text("Resident: %.1f MB of %.1f MB budget", (double)stats.residentBytes_ / (1024.0 * 1024.0), (double)params.memoryBudget_ / (1024.0 * 1024.0));
+		ImGui::Text("Draw commands: %u", uploads.numDrawCommands_);
+		ImGui::Text("Uploaded: %u ranges, %.1f KB this frame, %.1f MB total", uploads.numRanges_,
+			(double)uploads.uploadedBytes_ / 1024.0, (double)uploads.totalUploadedBytes_ / (1024.0 * 1024.0));
+		ImGui::End();
+		ImGui::Render();
+		rendererUI.render(width, height, ImGui::GetDrawData());
+
+		app.swapBuffers();
+	}
+
+	return 0;
+}
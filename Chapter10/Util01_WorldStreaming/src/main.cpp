@@ -0,0 +1,214 @@
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+#include "shared/scene/WorldStreaming.h"
+
+namespace fs = std::filesystem;
+
+const char* kWorldFile = "data/meshes/world/bistro.world";
+
+/* Splits the Bistro scene produced by Ch7_Tool01_SceneConverter into sectors, the world is made of tilesX x tilesZ copies of it */
+void partition(int tilesX, int tilesZ, float sectorSize)
+{
+	Scene scene;
+	MeshData meshData;
+	std::vector<MaterialDescription> materials;
+	std::vector<std::string> textureFiles;
+
+	MeshLoadStats loadStats;
+	const MeshFileHeader header = loadMeshData("data/meshes/bistro_all.meshes", meshData, &loadStats);
+	printMeshLoadStats("data/meshes/bistro_all.meshes", header, loadStats);
+	loadScene("data/meshes/bistro_all.scene", scene);
+	loadMaterials("data/meshes/bistro_all.materials", materials, textureFiles);
+
+	fs::create_directories("data/meshes/world");
+
+	const WorldDescription world = partitionWorld(scene, meshData, materials, textureFiles, sectorSize, "data/meshes/world/bistro", tilesX, tilesZ);
+	saveWorld(kWorldFile, world);
+
+	printf("[Partition] %zu sector files, %zu sectors (%d x %d tiles, sector size %.1f)\n",
+		world.sectorFiles_.size(), world.sectors_.size(), tilesX, tilesZ, sectorSize);
+}
+
+/* Text file with 'x y z' camera positions, one per frame */
+std::vector<vec3> loadCameraPath(const char* fileName)
+{
+	std::vector<vec3> path;
+
+	FILE* f = fopen(fileName, "r");
+
+	if (!f)
+		return path;
+
+	vec3 p;
+	while (fscanf(f, "%f %f %f", &p.x, &p.y, &p.z) == 3)
+		path.push_back(p);
+
+	fclose(f);
+
+	return path;
+}
+
+/* A diagonal sweep over the whole world at the eye height and back */
+std::vector<vec3> makeSweepPath(const WorldDescription& world, uint32_t numFrames)
+{
+	vec3 minP(std::numeric_limits<float>::max());
+	vec3 maxP(std::numeric_limits<float>::lowest());
+
+	for (const auto& s: world.sectors_)
+	{
+		minP = glm::min(minP, s.box_.min_);
+		maxP = glm::max(maxP, s.box_.max_);
+	}
+
+	std::vector<vec3> path(numFrames);
+
+	for (uint32_t i = 0 ; i != numFrames ; i++)
+	{
+		const float t = 1.0f - fabsf(2.0f * (float)i / (float)(numFrames - 1) - 1.0f);
+		path[i] = vec3(minP.x + t * (maxP.x - minP.x), minP.y + 2.0f, minP.z + t * (maxP.z - minP.z));
+	}
+
+	return path;
+}
+
+/**
+	Replays a camera path at 60 frames per second without a window and checks the residency invariants every frame:
+	the memory budget is never exceeded, no sector farther than the unload radius stays resident and the streamed scene
+	is consistent. Load latency (frames between a sector entering the load radius and becoming resident) and the time of
+	StreamedWorld::update() are reported
+*/
+int replay(const char* pathFile, const WorldStreamingParams& params)
+{
+	WorldDescription world;
+	loadWorld(kWorldFile, world);
+
+	std::vector<vec3> path = pathFile ? loadCameraPath(pathFile) : std::vector<vec3>();
+	if (path.empty())
+		path = makeSweepPath(world, 1200);
+
+	StreamedWorld streamed(world, params);
+
+	const uint32_t numSectors = (uint32_t)world.sectors_.size();
+	// the frame when a sector entered the load radius (-1 if it is outside or resident)
+	std::vector<int> requestedAt(numSectors, -1);
+
+	uint32_t maxLatency = 0;
+	uint64_t sumLatency = 0;
+	uint32_t numLatencies = 0;
+	double maxUpdateMs = 0.0;
+	double sumUpdateMs = 0.0;
+	uint64_t uploadedBytes = 0;
+	uint32_t numFailures = 0;
+
+	auto fail = [&numFailures](int frame, const char* what)
+	{
+		printf("Frame %d: %s\n", frame, what);
+		numFailures++;
+	};
+
+	const auto frameTime = std::chrono::microseconds(16667);
+	auto nextFrame = std::chrono::steady_clock::now();
+
+	for (int frame = 0 ; frame != (int)path.size() ; frame++)
+	{
+		const vec3& cam = path[frame];
+
+		const auto start = std::chrono::high_resolution_clock::now();
+		if (streamed.update(cam))
+			recalculateGlobalTransforms(streamed.scene_);
+		const double ms = 0.001 * std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+
+		maxUpdateMs = std::max(maxUpdateMs, ms);
+		sumUpdateMs += ms;
+
+		// the ranges GLStreamedWorldBuffers uploads into buffers allocated with the pool capacities (see Ch10_SampleGL06_WorldStreaming)
+		for (const auto& u: streamed.takeUploads())
+			uploadedBytes += (uint64_t)u.count_ * (u.indices_ ? sizeof(uint32_t) : 8 * sizeof(float));
+
+		const WorldStreamingStats& stats = streamed.getStats();
+
+		if (stats.reservedBytes_ > params.memoryBudget_)
+			fail(frame, "memory budget exceeded");
+
+		if (!streamed.checkConsistency())
+			fail(frame, "inconsistent streamed scene");
+
+		for (uint32_t i = 0 ; i != numSectors ; i++)
+		{
+			const float d = streamed.getSectorDistance(i, cam);
+			const eSectorState state = streamed.getSectorState(i);
+
+			if (state == eSectorState_Resident && d > params.unloadRadius_)
+				fail(frame, "a sector outside of the unload radius is resident");
+
+			if (state == eSectorState_Resident && requestedAt[i] > -1)
+			{
+				const uint32_t latency = (uint32_t)(frame - requestedAt[i]);
+				maxLatency = std::max(maxLatency, latency);
+				sumLatency += latency;
+				numLatencies++;
+			}
+
+			if (state != eSectorState_Resident && d <= params.loadRadius_)
+				requestedAt[i] = requestedAt[i] > -1 ? requestedAt[i] : frame;
+			else
+				requestedAt[i] = -1;
+		}
+
+		nextFrame += frameTime;
+		std::this_thread::sleep_until(nextFrame);
+	}
+
+	streamed.finishLoads();
+
+	const WorldStreamingStats& stats = streamed.getStats();
+
+	printf("[Replay] %zu frames, %u sectors: %u loads, %u unloads, %u postponed loads, %.1f MB uploaded\n",
+		path.size(), numSectors, stats.numLoaded_, stats.numUnloaded_, stats.numPostponed_, (double)uploadedBytes / (1024.0 * 1024.0));
+	printf("   load latency: %.1f frames average, %u frames max\n", numLatencies ? (double)sumLatency / numLatencies : 0.0, maxLatency);
+	printf("   update(): %.3f ms average, %.3f ms max\n", path.empty() ? 0.0 : sumUpdateMs / path.size(), maxUpdateMs);
+
+	if (numFailures)
+	{
+		printf("%u residency checks failed\n", numFailures);
+		return EXIT_FAILURE;
+	}
+
+	return 0;
+}
+
+/**
+	Usage:
+		Ch10_Util01_WorldStreaming partition [tilesX] [tilesZ] [sector size]
+		Ch10_Util01_WorldStreaming replay [camera path] [load radius] [unload radius] [memory budget in MB]
+*/
+int main(int argc, char* argv[])
+{
+	const std::string mode = argc > 1 ? argv[1] : "replay";
+
+	if (mode == "partition")
+	{
+		partition(
+			argc > 2 ? atoi(argv[2]) : 4,
+			argc > 3 ? atoi(argv[3]) : 4,
+			argc > 4 ? (float)atof(argv[4]) : 20.0f);
+		return 0;
+	}
+
+	if (mode == "replay")
+	{
+		WorldStreamingParams params;
+
+		if (argc > 3) params.loadRadius_ = (float)atof(argv[3]);
+		if (argc > 4) params.unloadRadius_ = (float)atof(argv[4]);
+		if (argc > 5) params.memoryBudget_ = (uint64_t)atoll(argv[5]) * 1024 * 1024;
+
+		return replay(argc > 2 ? argv[2] : nullptr, params);
+	}
+
+	printf("Unknown mode '%s', use 'partition' or 'replay'\n", mode.c_str());
+
+	return EXIT_FAILURE;
+}
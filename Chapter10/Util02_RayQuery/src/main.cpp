@@ -0,0 +1,132 @@
+#include <chrono>
+
+#include "shared/RayQuery.h"
+
+using glm::mat4;
+
+double getMs(std::chrono::high_resolution_clock::time_point start)
+{
+	return 0.001 * std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void printRate(const char* what, size_t numRays, double ms)
+{
+	printf("   %-28s %8.2f ms  %6.2f Mrays/s\n", what, ms, ms > 0.0 ? 0.001 * (double)numRays / ms : 0.0);
+}
+
+/**
+	Builds the two-level BVH for the Bistro scene produced by Ch7_Tool01_SceneConverter and measures the ray throughput:
+	primary rays from the Chapter 10 demo camera (single rays vs packets, both on one thread), shadow rays from
+	their hit points and a refit of the top level
+
+	Usage:
+		Ch10_Util02_RayQuery [width] [height]
+*/
+int main(int argc, char* argv[])
+{
+	const int width  = argc > 1 ? atoi(argv[1]) : 1280;
+	const int height = argc > 2 ? atoi(argv[2]) : 720;
+
+	Scene scene;
+	MeshData meshData;
+
+	MeshLoadStats loadStats;
+	const MeshFileHeader header = loadMeshData("data/meshes/bistro_all.meshes", meshData, &loadStats);
+	printMeshLoadStats("data/meshes/bistro_all.meshes", header, loadStats);
+	loadScene("data/meshes/bistro_all.scene", scene);
+
+	sortSceneByDepth(scene);
+	recalculateAllGlobalTransforms(scene);
+
+	// one worker thread, so that packets and single rays are compared on one thread each
+	RayQuery rayQuery(1);
+	rayQuery.buildMeshes(meshData);
+	rayQuery.buildInstances(scene);
+
+	const RayQueryStats& stats = rayQuery.getStats();
+
+	printf("[Build] %u triangles, %u mesh BVH nodes: %.2f ms\n", stats.numTriangles_, stats.numMeshNodes_, stats.meshBuildMs_);
+	printf("        %u instances, %u top-level nodes: %.2f ms\n", stats.numInstances_, stats.numInstanceNodes_, stats.instanceBuildMs_);
+
+	// the same view as in Ch10_GL05_Final
+	const mat4 view = glm::lookAt(vec3(-10.0f, 3.0f, 3.0f), vec3(-10.0f, 3.0f, 2.0f), vec3(0.0f, 1.0f, 0.0f));
+	const mat4 proj = glm::perspective(45.0f, (float)width / (float)height, 0.5f, 5000.0f);
+
+	// tiles of 4x2 pixels, so that every packet is made of adjacent rays
+	std::vector<Ray> rays;
+	rays.reserve((size_t)width * height);
+
+	for (int y = 0 ; y < height ; y += 2)
+		for (int x = 0 ; x < width ; x += 4)
+			for (int j = y ; j != std::min(y + 2, height) ; j++)
+				for (int i = x ; i != std::min(x + 4, width) ; i++)
+					rays.push_back(getPrimaryRay(view, proj, (float)i + 0.5f, (float)j + 0.5f, width, height));
+
+	printf("[Primary] %d x %d\n", width, height);
+
+	std::vector<RayHit> hits(rays.size());
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0 ; i != rays.size() ; i++)
+		rayQuery.closestHit(rays[i], hits[i]);
+	printRate("single rays:", rays.size(), getMs(start));
+
+	std::vector<RayHit> packetHits;
+
+	start = std::chrono::high_resolution_clock::now();
+	rayQuery.closestHits(rays, packetHits);
+	printRate("packets:", rays.size(), getMs(start));
+
+	uint32_t numHits = 0;
+	uint32_t numMismatches = 0;
+
+	for (size_t i = 0 ; i != rays.size() ; i++)
+	{
+		numHits += hits[i].isHit() ? 1 : 0;
+		numMismatches += (hits[i].isHit() != packetHits[i].isHit() || fabsf(hits[i].t_ - packetHits[i].t_) > 1e-3f * hits[i].t_) ? 1 : 0;
+	}
+
+	// rays grazing triangle edges can differ when the compiler contracts the packet loops differently
+	printf("   %u hits, %u mismatches between single rays and packets\n", numHits, numMismatches);
+
+	// shadow rays towards a directional light (see the light of Ch10_GL05_Final)
+	const vec3 toLight = glm::normalize(vec3(-0.3f, 1.0f, 0.2f));
+
+	std::vector<Ray> shadowRays;
+	shadowRays.reserve(numHits);
+
+	for (size_t i = 0 ; i != rays.size() ; i++)
+		if (hits[i].isHit())
+			shadowRays.push_back(Ray {
+				.origin_ = rays[i].origin_ + hits[i].t_ * rays[i].dir_,
+				.dir_ = toLight,
+				.tMin_ = 1e-3f
+			});
+
+	printf("[Shadow]\n");
+
+	uint32_t numOccluded = 0;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (const auto& r: shadowRays)
+		numOccluded += rayQuery.anyHit(r) ? 1 : 0;
+	printRate("single rays:", shadowRays.size(), getMs(start));
+
+	std::vector<uint8_t> occluded;
+
+	start = std::chrono::high_resolution_clock::now();
+	rayQuery.anyHits(shadowRays, occluded);
+	printRate("packets:", shadowRays.size(), getMs(start));
+
+	printf("   %u of %zu hit points are in shadow\n", numOccluded, shadowRays.size());
+
+	// moving the whole scene touches every instance
+	scene.localTransform_[0] = glm::translate(mat4(1.0f), vec3(0.0f, 1.0f, 0.0f)) * scene.localTransform_[0];
+	markAsChanged(scene, 0);
+	recalculateGlobalTransforms(scene);
+
+	rayQuery.refitInstances(scene);
+	printf("[Refit] %.3f ms\n", stats.refitMs_);
+
+	return 0;
+}
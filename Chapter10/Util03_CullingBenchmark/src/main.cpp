@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "shared/OcclusionCuller.h"
+#include "shared/scene/Material.h"
+#include "shared/scene/Scene.h"
+#include "shared/scene/VtxData.h"
+
+using glm::mat4;
+
+struct BenchmarkResult
+{
+	uint32_t numFrames_ = 0;
+	double avgFrustumVisible_ = 0.0;
+	double avgVisible_ = 0.0;
+	double avgMs_ = 0.0;
+	double maxMs_ = 0.0;
+};
+
+/* Frustum + occlusion culling of all shapes along a camera path, without rendering */
+BenchmarkResult runBenchmark(OcclusionCuller& culler, const std::vector<mat4>& views, const mat4& proj, const std::vector<BoundingBox>& boxes)
+{
+	BenchmarkResult r = { .numFrames_ = (uint32_t)views.size() };
+
+	std::vector<uint8_t> visible;
+
+	for (const mat4& view : views)
+	{
+		vec4 frustumPlanes[6];
+		getFrustumPlanes(proj * view, frustumPlanes);
+		vec4 frustumCorners[8];
+		getFrustumCorners(proj * view, frustumCorners);
+
+		culler.renderOccluders(proj * view);
+		culler.cullBoxes(boxes, visible);
+
+		uint32_t numFrustum = 0;
+		uint32_t numVisible = 0;
+
+		for (size_t i = 0; i != boxes.size(); i++)
+			if (isBoxInFrustum(frustumPlanes, frustumCorners, boxes[i]))
+			{
+				numFrustum++;
+				numVisible += visible[i];
+			}
+
+		const double ms = culler.getStats().rasterMs_ + culler.getStats().testMs_;
+
+		r.avgFrustumVisible_ += numFrustum;
+		r.avgVisible_ += numVisible;
+		r.avgMs_ += ms;
+		r.maxMs_ = std::max(r.maxMs_, ms);
+	}
+
+	if (r.numFrames_)
+	{
+		r.avgFrustumVisible_ /= r.numFrames_;
+		r.avgVisible_ /= r.numFrames_;
+		r.avgMs_ /= r.numFrames_;
+	}
+
+	return r;
+}
+
+void printResult(const char* pathName, const BenchmarkResult& r)
+{
+	printf("%-12s frames: %4u   frustum visible: %8.1f   occlusion visible: %8.1f   occluded: %5.1f%%   culling: avg %.3f ms, max %.3f ms\n",
+		pathName, r.numFrames_, r.avgFrustumVisible_, r.avgVisible_,
+		r.avgFrustumVisible_ > 0.0 ? 100.0 * (1.0 - r.avgVisible_ / r.avgFrustumVisible_) : 0.0, r.avgMs_, r.maxMs_);
+}
+
+/**
+	Software occlusion culling of the Bistro scene produced by Ch7_Tool01_SceneConverter (the culler of Ch10_GL01_CullingCPU)
+	along two fixed camera paths: a street-level orbit around the scene and a full turn from the initial camera position of the demo
+
+	Usage:
+		Ch10_Util03_CullingBenchmark [width] [height] [frames]
+*/
+int main(int argc, char* argv[])
+{
+	const int width     = argc > 1 ? atoi(argv[1]) : 1280;
+	const int height    = argc > 2 ? atoi(argv[2]) : 720;
+	const int numFrames = argc > 3 ? atoi(argv[3]) : 360;
+
+	Scene scene;
+	MeshData meshData;
+	std::vector<MaterialDescription> materials;
+	std::vector<std::string> textureFiles;
+
+	MeshLoadStats loadStats;
+	const MeshFileHeader header = loadMeshData("data/meshes/bistro_all.meshes", meshData, &loadStats);
+	printMeshLoadStats("data/meshes/bistro_all.meshes", header, loadStats);
+	loadScene("data/meshes/bistro_all.scene", scene);
+	loadMaterials("data/meshes/bistro_all.materials", materials, textureFiles);
+
+	sortSceneByDepth(scene);
+	recalculateAllGlobalTransforms(scene);
+
+	// the shapes of GLSceneData::createShapes()
+	std::vector<DrawData> shapes;
+
+	for (const auto& c: scene.meshes_)
+	{
+		const auto material = scene.materialForNode_.find(c.first);
+		if (material != scene.materialForNode_.end())
+			shapes.push_back(DrawData {
+				.meshIndex = c.second,
+				.materialIndex = material->second,
+				.LOD = 0,
+				.indexOffset = meshData.meshes_[c.second].indexOffset,
+				.vertexOffset = meshData.meshes_[c.second].vertexOffset,
+				.transformIndex = c.first
+			});
+	}
+
+	sortDrawDataForInstancing(shapes);
+
+	// world space boxes and occluders as in Ch10_GL01_CullingCPU
+	std::vector<BoundingBox> shapeBoxes;
+	std::vector<bool> canOcclude;
+	for (const auto& c : shapes)
+	{
+		const MaterialDescription& mtl = materials[c.materialIndex];
+		shapeBoxes.push_back(meshData.boxes_[c.meshIndex].getTransformed(scene.globalTransform_[c.transformIndex]));
+		// alpha-tested foliage and transparent shapes do not hide anything
+		canOcclude.push_back(!(mtl.flags_ & sMaterialFlags_Transparent) && mtl.opacityMap_ == INVALID_TEXTURE && mtl.alphaTest_ == 0.0f);
+	}
+
+	const BoundingBox fullScene = combineBoxes(shapeBoxes);
+
+	OcclusionCuller culler;
+	culler.setOccluders(gatherOccluderTriangles(meshData, shapes, scene.globalTransform_, shapeBoxes, canOcclude));
+
+	printf("%zu shapes, %u occluder triangles, %d x %d\n", shapes.size(), culler.getStats().numOccluderTriangles_, width, height);
+
+	// the projection and the initial camera of Ch10_GL01_CullingCPU
+	const mat4 proj = glm::perspective(45.0f, (float)width / (float)height, 0.1f, 1000.0f);
+	const vec3 cameraPos(-10.0f, 3.0f, 3.0f);
+
+	const vec3 center = 0.5f * (fullScene.min_ + fullScene.max_);
+	const vec3 size = fullScene.getSize();
+	const float eyeHeight = fullScene.min_.y + 2.0f;
+
+	std::vector<mat4> orbit, pan;
+	for (int i = 0; i != numFrames; i++)
+	{
+		const float a = Math::TWOPI * (float)i / numFrames;
+		const vec3 dir(cosf(a), 0.0f, sinf(a));
+		const vec3 pos = vec3(center.x, eyeHeight, center.z) + 0.25f * vec3(size.x * dir.x, 0.0f, size.z * dir.z);
+		orbit.push_back(glm::lookAt(pos, pos + vec3(-dir.z, 0.0f, dir.x), vec3(0.0f, 1.0f, 0.0f)));
+		pan.push_back(glm::lookAt(cameraPos, cameraPos + dir, vec3(0.0f, 1.0f, 0.0f)));
+	}
+
+	printResult("Orbit", runBenchmark(culler, orbit, proj, shapeBoxes));
+	printResult("Camera pan", runBenchmark(culler, pan, proj, shapeBoxes));
+
+	return 0;
+}
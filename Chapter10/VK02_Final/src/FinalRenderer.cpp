@@ -20,9 +20,9 @@ BaseMultiRenderer::BaseMultiRenderer(
 	const uint32_t indirectDataSize = (uint32_t)sceneData_.shapes_.size() * sizeof(VkDrawIndirectCommand);
 
 	const size_t imgCount = ctx.vkDev.swapchainImages.size();
-	uniforms_.resize(imgCount);
 	shape_.resize(imgCount);
 	indirect_.resize(imgCount);
+	indirectShadow_.resize(imgCount);
 
 	descriptorSets_.resize(imgCount);
 
@@ -42,7 +42,7 @@ BaseMultiRenderer::BaseMultiRenderer(
 
 	DescriptorSetInfo dsInfo = {
 		.buffers = {
-			uniformBufferAttachment(VulkanBuffer {},         0, uniformBufferSize, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT),
+			dynamicUniformBufferAttachment(ctx.frameRing.getBuffer(), uniformBufferSize, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT),
 			sceneData_.vertexBuffer_,
 			sceneData_.indexBuffer_,
 			storageBufferAttachment(VulkanBuffer {},         0, shapesSize, VK_SHADER_STAGE_VERTEX_BIT),
@@ -61,55 +61,169 @@ BaseMultiRenderer::BaseMultiRenderer(
 
 	for (size_t i = 0; i != imgCount; i++)
 	{
-		uniforms_[i] = ctx.resources.addUniformBuffer(uniformBufferSize);
-		indirect_[i] = ctx.resources.addIndirectBuffer(indirectDataSize);
+		// also read by the culling shader
+		indirect_[i] = ctx.resources.addComputedIndirectBuffer(indirectDataSize, true);
 		updateIndirectBuffers(i);
 
 		shape_[i] = ctx.resources.addStorageBuffer(shapesSize);
 		uploadBufferData(ctx.vkDev, shape_[i].memory, 0, sceneData_.shapes_.data(), shapesSize);
 
-		dsInfo.buffers[0].buffer = uniforms_[i];
 		dsInfo.buffers[3].buffer = shape_[i];
 
 		descriptorSets_[i] = ctx.resources.addDescriptorSet(descriptorPool_, descriptorSetLayout_);
 		ctx.resources.updateDescriptorSet(descriptorSets_[i], dsInfo);
 	}
 
+	dynamicOffsets_ = { 0 };
+
 	initPipeline({ vertShaderFile, fragShaderFile }, pInfo);
 }
 
+void BaseMultiRenderer::initCulling(const VulkanBuffer& worldBoxes)
+{
+	const size_t imgCount = ctx_.vkDev.swapchainImages.size();
+	const uint32_t indirectDataSize = (uint32_t)indices_.size() * sizeof(VkDrawIndirectCommand);
+
+	compacted_.resize(imgCount);
+	count_.resize(imgCount);
+	cullingDescriptorSets_.resize(imgCount);
+
+	cullingUbo_.numShapesToCull_ = (uint32_t)indices_.size();
+
+	DescriptorSetInfo dsInfo = {
+		.buffers = {
+			dynamicUniformBufferAttachment(ctx_.frameRing.getBuffer(), sizeof(CullingUBO), VK_SHADER_STAGE_COMPUTE_BIT),
+			storageBufferAttachment(VulkanBuffer {}, 0, indirectDataSize, VK_SHADER_STAGE_COMPUTE_BIT),
+			storageBufferAttachment(worldBoxes, 0, (uint32_t)worldBoxes.size, VK_SHADER_STAGE_COMPUTE_BIT),
+			storageBufferAttachment(VulkanBuffer {}, 0, indirectDataSize, VK_SHADER_STAGE_COMPUTE_BIT),
+			storageBufferAttachment(VulkanBuffer {}, 0, sizeof(uint32_t), VK_SHADER_STAGE_COMPUTE_BIT)
+		}
+	};
+
+	const VkDescriptorSetLayout dsLayout = ctx_.resources.addDescriptorSetLayout(dsInfo);
+	const VkDescriptorPool dsPool = ctx_.resources.addDescriptorPool(dsInfo, (uint32_t)imgCount);
+
+	for (size_t i = 0; i != imgCount; i++)
+	{
+		compacted_[i] = ctx_.resources.addComputedIndirectBuffer(std::max(indirectDataSize, (uint32_t)sizeof(VkDrawIndirectCommand)));
+		// cleared with vkCmdFillBuffer() and mapped to read the statistics
+		count_[i] = ctx_.resources.addBuffer(sizeof(uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, true);
+
+		dsInfo.buffers[1].buffer = indirect_[i];
+		dsInfo.buffers[3].buffer = compacted_[i];
+		dsInfo.buffers[4].buffer = count_[i];
+
+		cullingDescriptorSets_[i] = ctx_.resources.addDescriptorSet(dsPool, dsLayout);
+		ctx_.resources.updateDescriptorSet(cullingDescriptorSets_[i], dsInfo);
+	}
+
+	cullingPipelineLayout_ = ctx_.resources.addPipelineLayout(dsLayout);
+	cullingPipeline_ = ctx_.resources.addComputePipeline("data/shaders/chapter10/VK02_CullingCompact.comp", cullingPipelineLayout_);
+}
+
+uint32_t BaseMultiRenderer::getNumVisibleShapes() const
+{
+	if (!enableCulling_ || count_.empty())
+		return (uint32_t)indices_.size();
+
+	return *(const uint32_t*)count_[lastImage_].ptr;
+}
+
 void BaseMultiRenderer::fillCommandBuffer(VkCommandBuffer commandBuffer, size_t currentImage, VkFramebuffer fb, VkRenderPass rp)
 {
+	const bool culling = enableCulling_ && cullingPipeline_ != VK_NULL_HANDLE && !indices_.empty();
+
+	// the culling dispatch has to be recorded outside of the render pass
+	if (culling)
+	{
+		const VkBuffer countBuffer = count_[currentImage].buffer;
+
+		vkCmdFillBuffer(commandBuffer, countBuffer, 0, sizeof(uint32_t), 0);
+
+		const VkBufferMemoryBarrier clearBarrier = {
+			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+			.pNext = nullptr,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.buffer = countBuffer,
+			.offset = 0,
+			.size = VK_WHOLE_SIZE
+		};
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &clearBarrier, 0, nullptr);
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullingPipeline_);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullingPipelineLayout_, 0, 1, &cullingDescriptorSets_[currentImage], 1, &cullingDynamicOffset_);
+		vkCmdDispatch(commandBuffer, ((uint32_t)indices_.size() + 63) / 64, 1, 1);
+
+		const VkBufferMemoryBarrier cullBarriers[2] = {
+			{
+				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				.pNext = nullptr,
+				.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.buffer = countBuffer,
+				.offset = 0,
+				.size = VK_WHOLE_SIZE
+			},
+			{
+				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				.pNext = nullptr,
+				.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+				.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.buffer = compacted_[currentImage].buffer,
+				.offset = 0,
+				.size = VK_WHOLE_SIZE
+			}
+		};
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 2, cullBarriers, 0, nullptr);
+	}
+
 	beginRenderPass((rp != VK_NULL_HANDLE) ? rp : renderPass_.handle, (fb != VK_NULL_HANDLE) ? fb : framebuffer_, commandBuffer, currentImage);
 
-	/* For CountKHR (Vulkan 1.1) we may use indirect rendering with GPU-based object counter */
-	/// vkCmdDrawIndirectCountKHR(commandBuffer, indirectBuffers_[currentImage], 0, countBuffers_[currentImage], 0, shapes.size(), sizeof(VkDrawIndirectCommand));
-	/* For Vulkan 1.0 vkCmdDrawIndirect is enough */
-	vkCmdDrawIndirect(commandBuffer, indirect_[currentImage].buffer, 0, (uint32_t)sceneData_.shapes_.size(), sizeof(VkDrawIndirectCommand));
+	/* VK_KHR_draw_indirect_count is enabled in createDevice2(): the GPU reads the number of visible shapes from the count buffer */
+	if (culling)
+		vkCmdDrawIndirectCountKHR(commandBuffer, compacted_[currentImage].buffer, 0, count_[currentImage].buffer, 0, (uint32_t)indices_.size(), sizeof(VkDrawIndirectCommand));
+	else
+		vkCmdDrawIndirect(commandBuffer, indirect_[currentImage].buffer, 0, (uint32_t)indices_.size(), sizeof(VkDrawIndirectCommand));
 
 	vkCmdEndRenderPass(commandBuffer);
 }
 
-void BaseMultiRenderer::updateIndirectBuffers(size_t currentImage, bool* visibility)
+void BaseMultiRenderer::updateIndirectBuffers(size_t currentImage, const uint8_t* visibility)
 {
-	VkDrawIndirectCommand* data = nullptr;
-	vkMapMemory(ctx_.vkDev.device, indirect_[currentImage].memory, 0, sizeof(VkDrawIndirectCommand), 0, (void**)&data);
+	VkDrawIndirectCommand* data = (VkDrawIndirectCommand*)indirect_[currentImage].ptr;
 
 	const uint32_t size = (uint32_t)indices_.size(); // (uint32_t)sceneData_.shapes_.size();
 
+	auto& shadow = indirectShadow_[currentImage];
+	const bool firstUpdate = shadow.empty();
+	shadow.resize(size);
+
 	for (uint32_t i = 0; i != size; i++)
 	{
 		const uint32_t j = sceneData_.shapes_[indices_[i]].meshIndex;
 
 		const uint32_t lod = sceneData_.shapes_[indices_[i]].LOD;
-		data[i] = {
+		const VkDrawIndirectCommand cmd = {
 			.vertexCount = sceneData_.meshData_.meshes_[j].getLODIndicesCount(lod),
 			.instanceCount = visibility ? (visibility[indices_[i]] ? 1u : 0u) : 1u,
 			.firstVertex = 0,
 			.firstInstance = (uint32_t)indices_[i]
 		};
+
+		if (firstUpdate || memcmp(&shadow[i], &cmd, sizeof(cmd)))
+			data[i] = shadow[i] = cmd;
 	}
-	vkUnmapMemory(ctx_.vkDev.device, indirect_[currentImage].memory);
 }
 
 bool FinalMultiRenderer::checkLoadedTextures()
@@ -127,12 +241,266 @@ bool FinalMultiRenderer::checkLoadedTextures()
 		sceneData_.loadedFiles_.pop_back();
 	}
 
-	auto newTexture = ctx_.resources.addRGBATexture(data.w_, data.h_, const_cast<uint8_t*>(data.img_));
+	const double t = sceneData_.startupTrace_.getTimeUs();
+
+	auto newTexture = ctx_.resources.addRGBATexture(data.w_, data.h_, data.img_, ctx_.uploader);
 
-	transparentRenderer.updateTexture(data.index_, newTexture, 14);
-	opaqueRenderer.updateTexture(data.index_, newTexture, 11);
+	transparentRenderer.updateTexture(data.index_, newTexture, 16);
+	opaqueRenderer.updateTexture(data.index_, newTexture, 14);
 
 	stbi_image_free((void*)data.img_);
 
+	sceneData_.markTextureResident(data.index_, t);
+
 	return true;
 }
+
+std::vector<VulkanTexture> FinalMultiRenderer::createShadowMaps(VulkanRenderContext& ctx, const ShadowSettings& shadows)
+{
+	if (!shadows.numCascades_)
+		return { ctx.resources.addDepthTexture(ShadowSize, ShadowSize) };
+
+	if (shadows.numCascades_ > MaxShadowCascades)
+	{
+		printf("Too many shadow cascades: %u (max %u)\n", shadows.numCascades_, MaxShadowCascades);
+		exit(EXIT_FAILURE);
+	}
+
+	std::vector<VulkanTexture> maps;
+
+	// sampled before the first shadow pass if the shadows are disabled at startup
+	for (uint32_t i = 0 ; i != shadows.numCascades_ ; i++)
+		maps.push_back(ctx.resources.addDepthTexture(shadows.cascadeSize_, shadows.cascadeSize_, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+
+	return maps;
+}
+
+std::vector<TextureAttachment> FinalMultiRenderer::getShadowMapAttachments(const std::vector<VulkanTexture>& maps)
+{
+	std::vector<TextureAttachment> attachments;
+
+	for (uint32_t i = 0 ; i != MaxShadowCascades ; i++)
+		attachments.push_back(fsTextureAttachment(maps[i < maps.size() ? i : 0]));
+
+	return attachments;
+}
+
+void FinalMultiRenderer::initShadowRenderers()
+{
+	const std::vector<int> opaque = getOpaqueIndices(sceneData_);
+
+	for (int i: opaque)
+	{
+		const uint32_t flags = sceneData_.materials_[sceneData_.shapes_[i].materialIndex].flags_;
+
+		if (flags & sMaterialFlags_CastShadow)
+			casters_.push_back(i);
+		if (flags & sMaterialFlags_ReceiveShadow)
+			receivers_.push_back(i);
+
+		const DrawData& dd = sceneData_.shapes_[i];
+		allOpaqueTriangles_ += sceneData_.meshData_.meshes_[dd.meshIndex].getLODIndicesCount(dd.LOD) / 3;
+	}
+
+	casterCuller_.setShapes(shapeBoxes_, casters_, receivers_);
+
+	if (!shadowSettings.numCascades_)
+	{
+		shadowRenderers_.push_back(std::make_unique<BaseMultiRenderer>(ctx_, sceneData_, casters_,
+			"data/shaders/chapter10/VK02_Depth.vert", "data/shaders/chapter10/VK02_Depth.frag",
+			std::vector<VulkanTexture> { shadowColor, shadowMaps[0] },
+			ctx_.resources.addRenderPass({ shadowColor, shadowMaps[0] }, RenderPassCreateInfo {
+				.clearColor_ = true, .clearDepth_ = true, .flags_ = eRenderPassBit_First | eRenderPassBit_Offscreen })));
+	}
+	else
+	{
+		for (size_t i = 0 ; i != shadowMaps.size() ; i++)
+		{
+			// depth-only: the color output of VK02_Depth.frag is discarded
+			shadowRenderers_.push_back(std::make_unique<BaseMultiRenderer>(ctx_, sceneData_, casters_,
+				"data/shaders/chapter10/VK02_Depth.vert", "data/shaders/chapter10/VK02_Depth.frag",
+				std::vector<VulkanTexture> { shadowMaps[i] },
+				ctx_.resources.addDepthRenderPass({ shadowMaps[i] }, RenderPassCreateInfo {
+					.clearColor_ = false, .clearDepth_ = true, .flags_ = eRenderPassBit_First | eRenderPassBit_Offscreen })));
+
+			shadowRenderers_.back()->initCulling(worldBoxes_);
+		}
+	}
+
+	casterVisibility_.resize(shadowRenderers_.size());
+	shadowCaches_.resize(shadowRenderers_.size());
+	shadowPassNeeded_.resize(shadowRenderers_.size(), 1);
+}
+
+void FinalMultiRenderer::setLightParameters(const glm::mat4& lightProj, const glm::mat4& lightView, const BoundingBox& sceneBox)
+{
+	LightParamsBuffer params = {
+		.proj = lightProj,
+		.view = lightView,
+		.width = ctx_.vkDev.framebufferWidth,
+		.height = ctx_.vkDev.framebufferHeight,
+		.numCascades = 0,
+		.padding = 0,
+		.cascadeSplits = vec4(0.0f)
+	};
+
+	cascadeProj_.clear();
+	lightView_ = lightView;
+
+	if (!shadowSettings.numCascades_)
+	{
+		shadowRenderers_[0]->setMatrices(lightProj, lightView);
+	}
+	else
+	{
+		const uint32_t numCascades = shadowSettings.numCascades_;
+
+		float nearZ, farZ;
+		getPerspectiveNearFar(cameraProj_, nearZ, farZ);
+
+		float splits[MaxShadowCascades + 1];
+		getCascadeSplits(nearZ, glm::clamp(maxShadowDistance, 2.0f * nearZ, farZ), numCascades, cascadeSplitLambda, splits);
+
+		// the camera sees the scene flipped along Y, see BaseMultiRenderer::setMatrices()
+		const glm::mat4 m1 = glm::scale(glm::mat4(1.f), glm::vec3(1.f, -1.f, 1.f));
+
+		vec4 frustumCorners[8];
+		getFrustumCorners(cameraProj_ * cameraView_ * m1, frustumCorners);
+
+		params.numCascades = enableShadows ? numCascades : 0;
+
+		for (uint32_t i = 0 ; i != numCascades ; i++)
+		{
+			vec3 slice[8];
+			getFrustumSliceCorners(frustumCorners, nearZ, farZ, splits[i], splits[i + 1], slice);
+
+			const glm::mat4 proj = getCascadeProjection(slice, lightView, sceneBox, shadowSettings.cascadeSize_);
+
+			params.cascadeSplits[i] = splits[i + 1];
+			params.cascadeViewProj[i] = proj * lightView;
+
+			// VK02_Depth.vert flips the scene back, so the casters are culled with the unflipped matrix
+			shadowRenderers_[i]->setMatrices(proj, lightView);
+			shadowRenderers_[i]->setCullingFrustum(proj * lightView);
+
+			cascadeProj_.push_back(proj);
+		}
+	}
+
+	uploadBufferData(ctx_.vkDev, lightParams.memory, 0, &params, sizeof(LightParamsBuffer));
+
+	// the shadow map caches see the moved casters through casterCuller_.getVersion()
+	updateShapeBoxes();
+
+	if (enableShadows)
+		updateShadowCasters(lightView, shadowSettings.numCascades_ ? cascadeProj_ : std::vector<glm::mat4> { lightProj });
+
+	updateShadowStats();
+}
+
+void FinalMultiRenderer::updateShadowStats()
+{
+	// D32 or D24S8 depth, BGRA8 color
+	const uint64_t singleMapTexels = (uint64_t)ShadowSize * ShadowSize;
+
+	const ShadowStats prev = shadowStats_;
+
+	shadowStats_ = ShadowStats {};
+	shadowStats_.singleMapMemoryBytes_ = singleMapTexels * (4 + 4);
+	shadowStats_.singleMapTriangles_ = allOpaqueTriangles_;
+
+	for (const auto& m: shadowMaps)
+		shadowStats_.memoryBytes_ += (uint64_t)m.width * m.height * 4;
+	if (!shadowSettings.numCascades_)
+		shadowStats_.memoryBytes_ += singleMapTexels * 4;
+
+	if (!enableShadows)
+	{
+		shadowStats_.numUpdates_ = prev.numUpdates_;
+		shadowStats_.numSkipped_ = prev.numSkipped_;
+		return;
+	}
+
+	for (size_t c = 0 ; c != shadowRenderers_.size() ; c++)
+	{
+		for (int i: casters_)
+		{
+			if (!casterVisibility_[c][i])
+				continue;
+
+			const DrawData& dd = sceneData_.shapes_[i];
+
+			shadowStats_.numCasters_[c]++;
+			shadowStats_.numTriangles_[c] += sceneData_.meshData_.meshes_[dd.meshIndex].getLODIndicesCount(dd.LOD) / 3;
+		}
+
+		shadowStats_.totalTriangles_ += shadowStats_.numTriangles_[c];
+
+		if (shadowPassNeeded_[c])
+		{
+			shadowStats_.numCastersDrawn_ += shadowStats_.numCasters_[c];
+			shadowStats_.numTrianglesDrawn_ += shadowStats_.numTriangles_[c];
+		}
+
+		shadowStats_.numUpdates_ += shadowCaches_[c].numUpdates_;
+		shadowStats_.numSkipped_ += shadowCaches_[c].numSkipped_;
+	}
+}
+
+void FinalMultiRenderer::updateShapeBoxes()
+{
+	for (const auto& r: sceneData_.uploadGlobalTransforms())
+	{
+		uint32_t first = r.first_ + r.count_;
+		uint32_t last = r.first_;
+
+		// the ranges also contain unchanged shapes (gaps between the dirty ones or a full upload)
+		for (uint32_t i = r.first_ ; i != r.first_ + r.count_ ; i++)
+		{
+			const DrawData& dd = sceneData_.shapes_[i];
+			const BoundingBox box = sceneData_.meshData_.boxes_[dd.meshIndex].getTransformed(sceneData_.shapeTransforms_[i]);
+
+			if (!memcmp(&box, &shapeBoxes_[i], sizeof(BoundingBox)))
+				continue;
+
+			shapeBoxes_[i] = box;
+			casterCuller_.updateBox((int)i, box);
+
+			first = std::min(first, i);
+			last = std::max(last, i);
+		}
+
+		if (first <= last)
+			uploadBufferData(ctx_.vkDev, worldBoxes_.memory, first * sizeof(BoundingBox), shapeBoxes_.data() + first, (last - first + 1) * sizeof(BoundingBox));
+	}
+}
+
+void FinalMultiRenderer::updateShadowCasters(const glm::mat4& lightView, const std::vector<glm::mat4>& passProj)
+{
+	// the camera sees the scene flipped along Y, see BaseMultiRenderer::setMatrices()
+	const glm::mat4 m1 = glm::scale(glm::mat4(1.f), glm::vec3(1.f, -1.f, 1.f));
+
+	casterCuller_.setLight(lightView);
+	casterCuller_.setCamera(cameraProj_ * cameraView_ * m1);
+
+	for (size_t i = 0 ; i != shadowRenderers_.size() ; i++)
+	{
+		auto& visible = casterVisibility_[i];
+
+		if (enableCulling)
+		{
+			casterCuller_.cull(passProj[i], cullShadowReceivers, visible);
+		}
+		else
+		{
+			visible.assign(sceneData_.shapes_.size(), 0);
+			for (int c: casters_)
+				visible[c] = 1;
+		}
+
+		if (!cacheShadowMaps)
+			shadowCaches_[i].invalidate();
+
+		shadowPassNeeded_[i] = shadowCaches_[i].update(passProj[i] * lightView, hashShadowCasters(visible), casterCuller_.getVersion());
+	}
+}
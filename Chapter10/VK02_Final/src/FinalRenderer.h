@@ -1,14 +1,21 @@
 #pragma once
 
 #include "shared/vkFramework/MultiRenderer.h"
+#include "shared/vkFramework/Barriers.h"
 
 #include "shared/vkFramework/effects/LuminanceCalculator.h"
 
+#include "shared/ShadowCasterCuller.h"
+
 #include <algorithm>
+#include <memory>
 #include <numeric>
 
 const uint32_t ShadowSize = 8192;
 
+// VK02_Shadow.frag has one sampler binding per cascade
+const uint32_t MaxShadowCascades = 4;
+
 /**
 	The "finalized" variant of MultiRenderer
 
@@ -33,17 +40,42 @@ struct BaseMultiRenderer: public Renderer
 		const std::vector<BufferAttachment>& auxBuffers = std::vector<BufferAttachment> {},
 		const std::vector<TextureAttachment>& auxTextures = std::vector<TextureAttachment> {});
 
-	void updateIndirectBuffers(size_t currentImage, bool* visibility = nullptr);
+	/* 'visibility' is indexed by shape, invisible shapes get instanceCount = 0 */
+	void updateIndirectBuffers(size_t currentImage, const uint8_t* visibility = nullptr);
+
+	/*
+		GPU frustum culling: a compute shader writes the visible commands densely into a separate indirect buffer
+		and counts them, the count is consumed by vkCmdDrawIndirectCountKHR(). 'worldBoxes' holds one box per scene shape
+	*/
+	void initCulling(const VulkanBuffer& worldBoxes);
+
+	bool enableCulling_ = false;
+
+	/* Result of the last frame (the buffers are host-visible) */
+	uint32_t getNumVisibleShapes() const;
 
 	void fillCommandBuffer(VkCommandBuffer cmdBuffer, size_t currentImage, VkFramebuffer fb = VK_NULL_HANDLE, VkRenderPass rp = VK_NULL_HANDLE) override;
 	void updateBuffers(size_t currentImage) override {
-		updateUniformBuffer((uint32_t)currentImage, 0, sizeof(ubo_), &ubo_);
+		dynamicOffsets_[0] = uploadDynamicUniform(&ubo_, sizeof(ubo_));
+
+		if (cullingPipeline_ != VK_NULL_HANDLE)
+			cullingDynamicOffset_ = uploadDynamicUniform(&cullingUbo_, sizeof(cullingUbo_));
+
+		lastImage_ = currentImage;
 	}
 
 	inline void setMatrices(const glm::mat4& proj, const glm::mat4& view) {
 		const glm::mat4 m1 = glm::scale(glm::mat4(1.f), glm::vec3(1.f, -1.f, 1.f));
 		ubo_.proj_ = proj;
 		ubo_.view_ = view * m1;
+
+		setCullingFrustum(ubo_.proj_ * ubo_.view_);
+	}
+
+	/* The frustum for initCulling() in the space of 'worldBoxes', if it differs from proj * view (e.g. VK02_Depth.vert flips the scene) */
+	inline void setCullingFrustum(const glm::mat4& viewProj) {
+		getFrustumPlanes(viewProj, cullingUbo_.frustumPlanes_);
+		getFrustumCorners(viewProj, cullingUbo_.frustumCorners_);
 	}
 
 	inline void setCameraPosition(const glm::vec3& cameraPos) { ubo_.cameraPos_ = glm::vec4(cameraPos, 1.0f); }
@@ -58,11 +90,30 @@ private:
 	std::vector<VulkanBuffer> indirect_;
 	std::vector<VulkanBuffer> shape_;
 
+	std::vector<std::vector<VkDrawIndirectCommand>> indirectShadow_;
+
 	struct UBO {
 		mat4 proj_;
 		mat4 view_;
 		vec4 cameraPos_;
 	} ubo_;
+
+	// see VK02_CullingCompact.comp
+	struct CullingUBO {
+		vec4 frustumPlanes_[6];
+		vec4 frustumCorners_[8];
+		uint32_t numShapesToCull_;
+	} cullingUbo_;
+
+	std::vector<VulkanBuffer> compacted_;
+	std::vector<VulkanBuffer> count_;
+
+	std::vector<VkDescriptorSet> cullingDescriptorSets_;
+	VkPipelineLayout cullingPipelineLayout_ = VK_NULL_HANDLE;
+	VkPipeline cullingPipeline_ = VK_NULL_HANDLE;
+	uint32_t cullingDynamicOffset_ = 0;
+
+	size_t lastImage_ = 0;
 };
 
 // Extract a list of indices of opaque objects
@@ -110,6 +161,47 @@ struct LightParamsBuffer
 
 	uint32_t width;
 	uint32_t height;
+
+	// cascaded shadow maps (0 means the single map with 'proj' and 'view'), see VK02_Shadow.frag
+	uint32_t numCascades;
+	uint32_t padding;
+	vec4 cascadeSplits; // far view-space distance of every cascade
+	mat4 cascadeViewProj[MaxShadowCascades];
+};
+
+/**
+	Shadow maps of FinalMultiRenderer
+
+	numCascades_ == 0 is the single ShadowSize x ShadowSize map (color + depth) fitted to the bounding box of the whole scene.
+	Otherwise the view frustum is split into numCascades_ cascades (see getCascadeSplits() in UtilsMath.h), every cascade
+	has its own depth-only cascadeSize_ x cascadeSize_ map and its shadow pass draws only the casters inside the cascade's frustum
+*/
+struct ShadowSettings
+{
+	uint32_t numCascades_ = 4;
+	uint32_t cascadeSize_ = 2048;
+};
+
+/* Comparison of the shadow passes with the single ShadowSize map (CPU estimate from the bounding boxes) */
+struct ShadowStats
+{
+	uint64_t memoryBytes_ = 0;
+	uint64_t singleMapMemoryBytes_ = 0;
+
+	// after caster culling, including the cached maps
+	uint32_t numCasters_[MaxShadowCascades] = {};
+	uint64_t numTriangles_[MaxShadowCascades] = {};
+
+	uint64_t totalTriangles_ = 0;
+	uint64_t singleMapTriangles_ = 0; // the single map used to draw all opaque shapes
+
+	// rendered this frame (the cached maps are skipped)
+	uint32_t numCastersDrawn_ = 0;
+	uint64_t numTrianglesDrawn_ = 0;
+
+	// all shadow maps since the start
+	uint32_t numUpdates_ = 0;
+	uint32_t numSkipped_ = 0;
 };
 
 // Single item in the OIT buffer. See Chapter 10's GL03_OIT demo and "Order-independent Transparency" Recipe in the book
@@ -117,6 +209,50 @@ struct TransparentFragment {
 	vec4 color;
 	float depth;
 	uint32_t next;
+	// std430 array stride of the shader struct
+	uint32_t padding[2];
+};
+
+/**
+	Transparency modes of FinalMultiRenderer (see VK02_Glass.frag and VK02_ComposeOIT.frag)
+
+	eOITMode_LinkedList: per-pixel linked lists in a shared buffer of one fragment per pixel on average,
+	  the memory needed grows with the depth complexity and the fragments which do not fit are dropped.
+	eOITMode_FixedLayers: every pixel keeps its first OITLayers fragments which are sorted at composition time,
+	  the rest (the "tail") is alpha-blended into the framebuffer in the draw order. The memory is bounded
+	  by the screen size and no fragment is dropped, only the tail is not sorted.
+*/
+enum eOITMode : uint32_t
+{
+	eOITMode_LinkedList  = 0,
+	eOITMode_FixedLayers = 1
+};
+
+const uint32_t OITLayers = 4;
+
+// eOITMode_FixedLayers fragment: packHalf2x16(r, g), packHalf2x16(b, a), depth bits and padding
+struct PackedTransparentFragment {
+	uint32_t data[4];
+};
+
+// written by VK02_Glass.frag
+struct OITCounters {
+	uint32_t numFragments;
+	uint32_t numOverflow;
+};
+
+struct OITStats
+{
+	// previous frame
+	uint32_t numFragments_ = 0;
+	// dropped (eOITMode_LinkedList) or tail-blended (eOITMode_FixedLayers)
+	uint32_t numOverflow_ = 0;
+
+	// heads + fragment storage of every mode
+	uint64_t linkedListBytes_ = 0;
+	uint64_t fixedLayersBytes_ = 0;
+	// the linked lists would need this much to keep all fragments of the previous frame
+	uint64_t linkedListRequiredBytes_ = 0;
 };
 
 /**
@@ -135,41 +271,40 @@ struct TransparentFragment {
 */
 struct FinalMultiRenderer: public Renderer
 {
-	FinalMultiRenderer(VulkanRenderContext& ctx, VKSceneData& sceneData, const std::vector<VulkanTexture>& outputs = std::vector<VulkanTexture> {})
+	FinalMultiRenderer(VulkanRenderContext& ctx, VKSceneData& sceneData, const std::vector<VulkanTexture>& outputs = std::vector<VulkanTexture> {},
+		const ShadowSettings& shadows = ShadowSettings {})
 	: Renderer(ctx)
-	, shadowColor(ctx_.resources.addColorTexture(ShadowSize, ShadowSize))
-	, shadowDepth(ctx_.resources.addDepthTexture(ShadowSize, ShadowSize))
+	, shadowSettings(shadows)
+	, shadowColor(shadows.numCascades_ ? VulkanTexture {} : ctx_.resources.addColorTexture(ShadowSize, ShadowSize))
+	, shadowMaps(createShadowMaps(ctx, shadows))
 	, lightParams(ctx_.resources.addStorageBuffer(sizeof(LightParamsBuffer)))
-	, atomicBuffer(ctx_.resources.addStorageBuffer(sizeof(uint32_t)))
+	, atomicBuffer(ctx_.resources.addStorageBuffer(sizeof(OITCounters), true))
 	, headsBuffer(ctx_.resources.addStorageBuffer(ctx.vkDev.framebufferWidth * ctx.vkDev.framebufferHeight * sizeof(uint32_t)))
 	, oitBuffer(ctx_.resources.addStorageBuffer(ctx.vkDev.framebufferWidth * ctx.vkDev.framebufferHeight * sizeof(TransparentFragment)))
+	, oitLayersBuffer(ctx_.resources.addStorageBuffer(ctx.vkDev.framebufferWidth * ctx.vkDev.framebufferHeight * OITLayers * sizeof(PackedTransparentFragment)))
 	, outputColor(ctx_.resources.addColorTexture(0, 0, LuminosityFormat))
 	, sceneData_(sceneData)
+	, whBuffer(ctx_.resources.addUniformBuffer(sizeof(UBO), true))
 	, opaqueRenderer(ctx, sceneData, getOpaqueIndices(sceneData), "data/shaders/chapter10/VK02_Shadow.vert", "data/shaders/chapter10/VK02_Shadow.frag", outputs,
 		ctx_.resources.addRenderPass(outputs, RenderPassCreateInfo {
 			.clearColor_ = false, .clearDepth_ = false, .flags_ = eRenderPassBit_Offscreen }),
 			{ storageBufferAttachment(lightParams, 0, sizeof(LightParamsBuffer), VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT) },
-			{ fsTextureAttachment(shadowDepth) })
+			getShadowMapAttachments(shadowMaps))
 
 	, transparentRenderer(ctx, sceneData, getTransparentIndices(sceneData), "data/shaders/chapter10/VK02_Shadow.vert", "data/shaders/chapter10/VK02_Glass.frag", outputs,
 		ctx_.resources.addRenderPass(outputs, RenderPassCreateInfo {
 			.clearColor_ = false, .clearDepth_ = false, .flags_ = eRenderPassBit_Offscreen }),
 			{ storageBufferAttachment(lightParams, 0, sizeof(LightParamsBuffer), VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT),
-			  storageBufferAttachment(atomicBuffer, 0, sizeof(uint32_t), VK_SHADER_STAGE_FRAGMENT_BIT),
+			  storageBufferAttachment(atomicBuffer, 0, sizeof(OITCounters), VK_SHADER_STAGE_FRAGMENT_BIT),
 			  storageBufferAttachment(headsBuffer,  0, ctx.vkDev.framebufferWidth * ctx.vkDev.framebufferHeight * sizeof(uint32_t), VK_SHADER_STAGE_FRAGMENT_BIT),
-			  storageBufferAttachment(oitBuffer, 0, ctx.vkDev.framebufferWidth * ctx.vkDev.framebufferHeight * sizeof(TransparentFragment), VK_SHADER_STAGE_FRAGMENT_BIT) },
-			{ fsTextureAttachment(shadowDepth) })
-
-	, shadowRenderer(ctx_, sceneData, getOpaqueIndices(sceneData), "data/shaders/chapter10/VK02_Depth.vert", "data/shaders/chapter10/VK02_Depth.frag",
-			{ shadowColor, shadowDepth }, 
-			ctx_.resources.addRenderPass({ shadowColor, shadowDepth }, RenderPassCreateInfo {
-			.clearColor_ = true, .clearDepth_ = true, .flags_ = eRenderPassBit_First | eRenderPassBit_Offscreen }))
+			  storageBufferAttachment(oitBuffer, 0, ctx.vkDev.framebufferWidth * ctx.vkDev.framebufferHeight * sizeof(TransparentFragment), VK_SHADER_STAGE_FRAGMENT_BIT),
+			  storageBufferAttachment(oitLayersBuffer, 0, (uint32_t)oitLayersBuffer.size, VK_SHADER_STAGE_FRAGMENT_BIT),
+			  uniformBufferAttachment(whBuffer, 0, sizeof(UBO), VK_SHADER_STAGE_FRAGMENT_BIT) },
+			{ fsTextureAttachment(shadowMaps[0]) })
 
 	, colorToAttachment(ctx_, outputs[0])
 	, depthToAttachment(ctx_, outputs[1])
 
-	, whBuffer(ctx_.resources.addUniformBuffer(sizeof(UBO)))
-
 	, clearOIT(ctx_, { .buffers = {
 			uniformBufferAttachment(whBuffer,         0, sizeof(ubo_), VK_SHADER_STAGE_FRAGMENT_BIT),
 			storageBufferAttachment(headsBuffer,  0, ctx.vkDev.framebufferWidth * ctx.vkDev.framebufferHeight * sizeof(uint32_t), VK_SHADER_STAGE_FRAGMENT_BIT)
@@ -181,7 +316,8 @@ struct FinalMultiRenderer: public Renderer
 		.buffers = {
 				uniformBufferAttachment(whBuffer,     0, sizeof(ubo_),     VK_SHADER_STAGE_FRAGMENT_BIT),
 				storageBufferAttachment(headsBuffer,  0, ctx.vkDev.framebufferWidth * ctx.vkDev.framebufferHeight * sizeof(uint32_t), VK_SHADER_STAGE_FRAGMENT_BIT),
-				storageBufferAttachment(oitBuffer,    0, ctx.vkDev.framebufferWidth * ctx.vkDev.framebufferHeight * sizeof(TransparentFragment), VK_SHADER_STAGE_FRAGMENT_BIT)
+				storageBufferAttachment(oitBuffer,    0, ctx.vkDev.framebufferWidth * ctx.vkDev.framebufferHeight * sizeof(TransparentFragment), VK_SHADER_STAGE_FRAGMENT_BIT),
+				storageBufferAttachment(oitLayersBuffer, 0, (uint32_t)oitLayersBuffer.size, VK_SHADER_STAGE_FRAGMENT_BIT)
 			},
 		.textures = { fsTextureAttachment(outputs[0]) }
 		}, { outputColor }, "data/shaders/chapter10/VK02_ComposeOIT.frag" )
@@ -191,19 +327,50 @@ struct FinalMultiRenderer: public Renderer
 	{
 		ubo_.width  = ctx.vkDev.framebufferWidth;
 		ubo_.height = ctx.vkDev.framebufferHeight;
+		ubo_.numLayers = OITLayers;
+
+		const uint64_t headsBytes = headsBuffer.size;
+		oitStats_.linkedListBytes_ = headsBytes + oitBuffer.size;
+		oitStats_.fixedLayersBytes_ = headsBytes + oitLayersBuffer.size;
 
 		setVkImageName(ctx_.vkDev, outputColor.image.image, "outputColor");
+
+		// world-space bounding boxes of all shapes for GPU culling (moved by updateShapeBoxes())
+		shapeBoxes_.reserve(sceneData_.shapes_.size());
+		for (const auto& c: sceneData_.shapes_)
+			shapeBoxes_.push_back(sceneData_.meshData_.boxes_[c.meshIndex].getTransformed(sceneData_.scene_.globalTransform_[c.transformIndex]));
+
+		const VkDeviceSize boxesSize = std::max<VkDeviceSize>(shapeBoxes_.size(), 1) * sizeof(BoundingBox);
+		worldBoxes_ = ctx_.resources.addStorageBuffer(boxesSize);
+		if (!shapeBoxes_.empty())
+			uploadBufferData(ctx_.vkDev, worldBoxes_.memory, 0, shapeBoxes_.data(), shapeBoxes_.size() * sizeof(BoundingBox));
+
+		opaqueRenderer.initCulling(worldBoxes_);
+		transparentRenderer.initCulling(worldBoxes_);
+
+		initShadowRenderers();
 	}
 
 	void fillCommandBuffer(VkCommandBuffer cmdBuffer, size_t currentImage, VkFramebuffer fb = VK_NULL_HANDLE, VkRenderPass rp = VK_NULL_HANDLE) override
 	{
+		opaqueRenderer.enableCulling_ = enableCulling;
+		transparentRenderer.enableCulling_ = enableCulling;
+
 		outputToAttachment.fillCommandBuffer(cmdBuffer, currentImage);
 
 		clearOIT.fillCommandBuffer(cmdBuffer, currentImage);
 
 		if (enableShadows)
 		{
-			shadowRenderer.fillCommandBuffer(cmdBuffer, currentImage);
+			for (size_t i = 0 ; i != shadowRenderers_.size() ; i++)
+			{
+				// the cached map is still valid
+				if (!shadowPassNeeded_[i])
+					continue;
+
+				shadowRenderers_[i]->enableCulling_ = enableCulling;
+				shadowRenderers_[i]->fillCommandBuffer(cmdBuffer, currentImage);
+			}
 		}
 
 		opaqueRenderer.fillCommandBuffer(cmdBuffer, currentImage);
@@ -247,12 +414,24 @@ struct FinalMultiRenderer: public Renderer
 		transparentRenderer.updateBuffers(currentImage);
 		opaqueRenderer.updateBuffers(currentImage);
 
-		shadowRenderer.updateBuffers(currentImage);
+		for (size_t i = 0 ; i != shadowRenderers_.size() ; i++)
+		{
+			shadowRenderers_[i]->updateBuffers(currentImage);
+
+			if (enableShadows && shadowPassNeeded_[i])
+				shadowRenderers_[i]->updateIndirectBuffers(currentImage, casterVisibility_[i].data());
+		}
 
-		uint32_t zeroCount = 0;
-		uploadBufferData(ctx_.vkDev, atomicBuffer.memory, 0, &zeroCount, sizeof(uint32_t));
+		// counters of the previous frame (both buffers are persistently mapped and host-coherent)
+		OITCounters* counters = (OITCounters*)atomicBuffer.ptr;
+		oitStats_.numFragments_ = counters->numFragments;
+		oitStats_.numOverflow_ = counters->numOverflow;
+		oitStats_.linkedListRequiredBytes_ = headsBuffer.size + (uint64_t)counters->numFragments * sizeof(TransparentFragment);
 
-		uploadBufferData(ctx_.vkDev, whBuffer.memory, 0, &ubo_, sizeof(ubo_));
+		*counters = OITCounters {};
+
+		ubo_.oitMode = oitMode;
+		memcpy(whBuffer.ptr, &ubo_, sizeof(ubo_));
 	}
 
 	void updateIndirectBuffers(size_t currentImage, bool* visibility = nullptr);
@@ -260,62 +439,133 @@ struct FinalMultiRenderer: public Renderer
 	inline void setMatrices(const glm::mat4& proj, const glm::mat4& view) {
 		transparentRenderer.setMatrices(proj, view);
 		opaqueRenderer.setMatrices(proj, view);
-	}
 
-	inline void setLightParameters(const glm::mat4& lightProj, const glm::mat4& lightView)
-	{
-		LightParamsBuffer lightParamsBuffer = { .proj = lightProj, .view = lightView, .width = ctx_.vkDev.framebufferWidth, .height = ctx_.vkDev.framebufferHeight };
-
-		uploadBufferData(ctx_.vkDev, lightParams.memory, 0, &lightParamsBuffer, sizeof(LightParamsBuffer));
-
-		shadowRenderer.setMatrices(lightProj, lightView);
+		cameraProj_ = proj;
+		cameraView_ = view;
 	}
 
+	/*
+		'lightProj' is used by the single shadow map, the cascades are fitted to the camera frustum set by setMatrices()
+		and use only the direction of the light. 'sceneBox' bounds all shadow casters
+	*/
+	void setLightParameters(const glm::mat4& lightProj, const glm::mat4& lightView, const BoundingBox& sceneBox);
+
 	inline void setCameraPosition(const glm::vec3& cameraPos) {
 		transparentRenderer.setCameraPosition(cameraPos);
 		opaqueRenderer.setCameraPosition(cameraPos);
-		shadowRenderer.setCameraPosition(cameraPos);
+		for (auto& r: shadowRenderers_)
+			r->setCameraPosition(cameraPos);
 	}
 
+	/* Light-space projections of the cascades from the last setLightParameters() (for debug drawing) */
+	inline const std::vector<glm::mat4>& getCascadeProjections() const { return cascadeProj_; }
+
+	inline const ShadowStats& getShadowStats() const { return shadowStats_; }
+
+	inline const OITStats& getOITStats() const { return oitStats_; }
+
 	inline const VKSceneData& getSceneData() const { return sceneData_; }
 
+	inline uint32_t getNumVisibleShapes() const {
+		return opaqueRenderer.getNumVisibleShapes() + (renderTransparentObjects ? transparentRenderer.getNumVisibleShapes() : 0);
+	}
+
 	bool checkLoadedTextures();
 
+	const ShadowSettings shadowSettings;
+
+	// only for the single shadow map
 	VulkanTexture shadowColor;
-	VulkanTexture shadowDepth;
+	// one depth map per cascade (or the single ShadowSize map)
+	std::vector<VulkanTexture> shadowMaps;
 
 	VulkanBuffer lightParams;
 
 	VulkanBuffer atomicBuffer;
 	VulkanBuffer headsBuffer;
 	VulkanBuffer oitBuffer;
+	VulkanBuffer oitLayersBuffer;
 
 	VulkanTexture outputColor;
 
 	bool enableShadows = true;
 	bool renderTransparentObjects = true;
+	/* Can be changed at any frame, both modes have their buffers allocated */
+	eOITMode oitMode = eOITMode_LinkedList;
+	/* GPU frustum culling of the opaque and transparent objects and of the shadow casters of every cascade */
+	bool enableCulling = true;
+
+	// shadow casters: skip the casters which cannot shadow anything visible, re-render the shadow maps only when they change
+	bool cullShadowReceivers = true;
+	bool cacheShadowMaps = true;
+
+	// cascade placement: 0 is the uniform split, 1 is the logarithmic split; shadows end at maxShadowDistance from the camera
+	float cascadeSplitLambda = 0.75f;
+	float maxShadowDistance = 100.0f;
 
 private:
 	VKSceneData& sceneData_;
 
+	// see VK02_ClearBuffer.frag, VK02_Glass.frag and VK02_ComposeOIT.frag
+	struct UBO {
+		uint32_t width;
+		uint32_t height;
+		uint32_t oitMode;
+		uint32_t numLayers;
+	} ubo_;
+
+	VulkanBuffer whBuffer;
+
 	BaseMultiRenderer transparentRenderer;
 	BaseMultiRenderer opaqueRenderer;
 
-	BaseMultiRenderer shadowRenderer;
+	// one per cascade (or a single one)
+	std::vector<std::unique_ptr<BaseMultiRenderer>> shadowRenderers_;
 
 	ShaderOptimalToColorBarrier colorToAttachment;
 	ShaderOptimalToDepthBarrier depthToAttachment;
 
-	VulkanBuffer whBuffer;
+	VulkanBuffer worldBoxes_;
+	std::vector<BoundingBox> shapeBoxes_;
+
+	glm::mat4 cameraProj_ = glm::mat4(1.0f);
+	glm::mat4 cameraView_ = glm::mat4(1.0f);
+
+	std::vector<glm::mat4> cascadeProj_;
+	glm::mat4 lightView_ = glm::mat4(1.0f);
+
+	// opaque shapes with sMaterialFlags_CastShadow and sMaterialFlags_ReceiveShadow
+	std::vector<int> casters_;
+	std::vector<int> receivers_;
+
+	uint64_t allOpaqueTriangles_ = 0;
+
+	ShadowCasterCuller casterCuller_;
+
+	// per shadow pass
+	std::vector<std::vector<uint8_t>> casterVisibility_;
+	std::vector<ShadowMapCache> shadowCaches_;
+	std::vector<uint8_t> shadowPassNeeded_;
+
+	ShadowStats shadowStats_;
 
 	QuadProcessor clearOIT;
 	QuadProcessor composeOIT;
 
-	struct UBO {
-		uint32_t width;
-		uint32_t height;
-	} ubo_;
+	OITStats oitStats_;
 
 	ShaderOptimalToColorBarrier outputToAttachment;
 	ColorToShaderOptimalBarrier outputToShader;
+
+	static std::vector<VulkanTexture> createShadowMaps(VulkanRenderContext& ctx, const ShadowSettings& shadows);
+
+	// VK02_Shadow.frag always has MaxShadowCascades sampler bindings, the unused ones repeat the first map
+	static std::vector<TextureAttachment> getShadowMapAttachments(const std::vector<VulkanTexture>& maps);
+
+	void initShadowRenderers();
+
+	/* Uploads the recalculated transforms and moves the boxes of their shapes */
+	void updateShapeBoxes();
+	void updateShadowCasters(const glm::mat4& lightView, const std::vector<glm::mat4>& passProj);
+	void updateShadowStats();
 };
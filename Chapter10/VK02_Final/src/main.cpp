@@ -40,19 +40,18 @@ struct MyApp: public CameraApp
 	// tone mapping (gamma correction / exposure)
 	, luminance(ctx_, finalTex, luminanceResult)
 	, hdrUniformBuffer(mappedUniformBufferAttachment(ctx_.resources, &hdrUniforms, VK_SHADER_STAGE_FRAGMENT_BIT))
-	, hdr(ctx_, finalTex, luminanceResult, hdrUniformBuffer)
+	// (no aliasing of the bloom targets: they are displayed in the HDR debug window)
+	, hdr(ctx_, finalTex, luminanceResult, hdrUniformBuffer, false)
 
 	, ssao(ctx_, finalRenderer.outputColor /*colorTex for no-HDR */, depthTex, finalTex)
 
 	, displayedTextureList({
-				finalRenderer.shadowDepth, finalTex, depthTex, ssao.getBlurY(),              // 0 - 3
-				colorTex, luminance.getResult64(),                                           // 4 - 5
-				luminance.getResult32(), luminance.getResult16(), luminance.getResult08(),   // 6 - 8
-				luminance.getResult04(), luminance.getResult02(), luminance.getResult01(),   // 9 - 11
-				hdr.getBloom1(), hdr.getBloom2(), hdr.getBrightness(), hdr.getResult(),      // 12 - 15
-				hdr.getStreaks1(), hdr.getStreaks2(),                                        // 16 - 17
-				hdr.getAdaptatedLum1(), hdr.getAdaptatedLum2(),                              // 18 - 19
-				finalRenderer.outputColor                                                    // 20
+				finalRenderer.shadowMaps[0], finalTex, depthTex, ssao.getBlurY(),            // 0 - 3
+				colorTex, luminance.getResult01(),                                           // 4 - 5
+				hdr.getBloom1(), hdr.getBloom2(), hdr.getBrightness(), hdr.getResult(),      // 6 - 9
+				hdr.getStreaks1(), hdr.getStreaks2(),                                        // 10 - 11
+				hdr.getAdaptatedLum1(), hdr.getAdaptatedLum2(),                              // 12 - 13
+				finalRenderer.outputColor                                                    // 14
 		})
 
 	, quads(ctx_, displayedTextureList)
@@ -75,25 +74,29 @@ struct MyApp: public CameraApp
 		setVkImageName(ctx_.vkDev, depthTex.image.image, "depth");
 		setVkImageName(ctx_.vkDev, finalTex.image.image, "final");
 
-		setVkImageName(ctx_.vkDev, finalRenderer.shadowColor.image.image, "shadowColor");
-		setVkImageName(ctx_.vkDev, finalRenderer.shadowDepth.image.image, "shadowDepth");
+		if (!finalRenderer.shadowSettings.numCascades_)
+			setVkImageName(ctx_.vkDev, finalRenderer.shadowColor.image.image, "shadowColor");
 
-		onScreenRenderers_.emplace_back(cubeRenderer);        // 0
-		onScreenRenderers_.emplace_back(toDepth, false);      // 1
-		onScreenRenderers_.emplace_back(lumToColor, false);   // 2
+		static const char* shadowMapNames[MaxShadowCascades] = { "shadowCascade0", "shadowCascade1", "shadowCascade2", "shadowCascade3" };
+		for (size_t i = 0 ; i != finalRenderer.shadowMaps.size() ; i++)
+			setVkImageName(ctx_.vkDev, finalRenderer.shadowMaps[i].image.image, finalRenderer.shadowSettings.numCascades_ ? shadowMapNames[i] : "shadowDepth");
 
-		onScreenRenderers_.emplace_back(finalRenderer);       // 3
+		onScreenRenderers_.emplace_back(cubeRenderer, true, "Cube");         // 0
+		onScreenRenderers_.emplace_back(toDepth, false, "ToDepth");          // 1
+		onScreenRenderers_.emplace_back(lumToColor, false, "LumToColor");    // 2
 
-		onScreenRenderers_.emplace_back(ssao);                // 4
+		onScreenRenderers_.emplace_back(finalRenderer, true, "Scene");       // 3
 
-		onScreenRenderers_.emplace_back(lumWait, false);      // 5
-		onScreenRenderers_.emplace_back(luminance, false);    // 6
-		onScreenRenderers_.emplace_back(hdr, false);          // 7
+		onScreenRenderers_.emplace_back(ssao, true, "SSAOProcessor");        // 4
 
-		onScreenRenderers_.emplace_back(quads, false);        // 8
-		onScreenRenderers_.emplace_back(imgui, false);        // 9
+		onScreenRenderers_.emplace_back(lumWait, false, "LumWait");          // 5
+		onScreenRenderers_.emplace_back(luminance, false, "Luminance");      // 6
+		onScreenRenderers_.emplace_back(hdr, false, "HDRProcessor");         // 7
 
-		onScreenRenderers_.emplace_back(canvas);              // 10
+		onScreenRenderers_.emplace_back(quads, false, "Quads");              // 8
+		onScreenRenderers_.emplace_back(imgui, false, "ImGui");              // 9
+
+		onScreenRenderers_.emplace_back(canvas, true, "Canvas");             // 10
 
 		{
 			std::vector<BoundingBox> reorderedBoxes;
@@ -124,6 +127,65 @@ struct MyApp: public CameraApp
 		ImGui::Checkbox("Show object bounding boxes", &showObjectBoxes);
 		ImGui::Checkbox("Render transparent objects", &finalRenderer.renderTransparentObjects);
 
+		// both modes are allocated, the stats show what each one needs at this resolution
+		if (finalRenderer.renderTransparentObjects && ImGui::TreeNode("Order-independent transparency"))
+		{
+			if (ImGui::RadioButton("Linked lists", finalRenderer.oitMode == eOITMode_LinkedList))
+				finalRenderer.oitMode = eOITMode_LinkedList;
+			if (ImGui::RadioButton("Fixed layers + tail blending", finalRenderer.oitMode == eOITMode_FixedLayers))
+				finalRenderer.oitMode = eOITMode_FixedLayers;
+
+			const OITStats& oit = finalRenderer.getOITStats();
+			const double MB = 1.0 / (1024.0 * 1024.0);
+			ImGui::Text("Fragments: %u", oit.numFragments_);
+			ImGui::Text(finalRenderer.oitMode == eOITMode_LinkedList ? "Dropped: %u" : "Tail-blended (unsorted): %u", oit.numOverflow_);
+			ImGui::Text("Linked lists: %.1f MB (%.1f MB to keep all fragments)", oit.linkedListBytes_ * MB, oit.linkedListRequiredBytes_ * MB);
+			ImGui::Text("Fixed layers (%u per pixel): %.1f MB", OITLayers, oit.fixedLayersBytes_ * MB);
+			ImGui::TreePop();
+		}
+		ImGui::Checkbox("GPU frustum culling", &finalRenderer.enableCulling);
+		ImGui::Text("Visible shapes: %u / %u", finalRenderer.getNumVisibleShapes(), (uint32_t)finalRenderer.getSceneData().shapes_.size());
+
+		// print the post-processing schedules and write Graphviz files
+		if (ImGui::Button("Dump render graphs"))
+		{
+			luminance.dump("luminance_graph.dot");
+			hdr.dump("hdr_graph.dot");
+			ssao.dump("ssao_graph.dot");
+
+			hdr.printMemoryReport("HDR");
+			ssao.printMemoryReport("SSAO");
+		}
+
+		// every on-screen renderer gets its own command buffer recorded on a worker thread (takes effect in the next frame)
+		ImGui::Checkbox("Parallel command recording", &ctx_.parallelRecording_);
+
+		if (ImGui::TreeNode("CPU recording time"))
+		{
+			ImGui::Text("Frame: %.3f ms", ctx_.frameRecordingTimeMs_);
+			for (size_t i = 0 ; i != ctx_.recordingTimesMs_.size() ; i++)
+				ImGui::Text("%s: %.3f ms", onScreenRenderers_[i].name_, ctx_.recordingTimesMs_[i]);
+			ImGui::TreePop();
+		}
+
+		ImGui::Text("Textures: %u of %u resident", sceneData.numResidentTextures_, (uint32_t)sceneData.textureFiles_.size());
+		if (ImGui::Button("Export startup trace"))
+			sceneData.writeStartupTrace("startup_trace.json");
+
+		// timestamp queries are read back a few frames later, the table shows rolling averages
+		ImGui::Checkbox("GPU profiler", &ctx_.gpuProfiler.enabled_);
+
+		if (ctx_.gpuProfiler.enabled_)
+		{
+			if (ImGui::Button("Export GPU trace"))
+				ctx_.gpuProfiler.exportChromeTrace("gpu_trace.json");
+
+			ImGui::SetNextWindowSize(ImVec2(360, 300), ImGuiCond_FirstUseEver);
+			ImGui::Begin("GPU time", nullptr);
+			ctx_.gpuProfiler.drawStatsTable();
+			ImGui::End();
+		}
+
 		ImGui::Text("HDR");
 		ImGui::Indent(indentSize);
 
@@ -165,6 +227,25 @@ struct MyApp: public CameraApp
 				ImGui::SliderFloat("Light Theta", &g_LightTheta, -85.0f, +85.0f);
 				ImGui::SliderFloat("Light Phi", &g_LightPhi, -85.0f, +85.0f);
 
+				if (finalRenderer.shadowSettings.numCascades_)
+				{
+					ImGui::SliderFloat("Cascade split lambda", &finalRenderer.cascadeSplitLambda, 0.0f, 1.0f);
+					ImGui::SliderFloat("Shadow distance", &finalRenderer.maxShadowDistance, 10.0f, 500.0f);
+				}
+
+				ImGui::Checkbox("Cull casters by receivers", &finalRenderer.cullShadowReceivers);
+				ImGui::Checkbox("Cache shadow maps", &finalRenderer.cacheShadowMaps);
+
+				const ShadowStats& stats = finalRenderer.getShadowStats();
+				const double MB = 1.0 / (1024.0 * 1024.0);
+
+				ImGui::Text("Shadow maps: %.1f MB (single %ux%u map: %.1f MB)", stats.memoryBytes_ * MB, ShadowSize, ShadowSize, stats.singleMapMemoryBytes_ * MB);
+				for (uint32_t i = 0 ; i != std::max(finalRenderer.shadowSettings.numCascades_, 1u) ; i++)
+					ImGui::Text("  pass %u: %u casters, %llu triangles", i, stats.numCasters_[i], (unsigned long long)stats.numTriangles_[i]);
+				ImGui::Text("Shadow triangles: %llu (single map: %llu)", (unsigned long long)stats.totalTriangles_, (unsigned long long)stats.singleMapTriangles_);
+				ImGui::Text("Drawn this frame: %u casters, %llu triangles", stats.numCastersDrawn_, (unsigned long long)stats.numTrianglesDrawn_);
+				ImGui::Text("Shadow map updates: %u, skipped: %u", stats.numUpdates_, stats.numSkipped_);
+
 			ImGui::PopItemFlag();
 			ImGui::PopStyleVar();
 		ImGui::Unindent(indentSize);
@@ -177,20 +258,8 @@ struct MyApp: public CameraApp
 
 			ImGui::Text("HDRColor");
 			ImGui::Image((void*)(intptr_t)(5 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
-			ImGui::Text("Lum64");
-			ImGui::Image((void*)(intptr_t)(6 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
-			ImGui::Text("Lum32");
-			ImGui::Image((void*)(intptr_t)(7 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
-			ImGui::Text("Lum16");
-			ImGui::Image((void*)(intptr_t)(8 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
-			ImGui::Text("Lum08");
-			ImGui::Image((void*)(intptr_t)(9 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
-			ImGui::Text("Lum04");
-			ImGui::Image((void*)(intptr_t)(10| TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
-			ImGui::Text("Lum02");
-			ImGui::Image((void*)(intptr_t)(11| TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 			ImGui::Text("Lum01");
-			ImGui::Image((void*)(intptr_t)(12| TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+			ImGui::Image((void*)(intptr_t)(6 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 			ImGui::End();
 		}
 
@@ -198,25 +267,25 @@ struct MyApp: public CameraApp
 		{
 			ImGui::Begin("Adaptation", nullptr);
 			ImGui::Text("Adapt1");
-			ImGui::Image((void*)(intptr_t)(19 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+			ImGui::Image((void*)(intptr_t)(13 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 			ImGui::Text("Adapt2");
-			ImGui::Image((void*)(intptr_t)(20 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+			ImGui::Image((void*)(intptr_t)(14 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 			ImGui::End();
 
 			ImGui::Begin("Debug", nullptr);
 			ImGui::Text("Bloom1");
-			ImGui::Image((void*)(intptr_t)(13 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+			ImGui::Image((void*)(intptr_t)(7 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 			ImGui::Text("Bloom2");
-			ImGui::Image((void*)(intptr_t)(14 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+			ImGui::Image((void*)(intptr_t)(8 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 			ImGui::Text("Bright");
-			ImGui::Image((void*)(intptr_t)(15 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+			ImGui::Image((void*)(intptr_t)(9 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 			ImGui::Text("Result");
-			ImGui::Image((void*)(intptr_t)(16 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+			ImGui::Image((void*)(intptr_t)(10 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 
 			ImGui::Text("Streaks1");
-			ImGui::Image((void*)(intptr_t)(17 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+			ImGui::Image((void*)(intptr_t)(11 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 			ImGui::Text("Streaks2");
-			ImGui::Image((void*)(intptr_t)(18 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+			ImGui::Image((void*)(intptr_t)(12 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 			ImGui::End();
 		}
 
@@ -239,6 +308,17 @@ struct MyApp: public CameraApp
 	bool showLightFrustum = false;
 	bool showObjectBoxes = false;
 
+	bool firstFrameTraced = false;
+
+	void framePresented() override {
+		// the first frame is drawn with whatever textures are resident
+		if (!firstFrameTraced)
+		{
+			sceneData.startupTrace_.addEvent("Time to first frame", "startup", 0, 0.0);
+			firstFrameTraced = true;
+		}
+	}
+
 	void draw3D() override {
 		const mat4 p = getDefaultProjection();
 		const mat4 view =camera.getViewMatrix();
@@ -254,30 +334,44 @@ struct MyApp: public CameraApp
 		const BoundingBox box = bigBox.getTransformed(lightView);
 		const mat4 lightProj = finalRenderer.enableShadows ? glm::ortho(box.min_.x, box.max_.x, box.min_.y, box.max_.y, -box.max_.z, -box.min_.z) : mat4(0.f);
 
+		finalRenderer.setMatrices(p, view);
+		finalRenderer.setLightParameters(lightProj, lightView, bigBox);
+
 		if (finalRenderer.enableShadows && showLightFrustum)
 		{
 			drawBox3d(canvas, glm::scale(glm::mat4(1.f), vec3(1, -1, 1)), bigBox, glm::vec4(0, 0, 0, 1));
-			drawBox3d(canvas, glm::mat4(1.f), box, vec4(1, 0, 0, 1));
-			renderCameraFrustum(canvas, lightView, lightProj, vec4(1.0f, 0.0f, 0.0f, 1.0f));
+
+			if (finalRenderer.shadowSettings.numCascades_)
+			{
+				const vec4 cascadeColors[MaxShadowCascades] = { vec4(1, 0, 0, 1), vec4(0, 1, 0, 1), vec4(0, 0, 1, 1), vec4(1, 1, 0, 1) };
+				// the canvas draws the scene flipped along Y
+				const mat4 m1 = glm::scale(glm::mat4(1.f), vec3(1, -1, 1));
+				const auto& cascades = finalRenderer.getCascadeProjections();
+				for (size_t i = 0 ; i != cascades.size() ; i++)
+					renderCameraFrustum(canvas, lightView * m1, cascades[i], cascadeColors[i]);
+			}
+			else
+			{
+				drawBox3d(canvas, glm::mat4(1.f), box, vec4(1, 0, 0, 1));
+				renderCameraFrustum(canvas, lightView, lightProj, vec4(1.0f, 0.0f, 0.0f, 1.0f));
+			}
 
 			canvas.line(vec3(0.0f), lightDir * 100.0f, vec4(0, 0, 1, 1));
 		}
 
 		if (showObjectBoxes)
-			for (const auto& b : sceneData.meshData_.boxes_)
-				drawBox3d(canvas, glm::scale(glm::mat4(1.f), vec3(1, -1, 1)), b, glm::vec4(0, 1, 0, 1));
+			for (const auto& c : sceneData.shapes_)
+				drawBox3d(canvas, glm::scale(glm::mat4(1.f), vec3(1, -1, 1)) * sceneData.scene_.globalTransform_[c.transformIndex], sceneData.meshData_.boxes_[c.meshIndex], glm::vec4(0, 1, 0, 1));
 
 		cubeRenderer.setMatrices(p, view);
 
-		finalRenderer.setMatrices(p, view);
-		finalRenderer.setLightParameters(lightProj, lightView);
 		finalRenderer.setCameraPosition(positioner.getPosition());
 
 		for (int i = 0 ; i < 25 ; i++)
 			finalRenderer.checkLoadedTextures();
 
 		quads.clear();
-		quads.quad(-1.0f, enableHDR ? 1.0f : -1.0f, 1.0f, enableHDR ? -1.0f : 1.0f, 15);
+		quads.quad(-1.0f, enableHDR ? 1.0f : -1.0f, 1.0f, enableHDR ? -1.0f : 1.0f, 9);
 	}
 private:
 	HDRUniformBuffer* hdrUniforms;
@@ -1,10 +1,9 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <assimp/cimport.h>
+#include "shared/scene/MeshLods.h"
 #include "shared/scene/VtxData.h"
 
-#include <meshoptimizer.h>
-
 MeshData g_meshData;
 
 uint32_t g_indexOffset = 0;
@@ -15,87 +14,22 @@ constexpr uint32_t g_numElementsToStore = 3 + 3 + 2;
 float g_meshScale = 0.01f;
 bool g_calculateLODs = false;
 
-void processLods(std::vector<uint32_t>& indices, std::vector<float>& vertices, std::vector<std::vector<uint32_t>>& outLods)
-{
-	size_t verticesCountIn = vertices.size() / 2;
-	size_t targetIndicesCount = indices.size();
-
-	uint8_t LOD = 1;
-
-	printf("\n   LOD0: %i indices", int(indices.size()));
-
-	outLods.push_back(indices);
-
-	while ( targetIndicesCount > 1024 && LOD < 8 )
-	{
-		targetIndicesCount = indices.size() / 2;
-
-		bool sloppy = false;
-
-		size_t numOptIndices = meshopt_simplify(
-			indices.data(),
-			indices.data(), (uint32_t)indices.size(),
-			vertices.data(), verticesCountIn,
-			sizeof( float ) * 3,
-			targetIndicesCount, 0.02f );
-
-		// cannot simplify further
-		if (static_cast<size_t>(numOptIndices * 1.1f) > indices.size())
-		{
-			if (LOD > 1)
-			{
-				// try harder
-				numOptIndices = meshopt_simplifySloppy(
-					indices.data(),
-					indices.data(), indices.size(),
-					vertices.data(), verticesCountIn,
-					sizeof(float) * 3,
-					targetIndicesCount, 0.02f);
-				sloppy = true;
-				if (numOptIndices == indices.size()) break;
-			}
-			else
-				break;
-		}
-
-		indices.resize(numOptIndices);
-
-		meshopt_optimizeVertexCache(indices.data(), indices.data(), indices.size(), verticesCountIn);
-
-		printf("\n   LOD%i: %i indices %s", int(LOD), int(numOptIndices), sloppy ? "[sloppy]" : "");
-
-		LOD++;
-
-		outLods.push_back(indices);
-	}
-}
-
 Mesh convertAIMesh(const aiMesh* m)
 {
 	const bool hasTexCoords = m->HasTextureCoords(0);
 	const uint32_t streamElementSize = static_cast<uint32_t>(g_numElementsToStore * sizeof(float));
 
-	// Original data for LOD calculation
-	std::vector<float> srcVertices;
+	std::vector<float> vertices;
 	std::vector<uint32_t> srcIndices;
 
 	std::vector<std::vector<uint32_t>> outLods;
 
-	auto& vertices = g_meshData.vertexData_;
-
 	for (size_t i = 0; i != m->mNumVertices; i++)
 	{
 		const aiVector3D v = m->mVertices[i];
 		const aiVector3D n = m->mNormals[i];
 		const aiVector3D t = hasTexCoords ? m->mTextureCoords[0][i] : aiVector3D();
 
-		if (g_calculateLODs)
-		{
-			srcVertices.push_back(v.x);
-			srcVertices.push_back(v.y);
-			srcVertices.push_back(v.z);
-		}
-
 		vertices.push_back(v.x * g_meshScale);
 		vertices.push_back(v.y * g_meshScale);
 		vertices.push_back(v.z * g_meshScale);
@@ -125,10 +59,10 @@ Mesh convertAIMesh(const aiMesh* m)
 			srcIndices.push_back(m->mFaces[i].mIndices[j]);
 	}
 
-	if (!g_calculateLODs)
-		outLods.push_back(srcIndices);
-	else
-		processLods(srcIndices, srcVertices, outLods);
+	processLods(vertices, g_numElementsToStore, srcIndices, g_calculateLODs, outLods, result);
+
+	result.vertexCount = (uint32_t)(vertices.size() / g_numElementsToStore);
+	mergeVectors(g_meshData.vertexData_, vertices);
 
 	printf("\nCalculated LOD count: %u\n", (unsigned)outLods.size());
 
@@ -146,7 +80,7 @@ Mesh convertAIMesh(const aiMesh* m)
 	result.lodCount = (uint32_t)outLods.size();
 
 	g_indexOffset  += numIndices;
-	g_vertexOffset += m->mNumVertices;
+	g_vertexOffset += result.vertexCount;
 
 	return result;
 }
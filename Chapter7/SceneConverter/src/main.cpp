@@ -13,6 +13,7 @@
 #include <rapidjson/document.h>
 #include <rapidjson/rapidjson.h>
 
+#include "shared/scene/MeshLods.h"
 #include "shared/scene/VtxData.h"
 
 #include "shared/scene/Material.h"
@@ -24,8 +25,6 @@
 #include "stb_image.h"
 #include "stb_image_resize2.h"
 
-#include <meshoptimizer.h>
-
 namespace fs = std::filesystem;
 
 MeshData g_MeshData;
@@ -162,61 +161,6 @@ MaterialDescription convertAIMaterialToDescription(const aiMaterial* M, std::vec
 	return D;
 }
 
-void processLods(std::vector<uint32_t>& indices, std::vector<float>& vertices, std::vector<std::vector<uint32_t>>& outLods)
-{
-	size_t verticesCountIn = vertices.size() / 2;
-	size_t targetIndicesCount = indices.size();
-
-	uint8_t LOD = 1;
-
-	printf("\n   LOD0: %i indices", int(indices.size()));
-
-	outLods.push_back(indices);
-
-	while ( targetIndicesCount > 1024 && LOD < 8 )
-	{
-		targetIndicesCount = indices.size() / 2;
-
-		bool sloppy = false;
-
-		size_t numOptIndices = meshopt_simplify(
-			indices.data(),
-			indices.data(), (uint32_t)indices.size(),
-			vertices.data(), verticesCountIn,
-			sizeof( float ) * 3,
-			targetIndicesCount, 0.02f );
-
-		// cannot simplify further
-		if (static_cast<size_t>(numOptIndices * 1.1f) > indices.size())
-		{
-			if (LOD > 1)
-			{
-				// try harder
-				numOptIndices = meshopt_simplifySloppy(
-					indices.data(),
-					indices.data(), indices.size(),
-					vertices.data(), verticesCountIn,
-					sizeof(float) * 3,
-					targetIndicesCount, 0.02f, nullptr);
-				sloppy = true;
-				if (numOptIndices == indices.size()) break;
-			}
-			else
-				break;
-		}
-
-		indices.resize(numOptIndices);
-
-		meshopt_optimizeVertexCache(indices.data(), indices.data(), indices.size(), verticesCountIn);
-
-		printf("\n   LOD%i: %i indices %s", int(LOD), int(numOptIndices), sloppy ? "[sloppy]" : "");
-
-		LOD++;
-
-		outLods.push_back(indices);
-	}
-}
-
 Mesh convertAIMesh(const aiMesh* m, const SceneConfig& cfg)
 {
 	const bool hasTexCoords = m->HasTextureCoords(0);
@@ -231,27 +175,17 @@ Mesh convertAIMesh(const aiMesh* m, const SceneConfig& cfg)
 		.streamElementSize = { streamElementSize }
 	};
 
-	// Original data for LOD calculation
-	std::vector<float> srcVertices;
+	std::vector<float> vertices;
 	std::vector<uint32_t> srcIndices;
 
 	std::vector<std::vector<uint32_t>> outLods;
 
-	auto& vertices = g_MeshData.vertexData_;
-
 	for (size_t i = 0; i != m->mNumVertices; i++)
 	{
 		const aiVector3D v = m->mVertices[i];
 		const aiVector3D n = m->mNormals[i];
 		const aiVector3D t = hasTexCoords ? m->mTextureCoords[0][i] : aiVector3D();
 
-		if (cfg.calculateLODs)
-		{
-			srcVertices.push_back(v.x);
-			srcVertices.push_back(v.y);
-			srcVertices.push_back(v.z);
-		}
-
 		vertices.push_back(v.x * cfg.scale);
 		vertices.push_back(v.y * cfg.scale);
 		vertices.push_back(v.z * cfg.scale);
@@ -272,10 +206,10 @@ Mesh convertAIMesh(const aiMesh* m, const SceneConfig& cfg)
 			srcIndices.push_back(m->mFaces[i].mIndices[j]);
 	}
 
-	if (!cfg.calculateLODs)
-		outLods.push_back(srcIndices);
-	else
-		processLods(srcIndices, srcVertices, outLods);
+	processLods(vertices, g_numElementsToStore, srcIndices, cfg.calculateLODs, outLods, result);
+
+	result.vertexCount = (uint32_t)(vertices.size() / g_numElementsToStore);
+	mergeVectors(g_MeshData.vertexData_, vertices);
 
 	printf("\nCalculated LOD count: %u\n", (unsigned)outLods.size());
 
@@ -294,7 +228,7 @@ Mesh convertAIMesh(const aiMesh* m, const SceneConfig& cfg)
 	result.lodCount = (uint32_t)outLods.size();
 
 	g_indexOffset  += numIndices;
-	g_vertexOffset += m->mNumVertices;
+	g_vertexOffset += result.vertexCount;
 
 	return result;
 }
@@ -594,8 +528,6 @@ void processScene(const SceneConfig& cfg)
 
 	recalculateBoundingBoxes(g_MeshData);
 
-	saveMeshData(cfg.outputMesh.c_str(), g_MeshData);
-
 	Scene ourScene;
 
 	// 2. Material conversion
@@ -625,11 +557,24 @@ void processScene(const SceneConfig& cfg)
 	// 4. Scene hierarchy conversion
 	traverse(scene, ourScene, scene->mRootNode, -1, 0);
 
+	// 5. Automatic instancing: copies of the same mesh are stored once and drawn as instances
+	if (cfg.mergeInstances)
+	{
+		const MeshInstancingStats stats = deduplicateMeshes(ourScene, g_MeshData);
+		printf("[Instancing] meshes: %u -> %u, mesh data: %llu -> %llu bytes, draw commands: %u -> %u\n",
+			stats.meshesBefore_, stats.meshesAfter_, (unsigned long long)stats.bytesBefore_, (unsigned long long)stats.bytesAfter_,
+			stats.drawsBefore_, stats.drawsAfter_);
+	}
+
+	// nodes are stored level by level (see sortSceneByDepth())
+	sortSceneByDepth(ourScene);
+
+	saveMeshData(cfg.outputMesh.c_str(), g_MeshData);
 	saveScene(cfg.outputScene.c_str(), ourScene);
 }
 
 /** Chapter9: Merge meshes (interior/exterior) */
-void mergeBistro()
+void mergeBistro(const StaticBatchingParams& batchingParams)
 {
 	Scene scene1, scene2;
 	std::vector<Scene*> scenes = { &scene1, &scene2 };
@@ -668,21 +613,25 @@ void mergeBistro()
 	saveMaterials("data/meshes/bistro_all.materials", allMaterials, allTextures);
 
 	printf("[Unmerged] scene items: %d\n", (int)scene.hierarchy_.size());
-	mergeScene(scene, meshData, "Foliage_Linde_Tree_Large_Orange_Leaves");
-	printf("[Merged orange leaves] scene items: %d\n", (int)scene.hierarchy_.size());
-	mergeScene(scene, meshData, "Foliage_Linde_Tree_Large_Green_Leaves");
-	printf("[Merged green leaves]  scene items: %d\n", (int)scene.hierarchy_.size());
-	mergeScene(scene, meshData, "Foliage_Linde_Tree_Large_Trunk");
-	printf("[Merged trunk]  scene items: %d\n", (int)scene.hierarchy_.size());
+	const StaticBatchingStats stats = batchStaticMeshes(scene, meshData, batchingParams);
+	printf("[Static batching] scene items: %d, %u batches (cell size %.1f)\n", (int)scene.hierarchy_.size(), stats.numBatches_, batchingParams.cellSize_);
+	printf("   draw calls: %u -> %u, triangles: %llu -> %llu\n", stats.drawsBefore_, stats.drawsAfter_,
+		(unsigned long long)stats.trianglesBefore_, (unsigned long long)stats.trianglesAfter_);
 
-	recalculateBoundingBoxes(meshData);
+	sortSceneByDepth(scene);
 
 	saveMeshData("data/meshes/bistro_all.meshes", meshData);
 	saveScene("data/meshes/bistro_all.scene", scene);
 }
 
-int main()
+/* Usage: Ch7_Tool01_SceneConverter [static batching cell size] */
+int main(int argc, char* argv[])
 {
+	StaticBatchingParams batchingParams;
+
+	if (argc > 1)
+		batchingParams.cellSize_ = (float)atof(argv[1]);
+
 	fs::create_directory("data/out_textures");
 
 	const auto configs = readConfigFile("data/sceneconverter.json");
@@ -691,7 +640,7 @@ int main()
 		processScene(cfg);
 
 	// Final step: optimize bistro scene
-	mergeBistro();
+	mergeBistro(batchingParams);
 
 	return 0;
 }
@@ -3,6 +3,7 @@
 #include "shared/vkFramework/MultiRenderer.h"
 #include "shared/vkFramework/QuadRenderer.h"
 #include "shared/vkFramework/InfinitePlaneRenderer.h"
+#include "shared/RayQuery.h"
 
 #include "ImGuizmo.h"
 
@@ -24,11 +25,17 @@ struct MyApp: public CameraApp
 		onScreenRenderers_.emplace_back(imgui, false);
 
 		sceneData.scene_.localTransform_[0] = glm::rotate(glm::mat4(1.f), (float)(M_PI / 2.f), glm::vec3(1.f, 0.f, 0.0f));
+
+		sceneData.recalculateAllTransforms();
+		rayQuery.buildMeshes(sceneData.meshData_);
+		rayQuery.buildInstances(sceneData.scene_);
 	}
 
 	void drawUI() override {
 		ImGui::Begin("Information", nullptr);
 			ImGui::Text("FPS: %.2f", getFPS());
+			ImGui::Text("Transforms: %u bytes uploaded", (uint32_t)sceneData.transformUploads_.getStats().uploadedBytes_);
+			ImGui::Text("%u shapes in %u instanced draw commands", (uint32_t)sceneData.shapes_.size(), multiRenderer.getNumDrawCommands(0));
 		ImGui::End();
 
 		ImGui::Begin("Scene graph", nullptr);
@@ -52,9 +59,32 @@ struct MyApp: public CameraApp
 	{
 		CameraApp::update(deltaSeconds);
 
-		// update/upload matrices for individual scene nodes
-		sceneData.recalculateAllTransforms();
+		// update/upload matrices of the edited scene nodes
+		recalculateGlobalTransforms(sceneData.scene_);
 		sceneData.uploadGlobalTransforms();
+
+		// edited nodes stay pickable
+		rayQuery.refitInstances(sceneData.scene_);
+	}
+
+	/* The right mouse button selects the node under the cursor (the left one rotates the camera) */
+	void handleMouseClick(int button, bool pressed) override
+	{
+		CameraApp::handleMouseClick(button, pressed);
+
+		if (button != GLFW_MOUSE_BUTTON_RIGHT || !pressed || !shouldHandleMouse())
+			return;
+
+		const int w = (int)ctx_.vkDev.framebufferWidth;
+		const int h = (int)ctx_.vkDev.framebufferHeight;
+
+		// MultiRenderer::setMatrices() renders with 'view * m1', Y points down in Vulkan clip space
+		const glm::mat4 m1 = glm::scale(glm::mat4(1.f), glm::vec3(1.f, -1.f, 1.f));
+		const Ray ray = getPrimaryRay(camera.getViewMatrix() * m1, getDefaultProjection(), mouseState_.pos.x * w, (1.0f - mouseState_.pos.y) * h, w, h);
+
+		RayHit hit;
+		if (rayQuery.closestHit(ray, hit))
+			selectedNode = hit.node_;
 	}
 
 private:
@@ -67,6 +97,8 @@ private:
 	MultiRenderer multiRenderer;
 	GuiRenderer imgui;
 
+	RayQuery rayQuery;
+
 	int selectedNode = -1;
 
 	void editNode(int node)
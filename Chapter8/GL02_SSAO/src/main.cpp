@@ -1,11 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <memory>
 #include <vector>
 
 #include "shared/glFramework/GLFWApp.h"
 #include "shared/glFramework/GLShader.h"
 #include "shared/glFramework/GLSceneData.h"
 #include "shared/glFramework/GLFramebuffer.h"
+#include "shared/glFramework/GLSSAOTargets.h"
 #include "shared/glFramework/UtilsGLImGui.h"
 #include "shared/UtilsMath.h"
 #include "shared/Camera.h"
@@ -45,6 +47,8 @@ CameraPositioner_FirstPerson positioner( vec3(-10.0f, 3.0f, 3.0f), vec3(0.0f, 0.
 Camera camera(positioner);
 bool g_EnableSSAO = true;
 bool g_EnableBlur = true;
+// the SSAO buffers are 1/g_SSAODownsample of the framebuffer size (1, 2 or 4)
+int g_SSAODownsample = 2;
 
 int main(void)
 {
@@ -59,6 +63,9 @@ int main(void)
 
 	GLShader shdFullScreenQuadVert("data/shaders/chapter08/GL02_FullScreenQuad.vert");
 
+	GLShader shdDownsampleDepthFrag("data/shaders/chapter08/GL02_SSAODownsampleDepth.frag");
+	GLProgram progDownsampleDepth(shdFullScreenQuadVert, shdDownsampleDepthFrag);
+
 	GLShader shdSSAOFrag("data/shaders/chapter08/GL02_SSAO.frag");
 	GLShader shdCombineSSAOFrag("data/shaders/chapter08/GL02_SSAO_combine.frag");
 	GLProgram progSSAO(shdFullScreenQuadVert, shdSSAOFrag);
@@ -147,8 +154,7 @@ int main(void)
 	int width, height;
 	glfwGetFramebufferSize(app.getWindow(), &width, &height);
 	GLFramebuffer framebuffer(width, height, GL_RGBA8, GL_DEPTH_COMPONENT24);
-	GLFramebuffer ssao(1024, 1024, GL_RGBA8, 0);
-	GLFramebuffer blur(1024, 1024, GL_RGBA8, 0);
+	std::unique_ptr<SSAOTargets> ssaoTargets = std::make_unique<SSAOTargets>(width, height, g_SSAODownsample);
 
 	ImGuiGLRenderer rendererUI;
 
@@ -188,17 +194,27 @@ int main(void)
 		framebuffer.unbind();
 		glDisable(GL_DEPTH_TEST);
 
+		if (ssaoTargets->downsample_ != g_SSAODownsample)
+			ssaoTargets = std::make_unique<SSAOTargets>(width, height, g_SSAODownsample);
+
+		GLFramebuffer& ssao = ssaoTargets->ssao;
+		GLFramebuffer& blur = ssaoTargets->blur;
+
 		// 2. Calculate SSAO
-		glClearNamedFramebufferfv(ssao.getHandle(), GL_COLOR, 0, glm::value_ptr(vec4(0.0f, 0.0f, 0.0f, 1.0f)));
 		glNamedBufferSubData(perFrameDataBuffer.getHandle(), 0, sizeof(g_SSAOParams), &g_SSAOParams);
+
+		// 2.1 Downsample depth
+		const GLuint depthSSAO = ssaoTargets->downsampleDepth(progDownsampleDepth, framebuffer.getTextureDepth().getHandle());
+
+		glClearNamedFramebufferfv(ssao.getHandle(), GL_COLOR, 0, glm::value_ptr(vec4(0.0f, 0.0f, 0.0f, 1.0f)));
 		ssao.bind();
 		progSSAO.useProgram();
-		glBindTextureUnit(0, framebuffer.getTextureDepth().getHandle());
+		glBindTextureUnit(0, depthSSAO);
 		glBindTextureUnit(1, rotationPattern.getHandle());
 		glDrawArrays(GL_TRIANGLES, 0, 6);
 		ssao.unbind();
 
-		// 2.1 Blur SSAO
+		// 2.2 Blur SSAO
 		if (g_EnableBlur)
 		{
 			// Blur X
@@ -222,6 +238,8 @@ int main(void)
 			progCombineSSAO.useProgram();
 			glBindTextureUnit(0, framebuffer.getTextureColor().getHandle());
 			glBindTextureUnit(1, ssao.getTextureColor().getHandle());
+			glBindTextureUnit(2, framebuffer.getTextureDepth().getHandle());
+			glBindTextureUnit(3, depthSSAO);
 			glDrawArrays(GL_TRIANGLES, 0, 6);
 		}
 		else
@@ -238,6 +256,12 @@ int main(void)
 		ImGui::PushItemFlag(ImGuiItemFlags_Disabled, !g_EnableSSAO);
 		ImGui::PushStyleVar(ImGuiStyleVar_Alpha, ImGui::GetStyle().Alpha * g_EnableSSAO ? 1.0f : 0.2f);
 		ImGui::Checkbox("Enable blur", &g_EnableBlur);
+		ImGui::Text("SSAO resolution:");
+		ImGui::RadioButton("Full", &g_SSAODownsample, 1);
+		ImGui::SameLine();
+		ImGui::RadioButton("Half", &g_SSAODownsample, 2);
+		ImGui::SameLine();
+		ImGui::RadioButton("Quarter", &g_SSAODownsample, 4);
 		ImGui::SliderFloat("SSAO scale", &g_SSAOParams.scale_, 0.0f, 2.0f);
 		ImGui::SliderFloat("SSAO bias",  &g_SSAOParams.bias_, 0.0f, 0.3f);
 		ImGui::PopItemFlag();
@@ -249,7 +273,7 @@ int main(void)
 		ImGui::End();
 		imguiTextureWindowGL("Color", framebuffer.getTextureColor().getHandle());
 		imguiTextureWindowGL("Depth", framebuffer.getTextureDepth().getHandle());
-		imguiTextureWindowGL("SSAO", ssao.getTextureColor().getHandle());
+		imguiTextureWindowGL("SSAO", ssaoTargets->ssao.getTextureColor().getHandle());
 		ImGui::Render();
 		rendererUI.render(width, height, ImGui::GetDrawData());
 
@@ -40,16 +40,15 @@ struct MyApp: public CameraApp
 		// tone mapping (gamma correction / exposure)
 		luminance(ctx_, HDRLuminance, luminanceResult),
 		// Temporarily we switch between luminances [coming from PingPong light adaptation calculator]
-		hdr(ctx_, HDRLuminance, luminanceResult, mappedUniformBufferAttachment(ctx_.resources, &hdrUniforms, VK_SHADER_STAGE_FRAGMENT_BIT)),
+		// (no aliasing of the bloom targets: all of them are displayed in the debug window)
+		hdr(ctx_, HDRLuminance, luminanceResult, mappedUniformBufferAttachment(ctx_.resources, &hdrUniforms, VK_SHADER_STAGE_FRAGMENT_BIT), false),
 
 		displayedTextureList(
 			 {	hdrTex,
-				HDRLuminance, luminance.getResult64(),
-				luminance.getResult32(), luminance.getResult16(), luminance.getResult08(),
-				luminance.getResult04(), luminance.getResult02(), luminance.getResult01(), // 2 - 9
-				hdr.getBloom1(), hdr.getBloom2(), hdr.getBrightness(), hdr.getResult(), // 10 - 13
-				HDRLuminance, hdr.getStreaks1(), hdr.getStreaks2(),  // 14 - 16
-				hdr.getAdaptatedLum1(), hdr.getAdaptatedLum2() }),// 17 - 18
+				HDRLuminance, luminance.getResult01(), // 2 - 3
+				hdr.getBloom1(), hdr.getBloom2(), hdr.getBrightness(), hdr.getResult(), // 4 - 7
+				HDRLuminance, hdr.getStreaks1(), hdr.getStreaks2(),  // 8 - 10
+				hdr.getAdaptatedLum1(), hdr.getAdaptatedLum2() }),// 11 - 12
 
 		quads(ctx_, displayedTextureList),
 		imgui(ctx_, displayedTextureList),
@@ -114,6 +113,9 @@ struct MyApp: public CameraApp
 			ImGui::SliderFloat("MaxWhite: ", &hdrUniforms->maxWhite, 0.1f, 2.0f);
 			ImGui::SliderFloat("Exposure: ", &hdrUniforms->exposure, 0.1f, 10.0f);
 			ImGui::SliderFloat("Adaptation speed: ", &hdrUniforms->adaptationSpeed, 0.01f, 2.0f);
+			// the average is taken over [low, high], an empty range falls back to the darkest bin
+			ImGui::SliderFloat("Low percentile: ", &luminance.params->lowPercentile_, 0.0f, luminance.params->highPercentile_);
+			ImGui::SliderFloat("High percentile: ", &luminance.params->highPercentile_, luminance.params->lowPercentile_, 1.0f);
 		ImGui::End();
 
 		if (showPyramid)
@@ -122,20 +124,8 @@ struct MyApp: public CameraApp
 
 			ImGui::Text("HDRColor");
 			ImGui::Image((void*)(intptr_t)(2 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
-			ImGui::Text("Lum64");
-			ImGui::Image((void*)(intptr_t)(3 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
-			ImGui::Text("Lum32");
-			ImGui::Image((void*)(intptr_t)(4 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
-			ImGui::Text("Lum16");
-			ImGui::Image((void*)(intptr_t)(5 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
-			ImGui::Text("Lum08");
-			ImGui::Image((void*)(intptr_t)(6 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
-			ImGui::Text("Lum04");
-			ImGui::Image((void*)(intptr_t)(7 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
-			ImGui::Text("Lum02");
-			ImGui::Image((void*)(intptr_t)(8 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 			ImGui::Text("Lum01");
-			ImGui::Image((void*)(intptr_t)(9 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+			ImGui::Image((void*)(intptr_t)(3 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 			ImGui::End();
 		}
 
@@ -143,25 +133,25 @@ struct MyApp: public CameraApp
 		{
 			ImGui::Begin("Adaptation", nullptr);
 			ImGui::Text("Adapt1");
-			ImGui::Image((void*)(intptr_t)(17 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+			ImGui::Image((void*)(intptr_t)(11 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 			ImGui::Text("Adapt2");
-			ImGui::Image((void*)(intptr_t)(18 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+			ImGui::Image((void*)(intptr_t)(12 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 			ImGui::End();
 
 			ImGui::Begin("Debug", nullptr);
 			ImGui::Text("Bloom1");
-			ImGui::Image((void*)(intptr_t)(10 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+			ImGui::Image((void*)(intptr_t)(4 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 			ImGui::Text("Bloom2");
-			ImGui::Image((void*)(intptr_t)(11 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+			ImGui::Image((void*)(intptr_t)(5 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 			ImGui::Text("Bright");
-			ImGui::Image((void*)(intptr_t)(12 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+			ImGui::Image((void*)(intptr_t)(6 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 			ImGui::Text("Result");
-			ImGui::Image((void*)(intptr_t)(13 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+			ImGui::Image((void*)(intptr_t)(7 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 
 			ImGui::Text("Streaks1");
-			ImGui::Image((void*)(intptr_t)(14 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+			ImGui::Image((void*)(intptr_t)(8 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 			ImGui::Text("Streaks2");
-			ImGui::Image((void*)(intptr_t)(15 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
+			ImGui::Image((void*)(intptr_t)(9 | TEX_RGB), ImVec2(128, 128), ImVec2(0.0f, 1.0f), ImVec2(1.0f, 0.0f));
 			ImGui::End();
 		}
 	}
@@ -175,7 +165,7 @@ struct MyApp: public CameraApp
 		multiRenderer.checkLoadedTextures();
 
 		quads.clear();
-		quads.quad(-1.0f, 1.0f, 1.0f, -1.0f, 12);
+		quads.quad(-1.0f, 1.0f, 1.0f, -1.0f, 6);
 	}
 
 private:
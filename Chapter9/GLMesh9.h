@@ -2,6 +2,8 @@
 
 #include <functional>
 
+#include "shared/scene/TransformUploads.h"
+
 const GLuint kBufferIndex_PerFrameUniforms = 0;
 const GLuint kBufferIndex_ModelMatrices = 1;
 const GLuint kBufferIndex_Materials = 2;
@@ -32,16 +34,23 @@ public:
 	void selectTo(GLIndirectBuffer& buf, const std::function<bool(const DrawElementsIndirectCommand&)>& pred)
 	{
 		buf.drawCommands_.clear();
-		for (const auto& c : drawCommands_)
+		buf.numShortCommands_ = 0;
+		for (size_t i = 0; i != drawCommands_.size(); i++)
 		{
-			if (pred(c))
-				buf.drawCommands_.push_back(c);
+			if (pred(drawCommands_[i]))
+			{
+				buf.drawCommands_.push_back(drawCommands_[i]);
+				buf.numShortCommands_ += (i < numShortCommands_) ? 1 : 0;
+			}
 		}
 		buf.uploadIndirectBuffer();
 	}
 
 	std::vector<DrawElementsIndirectCommand> drawCommands_;
 
+	/* The commands with 16-bit indices come first (see PackedIndexData) */
+	uint32_t numShortCommands_ = 0;
+
 private:
 	GLBuffer bufferIndirect_;
 };
@@ -50,9 +59,15 @@ template <typename GLSceneDataType>
 class GLMesh final
 {
 public:
-	explicit GLMesh(const GLSceneDataType& data)
-		: numIndices_(data.header_.indexDataSize / sizeof(uint32_t))
-		, bufferIndices_(data.header_.indexDataSize, data.meshData_.indexData_.data(), 0)
+	/* If 'drawInstances' is set, adjacent shapes with the same mesh and material become one command with several instances
+	   (see gl_InstanceID in GL01_scene_IBL.vert), otherwise every shape has its own command for per-shape culling.
+	   Every mesh uses 16-bit indices if it fits, the commands with 16-bit indices come first (the shape of a command is baseInstance_ >> 16) */
+	explicit GLMesh(const GLSceneDataType& data, bool drawInstances = false)
+		: GLMesh(data, packIndexData(data.meshData_), drawInstances)
+	{}
+
+	GLMesh(const GLSceneDataType& data, const PackedIndexData& indices, bool drawInstances)
+		: bufferIndices_(indices.data_.size() * sizeof(uint32_t), indices.data_.data(), 0)
 		, bufferVertices_(data.header_.vertexDataSize, data.meshData_.vertexData_.data(), 0)
 		, bufferMaterials_(sizeof(MaterialDescription) * data.materials_.size(), data.materials_.data(), GL_DYNAMIC_STORAGE_BIT)
 		, bufferModelMatrices_(sizeof(glm::mat4) * data.shapes_.size(), nullptr, GL_DYNAMIC_STORAGE_BIT)
@@ -76,38 +91,81 @@ public:
 
 		std::vector<glm::mat4> matrices(data.shapes_.size());
 
-		// prepare indirect commands buffer
-		for (size_t i = 0; i != data.shapes_.size(); i++)
+		// prepare indirect commands buffer: the commands with 16-bit indices first, so every index type is drawn by one multi-draw
+		std::vector<DrawElementsIndirectCommand>& shortCommands = bufferIndirect_.drawCommands_;
+		std::vector<DrawElementsIndirectCommand> longCommands;
+		shortCommands.clear();
+
+		for (size_t i = 0; i != data.shapes_.size(); )
 		{
-			const uint32_t meshIdx = data.shapes_[i].meshIndex;
-			const uint32_t lod = data.shapes_[i].LOD;
-			bufferIndirect_.drawCommands_[i] = {
-				.count_ = data.meshData_.meshes_[meshIdx].getLODIndicesCount(lod),
-				.instanceCount_ = 1,
-				.firstIndex_ = data.shapes_[i].indexOffset,
-				.baseVertex_ = data.shapes_[i].vertexOffset,
-				.baseInstance_ = data.shapes_[i].materialIndex + (uint32_t(i) << 16)
-			};
-			matrices[i] = data.scene_.globalTransform_[data.shapes_[i].transformIndex];
+			const size_t first = i;
+
+			while (++i != data.shapes_.size() && drawInstances && canDrawAsInstances(data.shapes_[first], data.shapes_[i])) {}
+
+			const uint32_t meshIdx = data.shapes_[first].meshIndex;
+			const uint32_t lod = data.shapes_[first].LOD;
+			const Mesh& m = data.meshData_.meshes_[meshIdx];
+			(m.hasShortIndices() ? shortCommands : longCommands).push_back({
+				.count_ = m.getLODIndicesCount(lod),
+				.instanceCount_ = uint32_t(i - first),
+				.firstIndex_ = indices.getFirstIndex(data.meshData_, meshIdx, data.shapes_[first].indexOffset),
+				.baseVertex_ = data.shapes_[first].vertexOffset,
+				.baseInstance_ = data.shapes_[first].materialIndex + (uint32_t(first) << 16)
+			});
 		}
 
+		bufferIndirect_.numShortCommands_ = (uint32_t)shortCommands.size();
+		mergeVectors(shortCommands, longCommands);
+
+		for (size_t i = 0; i != data.shapes_.size(); i++)
+			matrices[i] = data.scene_.globalTransform_[data.shapes_[i].transformIndex];
+
 		bufferIndirect_.uploadIndirectBuffer();
 
 		glNamedBufferSubData(bufferModelMatrices_.getHandle(), 0, matrices.size() * sizeof(mat4), matrices.data());
 	}
 
+	/* Uploads the transforms of the shapes whose nodes were recalculated since the last call (see TransformUploadTracker).
+	   The first call uploads all of them */
+	void updateMatrices(GLSceneDataType& data)
+	{
+		for (const auto& r: transformUploads_.update(data.scene_, data.shapes_, matrices_))
+			glNamedBufferSubData(bufferModelMatrices_.getHandle(), r.first_ * sizeof(mat4), r.count_ * sizeof(mat4), matrices_.data() + r.first_);
+	}
+
+	const TransformUploadStats& getTransformUploadStats() const { return transformUploads_.getStats(); }
+
 	void updateMaterialsBuffer(const GLSceneDataType& data)
 	{
 		glNamedBufferSubData(bufferMaterials_.getHandle(), 0, sizeof(MaterialDescription) * data.materials_.size(), data.materials_.data());
 	}
 
+	/* One multi-draw for the commands with 16-bit indices, one for the rest */
 	void draw(size_t numDrawCommands, const GLIndirectBuffer* buffer = nullptr) const
 	{
+		const GLIndirectBuffer& commands = buffer ? *buffer : bufferIndirect_;
+		const size_t numShort = std::min(numDrawCommands, (size_t)commands.numShortCommands_);
+
 		glBindVertexArray(vao_);
 		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_Materials, bufferMaterials_.getHandle());
 		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_ModelMatrices, bufferModelMatrices_.getHandle());
-		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, (buffer ? *buffer : bufferIndirect_).getHandle());
-		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, (GLsizei)numDrawCommands, 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.getHandle());
+		if (numShort)
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, nullptr, (GLsizei)numShort, 0);
+		if (numDrawCommands > numShort)
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)(numShort * sizeof(DrawElementsIndirectCommand)), (GLsizei)(numDrawCommands - numShort), 0);
+	}
+
+	/* The GPU reads the number of commands (up to 'maxDrawCommands') from 'countBuffer' at 'countOffset' bytes (see GL02_FrustumCullingCompact.comp).
+	   All the commands in the range have the same 'indexType' (see GLIndirectBuffer::numShortCommands_) */
+	void drawIndirectCount(const GLIndirectBuffer& buffer, size_t firstDrawCommand, size_t maxDrawCommands, const GLBuffer& countBuffer, size_t countOffset, GLenum indexType) const
+	{
+		glBindVertexArray(vao_);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_Materials, bufferMaterials_.getHandle());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, kBufferIndex_ModelMatrices, bufferModelMatrices_.getHandle());
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffer.getHandle());
+		glBindBuffer(GL_PARAMETER_BUFFER, countBuffer.getHandle());
+		glMultiDrawElementsIndirectCount(GL_TRIANGLES, indexType, (const void*)(firstDrawCommand * sizeof(DrawElementsIndirectCommand)), (GLintptr)countOffset, (GLsizei)maxDrawCommands, 0);
 	}
 
 	~GLMesh()
@@ -120,7 +178,6 @@ public:
 
 //private:
 	GLuint vao_;
-	uint32_t numIndices_;
 
 	GLBuffer bufferIndices_;
 	GLBuffer bufferVertices_;
@@ -128,4 +185,7 @@ public:
 	GLBuffer bufferModelMatrices_;
 
 	GLIndirectBuffer bufferIndirect_;
+
+	TransformUploadTracker transformUploads_;
+	std::vector<glm::mat4> matrices_;
 };
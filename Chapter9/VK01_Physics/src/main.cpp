@@ -39,6 +39,7 @@ struct MyApp: public CameraApp
 		sceneData.scene_.globalTransform_[0] = glm::mat4(1.f);
 		for (size_t i = 0; i < physics.boxTransform.size(); i++)
 			sceneData.scene_.globalTransform_[i] = physics.boxTransform[i];
+		sceneData.scene_.allTransformsChanged_ = true;
 	}
 
 	void update(float deltaSeconds) override
@@ -65,7 +66,7 @@ void generateMeshFile()
 	constexpr uint32_t cubeVtxCount = 8;
 	constexpr uint32_t cubeIdxCount = 36;
 
-	Mesh cubeMesh { .lodCount = 1, .streamCount = 1, .lodOffset = { 0, cubeIdxCount }, .streamOffset = { 0 } };
+	Mesh cubeMesh { .lodCount = 1, .streamCount = 1, .vertexCount = cubeVtxCount, .lodOffset = { 0, cubeIdxCount }, .lodVertexCount = { cubeVtxCount }, .streamOffset = { 0 } };
 
 	MeshData md = {
 		.indexData_ = std::vector<uint32_t>(cubeIdxCount, 0),
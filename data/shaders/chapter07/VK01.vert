@@ -11,12 +11,11 @@ layout(location = 3) out flat uint matIdx;
 
 void main()
 {
-	DrawData dd = drawDataBuffer.data[gl_BaseInstance];
+	DrawData dd = drawDataBuffer.data[gl_InstanceIndex];
 
-	uint refIdx = dd.indexOffset + gl_VertexIndex;
-	ImDrawVert v = sbo.data[ibo.data[refIdx] + dd.vertexOffset];
+	ImDrawVert v = sbo.data[fetchIndex(dd, gl_VertexIndex) + dd.vertexOffset];
 
-	mat4 model = transformBuffer.data[gl_BaseInstance];
+	mat4 model = transformBuffer.data[gl_InstanceIndex];
 
 	v_worldPos   = model * vec4(v.x, v.y, v.z, 1.0);
 	v_worldNormal = transpose(inverse(mat3(model))) * vec3(v.nx, v.ny, v.nz);
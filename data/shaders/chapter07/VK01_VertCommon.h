@@ -3,3 +3,13 @@ layout(binding = 1) readonly buffer SBO    { ImDrawVert data[]; } sbo;
 layout(binding = 2) readonly buffer IBO    { uint   data[]; } ibo;
 layout(binding = 3) readonly buffer DrawBO { DrawData data[]; } drawDataBuffer;
 layout(binding = 5) readonly buffer XfrmBO { mat4 data[]; } transformBuffer;
+
+// the meshes with 16-bit indices have the top bit of indexOffset set, their offsets are counted in 16-bit elements (see VKSceneData)
+uint fetchIndex(DrawData dd, uint i)
+{
+	if ((dd.indexOffset & 0x80000000u) == 0u)
+		return ibo.data[dd.indexOffset + i];
+
+	const uint idx = (dd.indexOffset & 0x7FFFFFFFu) + i;
+	return (ibo.data[idx >> 1] >> (16u * (idx & 1u))) & 0xFFFFu;
+}
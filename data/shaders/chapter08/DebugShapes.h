@@ -0,0 +1,62 @@
+//
+// Wireframe shapes of LineCanvas and CanvasGL, expanded from one instance (see shared/DebugShapes.h)
+
+struct DebugLineVertex
+{
+	float x, y, z;
+	uint color;
+};
+
+struct DebugShape
+{
+	mat4 transform;
+	uint color;
+	uint outlineColor;
+	uint gridX; // 0 for boxes and frusta
+	uint gridY;
+};
+
+// pairs of cube corners, bit 0 = x, bit 1 = y, bit 2 = z
+const uint boxEdges[24] = uint[](0, 1, 2, 3, 4, 5, 6, 7,  0, 2, 1, 3, 4, 6, 5, 7,  0, 4, 1, 5, 2, 6, 3, 7);
+
+// Returns false for the padding vertices of planes with coarser grids
+bool getDebugShapeVertex(DebugShape s, uint vertex, out vec4 pos, out vec4 color)
+{
+	if (s.gridX == 0)
+	{
+		uint c = boxEdges[vertex];
+		vec4 p = s.transform * vec4((c & 1) != 0 ? 1.0 : -1.0, (c & 2) != 0 ? 1.0 : -1.0, (c & 4) != 0 ? 1.0 : -1.0, 1.0);
+		// frusta are transformed by an inverse projection
+		pos = vec4(p.xyz / p.w, 1.0);
+		color = unpackUnorm4x8(s.color);
+		return true;
+	}
+
+	uint line = vertex / 2;
+	float e = (vertex & 1) != 0 ? 1.0 : -1.0;
+	vec2 p;
+
+	if (line < 4)
+	{
+		// outline
+		p = (line < 2) ? vec2(line == 0 ? -1.0 : 1.0, e) : vec2(e, line == 2 ? 1.0 : -1.0);
+		color = unpackUnorm4x8(s.outlineColor);
+	}
+	else if (line < 3 + s.gridX)
+	{
+		p = vec2(2.0 * float(line - 3) / float(s.gridX) - 1.0, e);
+		color = unpackUnorm4x8(s.color);
+	}
+	else if (line < 2 + s.gridX + s.gridY)
+	{
+		p = vec2(e, 2.0 * float(line - 2 - s.gridX) / float(s.gridY) - 1.0);
+		color = unpackUnorm4x8(s.color);
+	}
+	else
+	{
+		return false;
+	}
+
+	pos = s.transform * vec4(p, 0.0, 1.0);
+	return true;
+}
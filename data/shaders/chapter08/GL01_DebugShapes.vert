@@ -0,0 +1,41 @@
+//
+#version 460 core
+
+#include <data/shaders/chapter08/DebugShapes.h>
+
+layout(std140, binding = 0) uniform PerFrameData
+{
+	mat4 view;
+	mat4 proj;
+	vec4 cameraPos;
+};
+
+layout(std430, binding = 1) restrict readonly buffer Shapes
+{
+	DebugShape in_Shapes[];
+};
+
+struct PerVertex
+{
+	vec4 color;
+};
+
+layout (location=0) out PerVertex vtx;
+
+void main()
+{
+	vec4 pos;
+	vec4 color;
+
+	if (getDebugShapeVertex(in_Shapes[gl_BaseInstance + gl_InstanceID], gl_VertexID, pos, color))
+	{
+		gl_Position = proj * view * pos;
+		vtx.color = color;
+	}
+	else
+	{
+		// behind the far plane
+		gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+		vtx.color = vec4(0.0);
+	}
+}
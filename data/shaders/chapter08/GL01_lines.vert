@@ -1,6 +1,8 @@
 ﻿//
 #version 460 core
 
+#include <data/shaders/chapter08/DebugShapes.h>
+
 layout(std140, binding = 0) uniform PerFrameData
 {
 	mat4 view;
@@ -8,27 +10,11 @@ layout(std140, binding = 0) uniform PerFrameData
 	vec4 cameraPos;
 };
 
-struct Vertex
-{
-	float p[3];
-	float c[4];
-};
-
 layout(std430, binding = 1) restrict readonly buffer Vertices
 {
-	Vertex in_Vertices[];
+	DebugLineVertex in_Vertices[];
 };
 
-vec3 getPosition(int i)
-{
-	return vec3(in_Vertices[i].p[0], in_Vertices[i].p[1], in_Vertices[i].p[2]);
-}
-
-vec4 getColor(int i)
-{
-	return vec4(in_Vertices[i].c[0], in_Vertices[i].c[1], in_Vertices[i].c[2], in_Vertices[i].c[3]);
-}
-
 struct PerVertex
 {
 	vec4 color;
@@ -38,7 +24,9 @@ layout (location=0) out PerVertex vtx;
 
 void main()
 {
-	gl_Position = proj * view * vec4(getPosition(gl_VertexID), 1.0);
+	DebugLineVertex v = in_Vertices[gl_VertexID];
+
+	gl_Position = proj * view * vec4(v.x, v.y, v.z, 1.0);
 
-	vtx.color = getColor(gl_VertexID);
+	vtx.color = unpackUnorm4x8(v.color);
 }
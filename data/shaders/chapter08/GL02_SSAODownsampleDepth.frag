@@ -0,0 +1,37 @@
+/**/
+#version 460 core
+
+layout(location = 0) in vec2 uv;
+
+layout(location = 0) out vec4 outColor;
+
+layout(binding = 0) uniform sampler2D texDepth;
+
+// Min/max downsampling in a checkerboard pattern: both the foreground and the background of every block survive
+// in the SSAO buffer and GL02_SSAO_combine.frag picks the samples with the matching depth
+void main()
+{
+	ivec2 size = textureSize(texDepth, 0);
+
+	// the quad covers the whole output, so the derivative is exactly one output texel
+	int factor = max(int(round(abs(dFdx(uv.x)) * float(size.x))), 1);
+
+	ivec2 base = ivec2(floor(uv * vec2(size))) - ivec2(factor / 2);
+
+	float minZ = 1.0;
+	float maxZ = 0.0;
+
+	for (int y = 0; y < factor; y++)
+	{
+		for (int x = 0; x < factor; x++)
+		{
+			float z = texelFetch(texDepth, clamp(base + ivec2(x, y), ivec2(0), size - ivec2(1)), 0).x;
+			minZ = min(minZ, z);
+			maxZ = max(maxZ, z);
+		}
+	}
+
+	ivec2 p = ivec2(gl_FragCoord.xy);
+
+	outColor = vec4(((p.x + p.y) & 1) == 0 ? minZ : maxZ, 0.0, 0.0, 1.0);
+}
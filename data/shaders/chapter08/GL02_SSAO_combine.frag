@@ -7,17 +7,58 @@ layout(location = 0) out vec4 outColor;
 
 layout(binding = 0) uniform sampler2D texScene;
 layout(binding = 1) uniform sampler2D texSSAO;
+// full resolution and SSAO resolution (see GL02_SSAODownsampleDepth.frag)
+layout(binding = 2) uniform sampler2D texDepth;
+layout(binding = 3) uniform sampler2D texDepthSSAO;
 
 layout(std140, binding = 0) uniform SSAOParams
 {
 	float scale;
 	float bias;
+	float zNear;
+	float zFar;
 };
 
+float linearDepth(float z)
+{
+	return zFar * zNear / (zFar - z * (zFar - zNear));
+}
+
+// Depth-aware bilateral upsampling: the bilinear weights of the 4 nearest SSAO texels are reduced by their relative depth difference
+float upsampleSSAO(vec2 uv)
+{
+	const float depthSharpness = 1000.0;
+
+	ivec2 size = textureSize(texSSAO, 0);
+	vec2 pos = uv * vec2(size) - vec2(0.5);
+	ivec2 p0 = ivec2(floor(pos));
+	vec2 f = pos - floor(pos);
+
+	float z = linearDepth(texture(texDepth, uv).x);
+
+	float sum = 0.0;
+	float sumWeights = 0.0;
+
+	for (int i = 0; i < 4; i++)
+	{
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		ivec2 p = clamp(p0 + offset, ivec2(0), size - ivec2(1));
+
+		vec2 bilinear = mix(vec2(1.0) - f, f, vec2(offset));
+		float dz = (linearDepth(texelFetch(texDepthSSAO, p, 0).x) - z) / z;
+		float w = bilinear.x * bilinear.y / (1.0 + depthSharpness * dz * dz);
+
+		sum += w * texelFetch(texSSAO, p, 0).r;
+		sumWeights += w;
+	}
+
+	return sum / max(sumWeights, 1e-6);
+}
+
 void main()
 {
 	vec4 color = texture(texScene, uv);
-	float ssao = clamp( texture(texSSAO,  uv).r + bias, 0.0, 1.0 );
+	float ssao = clamp( upsampleSSAO(uv) + bias, 0.0, 1.0 );
 
 	outColor = vec4(
 		mix(color, color * ssao, scale).rgb,
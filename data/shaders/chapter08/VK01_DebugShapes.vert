@@ -0,0 +1,32 @@
+//
+#version 460
+
+#include <data/shaders/chapter08/DebugShapes.h>
+
+layout(location = 0) out vec4 lineColor;
+
+layout(binding = 0) uniform UBO {
+	mat4 inMtx;
+	float time;
+} ubo;
+
+layout(binding = 2) readonly buffer Shapes { DebugShape data[]; } shapes;
+
+void main()
+{
+	vec4 pos;
+	vec4 color;
+
+	// gl_InstanceIndex includes the first instance of vkCmdDraw()
+	if (getDebugShapeVertex(shapes.data[gl_InstanceIndex], gl_VertexIndex, pos, color))
+	{
+		gl_Position = ubo.inMtx * pos;
+		lineColor = color;
+	}
+	else
+	{
+		// behind the far plane
+		gl_Position = vec4(0.0, 0.0, 2.0, 1.0);
+		lineColor = vec4(0.0);
+	}
+}
@@ -0,0 +1,21 @@
+//
+#version 460
+
+#include <data/shaders/chapter08/DebugShapes.h>
+
+layout(location = 0) out vec4 lineColor;
+
+layout(binding = 0) uniform UBO {
+	mat4 inMtx;
+	float time;
+} ubo;
+
+layout(binding = 1) readonly buffer Vertices { DebugLineVertex data[]; } vertices;
+
+void main()
+{
+	DebugLineVertex v = vertices.data[gl_VertexIndex];
+
+	gl_Position = ubo.inMtx * vec4(v.x, v.y, v.z, 1.0);
+	lineColor = unpackUnorm4x8(v.color);
+}
@@ -0,0 +1,21 @@
+/**/
+#version 460
+
+layout(location = 0) in vec2 texCoord;
+layout(location = 0) out vec4 outColor;
+
+layout(binding = 0) uniform sampler2D texSampler;
+
+void main()
+{
+	// the output is half the size of the input: every bilinear tap averages 2x2 texels, the four taps cover 4x4 texels
+	vec2 texel = 1.0 / vec2(textureSize(texSampler, 0));
+
+	vec3 color = 0.25 * (
+		texture(texSampler, texCoord + vec2(-texel.x, -texel.y)).rgb +
+		texture(texSampler, texCoord + vec2( texel.x, -texel.y)).rgb +
+		texture(texSampler, texCoord + vec2(-texel.x,  texel.y)).rgb +
+		texture(texSampler, texCoord + vec2( texel.x,  texel.y)).rgb );
+
+	outColor = vec4(color, 1.0);
+}
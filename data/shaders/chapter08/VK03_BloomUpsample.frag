@@ -0,0 +1,39 @@
+/**/
+#version 460
+
+layout(location = 0) in vec2 texCoord;
+layout(location = 0) out vec4 outColor;
+
+// the accumulated coarser levels (half the size of the output) and the downsampled level of the output size
+layout(binding = 0) uniform sampler2D texCoarser;
+layout(binding = 1) uniform sampler2D texLevel;
+
+// weight of the coarser levels: the result is a weighted average of all levels, larger values give wider halos
+const float scatter = 0.7;
+
+void main()
+{
+	vec2 texel = 1.0 / vec2(textureSize(texCoarser, 0));
+
+	// 3x3 tent filter
+	vec3 up = 4.0 * texture(texCoarser, texCoord).rgb;
+
+	up += 2.0 * (
+		texture(texCoarser, texCoord + vec2(-texel.x, 0.0)).rgb +
+		texture(texCoarser, texCoord + vec2( texel.x, 0.0)).rgb +
+		texture(texCoarser, texCoord + vec2(0.0, -texel.y)).rgb +
+		texture(texCoarser, texCoord + vec2(0.0,  texel.y)).rgb );
+
+	up +=
+		texture(texCoarser, texCoord + vec2(-texel.x, -texel.y)).rgb +
+		texture(texCoarser, texCoord + vec2( texel.x, -texel.y)).rgb +
+		texture(texCoarser, texCoord + vec2(-texel.x,  texel.y)).rgb +
+		texture(texCoarser, texCoord + vec2( texel.x,  texel.y)).rgb;
+
+	up /= 16.0;
+
+	// every quad pass flips the image vertically and the two inputs went through an odd and an even number of passes
+	vec3 level = texture(texLevel, vec2(texCoord.x, 1.0 - texCoord.y)).rgb;
+
+	outColor = vec4(mix(level, up, scatter), 1.0);
+}
@@ -6,12 +6,26 @@ layout(location = 0) out vec4 outColor;
 
 layout(binding = 0) uniform sampler2D texSampler;
 
-void main()
+vec4 brightTap(vec2 uv)
 {
-  vec4 Color = vec4( texture(texSampler, texCoord) );
+  vec4 Color = vec4( texture(texSampler, uv) );
 
   if ( dot( Color, vec4( 0.33, 0.34, 0.33, 0.0) ) < 1.0 ) Color = vec4( 0.0, 0.0, 0.0, 1.0 );
 
+  return Color;
+}
+
+void main()
+{
+  // the output is half the size of the input: 4 bilinear taps average 4x4 input texels (see VK03_BloomDownsample.frag)
+  vec2 texel = 1.0 / vec2(textureSize(texSampler, 0));
+
+  vec4 Color = 0.25 * (
+    brightTap(texCoord + vec2(-texel.x, -texel.y)) +
+    brightTap(texCoord + vec2( texel.x, -texel.y)) +
+    brightTap(texCoord + vec2(-texel.x,  texel.y)) +
+    brightTap(texCoord + vec2( texel.x,  texel.y)) );
+
   outColor = vec4(Color.xyz, 1.0);
 //  outColor = vec4(0, 1, 0, 1.0);
 }
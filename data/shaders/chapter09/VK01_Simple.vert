@@ -53,7 +53,7 @@ void main()
 	vec3 position = pos[vidx];
 	vec3 normal = normals[faceIndex];
 
-	mat4 model = transformBuffer.data[gl_BaseInstance];
+	mat4 model = transformBuffer.data[gl_InstanceIndex];
 
 	v_worldPos   = model * vec4(position, 1.0);
 	v_worldNormal = transpose(inverse(mat3(model))) * normal;
@@ -0,0 +1,40 @@
+//
+// Bounding box vs. frustum test shared by the culling shaders. Expects 'frustumPlanes[6]' and 'frustumCorners[8]' to be declared
+
+struct AABB
+{
+	float pt[6];
+};
+
+#define Box_min_x box.pt[0]
+#define Box_min_y box.pt[1]
+#define Box_min_z box.pt[2]
+#define Box_max_x box.pt[3]
+#define Box_max_y box.pt[4]
+#define Box_max_z box.pt[5]
+
+bool isAABBinFrustum(AABB box)
+{
+	for (int i = 0; i < 6; i++) {
+		int r = 0;
+		r += ( dot( frustumPlanes[i], vec4(Box_min_x, Box_min_y, Box_min_z, 1.0f) ) < 0.0 ) ? 1 : 0;
+		r += ( dot( frustumPlanes[i], vec4(Box_max_x, Box_min_y, Box_min_z, 1.0f) ) < 0.0 ) ? 1 : 0;
+		r += ( dot( frustumPlanes[i], vec4(Box_min_x, Box_max_y, Box_min_z, 1.0f) ) < 0.0 ) ? 1 : 0;
+		r += ( dot( frustumPlanes[i], vec4(Box_max_x, Box_max_y, Box_min_z, 1.0f) ) < 0.0 ) ? 1 : 0;
+		r += ( dot( frustumPlanes[i], vec4(Box_min_x, Box_min_y, Box_max_z, 1.0f) ) < 0.0 ) ? 1 : 0;
+		r += ( dot( frustumPlanes[i], vec4(Box_max_x, Box_min_y, Box_max_z, 1.0f) ) < 0.0 ) ? 1 : 0;
+		r += ( dot( frustumPlanes[i], vec4(Box_min_x, Box_max_y, Box_max_z, 1.0f) ) < 0.0 ) ? 1 : 0;
+		r += ( dot( frustumPlanes[i], vec4(Box_max_x, Box_max_y, Box_max_z, 1.0f) ) < 0.0 ) ? 1 : 0;
+		if ( r == 8 ) return false;
+	}
+
+	int r = 0;
+	r = 0; for ( int i = 0; i < 8; i++ ) r += ( (frustumCorners[i].x > Box_max_x) ? 1 : 0 ); if ( r == 8 ) return false;
+	r = 0; for ( int i = 0; i < 8; i++ ) r += ( (frustumCorners[i].x < Box_min_x) ? 1 : 0 ); if ( r == 8 ) return false;
+	r = 0; for ( int i = 0; i < 8; i++ ) r += ( (frustumCorners[i].y > Box_max_y) ? 1 : 0 ); if ( r == 8 ) return false;
+	r = 0; for ( int i = 0; i < 8; i++ ) r += ( (frustumCorners[i].y < Box_min_y) ? 1 : 0 ); if ( r == 8 ) return false;
+	r = 0; for ( int i = 0; i < 8; i++ ) r += ( (frustumCorners[i].z > Box_max_z) ? 1 : 0 ); if ( r == 8 ) return false;
+	r = 0; for ( int i = 0; i < 8; i++ ) r += ( (frustumCorners[i].z < Box_min_z) ? 1 : 0 ); if ( r == 8 ) return false;
+
+	return true;
+}
@@ -30,7 +30,7 @@ const mat4 scaleBias = mat4(
 
 void main()
 {
-	mat4 model = in_Model[gl_BaseInstance >> 16];
+	mat4 model = in_Model[(gl_BaseInstance >> 16) + gl_InstanceID];
 	mat4 MVP = proj * view * model;
 
 	gl_Position = MVP * vec4(in_Vertex, 1.0);
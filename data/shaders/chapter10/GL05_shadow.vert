@@ -12,7 +12,7 @@ layout (location=0) in vec3 in_Vertex;
 
 void main()
 {
-	mat4 model = in_Model[gl_BaseInstance >> 16];
+	mat4 model = in_Model[(gl_BaseInstance >> 16) + gl_InstanceID];
 
 	gl_Position = proj * view * model * vec4(in_Vertex, 1.0);
 }
@@ -4,7 +4,7 @@
 layout (location = 0) in vec2 uv;
 layout (location = 0) out vec4 outColor;
 
-layout (binding = 0) uniform UniformBuffer { uint width; uint height; } ubo;
+layout (binding = 0) uniform UniformBuffer { uint width; uint height; uint oitMode; uint numLayers; } ubo;
 
 struct TransparentFragment {
 	vec4 color;
@@ -16,7 +16,10 @@ layout (binding = 1) buffer Heads { uint heads[] ; };
 
 layout (binding = 2) buffer Lists { TransparentFragment fragments[]; };
 
-layout (binding = 3) uniform sampler2D texScene;
+// see VK02_Glass.frag
+layout (binding = 3) buffer Layers { uvec4 layers[]; };
+
+layout (binding = 4) uniform sampler2D texScene;
 
 void main()
 {
@@ -24,17 +27,34 @@ void main()
 	TransparentFragment frags[64];
 
 	int numFragments = 0;
-	uint headIdx = heads[uint(gl_FragCoord.y) * ubo.width + uint(gl_FragCoord.x)]; // imageLoad(heads, ivec2(gl_FragCoord.xy)).r;
-	uint idx = headIdx;
+	uint pixel = uint(gl_FragCoord.y) * ubo.width + uint(gl_FragCoord.x);
+	uint headIdx = heads[pixel]; // imageLoad(heads, ivec2(gl_FragCoord.xy)).r;
+
+	if (ubo.oitMode == 0)
+	{
+		uint idx = headIdx;
 
-//	vec4 idxColor = unpackUnorm4x8(idx);
+//		vec4 idxColor = unpackUnorm4x8(idx);
 
-	// copy the linked list for this fragment into an array
-	while (idx != 0xFFFFFFFF && numFragments < MAX_FRAGMENTS)
+		// copy the linked list for this fragment into an array
+		while (idx != 0xFFFFFFFF && numFragments < MAX_FRAGMENTS)
+		{
+			frags[numFragments] = fragments[idx];
+			numFragments++;
+			idx = fragments[idx].next;
+		}
+	}
+	else
 	{
-		frags[numFragments] = fragments[idx];
-		numFragments++;
-		idx = fragments[idx].next;
+		// fixed layers: 'heads' is the number of fragments, the ones beyond numLayers are already blended into texScene
+		numFragments = int(min(headIdx, ubo.numLayers));
+
+		for (int i = 0; i < numFragments; i++)
+		{
+			uvec4 f = layers[uint(i) * ubo.width * ubo.height + pixel];
+			frags[i].color = vec4(unpackHalf2x16(f.x), unpackHalf2x16(f.y));
+			frags[i].depth = uintBitsToFloat(f.z);
+		}
 	}
 
 	// sort the array by depth using insertion sort (largest to smallest)
@@ -28,18 +28,27 @@ struct TransparentFragment {
 	uint next;
 };
 
-layout (binding = 7) buffer Atomic { uint numFragments; };
+// see eOITMode in FinalRenderer.h
+const uint OITMode_LinkedList  = 0;
+const uint OITMode_FixedLayers = 1;
+
+layout (binding = 7) buffer Atomic { uint numFragments; uint numOverflow; };
+// list heads (linked lists) or the number of fragments of every pixel (fixed layers)
 layout (binding = 8) buffer Heads { uint heads[]; };
 layout (binding = 9) buffer Lists { TransparentFragment fragments[]; };
+// layer-major: layer * width * height + pixel; packHalf2x16(r, g), packHalf2x16(b, a), depth, unused
+layout (binding = 10) buffer Layers { uvec4 layers[]; };
+
+layout (binding = 11) uniform OITParams { uint width; uint height; uint oitMode; uint numLayers; } oit;
 
-layout(binding = 10) uniform samplerCube texEnvMap;
-layout(binding = 11) uniform samplerCube texEnvMapIrradiance;
-layout(binding = 12) uniform sampler2D   texBRDF_LUT;
+layout(binding = 12) uniform samplerCube texEnvMap;
+layout(binding = 13) uniform samplerCube texEnvMapIrradiance;
+layout(binding = 14) uniform sampler2D   texBRDF_LUT;
 
-layout(binding = 13) uniform sampler2D shadowMap;
+layout(binding = 15) uniform sampler2D shadowMap;
 
 // All 2D textures for all of the materials
-layout(binding = 14) uniform sampler2D textures[];
+layout(binding = 16) uniform sampler2D textures[];
 
 #include <data/shaders/chapter06/PBR.sp>
 
@@ -86,22 +95,47 @@ void main()
 
 	float alpha = clamp(albedo.a, 0.0, 1.0) * md.transparencyFactor_;
 	bool isTransparent = alpha < 0.99;
+	vec4 tailColor = vec4(0, 0, 0, 0);
 	if (isTransparent && gl_HelperInvocation == false)
 	{
 		if (alpha > 0.01)
 		{
 			uint index = atomicAdd(numFragments, 1);
-			const uint maxOITfragments = 16 * 1024 * 1024;
-			if (index < maxOITfragments)
+			uint fragIndex = uint(gl_FragCoord.y) * (oit.width)  + uint(gl_FragCoord.x);
+			if (oit.oitMode == OITMode_LinkedList)
+			{
+				// the buffer holds a fixed number of fragments, the rest is lost
+				if (index < fragments.length())
+				{
+					uint prevIndex = atomicExchange(heads[fragIndex], index);
+					fragments[index].color = vec4(outColor.rgb, alpha);
+					fragments[index].depth = gl_FragCoord.z;
+					fragments[index].next  = prevIndex;
+				}
+				else
+				{
+					atomicAdd(numOverflow, 1);
+				}
+			}
+			else
 			{
-				uint fragIndex = uint(gl_FragCoord.y) * (shadow_bo.width)  + uint(gl_FragCoord.x);
-				uint prevIndex = atomicExchange(heads[fragIndex], index);
-				fragments[index].color = vec4(outColor.rgb, alpha);
-				fragments[index].depth = gl_FragCoord.z;
-				fragments[index].next  = prevIndex;
+				// the first numLayers fragments of the pixel are sorted by VK02_ComposeOIT.frag,
+				// the tail is blended in the draw order right here, under the sorted layers
+				uint layer = atomicAdd(heads[fragIndex], 1);
+				if (layer < oit.numLayers)
+				{
+					layers[layer * oit.width * oit.height + fragIndex] =
+						uvec4(packHalf2x16(outColor.rg), packHalf2x16(vec2(outColor.b, alpha)), floatBitsToUint(gl_FragCoord.z), 0);
+				}
+				else
+				{
+					atomicAdd(numOverflow, 1);
+					tailColor = vec4(outColor.rgb, alpha);
+				}
 			}
 		}
 	}
 
- 	outColor = vec4(0, 0, 0, 0);
+	// blended with SRC_ALPHA / ONE_MINUS_SRC_ALPHA, zero alpha keeps the framebuffer
+	outColor = tailColor;
 }
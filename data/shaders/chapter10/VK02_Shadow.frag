@@ -18,20 +18,42 @@ layout(location = 0) out vec4 outColor;
 // Buffer with PBR material coefficients
 layout(binding = 4) readonly buffer MatBO  { MaterialData data[]; } mat_bo;
 
-layout(binding = 6) readonly buffer ShadowBO  { mat4 lightProj; mat4 lightView; } shadow_bo;
+// see LightParamsBuffer in FinalRenderer.h
+layout(binding = 6) readonly buffer ShadowBO
+{
+	mat4 lightProj;
+	mat4 lightView;
+	uint width;
+	uint height;
+	uint numCascades;
+	uint padding;
+	vec4 cascadeSplits;
+	mat4 cascadeViewProj[4];
+} shadow_bo;
 
 layout(binding = 7) uniform samplerCube texEnvMap;
 layout(binding = 8) uniform samplerCube texEnvMapIrradiance;
 layout(binding = 9) uniform sampler2D   texBRDF_LUT;
 
-layout(binding = 10) uniform sampler2D shadowMap;
+// cascades (the single shadow map is bound to all of them)
+layout(binding = 10) uniform sampler2D shadowMap0;
+layout(binding = 11) uniform sampler2D shadowMap1;
+layout(binding = 12) uniform sampler2D shadowMap2;
+layout(binding = 13) uniform sampler2D shadowMap3;
 
 // All 2D textures for all of the materials
-layout(binding = 11) uniform sampler2D textures[];
+layout(binding = 14) uniform sampler2D textures[];
 
 #include <data/shaders/chapter06/PBR.sp>
 
-float PCF(int kernelSize, vec2 shadowCoord, float depth)
+// Vulkan's Z is in 0..1, but we did "(gl_Position.z + gl_Position.w) / 2.0" in VK02_Depth.vert
+const mat4 scaleBias = mat4( 
+	0.5, 0.0, 0.0, 0.0,
+	0.0, 0.5, 0.0, 0.0,
+	0.0, 0.0, 0.5, 0.0,
+	0.5, 0.5, 0.5, 1.0);
+
+float PCF(sampler2D shadowMap, int kernelSize, vec2 shadowCoord, float depth)
 {
 	float size = 1.0 / float( textureSize(shadowMap, 0 ).x );
 	float shadow = 0.0;
@@ -41,6 +63,15 @@ float PCF(int kernelSize, vec2 shadowCoord, float depth)
 	return shadow / (kernelSize * kernelSize);
 }
 
+float cascadePCF(uint cascade, vec2 shadowCoord, float depth)
+{
+	// the cascades are 4x smaller than the single map, so is the kernel
+	if (cascade == 0) return PCF( shadowMap0, 5, shadowCoord, depth );
+	if (cascade == 1) return PCF( shadowMap1, 5, shadowCoord, depth );
+	if (cascade == 2) return PCF( shadowMap2, 5, shadowCoord, depth );
+	return PCF( shadowMap3, 5, shadowCoord, depth );
+}
+
 float shadowFactor(vec4 shadowCoord)
 {
 	if (shadow_bo.lightProj[3][3] == 0.0)
@@ -51,13 +82,39 @@ float shadowFactor(vec4 shadowCoord)
 	if (shadowCoords4.z > -1.0 && shadowCoords4.z < 1.0)
 	{
 		float depthBias = -0.001;
-		float shadowSample = PCF( 13, shadowCoords4.xy, shadowCoords4.z + depthBias );
+		float shadowSample = PCF( shadowMap0, 13, shadowCoords4.xy, shadowCoords4.z + depthBias );
 		return mix(1.0, 0.3, shadowSample);
 	}
 
 	return 1.0; 
 }
 
+float cascadedShadowFactor(vec3 worldPos)
+{
+	// the cascades are split along the view-space depth
+	float viewDepth = -(ubo.view * vec4(worldPos, 1.0)).z;
+
+	for (uint i = 0; i < shadow_bo.numCascades; i++)
+	{
+		if (viewDepth > shadow_bo.cascadeSplits[i])
+			continue;
+
+		vec4 shadowCoords4 = scaleBias * shadow_bo.cascadeViewProj[i] * vec4(worldPos, 1.0);
+		shadowCoords4 /= shadowCoords4.w;
+
+		// outside of this cascade's depth range: the next (larger) cascade may still cover the point
+		if (shadowCoords4.z > -1.0 && shadowCoords4.z < 1.0)
+		{
+			float depthBias = -0.001;
+			float shadowSample = cascadePCF( i, shadowCoords4.xy, shadowCoords4.z + depthBias );
+			return mix(1.0, 0.3, shadowSample);
+		}
+	}
+
+	// beyond the last cascade
+	return 1.0;
+}
+
 void main()
 {
 
@@ -95,5 +152,7 @@ void main()
 	vec3 diffuseColor = albedo.rgb * (vec3(1.0) - f0);
 	vec3 diffuse = texture(texEnvMapIrradiance, n.xyz).rgb * diffuseColor;
 
-	outColor = vec4( diffuse * shadowFactor(v_shadowCoord), 1.0 );
+	float shadow = (shadow_bo.numCascades > 0) ? cascadedShadowFactor(v_worldPos.xyz) : shadowFactor(v_shadowCoord);
+
+	outColor = vec4( diffuse * shadow, 1.0 );
 }
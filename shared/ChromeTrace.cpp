@@ -0,0 +1,49 @@
+#include "shared/ChromeTrace.h"
+
+#include <stdio.h>
+
+/* Names come from the code (shaders, passes, files), so escaping quotes and backslashes is enough */
+static void writeEscaped(FILE* f, const std::string& s)
+{
+	for (char c: s)
+	{
+		if (c == '"' || c == '\\')
+			fputc('\\', f);
+		fputc((c >= 0 && c < ' ') ? ' ' : c, f);
+	}
+}
+
+bool writeChromeTrace(const char* fileName, const std::vector<TraceEvent>& events, const std::vector<std::string>& threadNames)
+{
+	FILE* f = fopen(fileName, "w");
+	if (!f)
+	{
+		printf("Cannot write %s\n", fileName);
+		return false;
+	}
+
+	fprintf(f, "{\n\"displayTimeUnit\": \"ms\",\n\"traceEvents\": [\n");
+
+	bool first = true;
+
+	for (size_t i = 0 ; i != threadNames.size() ; i++)
+	{
+		fprintf(f, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": %u, \"args\": { \"name\": \"", first ? "" : ",\n", (uint32_t)i);
+		writeEscaped(f, threadNames[i]);
+		fprintf(f, "\" }}");
+		first = false;
+	}
+
+	for (const auto& e: events)
+	{
+		fprintf(f, "%s{\"name\": \"", first ? "" : ",\n");
+		writeEscaped(f, e.name_);
+		fprintf(f, "\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}", e.category_, e.threadId_, e.startUs_, e.durationUs_);
+		first = false;
+	}
+
+	fprintf(f, "\n]\n}\n");
+	fclose(f);
+
+	return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+	Chrome trace event format writer (no GPU dependencies)
+
+	The output can be opened in chrome://tracing or https://ui.perfetto.dev.
+	Every event is a "complete" event ("ph": "X") on the lane (thread) 'threadId_';
+	lanes are named with 'thread_name' metadata events.
+*/
+
+struct TraceEvent
+{
+	std::string name_;
+	const char* category_ = "";
+	uint32_t threadId_ = 0;
+
+	double startUs_ = 0.0;
+	double durationUs_ = 0.0;
+};
+
+/* 'threadNames[i]' is the name of the lane with threadId_ == i */
+bool writeChromeTrace(const char* fileName, const std::vector<TraceEvent>& events, const std::vector<std::string>& threadNames = std::vector<std::string>());
+
+/* Thread-safe collection of CPU events (e.g., a startup timeline), times are relative to the construction of the recorder */
+struct CpuTraceRecorder final
+{
+	CpuTraceRecorder(): start_(std::chrono::high_resolution_clock::now()) {}
+
+	double getTimeUs() const
+	{
+		return 0.001 * (double)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start_).count();
+	}
+
+	/* The event lasts from 'startUs' till now */
+	void addEvent(const std::string& name, const char* category, uint32_t lane, double startUs)
+	{
+		const double endUs = getTimeUs();
+
+		std::lock_guard lock(mutex_);
+		events_.push_back({ .name_ = name, .category_ = category, .threadId_ = lane, .startUs_ = startUs, .durationUs_ = endUs - startUs });
+	}
+
+	bool write(const char* fileName, const std::vector<std::string>& laneNames = std::vector<std::string>()) const
+	{
+		std::lock_guard lock(mutex_);
+		return writeChromeTrace(fileName, events_, laneNames);
+	}
+
+private:
+	std::chrono::high_resolution_clock::time_point start_;
+
+	mutable std::mutex mutex_;
+	std::vector<TraceEvent> events_;
+};
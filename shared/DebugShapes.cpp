@@ -0,0 +1,57 @@
+#include "shared/DebugShapes.h"
+
+#include <algorithm>
+
+uint32_t packDebugColor(const vec4& c)
+{
+	auto b = [](float v) { return (uint32_t)(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f); };
+
+	return b(c.r) | (b(c.g) << 8) | (b(c.b) << 16) | (b(c.a) << 24);
+}
+
+void DebugDrawList::clear()
+{
+	lines_.clear();
+	boxes_.clear();
+	planes_.clear();
+
+	maxGridX_ = 0;
+	maxGridY_ = 0;
+}
+
+void DebugDrawList::line(const vec3& p1, const vec3& p2, const vec4& c)
+{
+	const uint32_t color = packDebugColor(c);
+
+	lines_.push_back({ .position = p1, .color = color });
+	lines_.push_back({ .position = p2, .color = color });
+}
+
+void DebugDrawList::box(const mat4& m, const BoundingBox& box, const vec4& c)
+{
+	const mat4 t = m * glm::translate(mat4(1.0f), 0.5f * (box.min_ + box.max_)) * glm::scale(mat4(1.0f), 0.5f * (box.max_ - box.min_));
+
+	boxes_.push_back({ .transform = t, .color = packDebugColor(c), .outlineColor = 0, .gridX = 0, .gridY = 0 });
+}
+
+void DebugDrawList::frustum(const mat4& view, const mat4& proj, const vec4& c)
+{
+	boxes_.push_back({ .transform = glm::inverse(proj * view), .color = packDebugColor(c), .outlineColor = 0, .gridX = 0, .gridY = 0 });
+}
+
+void DebugDrawList::plane(const vec3& o, const vec3& v1, const vec3& v2, int n1, int n2, float s1, float s2, const vec4& color, const vec4& outlineColor)
+{
+	const mat4 t(
+		vec4(0.5f * s1 * v1, 0.0f),
+		vec4(0.5f * s2 * v2, 0.0f),
+		vec4(0.0f),
+		vec4(o, 1.0f));
+
+	const uint32_t gridX = (uint32_t)std::max(n1, 1);
+	const uint32_t gridY = (uint32_t)std::max(n2, 1);
+
+	planes_.push_back({ .transform = t, .color = packDebugColor(color), .outlineColor = packDebugColor(outlineColor), .gridX = gridX, .gridY = gridY });
+
+	maxGridX_ = std::max(maxGridX_, gridX);
+	maxGridY_ = std::max(maxGridY_, gridY);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "shared/UtilsMath.h"
+
+/**
+	Debug geometry for LineCanvas (Vulkan) and CanvasGL (OpenGL), no GPU dependencies
+
+	Lines are stored as 16-byte vertices (position + RGBA8 color). Boxes, frusta and planes are instances
+	of wireframe shapes which are expanded in the vertex shader (see data/shaders/chapter08/DebugShapes.h):
+	a transform and packed colors replace 12 or more lines per shape.
+*/
+
+struct DebugLineVertex
+{
+	vec3 position;
+	uint32_t color;
+};
+
+static_assert(sizeof(DebugLineVertex) == 16);
+
+/* Edges of the cube [-1, 1]^3 (gridX == 0) or a gridX x gridY grid with an outline in the square [-1, 1]^2 */
+struct DebugShapeInstance
+{
+	mat4 transform;
+	uint32_t color;
+	uint32_t outlineColor;
+	uint32_t gridX;
+	uint32_t gridY;
+};
+
+static_assert(sizeof(DebugShapeInstance) == 80);
+
+/* RGBA8, the same layout as unpackUnorm4x8() */
+uint32_t packDebugColor(const vec4& c);
+
+struct DebugDrawList
+{
+	static constexpr uint32_t VerticesPerBox = 24;
+
+	void clear();
+
+	void line(const vec3& p1, const vec3& p2, const vec4& c);
+
+	void box(const mat4& m, const BoundingBox& box, const vec4& c);
+
+	/* The cube [-1, 1]^3 transformed by inverse(proj * view) */
+	void frustum(const mat4& view, const mat4& proj, const vec4& c);
+
+	/* n1 x n2 grid of size s1 x s2 spanned by v1 and v2 around 'orig' */
+	void plane(const vec3& orig, const vec3& v1, const vec3& v2, int n1, int n2, float s1, float s2, const vec4& color, const vec4& outlineColor);
+
+	/* Planes with coarser grids are padded with clipped vertices */
+	inline uint32_t getVerticesPerPlane() const { return 2 * (maxGridX_ + maxGridY_ + 2); }
+
+	inline bool empty() const { return lines_.empty() && boxes_.empty() && planes_.empty(); }
+
+	std::vector<DebugLineVertex> lines_;
+	// boxes and frusta
+	std::vector<DebugShapeInstance> boxes_;
+	std::vector<DebugShapeInstance> planes_;
+
+	uint32_t maxGridX_ = 0;
+	uint32_t maxGridY_ = 0;
+};
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+/**
+	Draw command stream compaction (CPU reference, no GPU dependencies)
+
+	Culling shaders write only the visible commands into a dense array and count them with an atomic counter,
+	so the count can be fed straight into glMultiDrawElementsIndirectCount()/vkCmdDrawIndirectCount().
+	Commands can be split into buckets (e.g. by material or transparency): every bucket owns a fixed range
+	of the output array, large enough for all of its commands, and has its own counter.
+
+	The GPU writes the commands of a bucket in an arbitrary order (whichever invocation increments the counter first),
+	so verifyCompactedDrawCommands() compares the buckets as sets.
+*/
+
+struct DrawBuckets
+{
+	/* Bucket of every input command */
+	std::vector<uint32_t> bucketOfCommand_;
+
+	/* First element of every bucket in the output array and the number of input commands in it */
+	std::vector<uint32_t> offsets_;
+	std::vector<uint32_t> sizes_;
+
+	inline uint32_t getNumBuckets() const { return (uint32_t)offsets_.size(); }
+};
+
+inline DrawBuckets makeDrawBuckets(const std::vector<uint32_t>& bucketOfCommand, uint32_t numBuckets)
+{
+	DrawBuckets b = {
+		.bucketOfCommand_ = bucketOfCommand,
+		.offsets_ = std::vector<uint32_t>(numBuckets, 0),
+		.sizes_ = std::vector<uint32_t>(numBuckets, 0)
+	};
+
+	for (uint32_t bucket: bucketOfCommand)
+		b.sizes_[bucket]++;
+
+	for (uint32_t i = 1 ; i < numBuckets ; i++)
+		b.offsets_[i] = b.offsets_[i - 1] + b.sizes_[i - 1];
+
+	return b;
+}
+
+/* A single bucket with all commands */
+inline DrawBuckets makeDrawBuckets(uint32_t numCommands)
+{
+	return makeDrawBuckets(std::vector<uint32_t>(numCommands, 0), 1);
+}
+
+/* What the culling shader does, in the order of the input: 'out' gets the same size as 'in', unused elements are left untouched */
+template <typename Command>
+void compactDrawCommands(const std::vector<Command>& in, const std::vector<uint8_t>& visible, const DrawBuckets& buckets,
+	std::vector<Command>& out, std::vector<uint32_t>& counts)
+{
+	out.resize(in.size());
+	counts.assign(buckets.getNumBuckets(), 0);
+
+	for (size_t i = 0 ; i != in.size() ; i++)
+	{
+		if (!visible[i])
+			continue;
+
+		const uint32_t bucket = buckets.bucketOfCommand_[i];
+		out[buckets.offsets_[bucket] + counts[bucket]++] = in[i];
+	}
+}
+
+/* Returns the number of mismatching buckets (0 if 'actual' is a permutation of 'expected' inside every bucket) */
+template <typename Command>
+uint32_t verifyCompactedDrawCommands(const DrawBuckets& buckets,
+	const std::vector<Command>& expected, const std::vector<uint32_t>& expectedCounts,
+	const std::vector<Command>& actual, const std::vector<uint32_t>& actualCounts)
+{
+	auto less = [](const Command& a, const Command& b) { return memcmp(&a, &b, sizeof(Command)) < 0; };
+	auto equal = [](const Command& a, const Command& b) { return memcmp(&a, &b, sizeof(Command)) == 0; };
+
+	uint32_t numMismatches = 0;
+
+	for (uint32_t b = 0 ; b != buckets.getNumBuckets() ; b++)
+	{
+		if (expectedCounts[b] != actualCounts[b] || actualCounts[b] > buckets.sizes_[b])
+		{
+			numMismatches++;
+			continue;
+		}
+
+		std::vector<Command> e(expected.begin() + buckets.offsets_[b], expected.begin() + buckets.offsets_[b] + expectedCounts[b]);
+		std::vector<Command> a(actual.begin() + buckets.offsets_[b], actual.begin() + buckets.offsets_[b] + actualCounts[b]);
+
+		std::sort(e.begin(), e.end(), less);
+		std::sort(a.begin(), a.end(), less);
+
+		if (!std::equal(e.begin(), e.end(), a.begin(), equal))
+			numMismatches++;
+	}
+
+	return numMismatches;
+}
@@ -0,0 +1,56 @@
+#include "shared/LuminanceHistogram.h"
+
+#include <math.h>
+#include <algorithm>
+
+uint32_t getLuminanceBin(float lum, const LuminanceHistogramParams& params)
+{
+	if (lum < exp2f(params.minLog2Lum_))
+		return 0;
+
+	const float t = (log2f(lum) - params.minLog2Lum_) / params.log2LumRange_;
+
+	return 1 + (uint32_t)std::min(std::max(t, 0.0f) * (LuminanceHistogramBins - 1), (float)(LuminanceHistogramBins - 2));
+}
+
+float getLuminanceBinCenter(uint32_t bin, const LuminanceHistogramParams& params)
+{
+	return params.minLog2Lum_ + ((float)bin - 0.5f) * params.log2LumRange_ / (LuminanceHistogramBins - 1);
+}
+
+void buildLuminanceHistogram(const float* rgba, uint32_t numPixels, const LuminanceHistogramParams& params, std::vector<uint32_t>& bins)
+{
+	bins.assign(LuminanceHistogramBins, 0);
+
+	for (uint32_t i = 0 ; i != numPixels ; i++, rgba += 4)
+		bins[getLuminanceBin(getLuminance(rgba[0], rgba[1], rgba[2]), params)]++;
+}
+
+float getAverageLuminance(const std::vector<uint32_t>& bins, const LuminanceHistogramParams& params)
+{
+	float numPixels = 0.0f;
+
+	for (uint32_t i = 1 ; i != LuminanceHistogramBins ; i++)
+		numPixels += (float)bins[i];
+
+	const float low = numPixels * params.lowPercentile_;
+	const float high = numPixels * params.highPercentile_;
+
+	// the same order of operations as in VK03_LuminanceAverage.comp: inclusive prefix sum, then the part of every bin inside [low, high]
+	float sumLog = 0.0f;
+	float sumWeight = 0.0f;
+	float prefix = 0.0f;
+
+	for (uint32_t i = 1 ; i != LuminanceHistogramBins ; i++)
+	{
+		const float count = (float)bins[i];
+		prefix += count;
+
+		const float w = std::max(std::min(prefix, high) - std::max(prefix - count, low), 0.0f);
+
+		sumLog += w * getLuminanceBinCenter(i, params);
+		sumWeight += w;
+	}
+
+	return exp2f(sumWeight > 0.0f ? sumLog / sumWeight : params.minLog2Lum_);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+/**
+	Luminance histogram for automatic exposure (CPU reference of VK03_LuminanceHistogram.comp and VK03_LuminanceAverage.comp)
+
+	Bin 0 counts black pixels (luminance below exp2(minLog2Lum_)) which are ignored,
+	bins 1..255 split [minLog2Lum_, minLog2Lum_ + log2LumRange_] evenly (brighter pixels go to the last bin).
+	The average is the geometric mean of the bin centers between the low and the high percentiles,
+	so a few very dark or very bright pixels (the sun, a black sky) do not change the exposure.
+*/
+
+constexpr uint32_t LuminanceHistogramBins = 256;
+
+struct LuminanceHistogramParams
+{
+	float minLog2Lum_ = -10.0f;
+	float log2LumRange_ = 16.0f;
+	// only the pixels between these fractions of the sorted luminances are averaged
+	float lowPercentile_ = 0.1f;
+	float highPercentile_ = 0.95f;
+};
+
+/* Rec. 709 */
+inline float getLuminance(float r, float g, float b) { return 0.2126f * r + 0.7152f * g + 0.0722f * b; }
+
+uint32_t getLuminanceBin(float lum, const LuminanceHistogramParams& params);
+
+/* log2 of the luminance in the middle of the bin */
+float getLuminanceBinCenter(uint32_t bin, const LuminanceHistogramParams& params);
+
+/* 'rgba' has 4 floats per pixel, 'bins' gets LuminanceHistogramBins elements */
+void buildLuminanceHistogram(const float* rgba, uint32_t numPixels, const LuminanceHistogramParams& params, std::vector<uint32_t>& bins);
+
+/* Returns exp2(minLog2Lum_) if all pixels are black */
+float getAverageLuminance(const std::vector<uint32_t>& bins, const LuminanceHistogramParams& params);
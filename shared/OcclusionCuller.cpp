@@ -0,0 +1,440 @@
+#include "shared/OcclusionCuller.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+// vertices closer than this (in clip-space w) are clipped away
+static constexpr float kNearW = 1e-2f;
+
+// boxes are tested starting from the level where their rectangle spans at most this many texels
+static constexpr int kStartTexels = 4;
+
+static double millisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static int roundUpToTiles(int size)
+{
+	return std::max((size + OcclusionCuller::TileSize - 1) / OcclusionCuller::TileSize, 1);
+}
+
+OcclusionCuller::OcclusionCuller(int width, int height, uint32_t numThreads)
+: width_(roundUpToTiles(width) * TileSize)
+, height_(roundUpToTiles(height) * TileSize)
+, tilesX_(roundUpToTiles(width))
+, tilesY_(roundUpToTiles(height))
+, executor_(numThreads ? numThreads : std::max(std::thread::hardware_concurrency(), 1u))
+{
+	bins_.resize(tilesX_ * tilesY_);
+
+	int w = width_;
+	int h = height_;
+
+	for (;;)
+	{
+		levels_.push_back(Level {
+			.width = w,
+			.height = h,
+			.minZ = std::vector<float>(w * h, 0.0f),
+			.maxZ = std::vector<float>(w * h, 0.0f)
+		});
+
+		if (w == 1 && h == 1)
+			break;
+
+		w = std::max(w / 2, 1);
+		h = std::max(h / 2, 1);
+	}
+}
+
+void OcclusionCuller::setOccluders(std::vector<vec3>&& triangles)
+{
+	occluders_ = std::move(triangles);
+	occluders_.resize(occluders_.size() - occluders_.size() % 3);
+}
+
+void OcclusionCuller::renderOccluders(const glm::mat4& viewProj)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	viewProj_ = viewProj;
+
+	setupTriangles();
+
+	for (auto& b: bins_)
+		b.clear();
+
+	for (uint32_t i = 0 ; i != triangles_.size() ; i++)
+	{
+		const ScreenTriangle& t = triangles_[i];
+
+		for (int ty = t.minY / TileSize ; ty <= t.maxY / TileSize ; ty++)
+			for (int tx = t.minX / TileSize ; tx <= t.maxX / TileSize ; tx++)
+				bins_[ty * tilesX_ + tx].push_back(i);
+	}
+
+	// every tile owns its pixels, so the tiles are rasterized without synchronization
+	tf::Taskflow taskflow;
+	taskflow.for_each_index(0, tilesX_ * tilesY_, 1, [this](int tile) { rasterizeTile(tile % tilesX_, tile / tilesX_); });
+	executor_.run(taskflow).wait();
+
+	buildHierarchy();
+
+	stats_.numOccluderTriangles_ = (uint32_t)(occluders_.size() / 3);
+	stats_.numRasterizedTriangles_ = (uint32_t)triangles_.size();
+	stats_.rasterMs_ = millisecondsSince(start);
+}
+
+/* Sutherland-Hodgman against the w = kNearW plane: a triangle becomes up to 2 triangles */
+static int clipNear(const vec4 in[3], vec4 out[4])
+{
+	int n = 0;
+
+	for (int i = 0 ; i != 3 ; i++)
+	{
+		const vec4& a = in[i];
+		const vec4& b = in[(i + 1) % 3];
+
+		const bool insideA = a.w >= kNearW;
+		const bool insideB = b.w >= kNearW;
+
+		if (insideA)
+			out[n++] = a;
+
+		if (insideA != insideB)
+			out[n++] = glm::mix(a, b, (kNearW - a.w) / (b.w - a.w));
+	}
+
+	return n;
+}
+
+void OcclusionCuller::setupTriangles()
+{
+	const size_t numTriangles = occluders_.size() / 3;
+
+	// transform and set up in chunks, every chunk writes to its own list
+	constexpr size_t kChunkSize = 1024;
+	const size_t numChunks = (numTriangles + kChunkSize - 1) / kChunkSize;
+
+	std::vector<std::vector<ScreenTriangle>> chunks(numChunks);
+
+	const float halfW = 0.5f * (float)width_;
+	const float halfH = 0.5f * (float)height_;
+
+	tf::Taskflow taskflow;
+
+	taskflow.for_each_index(0, (int)numChunks, 1, [&](int chunk)
+		{
+			std::vector<ScreenTriangle>& out = chunks[chunk];
+
+			const size_t end = std::min((chunk + 1) * kChunkSize, numTriangles);
+
+			for (size_t i = chunk * kChunkSize ; i != end ; i++)
+			{
+				const vec4 clip[3] = {
+					viewProj_ * vec4(occluders_[i * 3 + 0], 1.0f),
+					viewProj_ * vec4(occluders_[i * 3 + 1], 1.0f),
+					viewProj_ * vec4(occluders_[i * 3 + 2], 1.0f)
+				};
+
+				vec4 poly[4];
+				const int numVertices = clipNear(clip, poly);
+
+				// screen-space x, y and 1/w
+				vec3 s[4];
+				for (int v = 0 ; v != numVertices ; v++)
+				{
+					const float invW = 1.0f / poly[v].w;
+					s[v] = vec3((poly[v].x * invW + 1.0f) * halfW, (poly[v].y * invW + 1.0f) * halfH, invW);
+				}
+
+				for (int v = 2 ; v < numVertices ; v++)
+				{
+					vec3 p0 = s[0];
+					vec3 p1 = s[v - 1];
+					vec3 p2 = s[v];
+
+					float area = (p1.x - p0.x) * (p2.y - p0.y) - (p1.y - p0.y) * (p2.x - p0.x);
+
+					if (std::abs(area) < 1e-6f)
+						continue;
+
+					// occluders are rendered double-sided
+					if (area < 0.0f)
+					{
+						std::swap(p1, p2);
+						area = -area;
+					}
+
+					const float minX = std::min({ p0.x, p1.x, p2.x });
+					const float maxX = std::max({ p0.x, p1.x, p2.x });
+					const float minY = std::min({ p0.y, p1.y, p2.y });
+					const float maxY = std::max({ p0.y, p1.y, p2.y });
+
+					// pixel centers are at (x + 0.5, y + 0.5)
+					ScreenTriangle t;
+					t.minX = std::max((int)std::ceil(minX - 0.5f), 0);
+					t.minY = std::max((int)std::ceil(minY - 0.5f), 0);
+					t.maxX = std::min((int)std::floor(maxX - 0.5f), width_ - 1);
+					t.maxY = std::min((int)std::floor(maxY - 0.5f), height_ - 1);
+
+					if (t.minX > t.maxX || t.minY > t.maxY)
+						continue;
+
+					const vec3 p[3] = { p0, p1, p2 };
+
+					// edge i goes from p[i] to p[i + 1] and is opposite to p[i + 2]
+					for (int e = 0 ; e != 3 ; e++)
+					{
+						const vec3& a = p[e];
+						const vec3& b = p[(e + 1) % 3];
+						t.a[e] = a.y - b.y;
+						t.b[e] = b.x - a.x;
+						t.c[e] = -(t.a[e] * a.x + t.b[e] * a.y);
+					}
+
+					// barycentric weight of p[i + 2] is E_i / area
+					const float invArea = 1.0f / area;
+					t.za = (t.a[0] * p2.z + t.a[1] * p0.z + t.a[2] * p1.z) * invArea;
+					t.zb = (t.b[0] * p2.z + t.b[1] * p0.z + t.b[2] * p1.z) * invArea;
+					t.zc = (t.c[0] * p2.z + t.c[1] * p0.z + t.c[2] * p1.z) * invArea;
+
+					out.push_back(t);
+				}
+			}
+		}
+	);
+
+	executor_.run(taskflow).wait();
+
+	triangles_.clear();
+
+	for (const auto& c: chunks)
+		triangles_.insert(triangles_.end(), c.begin(), c.end());
+}
+
+void OcclusionCuller::rasterizeTile(int tileX, int tileY)
+{
+	std::vector<float>& depth = levels_[0].maxZ;
+
+	const int tileMinX = tileX * TileSize;
+	const int tileMinY = tileY * TileSize;
+
+	for (int y = tileMinY ; y != tileMinY + TileSize ; y++)
+		std::fill_n(depth.begin() + y * width_ + tileMinX, TileSize, 0.0f);
+
+	for (uint32_t idx: bins_[tileY * tilesX_ + tileX])
+	{
+		const ScreenTriangle& t = triangles_[idx];
+
+		const int x0 = std::max(t.minX, tileMinX);
+		const int x1 = std::min(t.maxX, tileMinX + TileSize - 1);
+		const int y0 = std::max(t.minY, tileMinY);
+		const int y1 = std::min(t.maxY, tileMinY + TileSize - 1);
+
+		for (int y = y0 ; y <= y1 ; y++)
+		{
+			const float py = (float)y + 0.5f;
+
+			const float e0 = t.b[0] * py + t.c[0];
+			const float e1 = t.b[1] * py + t.c[1];
+			const float e2 = t.b[2] * py + t.c[2];
+			const float z  = t.zb   * py + t.zc;
+
+			float* row = depth.data() + y * width_;
+
+			// branch-free, so the compiler can vectorize it
+			for (int x = x0 ; x <= x1 ; x++)
+			{
+				const float px = (float)x + 0.5f;
+
+				const bool inside = (t.a[0] * px + e0 >= 0.0f) & (t.a[1] * px + e1 >= 0.0f) & (t.a[2] * px + e2 >= 0.0f);
+				const float d = std::max(row[x], t.za * px + z);
+
+				row[x] = inside ? d : row[x];
+			}
+		}
+	}
+}
+
+void OcclusionCuller::buildHierarchy()
+{
+	Level& base = levels_[0];
+	base.minZ = base.maxZ;
+
+	for (size_t l = 1 ; l < levels_.size() ; l++)
+	{
+		const Level& src = levels_[l - 1];
+		Level& dst = levels_[l];
+
+		for (int y = 0 ; y != dst.height ; y++)
+			for (int x = 0 ; x != dst.width ; x++)
+			{
+				// odd sizes: the last texel also covers the remaining row/column
+				const int sx0 = x * 2, sx1 = (x == dst.width  - 1) ? src.width  - 1 : x * 2 + 1;
+				const int sy0 = y * 2, sy1 = (y == dst.height - 1) ? src.height - 1 : y * 2 + 1;
+
+				float minZ = std::numeric_limits<float>::max();
+				float maxZ = 0.0f;
+
+				for (int sy = sy0 ; sy <= sy1 ; sy++)
+					for (int sx = sx0 ; sx <= sx1 ; sx++)
+					{
+						minZ = std::min(minZ, src.minZ[sy * src.width + sx]);
+						maxZ = std::max(maxZ, src.maxZ[sy * src.width + sx]);
+					}
+
+				dst.minZ[y * dst.width + x] = minZ;
+				dst.maxZ[y * dst.width + x] = maxZ;
+			}
+	}
+}
+
+bool OcclusionCuller::isBoxVisible(const BoundingBox& box) const
+{
+	float minX = std::numeric_limits<float>::max();
+	float minY = std::numeric_limits<float>::max();
+	float maxX = std::numeric_limits<float>::lowest();
+	float maxY = std::numeric_limits<float>::lowest();
+	float nearestZ = 0.0f;
+
+	for (int i = 0 ; i != 8 ; i++)
+	{
+		const vec3 corner((i & 1) ? box.max_.x : box.min_.x, (i & 2) ? box.max_.y : box.min_.y, (i & 4) ? box.max_.z : box.min_.z);
+		const vec4 clip = viewProj_ * vec4(corner, 1.0f);
+
+		if (clip.w < kNearW)
+			return true;
+
+		const float invW = 1.0f / clip.w;
+		const float x = (clip.x * invW + 1.0f) * 0.5f * (float)width_;
+		const float y = (clip.y * invW + 1.0f) * 0.5f * (float)height_;
+
+		minX = std::min(minX, x);
+		minY = std::min(minY, y);
+		maxX = std::max(maxX, x);
+		maxY = std::max(maxY, y);
+		nearestZ = std::max(nearestZ, invW);
+	}
+
+	// all pixels touched by the rectangle
+	const int x0 = std::max((int)std::floor(minX), 0);
+	const int y0 = std::max((int)std::floor(minY), 0);
+	const int x1 = std::min((int)std::floor(maxX), width_ - 1);
+	const int y1 = std::min((int)std::floor(maxY), height_ - 1);
+
+	if (x0 > x1 || y0 > y1)
+		return true;
+
+	int level = 0;
+	while (level + 1 < (int)levels_.size() && std::max((x1 >> level) - (x0 >> level), (y1 >> level) - (y0 >> level)) >= kStartTexels)
+		level++;
+
+	for (; level >= 0 ; level--)
+	{
+		const Level& l = levels_[level];
+
+		const int lx0 = std::min(x0 >> level, l.width  - 1);
+		const int ly0 = std::min(y0 >> level, l.height - 1);
+		const int lx1 = std::min(x1 >> level, l.width  - 1);
+		const int ly1 = std::min(y1 >> level, l.height - 1);
+
+		float farthest = std::numeric_limits<float>::max();
+		float nearest = 0.0f;
+
+		for (int y = ly0 ; y <= ly1 ; y++)
+			for (int x = lx0 ; x <= lx1 ; x++)
+			{
+				farthest = std::min(farthest, l.minZ[y * l.width + x]);
+				nearest = std::max(nearest, l.maxZ[y * l.width + x]);
+			}
+
+		// behind every occluder
+		if (nearestZ < farthest)
+			return false;
+
+		// in front of every occluder
+		if (nearestZ > nearest)
+			return true;
+	}
+
+	return true;
+}
+
+void OcclusionCuller::cullBoxes(const std::vector<BoundingBox>& boxes, std::vector<uint8_t>& visible)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	visible.resize(boxes.size());
+
+	constexpr int kChunkSize = 256;
+	const int numChunks = (int)((boxes.size() + kChunkSize - 1) / kChunkSize);
+
+	tf::Taskflow taskflow;
+
+	taskflow.for_each_index(0, numChunks, 1, [this, &boxes, &visible](int chunk)
+		{
+			const size_t end = std::min((size_t)(chunk + 1) * kChunkSize, boxes.size());
+
+			for (size_t i = (size_t)chunk * kChunkSize ; i != end ; i++)
+				visible[i] = isBoxVisible(boxes[i]) ? 1 : 0;
+		}
+	);
+
+	executor_.run(taskflow).wait();
+
+	stats_.numTestedBoxes_ = (uint32_t)boxes.size();
+	stats_.numOccludedBoxes_ = (uint32_t)std::count(visible.begin(), visible.end(), 0);
+	stats_.testMs_ = millisecondsSince(start);
+}
+
+std::vector<vec3> gatherOccluderTriangles(const MeshData& meshData, const std::vector<DrawData>& shapes, const std::vector<glm::mat4>& transforms,
+	const std::vector<BoundingBox>& worldBoxes, const std::vector<bool>& canOcclude, uint32_t maxOccluders, uint32_t maxTriangles)
+{
+	// position, texture coordinates and normal (see SceneConverter)
+	constexpr uint32_t kFloatsPerVertex = 8;
+
+	// the largest face of the box approximates how much of the screen a shape can cover
+	auto largestFace = [](const BoundingBox& b)
+	{
+		const vec3 s = b.getSize();
+		return std::max({ s.x * s.y, s.y * s.z, s.x * s.z });
+	};
+
+	std::vector<uint32_t> candidates;
+
+	for (uint32_t i = 0 ; i != shapes.size() ; i++)
+		if (canOcclude[i])
+			candidates.push_back(i);
+
+	std::sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) { return largestFace(worldBoxes[a]) > largestFace(worldBoxes[b]); });
+
+	if (candidates.size() > maxOccluders)
+		candidates.resize(maxOccluders);
+
+	std::vector<vec3> triangles;
+
+	for (uint32_t i: candidates)
+	{
+		const DrawData& shape = shapes[i];
+		const Mesh& mesh = meshData.meshes_[shape.meshIndex];
+		const glm::mat4& model = transforms[shape.transformIndex];
+
+		const uint32_t lod = mesh.lodCount - 1;
+		const uint32_t numIndices = mesh.getLODIndicesCount(lod);
+
+		if (triangles.size() / 3 + numIndices / 3 > maxTriangles)
+			continue;
+
+		for (uint32_t j = 0 ; j != numIndices - numIndices % 3 ; j++)
+		{
+			const uint32_t vtx = meshData.indexData_[mesh.indexOffset + mesh.lodOffset[lod] + j] + mesh.vertexOffset;
+			const float* v = &meshData.vertexData_[vtx * kFloatsPerVertex];
+			triangles.push_back(vec3(model * vec4(v[0], v[1], v[2], 1.0f)));
+		}
+	}
+
+	return triangles;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <taskflow/taskflow.hpp>
+
+#include "shared/UtilsMath.h"
+#include "shared/scene/VtxData.h"
+
+/**
+	Software occlusion culling (no GPU dependencies)
+
+	A few large occluders are rasterized into a low-resolution depth buffer, then the screen-space rectangles
+	of bounding boxes are tested against a min/max depth hierarchy built on top of it.
+
+	The depth buffer stores 1/w, which is linear in screen space (0 means "no occluder", larger values are closer).
+	Occluder triangles are binned into TileSize x TileSize tiles and the tiles are rasterized in parallel;
+	the inner loops are written to be auto-vectorized, every row of a tile is processed as a whole.
+
+	A box is occluded if its nearest point is farther than the farthest occluder over its rectangle:
+	the test starts at the level where the rectangle spans a few texels and descends only while it is ambiguous
+	(the max depth of a region gives an early "visible" answer).
+	Boxes crossing the near plane or leaving the screen are reported as visible, frustum culling is not done here.
+*/
+
+struct OcclusionCullerStats
+{
+	uint32_t numOccluderTriangles_ = 0;
+	uint32_t numRasterizedTriangles_ = 0; // after near plane clipping and backface/degenerate rejection
+	uint32_t numTestedBoxes_ = 0;
+	uint32_t numOccludedBoxes_ = 0;
+
+	double rasterMs_ = 0.0; // transform + binning + rasterization + hierarchy
+	double testMs_ = 0.0;
+};
+
+struct OcclusionCuller final
+{
+	static constexpr int TileSize = 32;
+
+	/* The resolution is rounded up to whole tiles. numThreads == 0 uses all hardware threads */
+	explicit OcclusionCuller(int width = 320, int height = 192, uint32_t numThreads = 0);
+
+	/* World-space occluder triangles, 3 vertices per triangle (see gatherOccluderTriangles()) */
+	void setOccluders(std::vector<vec3>&& triangles);
+
+	/* Clears the depth buffer and rasterizes all occluders */
+	void renderOccluders(const glm::mat4& viewProj);
+
+	/* Thread-safe after renderOccluders() */
+	bool isBoxVisible(const BoundingBox& box) const;
+
+	/* Parallel version of isBoxVisible() for all boxes; updates getStats() */
+	void cullBoxes(const std::vector<BoundingBox>& boxes, std::vector<uint8_t>& visible);
+
+	inline const OcclusionCullerStats& getStats() const { return stats_; }
+
+	inline int getWidth() const { return width_; }
+	inline int getHeight() const { return height_; }
+
+	/* 1/w per pixel, row 0 is the bottom of the screen */
+	inline const std::vector<float>& getDepthBuffer() const { return levels_[0].maxZ; }
+
+private:
+	struct ScreenTriangle
+	{
+		// edge functions E(x, y) = a * x + b * y + c, all non-negative inside
+		float a[3], b[3], c[3];
+		// 1/w plane
+		float za, zb, zc;
+		int minX, minY, maxX, maxY;
+	};
+
+	struct Level
+	{
+		int width = 0;
+		int height = 0;
+		// the farthest and the nearest occluder over the texel footprint
+		std::vector<float> minZ;
+		std::vector<float> maxZ;
+	};
+
+	const int width_;
+	const int height_;
+	const int tilesX_;
+	const int tilesY_;
+
+	tf::Executor executor_;
+
+	glm::mat4 viewProj_ = glm::mat4(1.0f);
+
+	std::vector<vec3> occluders_;
+	std::vector<ScreenTriangle> triangles_;
+	std::vector<std::vector<uint32_t>> bins_; // per-tile triangle indices
+
+	std::vector<Level> levels_;
+
+	OcclusionCullerStats stats_;
+
+	void setupTriangles();
+	void rasterizeTile(int tileX, int tileY);
+	void buildHierarchy();
+};
+
+/*
+	Picks up to 'maxOccluders' shapes with the largest bounding box faces (skipping shapes with canOcclude[i] == false)
+	and returns the world-space triangles of their coarsest LODs (see processLods() in SceneConverter),
+	stopping at 'maxTriangles'. 'worldBoxes' and 'canOcclude' are indexed by shape.
+*/
+std::vector<vec3> gatherOccluderTriangles(const MeshData& meshData, const std::vector<DrawData>& shapes, const std::vector<glm::mat4>& transforms,
+	const std::vector<BoundingBox>& worldBoxes, const std::vector<bool>& canOcclude, uint32_t maxOccluders = 256, uint32_t maxTriangles = 32768);
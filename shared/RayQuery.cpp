@@ -0,0 +1,764 @@
+#include "shared/RayQuery.h"
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <thread>
+
+// deeper nodes become leaves, traversal stacks are kMaxDepth + 2 deep
+static constexpr uint32_t kMaxDepth = 60;
+static constexpr int kNumBins = 16;
+// bottom-level leaves can have up to this many triangles if splitting them does not pay off, top-level leaves up to this many instances
+static constexpr uint32_t kMaxMeshLeafSize = 8;
+static constexpr uint32_t kMaxInstanceLeafSize = 2;
+
+static constexpr float kMiss = std::numeric_limits<float>::max();
+
+static double millisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+/* The BoundingBox constructor sorts its corners, so an empty box for combinePoint() is made here */
+static BoundingBox getEmptyBox()
+{
+	BoundingBox box;
+	box.min_ = vec3(std::numeric_limits<float>::max());
+	box.max_ = vec3(std::numeric_limits<float>::lowest());
+	return box;
+}
+
+static void combineBox(BoundingBox& box, const vec3& min, const vec3& max)
+{
+	box.min_ = glm::min(box.min_, min);
+	box.max_ = glm::max(box.max_, max);
+}
+
+static float getHalfArea(const BoundingBox& box)
+{
+	const vec3 d = glm::max(box.max_ - box.min_, vec3(0.0f));
+	return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+/* The distance to the box along the ray or kMiss */
+static float intersectBox(const vec3& min, const vec3& max, const vec3& origin, const vec3& invDir, float tMin, float tMax)
+{
+	const vec3 t1 = (min - origin) * invDir;
+	const vec3 t2 = (max - origin) * invDir;
+
+	const vec3 tNear = glm::min(t1, t2);
+	const vec3 tFar = glm::max(t1, t2);
+
+	const float t0 = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, tMin));
+	const float t3 = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, tMax));
+
+	return t0 <= t3 ? t0 : kMiss;
+}
+
+Ray getPrimaryRay(const mat4& view, const mat4& proj, float x, float y, int width, int height)
+{
+	const vec4 ndc(2.0f * x / (float)width - 1.0f, 1.0f - 2.0f * y / (float)height, 1.0f, 1.0f);
+	const vec4 p = glm::inverse(proj * view) * ndc;
+	const vec3 origin = vec3(glm::inverse(view)[3]);
+
+	return Ray { .origin_ = origin, .dir_ = glm::normalize(vec3(p) / p.w - origin) };
+}
+
+/* Packets are stored as structures of arrays: every loop over PacketSize lanes can be vectorized */
+struct RayQuery::Packet
+{
+	float ox_[PacketSize], oy_[PacketSize], oz_[PacketSize];
+	float dx_[PacketSize], dy_[PacketSize], dz_[PacketSize];
+	float tMin_[PacketSize];
+	// the closest hit so far, lanes with tMax_ < tMin_ are inactive
+	float tMax_[PacketSize];
+
+	float u_[PacketSize], v_[PacketSize];
+	int node_[PacketSize];
+	uint32_t mesh_[PacketSize];
+	uint32_t triangle_[PacketSize];
+
+	/* The lanes past the end of 'rays' are inactive */
+	void load(const std::vector<Ray>& rays, size_t first)
+	{
+		for (uint32_t i = 0 ; i != PacketSize ; i++)
+		{
+			const Ray& ray = rays[std::min(first + i, rays.size() - 1)];
+			ox_[i] = ray.origin_.x;
+			oy_[i] = ray.origin_.y;
+			oz_[i] = ray.origin_.z;
+			dx_[i] = ray.dir_.x;
+			dy_[i] = ray.dir_.y;
+			dz_[i] = ray.dir_.z;
+			tMin_[i] = ray.tMin_;
+			tMax_[i] = (first + i < rays.size()) ? ray.tMax_ : std::numeric_limits<float>::lowest();
+			node_[i] = -1;
+		}
+	}
+};
+
+/* True if any lane of the packet hits the box */
+static bool intersectBoxPacket(const vec3& min, const vec3& max,
+	const float* ox, const float* oy, const float* oz, const float* ix, const float* iy, const float* iz, const float* tMin, const float* tMax)
+{
+	uint32_t mask = 0;
+
+	for (uint32_t i = 0 ; i != RayQuery::PacketSize ; i++)
+	{
+		const float tx1 = (min.x - ox[i]) * ix[i], tx2 = (max.x - ox[i]) * ix[i];
+		const float ty1 = (min.y - oy[i]) * iy[i], ty2 = (max.y - oy[i]) * iy[i];
+		const float tz1 = (min.z - oz[i]) * iz[i], tz2 = (max.z - oz[i]) * iz[i];
+
+		const float t0 = std::max(std::max(std::min(tx1, tx2), std::min(ty1, ty2)), std::max(std::min(tz1, tz2), tMin[i]));
+		const float t3 = std::min(std::min(std::max(tx1, tx2), std::max(ty1, ty2)), std::min(std::max(tz1, tz2), tMax[i]));
+
+		mask |= (t0 <= t3) ? 1u : 0u;
+	}
+
+	return mask != 0;
+}
+
+/* Packets visit the child whose center is nearer along the first ray first, so the closest hits shrink tMax_ early */
+template <typename Node>
+static bool isLeftChildNearer(const std::vector<Node>& nodes, const Node& node, const vec3& dir)
+{
+	const Node& l = nodes[node.first_ + 0];
+	const Node& r = nodes[node.first_ + 1];
+
+	return glm::dot(l.min_ + l.max_ - r.min_ - r.max_, dir) <= 0.0f;
+}
+
+RayQuery::RayQuery(uint32_t numThreads)
+: executor_(numThreads ? numThreads : std::max(std::thread::hardware_concurrency(), 1u))
+{
+}
+
+/* Binned SAH: every split is chosen among kNumBins - 1 planes along each axis */
+void RayQuery::buildBVH(const std::vector<BoundingBox>& boxes, uint32_t maxLeafSize, std::vector<BVHNode>& nodes, std::vector<uint32_t>& order)
+{
+	const uint32_t numPrims = (uint32_t)boxes.size();
+
+	nodes.clear();
+	order.resize(numPrims);
+	std::iota(order.begin(), order.end(), 0);
+
+	if (!numPrims)
+		return;
+
+	std::vector<vec3> centers(numPrims);
+	for (uint32_t i = 0 ; i != numPrims ; i++)
+		centers[i] = boxes[i].getCenter();
+
+	nodes.reserve(2 * numPrims);
+	nodes.push_back(BVHNode { .first_ = 0, .count_ = numPrims });
+
+	// (node, depth)
+	std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0, 0 } };
+
+	while (!stack.empty())
+	{
+		const auto [n, depth] = stack.back();
+		stack.pop_back();
+
+		const uint32_t first = nodes[n].first_;
+		const uint32_t count = nodes[n].count_;
+
+		BoundingBox bounds = getEmptyBox();
+		BoundingBox centerBounds = getEmptyBox();
+
+		for (uint32_t i = first ; i != first + count ; i++)
+		{
+			combineBox(bounds, boxes[order[i]].min_, boxes[order[i]].max_);
+			combineBox(centerBounds, centers[order[i]], centers[order[i]]);
+		}
+
+		nodes[n].min_ = bounds.min_;
+		nodes[n].max_ = bounds.max_;
+
+		if (count == 1 || depth >= kMaxDepth)
+			continue;
+
+		int bestAxis = -1;
+		int bestSplit = 0;
+		float bestCost = kMiss;
+
+		for (int axis = 0 ; axis != 3 ; axis++)
+		{
+			const float extent = centerBounds.max_[axis] - centerBounds.min_[axis];
+
+			if (extent <= 0.0f)
+				continue;
+
+			const float scale = (float)kNumBins / extent;
+
+			BoundingBox binBoxes[kNumBins];
+			uint32_t binCounts[kNumBins] = { 0 };
+
+			for (auto& b: binBoxes)
+				b = getEmptyBox();
+
+			for (uint32_t i = first ; i != first + count ; i++)
+			{
+				const int bin = std::min((int)((centers[order[i]][axis] - centerBounds.min_[axis]) * scale), kNumBins - 1);
+				binCounts[bin]++;
+				combineBox(binBoxes[bin], boxes[order[i]].min_, boxes[order[i]].max_);
+			}
+
+			// the cost of splitting after bin i
+			float leftArea[kNumBins - 1];
+			uint32_t leftCount[kNumBins - 1];
+
+			BoundingBox box = getEmptyBox();
+			uint32_t sum = 0;
+
+			for (int i = 0 ; i != kNumBins - 1 ; i++)
+			{
+				sum += binCounts[i];
+				combineBox(box, binBoxes[i].min_, binBoxes[i].max_);
+				leftCount[i] = sum;
+				leftArea[i] = getHalfArea(box);
+			}
+
+			box = getEmptyBox();
+			sum = 0;
+
+			for (int i = kNumBins - 1 ; i != 0 ; i--)
+			{
+				sum += binCounts[i];
+				combineBox(box, binBoxes[i].min_, binBoxes[i].max_);
+
+				const float cost = (float)leftCount[i - 1] * leftArea[i - 1] + (float)sum * getHalfArea(box);
+
+				if (leftCount[i - 1] && sum && cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = i - 1;
+				}
+			}
+		}
+
+		uint32_t leftCount = 0;
+
+		if (bestAxis > -1)
+		{
+			// the leaf costs as much as intersecting all of its primitives, a split adds a traversal step
+			if (count <= maxLeafSize && bestCost + getHalfArea(bounds) >= (float)count * getHalfArea(bounds))
+				continue;
+
+			const float minC = centerBounds.min_[bestAxis];
+			const float scale = (float)kNumBins / (centerBounds.max_[bestAxis] - minC);
+
+			const auto mid = std::partition(order.begin() + first, order.begin() + first + count, [&](uint32_t p)
+				{
+					return std::min((int)((centers[p][bestAxis] - minC) * scale), kNumBins - 1) <= bestSplit;
+				});
+
+			leftCount = (uint32_t)(mid - (order.begin() + first));
+		}
+
+		// all the centers are the same
+		if (!leftCount || leftCount == count)
+		{
+			if (count <= maxLeafSize)
+				continue;
+
+			leftCount = count / 2;
+		}
+
+		const uint32_t left = (uint32_t)nodes.size();
+
+		nodes.push_back(BVHNode { .first_ = first, .count_ = leftCount });
+		nodes.push_back(BVHNode { .first_ = first + leftCount, .count_ = count - leftCount });
+
+		nodes[n].first_ = left;
+		nodes[n].count_ = 0;
+
+		stack.push_back({ left + 1, depth + 1 });
+		stack.push_back({ left, depth + 1 });
+	}
+}
+
+void RayQuery::buildMeshes(const MeshData& meshData)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	meshes_.clear();
+	meshes_.resize(meshData.meshes_.size());
+
+	tf::Taskflow taskflow;
+
+	taskflow.for_each_index(0, (int)meshData.meshes_.size(), 1, [this, &meshData](int m)
+		{
+			const Mesh& mesh = meshData.meshes_[m];
+			const uint32_t numTriangles = mesh.getLODIndicesCount(0) / 3;
+			const uint32_t* indices = &meshData.indexData_[mesh.indexOffset + mesh.lodOffset[0]];
+
+			auto getPosition = [&](uint32_t i)
+			{
+				const float* v = &meshData.vertexData_[(size_t)(mesh.vertexOffset + indices[i]) * 8];
+				return vec3(v[0], v[1], v[2]);
+			};
+
+			std::vector<Triangle> triangles(numTriangles);
+			std::vector<BoundingBox> boxes(numTriangles);
+
+			for (uint32_t t = 0 ; t != numTriangles ; t++)
+			{
+				const vec3 v0 = getPosition(t * 3 + 0);
+				const vec3 v1 = getPosition(t * 3 + 1);
+				const vec3 v2 = getPosition(t * 3 + 2);
+
+				triangles[t] = Triangle { .v0_ = v0, .e1_ = v1 - v0, .e2_ = v2 - v0, .index_ = t };
+				boxes[t] = BoundingBox(glm::min(v0, glm::min(v1, v2)), glm::max(v0, glm::max(v1, v2)));
+			}
+
+			MeshBVH& bvh = meshes_[m];
+			std::vector<uint32_t> order;
+			buildBVH(boxes, kMaxMeshLeafSize, bvh.nodes_, order);
+
+			bvh.triangles_.resize(numTriangles);
+			for (uint32_t t = 0 ; t != numTriangles ; t++)
+				bvh.triangles_[t] = triangles[order[t]];
+		});
+
+	executor_.run(taskflow).wait();
+
+	stats_.numTriangles_ = 0;
+	stats_.numMeshNodes_ = 0;
+
+	for (const auto& m: meshes_)
+	{
+		stats_.numTriangles_ += (uint32_t)m.triangles_.size();
+		stats_.numMeshNodes_ += (uint32_t)m.nodes_.size();
+	}
+
+	stats_.meshBuildMs_ = millisecondsSince(start);
+}
+
+void RayQuery::updateInstance(const Scene& scene, Instance& instance) const
+{
+	const mat4& m = scene.globalTransform_[instance.node_];
+	const BVHNode& root = meshes_[instance.mesh_].nodes_[0];
+
+	instance.worldToMesh_ = glm::inverse(m);
+	instance.box_ = BoundingBox(root.min_, root.max_).getTransformed(m);
+}
+
+void RayQuery::buildInstances(const Scene& scene)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	std::vector<Instance> instances;
+	instances.reserve(scene.meshes_.size());
+
+	// meshes without triangles are never hit
+	for (const auto& n: scene.meshes_)
+		if (n.second < meshes_.size() && !meshes_[n.second].nodes_.empty())
+			instances.push_back(Instance { .node_ = n.first, .mesh_ = n.second });
+
+	std::sort(instances.begin(), instances.end(), [](const Instance& a, const Instance& b) { return a.node_ < b.node_; });
+
+	std::vector<BoundingBox> boxes(instances.size());
+	for (size_t i = 0 ; i != instances.size() ; i++)
+	{
+		updateInstance(scene, instances[i]);
+		boxes[i] = instances[i].box_;
+	}
+
+	std::vector<uint32_t> order;
+	buildBVH(boxes, kMaxInstanceLeafSize, instanceNodes_, order);
+
+	instances_.resize(instances.size());
+	for (size_t i = 0 ; i != instances.size() ; i++)
+		instances_[i] = instances[order[i]];
+
+	stats_.numInstances_ = (uint32_t)instances_.size();
+	stats_.numInstanceNodes_ = (uint32_t)instanceNodes_.size();
+	stats_.instanceBuildMs_ = millisecondsSince(start);
+}
+
+void RayQuery::refitInstances(const Scene& scene)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+
+	tf::Taskflow taskflow;
+	taskflow.for_each_index(0, (int)instances_.size(), 1, [this, &scene](int i) { updateInstance(scene, instances_[i]); });
+	executor_.run(taskflow).wait();
+
+	// children are always stored after their parents
+	for (size_t i = instanceNodes_.size() ; i-- > 0 ; )
+	{
+		BVHNode& node = instanceNodes_[i];
+		BoundingBox box = getEmptyBox();
+
+		if (node.count_)
+		{
+			for (uint32_t j = node.first_ ; j != node.first_ + node.count_ ; j++)
+				combineBox(box, instances_[j].box_.min_, instances_[j].box_.max_);
+		}
+		else
+		{
+			combineBox(box, instanceNodes_[node.first_ + 0].min_, instanceNodes_[node.first_ + 0].max_);
+			combineBox(box, instanceNodes_[node.first_ + 1].min_, instanceNodes_[node.first_ + 1].max_);
+		}
+
+		node.min_ = box.min_;
+		node.max_ = box.max_;
+	}
+
+	stats_.refitMs_ = millisecondsSince(start);
+}
+
+/* Möller-Trumbore, updates 'hit' if the triangle is closer than hit.t_ */
+template <bool AnyHit>
+bool RayQuery::traceMesh(const MeshBVH& bvh, const vec3& origin, const vec3& dir, float tMin, RayHit& hit) const
+{
+	const vec3 invDir = 1.0f / dir;
+
+	if (intersectBox(bvh.nodes_[0].min_, bvh.nodes_[0].max_, origin, invDir, tMin, hit.t_) == kMiss)
+		return false;
+
+	uint32_t stack[kMaxDepth + 2];
+	uint32_t sp = 0;
+	uint32_t n = 0;
+	bool found = false;
+
+	for (;;)
+	{
+		const BVHNode& node = bvh.nodes_[n];
+
+		if (node.count_)
+		{
+			for (uint32_t i = node.first_ ; i != node.first_ + node.count_ ; i++)
+			{
+				const Triangle& tri = bvh.triangles_[i];
+
+				const vec3 p = glm::cross(dir, tri.e2_);
+				const float det = glm::dot(tri.e1_, p);
+
+				if (fabsf(det) < 1e-12f)
+					continue;
+
+				const float invDet = 1.0f / det;
+				const vec3 s = origin - tri.v0_;
+				const float u = glm::dot(s, p) * invDet;
+
+				if (u < 0.0f || u > 1.0f)
+					continue;
+
+				const vec3 q = glm::cross(s, tri.e1_);
+				const float v = glm::dot(dir, q) * invDet;
+				const float t = glm::dot(tri.e2_, q) * invDet;
+
+				if (v < 0.0f || u + v > 1.0f || t < tMin || t >= hit.t_)
+					continue;
+
+				hit.t_ = t;
+				hit.triangle_ = tri.index_;
+				hit.u_ = u;
+				hit.v_ = v;
+				found = true;
+
+				if (AnyHit)
+					return true;
+			}
+		}
+		else
+		{
+			uint32_t c1 = node.first_;
+			uint32_t c2 = node.first_ + 1;
+
+			float d1 = intersectBox(bvh.nodes_[c1].min_, bvh.nodes_[c1].max_, origin, invDir, tMin, hit.t_);
+			float d2 = intersectBox(bvh.nodes_[c2].min_, bvh.nodes_[c2].max_, origin, invDir, tMin, hit.t_);
+
+			if (d1 > d2)
+			{
+				std::swap(d1, d2);
+				std::swap(c1, c2);
+			}
+
+			if (d1 != kMiss)
+			{
+				if (d2 != kMiss)
+					stack[sp++] = c2;
+
+				n = c1;
+				continue;
+			}
+		}
+
+		if (!sp)
+			break;
+
+		n = stack[--sp];
+	}
+
+	return found;
+}
+
+template <bool AnyHit>
+bool RayQuery::trace(const Ray& ray, RayHit& hit) const
+{
+	hit = RayHit();
+	hit.t_ = ray.tMax_;
+
+	if (instanceNodes_.empty())
+		return false;
+
+	const vec3 invDir = 1.0f / ray.dir_;
+
+	if (intersectBox(instanceNodes_[0].min_, instanceNodes_[0].max_, ray.origin_, invDir, ray.tMin_, hit.t_) == kMiss)
+		return false;
+
+	uint32_t stack[kMaxDepth + 2];
+	uint32_t sp = 0;
+	uint32_t n = 0;
+
+	for (;;)
+	{
+		const BVHNode& node = instanceNodes_[n];
+
+		if (node.count_)
+		{
+			for (uint32_t i = node.first_ ; i != node.first_ + node.count_ ; i++)
+			{
+				const Instance& inst = instances_[i];
+
+				// mesh space, the direction is not normalized to keep t
+				const vec3 o = vec3(inst.worldToMesh_ * vec4(ray.origin_, 1.0f));
+				const vec3 d = vec3(inst.worldToMesh_ * vec4(ray.dir_, 0.0f));
+
+				if (traceMesh<AnyHit>(meshes_[inst.mesh_], o, d, ray.tMin_, hit))
+				{
+					hit.node_ = (int)inst.node_;
+					hit.mesh_ = inst.mesh_;
+
+					if (AnyHit)
+						return true;
+				}
+			}
+		}
+		else
+		{
+			uint32_t c1 = node.first_;
+			uint32_t c2 = node.first_ + 1;
+
+			float d1 = intersectBox(instanceNodes_[c1].min_, instanceNodes_[c1].max_, ray.origin_, invDir, ray.tMin_, hit.t_);
+			float d2 = intersectBox(instanceNodes_[c2].min_, instanceNodes_[c2].max_, ray.origin_, invDir, ray.tMin_, hit.t_);
+
+			if (d1 > d2)
+			{
+				std::swap(d1, d2);
+				std::swap(c1, c2);
+			}
+
+			if (d1 != kMiss)
+			{
+				if (d2 != kMiss)
+					stack[sp++] = c2;
+
+				n = c1;
+				continue;
+			}
+		}
+
+		if (!sp)
+			break;
+
+		n = stack[--sp];
+	}
+
+	if (!hit.isHit())
+		hit.t_ = kMiss;
+
+	return hit.isHit();
+}
+
+bool RayQuery::closestHit(const Ray& ray, RayHit& hit) const
+{
+	return trace<false>(ray, hit);
+}
+
+bool RayQuery::anyHit(const Ray& ray) const
+{
+	RayHit hit;
+	return trace<true>(ray, hit);
+}
+
+template <bool AnyHit>
+void RayQuery::traceMeshPacket(const MeshBVH& bvh, const Instance& instance, Packet& packet) const
+{
+	const mat4& m = instance.worldToMesh_;
+
+	float ox[PacketSize], oy[PacketSize], oz[PacketSize];
+	float dx[PacketSize], dy[PacketSize], dz[PacketSize];
+	float ix[PacketSize], iy[PacketSize], iz[PacketSize];
+
+	for (uint32_t i = 0 ; i != PacketSize ; i++)
+	{
+		ox[i] = m[0][0] * packet.ox_[i] + m[1][0] * packet.oy_[i] + m[2][0] * packet.oz_[i] + m[3][0];
+		oy[i] = m[0][1] * packet.ox_[i] + m[1][1] * packet.oy_[i] + m[2][1] * packet.oz_[i] + m[3][1];
+		oz[i] = m[0][2] * packet.ox_[i] + m[1][2] * packet.oy_[i] + m[2][2] * packet.oz_[i] + m[3][2];
+		dx[i] = m[0][0] * packet.dx_[i] + m[1][0] * packet.dy_[i] + m[2][0] * packet.dz_[i];
+		dy[i] = m[0][1] * packet.dx_[i] + m[1][1] * packet.dy_[i] + m[2][1] * packet.dz_[i];
+		dz[i] = m[0][2] * packet.dx_[i] + m[1][2] * packet.dy_[i] + m[2][2] * packet.dz_[i];
+		ix[i] = 1.0f / dx[i];
+		iy[i] = 1.0f / dy[i];
+		iz[i] = 1.0f / dz[i];
+	}
+
+	uint32_t stack[kMaxDepth + 2];
+	uint32_t sp = 0;
+	stack[sp++] = 0;
+
+	while (sp)
+	{
+		const BVHNode& node = bvh.nodes_[stack[--sp]];
+
+		if (!intersectBoxPacket(node.min_, node.max_, ox, oy, oz, ix, iy, iz, packet.tMin_, packet.tMax_))
+			continue;
+
+		if (!node.count_)
+		{
+			const bool leftFirst = isLeftChildNearer(bvh.nodes_, node, vec3(dx[0], dy[0], dz[0]));
+			stack[sp++] = node.first_ + (leftFirst ? 1 : 0);
+			stack[sp++] = node.first_ + (leftFirst ? 0 : 1);
+			continue;
+		}
+
+		for (uint32_t t = node.first_ ; t != node.first_ + node.count_ ; t++)
+		{
+			const Triangle& tri = bvh.triangles_[t];
+
+			for (uint32_t i = 0 ; i != PacketSize ; i++)
+			{
+				const float px = dy[i] * tri.e2_.z - dz[i] * tri.e2_.y;
+				const float py = dz[i] * tri.e2_.x - dx[i] * tri.e2_.z;
+				const float pz = dx[i] * tri.e2_.y - dy[i] * tri.e2_.x;
+
+				const float det = tri.e1_.x * px + tri.e1_.y * py + tri.e1_.z * pz;
+				const float invDet = 1.0f / det;
+
+				const float sx = ox[i] - tri.v0_.x;
+				const float sy = oy[i] - tri.v0_.y;
+				const float sz = oz[i] - tri.v0_.z;
+
+				const float u = (sx * px + sy * py + sz * pz) * invDet;
+
+				const float qx = sy * tri.e1_.z - sz * tri.e1_.y;
+				const float qy = sz * tri.e1_.x - sx * tri.e1_.z;
+				const float qz = sx * tri.e1_.y - sy * tri.e1_.x;
+
+				const float v = (dx[i] * qx + dy[i] * qy + dz[i] * qz) * invDet;
+				const float tHit = (tri.e2_.x * qx + tri.e2_.y * qy + tri.e2_.z * qz) * invDet;
+
+				const bool isHit = fabsf(det) >= 1e-12f && u >= 0.0f && v >= 0.0f && u + v <= 1.0f && tHit >= packet.tMin_[i] && tHit < packet.tMax_[i];
+
+				// selects instead of branches keep the loop vectorizable, any-hit lanes are deactivated
+				packet.tMax_[i] = isHit ? (AnyHit ? std::numeric_limits<float>::lowest() : tHit) : packet.tMax_[i];
+				packet.u_[i] = isHit ? u : packet.u_[i];
+				packet.v_[i] = isHit ? v : packet.v_[i];
+				packet.node_[i] = isHit ? (int)instance.node_ : packet.node_[i];
+				packet.mesh_[i] = isHit ? instance.mesh_ : packet.mesh_[i];
+				packet.triangle_[i] = isHit ? tri.index_ : packet.triangle_[i];
+			}
+		}
+	}
+}
+
+template <bool AnyHit>
+void RayQuery::tracePacket(Packet& packet) const
+{
+	if (instanceNodes_.empty())
+		return;
+
+	float ix[PacketSize], iy[PacketSize], iz[PacketSize];
+
+	for (uint32_t i = 0 ; i != PacketSize ; i++)
+	{
+		ix[i] = 1.0f / packet.dx_[i];
+		iy[i] = 1.0f / packet.dy_[i];
+		iz[i] = 1.0f / packet.dz_[i];
+	}
+
+	uint32_t stack[kMaxDepth + 2];
+	uint32_t sp = 0;
+	stack[sp++] = 0;
+
+	while (sp)
+	{
+		const BVHNode& node = instanceNodes_[stack[--sp]];
+
+		if (!intersectBoxPacket(node.min_, node.max_, packet.ox_, packet.oy_, packet.oz_, ix, iy, iz, packet.tMin_, packet.tMax_))
+			continue;
+
+		if (!node.count_)
+		{
+			const bool leftFirst = isLeftChildNearer(instanceNodes_, node, vec3(packet.dx_[0], packet.dy_[0], packet.dz_[0]));
+			stack[sp++] = node.first_ + (leftFirst ? 1 : 0);
+			stack[sp++] = node.first_ + (leftFirst ? 0 : 1);
+			continue;
+		}
+
+		for (uint32_t i = node.first_ ; i != node.first_ + node.count_ ; i++)
+			traceMeshPacket<AnyHit>(meshes_[instances_[i].mesh_], instances_[i], packet);
+	}
+}
+
+void RayQuery::closestHits(const std::vector<Ray>& rays, std::vector<RayHit>& hits)
+{
+	const int numPackets = (int)((rays.size() + PacketSize - 1) / PacketSize);
+
+	hits.resize(rays.size());
+
+	tf::Taskflow taskflow;
+
+	taskflow.for_each_index(0, numPackets, 1, [this, &rays, &hits](int p)
+		{
+			Packet packet;
+			packet.load(rays, (size_t)p * PacketSize);
+
+			tracePacket<false>(packet);
+
+			for (uint32_t i = 0 ; i != PacketSize && (size_t)p * PacketSize + i < rays.size() ; i++)
+			{
+				RayHit& hit = hits[(size_t)p * PacketSize + i];
+				hit = RayHit();
+
+				if (packet.node_[i] < 0)
+					continue;
+
+				hit.t_ = packet.tMax_[i];
+				hit.node_ = packet.node_[i];
+				hit.mesh_ = packet.mesh_[i];
+				hit.triangle_ = packet.triangle_[i];
+				hit.u_ = packet.u_[i];
+				hit.v_ = packet.v_[i];
+			}
+		});
+
+	executor_.run(taskflow).wait();
+}
+
+void RayQuery::anyHits(const std::vector<Ray>& rays, std::vector<uint8_t>& occluded)
+{
+	const int numPackets = (int)((rays.size() + PacketSize - 1) / PacketSize);
+
+	occluded.resize(rays.size());
+
+	tf::Taskflow taskflow;
+
+	taskflow.for_each_index(0, numPackets, 1, [this, &rays, &occluded](int p)
+		{
+			Packet packet;
+			packet.load(rays, (size_t)p * PacketSize);
+
+			tracePacket<true>(packet);
+
+			for (uint32_t i = 0 ; i != PacketSize && (size_t)p * PacketSize + i < rays.size() ; i++)
+				occluded[(size_t)p * PacketSize + i] = packet.node_[i] > -1 ? 1 : 0;
+		});
+
+	executor_.run(taskflow).wait();
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <stdint.h>
+#include <limits>
+#include <vector>
+
+#include <taskflow/taskflow.hpp>
+
+#include "shared/UtilsMath.h"
+#include "shared/scene/Scene.h"
+#include "shared/scene/VtxData.h"
+
+/**
+	Ray queries against scene geometry (no GPU dependencies): picking, visibility and shadow rays
+
+	A two-level BVH: every mesh gets a bottom-level BVH over its LOD0 triangles (built once, meshes in parallel),
+	the top-level BVH is built over the scene nodes with meshes using their global transforms.
+	Both levels use binned SAH builds. Rays enter a mesh in its local space, so t values are the same in both levels.
+	When global transforms change, refitInstances() recalculates the top-level boxes and keeps its topology.
+
+	Packets of PacketSize rays are traversed together: a node is visited if any active ray of the packet hits its box.
+	Packet data is stored as structures of arrays and the per-ray loops are written to be auto-vectorized.
+*/
+
+struct Ray
+{
+	vec3 origin_;
+	// does not have to be normalized, t is measured in its lengths
+	vec3 dir_;
+	float tMin_ = 0.0f;
+	float tMax_ = std::numeric_limits<float>::max();
+};
+
+struct RayHit
+{
+	float t_ = std::numeric_limits<float>::max();
+	// -1 if nothing was hit
+	int node_ = -1;
+	uint32_t mesh_ = 0;
+	// index of the triangle in LOD0 of the mesh
+	uint32_t triangle_ = 0;
+	// barycentrics of the hit point (the weights of the 2nd and the 3rd vertices)
+	float u_ = 0.0f;
+	float v_ = 0.0f;
+
+	inline bool isHit() const { return node_ > -1; }
+};
+
+struct RayQueryStats
+{
+	uint32_t numTriangles_ = 0;
+	uint32_t numMeshNodes_ = 0; // bottom-level BVH nodes of all meshes
+	uint32_t numInstances_ = 0;
+	uint32_t numInstanceNodes_ = 0;
+
+	double meshBuildMs_ = 0.0;
+	double instanceBuildMs_ = 0.0;
+	double refitMs_ = 0.0;
+};
+
+/* Generates a primary ray through the pixel (x, y) of a width x height viewport, row 0 is the top of the screen */
+Ray getPrimaryRay(const mat4& view, const mat4& proj, float x, float y, int width, int height);
+
+struct RayQuery final
+{
+	static constexpr uint32_t PacketSize = 8;
+
+	/* numThreads == 0 uses all hardware threads */
+	explicit RayQuery(uint32_t numThreads = 0);
+
+	/* Bottom-level BVHs over LOD0 triangles of every mesh */
+	void buildMeshes(const MeshData& meshData);
+
+	/* Top-level BVH over the nodes of the scene with meshes, buildMeshes() has to be called first */
+	void buildInstances(const Scene& scene);
+
+	/* Takes the new global transforms of the instances, the set of nodes with meshes must not change */
+	void refitInstances(const Scene& scene);
+
+	/* Thread-safe */
+	bool closestHit(const Ray& ray, RayHit& hit) const;
+	bool anyHit(const Ray& ray) const;
+
+	/* Parallel batched queries, consecutive rays are traced as packets (coherent rays should be adjacent) */
+	void closestHits(const std::vector<Ray>& rays, std::vector<RayHit>& hits);
+	void anyHits(const std::vector<Ray>& rays, std::vector<uint8_t>& occluded);
+
+	inline const RayQueryStats& getStats() const { return stats_; }
+
+private:
+	// 32 bytes, children of an interior node (count_ == 0) are stored next to each other at first_
+	struct BVHNode
+	{
+		vec3 min_;
+		uint32_t first_;
+		vec3 max_;
+		uint32_t count_;
+	};
+
+	struct Triangle
+	{
+		vec3 v0_;
+		vec3 e1_;
+		vec3 e2_;
+		uint32_t index_;
+	};
+
+	struct MeshBVH
+	{
+		std::vector<BVHNode> nodes_;
+		// reordered to match the leaves
+		std::vector<Triangle> triangles_;
+	};
+
+	struct Instance
+	{
+		mat4 worldToMesh_;
+		BoundingBox box_;
+		uint32_t node_;
+		uint32_t mesh_;
+	};
+
+	struct Packet;
+
+	static void buildBVH(const std::vector<BoundingBox>& boxes, uint32_t maxLeafSize, std::vector<BVHNode>& nodes, std::vector<uint32_t>& order);
+
+	void updateInstance(const Scene& scene, Instance& instance) const;
+
+	template <bool AnyHit>
+	bool traceMesh(const MeshBVH& bvh, const vec3& origin, const vec3& dir, float tMin, RayHit& hit) const;
+
+	template <bool AnyHit>
+	bool trace(const Ray& ray, RayHit& hit) const;
+
+	template <bool AnyHit>
+	void traceMeshPacket(const MeshBVH& bvh, const Instance& instance, Packet& packet) const;
+
+	template <bool AnyHit>
+	void tracePacket(Packet& packet) const;
+
+	tf::Executor executor_;
+
+	std::vector<MeshBVH> meshes_;
+
+	std::vector<Instance> instances_;
+	std::vector<BVHNode> instanceNodes_;
+
+	RayQueryStats stats_;
+};
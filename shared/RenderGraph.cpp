@@ -0,0 +1,403 @@
+#include "shared/RenderGraph.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+static constexpr uint32_t NoPass = ~0u;
+
+bool isWriteUsage(eResourceUsage usage)
+{
+	switch (usage)
+	{
+	case eResourceUsage_ColorAttachment:
+	case eResourceUsage_DepthAttachment:
+	case eResourceUsage_StorageWrite:
+	case eResourceUsage_StorageReadWrite:
+	case eResourceUsage_TransferDst:
+		return true;
+	default:
+		return false;
+	}
+}
+
+const char* resourceUsageName(eResourceUsage usage)
+{
+	static const char* names[eResourceUsage_Count] = {
+		"Undefined", "ColorAttachment", "DepthAttachment", "DepthRead", "ShaderRead",
+		"StorageRead", "StorageWrite", "StorageReadWrite", "TransferSrc", "TransferDst", "IndirectArgs"
+	};
+
+	return (usage < eResourceUsage_Count) ? names[usage] : "?";
+}
+
+/* Usage of a resource which is both read and written by the same pass */
+static eResourceUsage combineUsages(eResourceUsage a, eResourceUsage b)
+{
+	if (a == b)
+		return a;
+
+	const bool aStorage = (a == eResourceUsage_StorageRead || a == eResourceUsage_StorageWrite || a == eResourceUsage_StorageReadWrite);
+	const bool bStorage = (b == eResourceUsage_StorageRead || b == eResourceUsage_StorageWrite || b == eResourceUsage_StorageReadWrite);
+
+	if (aStorage && bStorage)
+		return eResourceUsage_StorageReadWrite;
+
+	// e.g. blending into a color attachment: the attachment state wins
+	return isWriteUsage(b) ? b : (isWriteUsage(a) ? a : b);
+}
+
+/* Read-after-read in the same state is the only case which does not need a barrier */
+static bool needsTransition(eResourceUsage before, eResourceUsage after)
+{
+	return (before != after) || isWriteUsage(after);
+}
+
+uint32_t RenderGraph::addResource(const std::string& name, const RenderGraphResourceDesc& desc)
+{
+	resources_.push_back(Resource { .name_ = name, .desc_ = desc });
+	compiled_ = false;
+	return (uint32_t)resources_.size() - 1;
+}
+
+uint32_t RenderGraph::addPass(const std::string& name, bool hasSideEffects)
+{
+	passes_.push_back(Pass { .name_ = name, .hasSideEffects_ = hasSideEffects });
+	compiled_ = false;
+	return (uint32_t)passes_.size() - 1;
+}
+
+void RenderGraph::setResourceFinalUsage(uint32_t resource, eResourceUsage finalUsage)
+{
+	if (resources_[resource].desc_.finalUsage_ == finalUsage)
+		return;
+
+	resources_[resource].desc_.finalUsage_ = finalUsage;
+	compiled_ = false;
+}
+
+void RenderGraph::read(uint32_t pass, uint32_t resource, eResourceUsage usage, eResourceUsage leavesAs)
+{
+	passes_[pass].accesses_.push_back(Access { .resource_ = resource, .usage_ = usage, .leavesAs_ = leavesAs, .isWrite_ = false });
+	compiled_ = false;
+}
+
+void RenderGraph::write(uint32_t pass, uint32_t resource, eResourceUsage usage, eResourceUsage leavesAs)
+{
+	passes_[pass].accesses_.push_back(Access { .resource_ = resource, .usage_ = usage, .leavesAs_ = leavesAs, .isWrite_ = true });
+	compiled_ = false;
+}
+
+void RenderGraph::setPassEnabled(uint32_t pass, bool enabled)
+{
+	if (passes_[pass].enabled_ == enabled)
+		return;
+
+	passes_[pass].enabled_ = enabled;
+	compiled_ = false;
+}
+
+bool RenderGraph::compile()
+{
+	compiled_ = false;
+	edges_.clear();
+	steps_.clear();
+	finalBarriers_.clear();
+
+	const uint32_t numPasses = (uint32_t)passes_.size();
+	const uint32_t numResources = (uint32_t)resources_.size();
+
+	auto writes = [this](uint32_t p, uint32_t r)
+	{
+		for (const auto& a: passes_[p].accesses_)
+			if (a.isWrite_ && a.resource_ == r)
+				return true;
+		return false;
+	};
+
+	// 1. Writers of each resource in declaration order; every write creates a new "version" of the resource
+	std::vector<std::vector<uint32_t>> writers(numResources);
+
+	for (uint32_t p = 0 ; p != numPasses ; p++)
+	{
+		passes_[p].alive_ = false;
+
+		if (!passes_[p].enabled_)
+			continue;
+
+		for (const auto& a: passes_[p].accesses_)
+			if (a.isWrite_ && (writers[a.resource_].empty() || writers[a.resource_].back() != p))
+				writers[a.resource_].push_back(p);
+	}
+
+	// 2. Read-after-write: a reader sees the last version written before it. A reader declared before all writers sees
+	//    the contents the resource had when the graph started (e.g. written in the previous frame), so it has no producer
+	std::vector<std::vector<std::pair<uint32_t, uint32_t>>> readers(numResources); // (producer, reader)
+
+	for (uint32_t p = 0 ; p != numPasses ; p++)
+	{
+		if (!passes_[p].enabled_)
+			continue;
+
+		for (const auto& a: passes_[p].accesses_)
+		{
+			if (a.isWrite_ || writes(p, a.resource_))
+				continue;
+
+			const auto& w = writers[a.resource_];
+
+			uint32_t producer = NoPass;
+			for (auto i: w)
+				if (i < p)
+					producer = i;
+
+			if (producer != NoPass)
+				edges_.push_back(Edge { .from_ = producer, .to_ = p, .isData_ = true });
+
+			readers[a.resource_].emplace_back(producer, p);
+		}
+	}
+
+	// 3. Write-after-write between consecutive versions and write-after-read for the readers of the previous version
+	for (uint32_t r = 0 ; r != numResources ; r++)
+	{
+		const auto& w = writers[r];
+
+		// the initial contents have to be read before the first write
+		if (!w.empty())
+			for (const auto& rd: readers[r])
+				if (rd.first == NoPass && rd.second != w[0])
+					edges_.push_back(Edge { .from_ = rd.second, .to_ = w[0], .isData_ = false });
+
+		for (size_t i = 1 ; i < w.size() ; i++)
+		{
+			edges_.push_back(Edge { .from_ = w[i - 1], .to_ = w[i], .isData_ = true });
+
+			for (const auto& rd: readers[r])
+				if (rd.first == w[i - 1] && rd.second != w[i])
+					edges_.push_back(Edge { .from_ = rd.second, .to_ = w[i], .isData_ = false });
+		}
+	}
+
+	// 4. Topological sort, lowest declaration index first
+	std::vector<uint32_t> inDegree(numPasses, 0);
+	std::vector<std::vector<uint32_t>> outgoing(numPasses);
+
+	for (const auto& e: edges_)
+	{
+		inDegree[e.to_]++;
+		outgoing[e.from_].push_back(e.to_);
+	}
+
+	std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> ready;
+	uint32_t numEnabled = 0;
+
+	for (uint32_t p = 0 ; p != numPasses ; p++)
+		if (passes_[p].enabled_)
+		{
+			numEnabled++;
+			if (inDegree[p] == 0)
+				ready.push(p);
+		}
+
+	std::vector<uint32_t> order;
+	order.reserve(numEnabled);
+
+	while (!ready.empty())
+	{
+		const uint32_t p = ready.top();
+		ready.pop();
+		order.push_back(p);
+
+		for (auto next: outgoing[p])
+			if (--inDegree[next] == 0)
+				ready.push(next);
+	}
+
+	if (order.size() != numEnabled)
+	{
+		printf("RenderGraph: dependency cycle detected (%u of %u passes scheduled)\n", (uint32_t)order.size(), numEnabled);
+		return false;
+	}
+
+	// 5. Culling: walk back from the passes with side effects and the writers of external resources
+	std::vector<uint32_t> stack;
+
+	for (auto p: order)
+	{
+		bool isRoot = passes_[p].hasSideEffects_;
+
+		for (const auto& a: passes_[p].accesses_)
+			isRoot = isRoot || (a.isWrite_ && resources_[a.resource_].desc_.isExternal_);
+
+		if (isRoot)
+		{
+			passes_[p].alive_ = true;
+			stack.push_back(p);
+		}
+	}
+
+	while (!stack.empty())
+	{
+		const uint32_t p = stack.back();
+		stack.pop_back();
+
+		for (const auto& e: edges_)
+			if (e.to_ == p && e.isData_ && !passes_[e.from_].alive_)
+			{
+				passes_[e.from_].alive_ = true;
+				stack.push_back(e.from_);
+			}
+	}
+
+	// 6. Simulate resource states along the schedule
+	std::vector<eResourceUsage> state(numResources);
+	std::vector<bool> touched(numResources, false);
+
+	for (uint32_t r = 0 ; r != numResources ; r++)
+		state[r] = resources_[r].desc_.initialUsage_;
+
+	for (auto p: order)
+	{
+		if (!passes_[p].alive_)
+			continue;
+
+		// one entry per resource, even if the pass reads and writes it
+		std::vector<Access> merged;
+
+		for (const auto& a: passes_[p].accesses_)
+		{
+			auto i = std::find_if(merged.begin(), merged.end(), [&a](const Access& m) { return m.resource_ == a.resource_; });
+
+			if (i == merged.end())
+			{
+				merged.push_back(a);
+				continue;
+			}
+
+			i->usage_ = combineUsages(i->usage_, a.usage_);
+			i->isWrite_ = i->isWrite_ || a.isWrite_;
+			if (a.leavesAs_ != eResourceUsage_Undefined)
+				i->leavesAs_ = a.leavesAs_;
+		}
+
+		RenderGraphStep step { .pass_ = p };
+
+		for (const auto& m: merged)
+		{
+			if (needsTransition(state[m.resource_], m.usage_))
+				step.barriers_.push_back(RenderGraphBarrier { .resource_ = m.resource_, .before_ = state[m.resource_], .after_ = m.usage_ });
+
+			state[m.resource_] = (m.leavesAs_ != eResourceUsage_Undefined) ? m.leavesAs_ : m.usage_;
+			touched[m.resource_] = true;
+		}
+
+		steps_.push_back(std::move(step));
+	}
+
+	for (uint32_t r = 0 ; r != numResources ; r++)
+	{
+		const eResourceUsage finalUsage = resources_[r].desc_.finalUsage_;
+
+		if (touched[r] && finalUsage != eResourceUsage_Undefined && state[r] != finalUsage)
+			finalBarriers_.push_back(RenderGraphBarrier { .resource_ = r, .before_ = state[r], .after_ = finalUsage });
+	}
+
+	compiled_ = true;
+
+	return true;
+}
+
+bool RenderGraph::getResourceLifetime(uint32_t resource, uint32_t* firstStep, uint32_t* lastStep) const
+{
+	bool used = false;
+
+	for (uint32_t s = 0 ; s != (uint32_t)steps_.size() ; s++)
+		for (const auto& a: passes_[steps_[s].pass_].accesses_)
+		{
+			if (a.resource_ != resource)
+				continue;
+
+			if (!used)
+				*firstStep = s;
+			*lastStep = s;
+			used = true;
+			break;
+		}
+
+	return used;
+}
+
+size_t RenderGraph::getBarrierCount() const
+{
+	size_t count = finalBarriers_.size();
+
+	for (const auto& s: steps_)
+		count += s.barriers_.size();
+
+	return count;
+}
+
+void RenderGraph::print() const
+{
+	uint32_t numCulled = 0;
+	for (const auto& p: passes_)
+		numCulled += (p.enabled_ && !p.alive_) ? 1 : 0;
+
+	printf("RenderGraph: %u passes (%u culled), %u resources, %u barriers\n",
+		(uint32_t)passes_.size(), numCulled, (uint32_t)resources_.size(), (uint32_t)getBarrierCount());
+
+	for (const auto& s: steps_)
+	{
+		printf("  %s\n", passes_[s.pass_].name_.c_str());
+
+		for (const auto& b: s.barriers_)
+			printf("    | %s: %s -> %s\n", resources_[b.resource_].name_.c_str(), resourceUsageName(b.before_), resourceUsageName(b.after_));
+	}
+
+	for (const auto& b: finalBarriers_)
+		printf("  (final) %s: %s -> %s\n", resources_[b.resource_].name_.c_str(), resourceUsageName(b.before_), resourceUsageName(b.after_));
+
+	for (const auto& p: passes_)
+		if (p.enabled_ && !p.alive_)
+			printf("  (culled) %s\n", p.name_.c_str());
+}
+
+void dumpRenderGraphToDot(const char* fileName, const RenderGraph& graph)
+{
+	FILE* f = fopen(fileName, "w");
+	if (!f)
+	{
+		printf("Cannot write %s\n", fileName);
+		return;
+	}
+
+	fprintf(f, "digraph G\n{\n\trankdir = LR\n");
+
+	for (size_t i = 0 ; i != graph.resources_.size() ; i++)
+	{
+		const auto& r = graph.resources_[i];
+		fprintf(f, "\tr%d [label=\"%s\", shape = ellipse%s]\n", (int)i, r.name_.c_str(), r.desc_.isExternal_ ? ", peripheries = 2" : "");
+	}
+
+	for (size_t i = 0 ; i != graph.passes_.size() ; i++)
+	{
+		const auto& p = graph.passes_[i];
+		if (!p.enabled_)
+			continue;
+
+		fprintf(f, "\tp%d [label=\"%s\", shape = box%s]\n", (int)i, p.name_.c_str(), p.alive_ ? "" : ", color = grey, fontcolor = grey, style = dashed");
+
+		for (const auto& a: p.accesses_)
+		{
+			if (a.isWrite_)
+				fprintf(f, "\tp%d -> r%d [label=\"%s\"]\n", (int)i, (int)a.resource_, resourceUsageName(a.usage_));
+			else
+				fprintf(f, "\tr%d -> p%d [label=\"%s\"]\n", (int)a.resource_, (int)i, resourceUsageName(a.usage_));
+		}
+	}
+
+	fprintf(f, "}\n");
+	fclose(f);
+}
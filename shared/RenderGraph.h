@@ -0,0 +1,158 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+	Declarative frame graph (no GPU dependencies)
+
+	Passes declare which resources they read and write and how (eResourceUsage).
+	compile() then
+	  - derives the execution order from the read/write dependencies (declaration order breaks ties),
+	  - culls passes whose results never reach a pass with side effects or an external resource,
+	  - computes the state transitions (barriers) in front of every pass, merged per pass.
+
+	A pass which reads a resource before any pass writes it reads the contents from before the graph (e.g. the previous frame):
+	it is scheduled before the writers. Ping-pong resources are declared once and get their textures swapped every frame.
+
+	The actual barrier commands are emitted by VulkanRenderGraph (vkFramework), which maps usages to layouts/access masks.
+*/
+
+enum eResourceUsage : uint8_t
+{
+	eResourceUsage_Undefined = 0,    // contents are not needed
+	eResourceUsage_ColorAttachment,
+	eResourceUsage_DepthAttachment,
+	eResourceUsage_DepthRead,        // read-only depth attachment
+	eResourceUsage_ShaderRead,       // sampled texture
+	eResourceUsage_StorageRead,
+	eResourceUsage_StorageWrite,
+	eResourceUsage_StorageReadWrite,
+	eResourceUsage_TransferSrc,
+	eResourceUsage_TransferDst,
+	eResourceUsage_IndirectArgs,
+	eResourceUsage_Count
+};
+
+bool isWriteUsage(eResourceUsage usage);
+
+const char* resourceUsageName(eResourceUsage usage);
+
+struct RenderGraphResourceDesc
+{
+	bool isImage_ = true;
+
+	/* The contents are used outside the graph (displayed, read next frame...): writers of this resource are never culled */
+	bool isExternal_ = false;
+
+	/* State at the beginning of the graph and the state the graph has to leave the resource in (Undefined: don't care) */
+	eResourceUsage initialUsage_ = eResourceUsage_Undefined;
+	eResourceUsage finalUsage_ = eResourceUsage_Undefined;
+};
+
+struct RenderGraphBarrier
+{
+	uint32_t resource_;
+	eResourceUsage before_;
+	eResourceUsage after_;
+};
+
+/* One scheduled pass with all the transitions which have to be done right before it */
+struct RenderGraphStep
+{
+	uint32_t pass_;
+	std::vector<RenderGraphBarrier> barriers_;
+};
+
+struct RenderGraph
+{
+	uint32_t addResource(const std::string& name, const RenderGraphResourceDesc& desc = RenderGraphResourceDesc());
+
+	uint32_t addPass(const std::string& name, bool hasSideEffects = false);
+
+	/* Undefined: no final transition (e.g. for a texture whose memory is reused by another one) */
+	void setResourceFinalUsage(uint32_t resource, eResourceUsage finalUsage);
+
+	/*
+		'leavesAs' is the state the pass itself leaves the resource in (e.g. a render pass with a different finalLayout).
+		Undefined means the pass does not change the state.
+	*/
+	void read(uint32_t pass, uint32_t resource, eResourceUsage usage = eResourceUsage_ShaderRead, eResourceUsage leavesAs = eResourceUsage_Undefined);
+	void write(uint32_t pass, uint32_t resource, eResourceUsage usage = eResourceUsage_ColorAttachment, eResourceUsage leavesAs = eResourceUsage_Undefined);
+
+	/* Disabled passes are treated as if they were never declared; changing this recompiles the graph, so it is not meant for per-frame toggling */
+	void setPassEnabled(uint32_t pass, bool enabled);
+	inline bool isPassEnabled(uint32_t pass) const { return passes_[pass].enabled_; }
+
+	/* Returns false if there is a dependency cycle */
+	bool compile();
+
+	inline bool isCompiled() const { return compiled_; }
+
+	inline const std::vector<RenderGraphStep>& getSteps() const { return steps_; }
+	inline const std::vector<RenderGraphBarrier>& getFinalBarriers() const { return finalBarriers_; }
+
+	inline bool isPassCulled(uint32_t pass) const { return !passes_[pass].alive_; }
+
+	/* Indices of the first and the last step (in getSteps()) which access the resource; false if no scheduled pass uses it */
+	bool getResourceLifetime(uint32_t resource, uint32_t* firstStep, uint32_t* lastStep) const;
+
+	inline size_t getPassCount() const { return passes_.size(); }
+	inline size_t getResourceCount() const { return resources_.size(); }
+
+	inline const std::string& getPassName(uint32_t pass) const { return passes_[pass].name_; }
+	inline const std::string& getResourceName(uint32_t resource) const { return resources_[resource].name_; }
+	inline const RenderGraphResourceDesc& getResourceDesc(uint32_t resource) const { return resources_[resource].desc_; }
+
+	/* Total number of transitions (including the final ones) after compile() */
+	size_t getBarrierCount() const;
+
+	/* Print the schedule with all transitions to stdout */
+	void print() const;
+
+private:
+	struct Access
+	{
+		uint32_t resource_;
+		eResourceUsage usage_;
+		eResourceUsage leavesAs_;
+		bool isWrite_;
+	};
+
+	struct Pass
+	{
+		std::string name_;
+		bool hasSideEffects_ = false;
+		bool enabled_ = true;
+		bool alive_ = false;
+		std::vector<Access> accesses_;
+	};
+
+	struct Resource
+	{
+		std::string name_;
+		RenderGraphResourceDesc desc_;
+	};
+
+	struct Edge
+	{
+		uint32_t from_;
+		uint32_t to_;
+		bool isData_; // RAW/WAW (false for WAR edges, which only constrain the order)
+	};
+
+	std::vector<Pass> passes_;
+	std::vector<Resource> resources_;
+
+	std::vector<Edge> edges_;
+	std::vector<RenderGraphStep> steps_;
+	std::vector<RenderGraphBarrier> finalBarriers_;
+
+	bool compiled_ = false;
+
+	friend void dumpRenderGraphToDot(const char* fileName, const RenderGraph& graph);
+};
+
+/* Graphviz output: passes are boxes, resources are ellipses, culled passes are grey */
+void dumpRenderGraphToDot(const char* fileName, const RenderGraph& graph);
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stdint.h>
+#include <deque>
+#include <limits>
+
+/**
+	Frame-scoped linear ring allocator (no GPU dependencies)
+
+	Hands out offsets inside a buffer of 'capacity' bytes. Allocations are linear inside a frame,
+	and all allocations of a frame are released together once 'framesInFlight' newer frames have begun.
+	When the end of the buffer is reached, the allocator wraps around to offset 0
+	(the skipped tail is accounted to the frame which caused the wrap).
+
+	The class only keeps the bookkeeping, so it can be used on top of any persistently mapped buffer
+	(see VulkanRingBuffer in vkFramework) and tested without a device.
+*/
+struct RingAllocator
+{
+	static constexpr uint64_t InvalidOffset = std::numeric_limits<uint64_t>::max();
+
+	explicit RingAllocator(uint64_t capacity = 0, uint32_t framesInFlight = 1)
+	: capacity_(capacity)
+	, framesInFlight_(framesInFlight > 0 ? framesInFlight : 1)
+	{}
+
+	/* Start a new frame and release everything allocated 'framesInFlight' frames ago */
+	void beginFrame()
+	{
+		while (frames_.size() >= framesInFlight_)
+		{
+			const FrameRecord& f = frames_.front();
+			tail_ = f.end_;
+			usedBytes_ -= f.bytes_;
+			frames_.pop_front();
+		}
+
+		// nothing in use: restart at the beginning, the frames still in flight are empty and have to end there too
+		if (usedBytes_ == 0)
+		{
+			head_ = tail_ = 0;
+			for (auto& f: frames_)
+				f.end_ = 0;
+		}
+
+		frames_.push_back(FrameRecord { .end_ = head_, .bytes_ = 0 });
+	}
+
+	/* Returns InvalidOffset if there is not enough space (i.e. the buffer is too small for the frames in flight) */
+	uint64_t allocate(uint64_t size, uint64_t alignment = 1)
+	{
+		if (size == 0 || size > capacity_ || frames_.empty())
+			return InvalidOffset;
+
+		const bool isFull = (usedBytes_ > 0) && (head_ == tail_);
+		if (isFull)
+			return InvalidOffset;
+
+		uint64_t offset = alignUp(head_, alignment);
+		uint64_t newHead = offset + size;
+
+		if (head_ >= tail_)
+		{
+			// free space: [head_, capacity_) and [0, tail_)
+			if (newHead > capacity_)
+			{
+				// wrap around: the tail of the buffer is wasted till the frame is released
+				if (size > tail_)
+					return InvalidOffset;
+				offset = 0;
+				newHead = size;
+			}
+		}
+		else if (newHead > tail_)
+		{
+			// free space: [head_, tail_)
+			return InvalidOffset;
+		}
+
+		const uint64_t consumed = (newHead >= head_) ? (newHead - head_) : (capacity_ - head_ + newHead);
+
+		usedBytes_ += consumed;
+		head_ = (newHead == capacity_) ? 0 : newHead;
+
+		frames_.back().end_ = head_;
+		frames_.back().bytes_ += consumed;
+
+		return offset;
+	}
+
+	inline uint64_t getCapacity() const { return capacity_; }
+	inline uint64_t getUsedBytes() const { return usedBytes_; }
+	inline uint64_t getHead() const { return head_; }
+	inline uint64_t getTail() const { return tail_; }
+	inline uint32_t getFramesInFlight() const { return framesInFlight_; }
+
+	static inline uint64_t alignUp(uint64_t value, uint64_t alignment)
+	{
+		return (alignment > 1) ? ((value + alignment - 1) / alignment) * alignment : value;
+	}
+
+private:
+	struct FrameRecord
+	{
+		uint64_t end_;   // head position after the last allocation of this frame
+		uint64_t bytes_; // bytes consumed by this frame (including alignment padding and wrapped tails)
+	};
+
+	uint64_t capacity_ = 0;
+	uint32_t framesInFlight_ = 1;
+
+	uint64_t head_ = 0;
+	uint64_t tail_ = 0;
+	uint64_t usedBytes_ = 0;
+
+	std::deque<FrameRecord> frames_;
+};
@@ -0,0 +1,156 @@
+#include "shared/ShadowCasterCuller.h"
+
+#include <string.h>
+
+void ShadowCasterCuller::setShapes(const std::vector<BoundingBox>& boxes, const std::vector<int>& casters, const std::vector<int>& receivers)
+{
+	boxes_ = boxes;
+	casters_ = casters;
+	receivers_ = receivers;
+	visibleReceivers_ = receivers;
+
+	lightBoxesValid_ = false;
+	version_++;
+}
+
+void ShadowCasterCuller::updateBox(int shape, const BoundingBox& box)
+{
+	boxes_[shape] = box;
+
+	if (lightBoxesValid_)
+		lightBoxes_[shape] = box.getTransformed(lightView_);
+
+	version_++;
+}
+
+void ShadowCasterCuller::setLight(const glm::mat4& lightView)
+{
+	if (lightBoxesValid_ && !memcmp(&lightView, &lightView_, sizeof(glm::mat4)))
+		return;
+
+	lightView_ = lightView;
+
+	lightBoxes_.resize(boxes_.size());
+
+	for (size_t i = 0 ; i != boxes_.size() ; i++)
+		lightBoxes_[i] = boxes_[i].getTransformed(lightView);
+
+	lightBoxesValid_ = true;
+}
+
+void ShadowCasterCuller::setCamera(const glm::mat4& cameraViewProj)
+{
+	vec4 planes[6];
+	vec4 corners[8];
+	getFrustumPlanes(cameraViewProj, planes);
+	getFrustumCorners(cameraViewProj, corners);
+
+	visibleReceivers_.clear();
+
+	for (int i: receivers_)
+		if (isBoxInFrustum(planes, corners, boxes_[i]))
+			visibleReceivers_.push_back(i);
+}
+
+uint32_t ShadowCasterCuller::cull(const glm::mat4& lightProj, bool useReceivers, std::vector<uint8_t>& visible, ShadowCasterCullingStats* stats) const
+{
+	visible.assign(boxes_.size(), 0);
+
+	ShadowCasterCullingStats s;
+	s.numCasters_ = (uint32_t)casters_.size();
+
+	vec4 planes[6];
+	vec4 corners[8];
+	getFrustumPlanes(lightProj * lightView_, planes);
+	getFrustumCorners(lightProj * lightView_, corners);
+
+	// light-space bounds of the receivers inside this light frustum
+	BoundingBox receivers;
+	receivers.min_ = vec3(std::numeric_limits<float>::max());
+	receivers.max_ = vec3(std::numeric_limits<float>::lowest());
+	bool hasReceivers = false;
+
+	if (useReceivers)
+	{
+		for (int i: visibleReceivers_)
+		{
+			if (!isBoxInFrustum(planes, corners, boxes_[i]))
+				continue;
+
+			receivers.combinePoint(lightBoxes_[i].min_);
+			receivers.combinePoint(lightBoxes_[i].max_);
+			hasReceivers = true;
+		}
+	}
+
+	for (int i: casters_)
+	{
+		if (!isBoxInFrustum(planes, corners, boxes_[i]))
+		{
+			s.numOutsideLightFrustum_++;
+			continue;
+		}
+
+		if (useReceivers)
+		{
+			const BoundingBox& b = lightBoxes_[i];
+
+			// the receivers' box is extruded towards the light (+Z), so only the far side of it is checked
+			const bool overlaps = hasReceivers &&
+				b.max_.x >= receivers.min_.x && b.min_.x <= receivers.max_.x &&
+				b.max_.y >= receivers.min_.y && b.min_.y <= receivers.max_.y &&
+				b.max_.z >= receivers.min_.z;
+
+			if (!overlaps)
+			{
+				s.numOutsideReceivers_++;
+				continue;
+			}
+		}
+
+		visible[i] = 1;
+		s.numVisible_++;
+	}
+
+	if (stats)
+		*stats = s;
+
+	return s.numVisible_;
+}
+
+uint64_t hashShadowCasters(const std::vector<uint8_t>& visible)
+{
+	// FNV-1a over the indices of the visible shapes
+	uint64_t hash = 14695981039346656037ull;
+
+	for (size_t i = 0 ; i != visible.size() ; i++)
+	{
+		if (!visible[i])
+			continue;
+
+		hash ^= (uint64_t)i;
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+bool ShadowMapCache::update(const glm::mat4& lightViewProj, uint64_t castersHash, uint32_t castersVersion)
+{
+	if (valid_ &&
+		!memcmp(&lightViewProj, &lightViewProj_, sizeof(glm::mat4)) &&
+		castersHash == castersHash_ &&
+		castersVersion == castersVersion_)
+	{
+		numSkipped_++;
+		return false;
+	}
+
+	valid_ = true;
+	lightViewProj_ = lightViewProj;
+	castersHash_ = castersHash;
+	castersVersion_ = castersVersion;
+
+	numUpdates_++;
+	return true;
+}
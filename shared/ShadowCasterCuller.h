@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "shared/UtilsMath.h"
+
+/**
+	Shadow caster culling (no GPU dependencies)
+
+	A shape is drawn into a shadow map if
+	  - its material casts shadows (sMaterialFlags_CastShadow, the caller builds the list of casters),
+	  - its box intersects the light frustum of the shadow map,
+	  - optionally, it can shadow a receiver visible from the camera: in light space (the light looks along -Z)
+	    the receivers are bounded by a box which is extruded towards the light, a caster has to overlap
+	    this box in XY and must not be entirely behind it.
+	The receivers are found per shadow map (inside both the camera and the light frustum), so every cascade
+	keeps only the casters between the light and its own part of the view.
+*/
+
+struct ShadowCasterCullingStats
+{
+	uint32_t numCasters_ = 0;
+	uint32_t numOutsideLightFrustum_ = 0;
+	uint32_t numOutsideReceivers_ = 0;
+	uint32_t numVisible_ = 0;
+};
+
+struct ShadowCasterCuller final
+{
+	/* World-space boxes of all shapes, 'casters' and 'receivers' are indices into 'boxes' */
+	void setShapes(const std::vector<BoundingBox>& boxes, const std::vector<int>& casters, const std::vector<int>& receivers);
+
+	/* For moving shapes: the next cull() sees the new box, getVersion() changes */
+	void updateBox(int shape, const BoundingBox& box);
+
+	/* Light-space boxes are recomputed only if 'lightView' changes */
+	void setLight(const glm::mat4& lightView);
+
+	/* Receivers are considered only if they are visible from the camera. Same space as the boxes */
+	void setCamera(const glm::mat4& cameraViewProj);
+
+	/*
+		Marks the casters of the shadow map with the light frustum lightProj * lightView in 'visible' (indexed by shape,
+		all other elements are set to 0). Returns the number of casters to draw
+	*/
+	uint32_t cull(const glm::mat4& lightProj, bool useReceivers, std::vector<uint8_t>& visible, ShadowCasterCullingStats* stats = nullptr) const;
+
+	/* Incremented when a box changes */
+	inline uint32_t getVersion() const { return version_; }
+
+private:
+	std::vector<BoundingBox> boxes_;
+	std::vector<BoundingBox> lightBoxes_;
+
+	std::vector<int> casters_;
+	std::vector<int> receivers_;
+	// receivers inside the camera frustum
+	std::vector<int> visibleReceivers_;
+
+	glm::mat4 lightView_ = glm::mat4(0.0f);
+	bool lightBoxesValid_ = false;
+
+	uint32_t version_ = 0;
+};
+
+/* Hash of the set of casters marked in 'visible' */
+uint64_t hashShadowCasters(const std::vector<uint8_t>& visible);
+
+/**
+	Static shadow map cache
+
+	A shadow map keeps its contents between frames and is re-rendered only if its light matrix, the set of casters
+	or any caster's transform (see ShadowCasterCuller::getVersion()) changes.
+*/
+struct ShadowMapCache
+{
+	/* Returns true if the shadow map has to be rendered this frame; counts the updates and skipped frames */
+	bool update(const glm::mat4& lightViewProj, uint64_t castersHash, uint32_t castersVersion);
+
+	inline void invalidate() { valid_ = false; }
+
+	uint32_t numUpdates_ = 0;
+	uint32_t numSkipped_ = 0;
+
+private:
+	bool valid_ = false;
+
+	glm::mat4 lightViewProj_ = glm::mat4(0.0f);
+	uint64_t castersHash_ = 0;
+	uint32_t castersVersion_ = 0;
+};
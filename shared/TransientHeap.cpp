@@ -0,0 +1,106 @@
+#include "shared/TransientHeap.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <numeric>
+
+static uint64_t alignOffset(uint64_t offset, uint64_t alignment)
+{
+	return (alignment > 1) ? (offset + alignment - 1) / alignment * alignment : offset;
+}
+
+TransientHeapLayout planTransientHeap(const std::vector<TransientAllocation>& allocations, bool alias)
+{
+	TransientHeapLayout layout;
+	layout.offsets_.resize(allocations.size(), 0);
+
+	std::vector<size_t> order(allocations.size());
+	std::iota(order.begin(), order.end(), 0);
+
+	std::stable_sort(order.begin(), order.end(), [&allocations](size_t a, size_t b) { return allocations[a].size_ > allocations[b].size_; });
+
+	std::vector<size_t> placed;
+	placed.reserve(allocations.size());
+
+	// memory ranges [begin, end) of placed resources which are alive at the same time as the current one
+	std::vector<std::pair<uint64_t, uint64_t>> busy;
+
+	for (auto i: order)
+	{
+		const TransientAllocation& a = allocations[i];
+
+		layout.unaliasedSize_ = alignOffset(layout.unaliasedSize_, a.alignment_) + a.size_;
+
+		busy.clear();
+
+		for (auto j: placed)
+			if (!alias || lifetimesOverlap(a, allocations[j]))
+				busy.emplace_back(layout.offsets_[j], layout.offsets_[j] + allocations[j].size_);
+
+		std::sort(busy.begin(), busy.end());
+
+		uint64_t offset = 0;
+
+		for (const auto& b: busy)
+		{
+			offset = alignOffset(offset, a.alignment_);
+
+			if (offset + a.size_ <= b.first)
+				break;
+
+			offset = std::max(offset, b.second);
+		}
+
+		offset = alignOffset(offset, a.alignment_);
+
+		layout.offsets_[i] = offset;
+		layout.heapSize_ = std::max(layout.heapSize_, offset + a.size_);
+
+		placed.push_back(i);
+	}
+
+	return layout;
+}
+
+void printTransientMemoryReport(const char* chainName, const std::vector<TransientTarget>& targets)
+{
+	struct Resolution { const char* name; uint32_t width, height; };
+
+	static const Resolution resolutions[] = {
+		{ "720p",  1280,  720 },
+		{ "1080p", 1920, 1080 },
+		{ "1440p", 2560, 1440 },
+		{ "4K",    3840, 2160 }
+	};
+
+	printf("%s: %u transient render targets\n", chainName, (uint32_t)targets.size());
+	printf("  %-8s %12s %12s %12s\n", "", "separate", "aliased", "saved");
+
+	std::vector<TransientAllocation> allocations(targets.size());
+
+	for (const auto& r: resolutions)
+	{
+		for (size_t i = 0 ; i != targets.size() ; i++)
+		{
+			const TransientTarget& t = targets[i];
+			const uint64_t w = t.width_  ? t.width_  : std::max(r.width  / t.divisor_, 1u);
+			const uint64_t h = t.height_ ? t.height_ : std::max(r.height / t.divisor_, 1u);
+
+			allocations[i] = TransientAllocation {
+				.size_ = w * h * t.bytesPerPixel_,
+				.alignment_ = 1,
+				.firstStep_ = t.firstStep_,
+				.lastStep_ = t.lastStep_
+			};
+		}
+
+		const TransientHeapLayout layout = planTransientHeap(allocations);
+
+		const double MB = 1024.0 * 1024.0;
+		const double separate = (double)layout.unaliasedSize_ / MB;
+		const double aliased = (double)layout.heapSize_ / MB;
+
+		printf("  %-8s %9.1f MB %9.1f MB %9.1f MB (%.0f%%)\n", r.name, separate, aliased, separate - aliased,
+			(separate > 0.0) ? 100.0 * (separate - aliased) / separate : 0.0);
+	}
+}
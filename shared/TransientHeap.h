@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+/**
+	Memory aliasing for transient render targets (no GPU dependencies)
+
+	Every resource has a size, an alignment and a lifetime, i.e. the range of steps of a compiled RenderGraph
+	in which it is used (see RenderGraph::getResourceLifetime()).
+	Resources with disjoint lifetimes can share the same memory, so the heap only has to be as large
+	as the peak of simultaneously alive resources instead of their sum.
+*/
+
+struct TransientAllocation
+{
+	uint64_t size_ = 0;
+	uint64_t alignment_ = 1;
+
+	/* Inclusive step range; firstStep_ > lastStep_ means "never used" (the resource can overlap anything) */
+	uint32_t firstStep_ = 0;
+	uint32_t lastStep_ = 0;
+};
+
+struct TransientHeapLayout
+{
+	std::vector<uint64_t> offsets_;
+
+	uint64_t heapSize_ = 0;
+
+	/* Memory required without aliasing (every resource in its own block) */
+	uint64_t unaliasedSize_ = 0;
+};
+
+inline bool lifetimesOverlap(const TransientAllocation& a, const TransientAllocation& b)
+{
+	if (a.firstStep_ > a.lastStep_ || b.firstStep_ > b.lastStep_)
+		return false;
+
+	return a.firstStep_ <= b.lastStep_ && b.firstStep_ <= a.lastStep_;
+}
+
+/*
+	Greedy first-fit: the largest resources are placed first, each one at the lowest offset
+	which does not intersect the memory of an already placed resource with an overlapping lifetime.
+	With 'alias' set to false all lifetimes are treated as overlapping (a plain linear layout).
+*/
+TransientHeapLayout planTransientHeap(const std::vector<TransientAllocation>& allocations, bool alias = true);
+
+/* Render target description for the memory report: zero width/height stand for the output resolution divided by 'divisor_' */
+struct TransientTarget
+{
+	uint32_t width_ = 0;
+	uint32_t height_ = 0;
+	uint32_t divisor_ = 1;
+	uint32_t bytesPerPixel_ = 4;
+
+	uint32_t firstStep_ = 0;
+	uint32_t lastStep_ = 0;
+};
+
+/* Print the memory of a chain of transient targets with and without aliasing at common output resolutions (720p ... 4K) */
+void printTransientMemoryReport(const char* chainName, const std::vector<TransientTarget>& targets);
@@ -178,3 +178,79 @@ inline BoundingBox combineBoxes(const std::vector<BoundingBox>& boxes)
 
 	return BoundingBox(allPoints.data(), allPoints.size());
 }
+
+/*
+	Cascaded shadow maps: the "practical" split scheme, a blend of logarithmic and uniform splits
+	(lambda = 0 is uniform, lambda = 1 is logarithmic). 'splits' receives numCascades + 1 view-space distances from nearZ to farZ
+*/
+inline void getCascadeSplits(float nearZ, float farZ, uint32_t numCascades, float lambda, float* splits)
+{
+	for (uint32_t i = 0; i <= numCascades; i++)
+	{
+		const float p = (float)i / (float)numCascades;
+		const float logSplit = nearZ * std::pow(farZ / nearZ, p);
+		const float uniformSplit = nearZ + (farZ - nearZ) * p;
+		splits[i] = lambda * logSplit + (1.0f - lambda) * uniformSplit;
+	}
+
+	splits[0] = nearZ;
+	splits[numCascades] = farZ;
+}
+
+/*
+	Corners of the part of a perspective frustum between the view-space distances splitNear and splitFar.
+	'frustumCorners' come from getFrustumCorners() for a projection with the near/far planes nearZ/farZ
+*/
+inline void getFrustumSliceCorners(const glm::vec4* frustumCorners, float nearZ, float farZ, float splitNear, float splitFar, glm::vec3* sliceCorners)
+{
+	const float t0 = (splitNear - nearZ) / (farZ - nearZ);
+	const float t1 = (splitFar - nearZ) / (farZ - nearZ);
+
+	// corners 0..3 are on the near plane, 4..7 are the corresponding far plane corners (the same rays from the eye)
+	for (int i = 0; i != 4; i++)
+	{
+		const vec3 n = vec3(frustumCorners[i]);
+		const vec3 f = vec3(frustumCorners[i + 4]);
+		sliceCorners[i]     = glm::mix(n, f, t0);
+		sliceCorners[i + 4] = glm::mix(n, f, t1);
+	}
+}
+
+/*
+	Orthographic projection (used with lightView) of a shadow cascade covering the frustum slice.
+
+	The projection is fitted to the bounding sphere of the slice, so its size does not change when the camera rotates,
+	and its origin is snapped to whole shadow map texels, so the shadows do not shimmer when the camera moves.
+	The depth range covers all of 'sceneBox' (world space) to keep the casters between the light and the slice
+*/
+inline glm::mat4 getCascadeProjection(const glm::vec3* sliceCorners, const glm::mat4& lightView, const BoundingBox& sceneBox, uint32_t resolution)
+{
+	vec3 center(0.0f);
+	for (int i = 0; i != 8; i++)
+		center += sliceCorners[i];
+	center /= 8.0f;
+
+	float radius = 0.0f;
+	for (int i = 0; i != 8; i++)
+		radius = glm::max(radius, glm::length(sliceCorners[i] - center));
+
+	// round the radius up, so that float noise does not change the texel size from frame to frame
+	radius = std::ceil(radius * 16.0f) / 16.0f;
+
+	const float texelSize = 2.0f * radius / (float)resolution;
+
+	vec3 origin = vec3(lightView * vec4(center, 1.0f));
+	origin.x = std::floor(origin.x / texelSize) * texelSize;
+	origin.y = std::floor(origin.y / texelSize) * texelSize;
+
+	const BoundingBox box = sceneBox.getTransformed(lightView);
+
+	return glm::ortho(origin.x - radius, origin.x + radius, origin.y - radius, origin.y + radius, -box.max_.z, -box.min_.z);
+}
+
+/* Near and far planes of a glm::perspective() projection */
+inline void getPerspectiveNearFar(const glm::mat4& proj, float& nearZ, float& farZ)
+{
+	nearZ = proj[3][2] / (proj[2][2] - 1.0f);
+	farZ  = proj[3][2] / (proj[2][2] + 1.0f);
+}
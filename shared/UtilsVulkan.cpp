@@ -427,7 +427,7 @@ VkResult createDevice2(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures
 	return vkCreateDevice(physicalDevice, &ci, nullptr, device);
 }
 
-VkResult createDevice2WithCompute(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures2 deviceFeatures2, uint32_t graphicsFamily, uint32_t computeFamily, VkDevice* device)
+VkResult createDevice2WithCompute(VkPhysicalDevice physicalDevice, VkPhysicalDeviceFeatures2 deviceFeatures2, uint32_t graphicsFamily, uint32_t computeFamily, uint32_t transferFamily, VkDevice* device)
 {
 	const std::vector<const char*> extensions =
 	{
@@ -438,39 +438,36 @@ VkResult createDevice2WithCompute(VkPhysicalDevice physicalDevice, VkPhysicalDev
 		VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME
 	};
 
-	if (graphicsFamily == computeFamily)
+	if (graphicsFamily == computeFamily && graphicsFamily == transferFamily)
 		return createDevice2(physicalDevice, deviceFeatures2, graphicsFamily, device);
 
-	const float queuePriorities[2] = { 0.f, 0.f };
-	const VkDeviceQueueCreateInfo qciGfx =
-	{
-		.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-		.pNext = nullptr,
-		.flags = 0,
-		.queueFamilyIndex = graphicsFamily,
-		.queueCount = 1,
-		.pQueuePriorities = &queuePriorities[0]
-	};
+	const float queuePriorities[3] = { 0.f, 0.f, 0.f };
 
-	const VkDeviceQueueCreateInfo qciComp =
+	// one queue per unique family: graphics, compute and (optionally) a dedicated transfer queue
+	std::vector<VkDeviceQueueCreateInfo> qci;
+
+	for (uint32_t family: { graphicsFamily, computeFamily, transferFamily })
 	{
-		.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-		.pNext = nullptr,
-		.flags = 0,
-		.queueFamilyIndex = computeFamily,
-		.queueCount = 1,
-		.pQueuePriorities = &queuePriorities[1]
-	};
+		if (std::find_if(qci.begin(), qci.end(), [family](const auto& q) { return q.queueFamilyIndex == family; }) != qci.end())
+			continue;
 
-	const VkDeviceQueueCreateInfo qci[2] = { qciGfx, qciComp };
+		qci.push_back(VkDeviceQueueCreateInfo {
+			.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.queueFamilyIndex = family,
+			.queueCount = 1,
+			.pQueuePriorities = &queuePriorities[qci.size()]
+		});
+	}
 
 	const VkDeviceCreateInfo ci =
 	{
 		.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
 		.pNext = &deviceFeatures2,
 		.flags = 0,
-		.queueCreateInfoCount = 2,
-		.pQueueCreateInfos = qci,
+		.queueCreateInfoCount = static_cast<uint32_t>(qci.size()),
+		.pQueueCreateInfos = qci.data(),
 		.enabledLayerCount = 0,
 		.ppEnabledLayerNames = nullptr,
 		.enabledExtensionCount = static_cast<uint32_t>(extensions.size()),
@@ -763,7 +760,9 @@ bool initVulkanRenderDevice2WithCompute(VulkanInstance& vk, VulkanRenderDevice&
 //	VK_CHECK(createDevice2(vkDev.physicalDevice, deviceFeatures2, vkDev.graphicsFamily, &vkDev.device));
 //	VK_CHECK(vkGetBestComputeQueue(vkDev.physicalDevice, &vkDev.computeFamily));
 	vkDev.computeFamily = findQueueFamilies(vkDev.physicalDevice, VK_QUEUE_COMPUTE_BIT);
-	VK_CHECK(createDevice2WithCompute(vkDev.physicalDevice, deviceFeatures2, vkDev.graphicsFamily, vkDev.computeFamily, &vkDev.device));
+	if (!findDedicatedTransferFamily(vkDev.physicalDevice, &vkDev.transferFamily))
+		vkDev.transferFamily = vkDev.graphicsFamily;
+	VK_CHECK(createDevice2WithCompute(vkDev.physicalDevice, deviceFeatures2, vkDev.graphicsFamily, vkDev.computeFamily, vkDev.transferFamily, &vkDev.device));
 
 	vkGetDeviceQueue(vkDev.device, vkDev.graphicsFamily, 0, &vkDev.graphicsQueue);
 	if (vkDev.graphicsQueue == nullptr)
@@ -773,6 +772,10 @@ bool initVulkanRenderDevice2WithCompute(VulkanInstance& vk, VulkanRenderDevice&
 	if (vkDev.computeQueue == nullptr)
 		exit(EXIT_FAILURE);
 
+	vkGetDeviceQueue(vkDev.device, vkDev.transferFamily, 0, &vkDev.transferQueue);
+	if (vkDev.transferQueue == nullptr)
+		exit(EXIT_FAILURE);
+
 	VkBool32 presentSupported = 0;
 	vkGetPhysicalDeviceSurfaceSupportKHR(vkDev.physicalDevice, vkDev.graphicsFamily, vk.surface, &presentSupported);
 	if (!presentSupported)
@@ -1054,6 +1057,29 @@ uint32_t findQueueFamilies(VkPhysicalDevice device, VkQueueFlags desiredFlags)
 	return 0;
 }
 
+bool findDedicatedTransferFamily(VkPhysicalDevice device, uint32_t* transferFamily)
+{
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, nullptr);
+
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, families.data());
+
+	// DMA engines are exposed as transfer-only families
+	for (uint32_t i = 0; i != families.size(); i++)
+	{
+		const VkQueueFlags maskedFlags = families[i].queueFlags & ~VK_QUEUE_SPARSE_BINDING_BIT;
+
+		if (families[i].queueCount > 0 && (maskedFlags & VK_QUEUE_TRANSFER_BIT) && !(maskedFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+		{
+			*transferFamily = i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
 VkFormat findSupportedFormat(VkPhysicalDevice device, const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features) {
 	for (VkFormat format : candidates) {
 		VkFormatProperties props;
@@ -58,6 +58,10 @@ struct VulkanRenderDevice final
 
 	VkCommandBuffer computeCommandBuffer;
 	VkCommandPool computeCommandPool;
+
+	// Dedicated transfer queue for batched uploads (see VulkanUploader) [may coincide with graphicsFamily]
+	uint32_t transferFamily = 0;
+	VkQueue transferQueue = nullptr;
 };
 
 // Features we need for our Vulkan context
@@ -206,6 +210,9 @@ VkResult findSuitablePhysicalDevice(VkInstance instance, std::function<bool(VkPh
 
 uint32_t findQueueFamilies(VkPhysicalDevice device, VkQueueFlags desiredFlags);
 
+/* Look for a transfer-only queue family (no graphics/compute), i.e. a DMA engine */
+bool findDedicatedTransferFamily(VkPhysicalDevice device, uint32_t* transferFamily);
+
 VkFormat findSupportedFormat(VkPhysicalDevice device, const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 
 uint32_t findMemoryType(VkPhysicalDevice device, uint32_t typeFilter, VkMemoryPropertyFlags properties);
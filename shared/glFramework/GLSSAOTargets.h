@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+
+#include "shared/glFramework/GLShader.h"
+#include "shared/glFramework/GLTexture.h"
+#include "shared/glFramework/GLFramebuffer.h"
+
+/**
+	SSAO render targets at 1/downsample of the framebuffer size
+
+	Depth is downsampled with a checkerboard min/max filter (see GL02_SSAODownsampleDepth.frag), SSAO and blur run
+	at the lower resolution and GL02_SSAO_combine.frag upsamples the result with a depth-aware bilateral filter
+*/
+struct SSAOTargets
+{
+	SSAOTargets(int width, int height, int downsample)
+	: downsample_(downsample)
+	, depth(std::max(width / downsample, 1), std::max(height / downsample, 1), GL_R32F, 0)
+	, ssao(std::max(width / downsample, 1), std::max(height / downsample, 1), GL_RGBA8, 0)
+	, blur(std::max(width / downsample, 1), std::max(height / downsample, 1), GL_RGBA8, 0)
+	{
+		// min and max depths alternate, so they are never interpolated
+		glTextureParameteri(depth.getTextureColor().getHandle(), GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(depth.getTextureColor().getHandle(), GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	}
+
+	/* Depth texture for the SSAO pass: 'fullResDepth' itself without downsampling */
+	GLuint downsampleDepth(const GLProgram& progDownsample, GLuint fullResDepth)
+	{
+		if (downsample_ == 1)
+			return fullResDepth;
+
+		depth.bind();
+		progDownsample.useProgram();
+		glBindTextureUnit(0, fullResDepth);
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+		depth.unbind();
+
+		return depth.getTextureColor().getHandle();
+	}
+
+	const int downsample_;
+
+	GLFramebuffer depth;
+	GLFramebuffer ssao;
+	GLFramebuffer blur;
+};
@@ -1,41 +1,211 @@
-﻿#include "GLSceneData.h"
+﻿#include <string.h>
 
-static uint64_t getTextureHandleBindless(uint64_t idx, const std::vector<GLTexture>& textures)
+#include "GLSceneData.h"
+#include <stb/stb_image.h>
+
+static uint64_t getTextureHandleBindless(uint64_t idx, const std::vector<std::shared_ptr<GLTexture>>& textures)
 {
 	if (idx == INVALID_TEXTURE) return 0;
 
-	return textures[idx].getHandleBindless();
+	return textures[idx]->getHandleBindless();
 }
 
 GLSceneData::GLSceneData(
 	const char* meshFile,
 	const char* sceneFile,
-	const char* materialFile)
+	const char* materialFile,
+	bool asyncLoad)
+{
+	const double startupUs = startupTrace_.getTimeUs();
+
+	tf::Taskflow materialsTask;
+	materialsTask.emplace([&]()
+		{
+			const double t = startupTrace_.getTimeUs();
+			loadMaterials(materialFile, materialsLoaded_, textureFiles_);
+			startupTrace_.addEvent("Read materials", "startup", getTraceLane(), t);
+		});
+
+	tf::Taskflow meshesTask;
+	meshesTask.emplace([&]()
+		{
+			const double t = startupTrace_.getTimeUs();
+			header_ = loadMeshData(meshFile, meshData_);
+			startupTrace_.addEvent("Read meshes", "startup", getTraceLane(), t);
+		});
+
+	tf::Taskflow sceneTask;
+	sceneTask.emplace([&]()
+		{
+			const double t = startupTrace_.getTimeUs();
+			::loadScene(sceneFile, scene_);
+			// parents precede their children, so global transforms are updated in one linear pass
+			sortSceneByDepth(scene_);
+			startupTrace_.addEvent("Read scene", "startup", getTraceLane(), t);
+		});
+
+	auto materialsLoaded = executor_.run(materialsTask);
+	auto meshesLoaded = executor_.run(meshesTask);
+	auto sceneLoaded = executor_.run(sceneTask);
+
+	materialsLoaded.wait();
+
+	const uint32_t numTextures = (uint32_t)textureFiles_.size();
+
+	loadedFiles_.reserve(numTextures);
+
+	taskflow_.for_each_index(0u, numTextures, 1u, [this](int idx)
+		{
+			const double t = startupTrace_.getTimeUs();
+			const char* ext = strrchr(textureFiles_[idx].c_str(), '.');
+			int w = 0;
+			int h = 0;
+			uint8_t* img = (ext && !strcmp(ext, ".ktx")) ? nullptr : stbi_load(textureFiles_[idx].c_str(), &w, &h, nullptr, STBI_rgb_alpha);
+			startupTrace_.addEvent("Decode " + textureFiles_[idx], "texture", getTraceLane(), t);
+			{
+				std::lock_guard lock(loadedFilesMutex_);
+				loadedFiles_.emplace_back(LoadedImageData { .index_ = idx, .w_ = w, .h_ = h, .img_ = img });
+			}
+			loadedFilesCV_.notify_one();
+		});
+
+	executor_.run(taskflow_);
+
+	meshesLoaded.wait();
+	sceneLoaded.wait();
+
+	double t = startupTrace_.getTimeUs();
+	createShapes();
+	startupTrace_.addEvent("Shapes and transforms", "startup", 0, t);
+
+	t = startupTrace_.getTimeUs();
+
+	// decoded textures replace these later (see uploadLoadedTextures())
+	allMaterialTextures_.assign(numTextures, dummyTexture_);
+
+	if (!asyncLoad)
+	{
+		// GL calls stay on this thread, the textures are created in the order they are decoded
+		for (uint32_t i = 0 ; i != numTextures ; i++)
+		{
+			LoadedImageData data;
+
+			{
+				std::unique_lock lock(loadedFilesMutex_);
+				loadedFilesCV_.wait(lock, [this]() { return !loadedFiles_.empty(); });
+				data = loadedFiles_.back();
+				loadedFiles_.pop_back();
+			}
+
+			uploadTexture(data);
+		}
+	}
+
+	startupTrace_.addEvent(asyncLoad ? "Placeholder textures" : "Textures", "startup", 0, t);
+
+	updateMaterials();
+
+	startupTrace_.addEvent("GLSceneData", "startup", 0, startupUs);
+}
+
+GLSceneData::~GLSceneData()
+{
+	executor_.wait_for_all();
+
+	// decoded but never uploaded
+	for (const auto& data: loadedFiles_)
+		stbi_image_free(data.img_);
+}
+
+bool GLSceneData::uploadLoadedTextures()
 {
-	header_ = loadMeshData(meshFile, meshData_);
-	loadScene(sceneFile);
+	LoadedImageData data;
+
+	{
+		std::lock_guard lock(loadedFilesMutex_);
 
-	std::vector<std::string> textureFiles;
-	loadMaterials(materialFile, materials_, textureFiles);
+		if (loadedFiles_.empty())
+			return false;
 
-	for (const auto& f: textureFiles) {
-		allMaterialTextures_.emplace_back(GL_TEXTURE_2D, f.c_str());
+		data = loadedFiles_.back();
+
+		loadedFiles_.pop_back();
 	}
 
-	for (auto& mtl: materials_)
+	uploadTexture(data);
+
+	updateMaterials();
+
+	return true;
+}
+
+void GLSceneData::uploadTexture(const LoadedImageData& data)
+{
+	const double t = startupTrace_.getTimeUs();
+
+	if (data.img_)
+	{
+		allMaterialTextures_[data.index_] = std::make_shared<GLTexture>(data.w_, data.h_, data.img_);
+		stbi_image_free(data.img_);
+	}
+	else
+	{
+		allMaterialTextures_[data.index_] = std::make_shared<GLTexture>(GL_TEXTURE_2D, textureFiles_[data.index_].c_str());
+	}
+
+	startupTrace_.addEvent("Upload " + textureFiles_[data.index_], "texture", 0, t);
+
+	if (++numResidentTextures_ == textureFiles_.size())
+		startupTrace_.addEvent("All textures resident", "startup", 0, 0.0);
+}
+
+void GLSceneData::updateMaterials()
+{
+	const size_t numMaterials = materialsLoaded_.size();
+
+	materials_.resize(numMaterials);
+
+	for (size_t i = 0 ; i != numMaterials ; i++)
 	{
-		mtl.ambientOcclusionMap_ = getTextureHandleBindless(mtl.ambientOcclusionMap_, allMaterialTextures_);
-		mtl.emissiveMap_ = getTextureHandleBindless(mtl.emissiveMap_, allMaterialTextures_);
-		mtl.albedoMap_ = getTextureHandleBindless(mtl.albedoMap_, allMaterialTextures_);
-		mtl.metallicRoughnessMap_ = getTextureHandleBindless(mtl.metallicRoughnessMap_, allMaterialTextures_);
-		mtl.normalMap_ = getTextureHandleBindless(mtl.normalMap_, allMaterialTextures_);
+		const auto& in = materialsLoaded_[i];
+		auto& out = materials_[i];
+		out = in;
+		out.ambientOcclusionMap_ = getTextureHandleBindless(in.ambientOcclusionMap_, allMaterialTextures_);
+		out.emissiveMap_ = getTextureHandleBindless(in.emissiveMap_, allMaterialTextures_);
+		out.albedoMap_ = getTextureHandleBindless(in.albedoMap_, allMaterialTextures_);
+		out.metallicRoughnessMap_ = getTextureHandleBindless(in.metallicRoughnessMap_, allMaterialTextures_);
+		out.normalMap_ = getTextureHandleBindless(in.normalMap_, allMaterialTextures_);
 	}
 }
 
+uint32_t GLSceneData::getTraceLane() const
+{
+	// 0 is the thread which has created the scene data
+	return (uint32_t)(executor_.this_worker_id() + 1);
+}
+
+bool GLSceneData::writeStartupTrace(const char* fileName) const
+{
+	std::vector<std::string> lanes = { "Main thread" };
+
+	for (size_t i = 0 ; i != executor_.num_workers() ; i++)
+		lanes.push_back("Worker " + std::to_string(i));
+
+	return startupTrace_.write(fileName, lanes);
+}
+
 void GLSceneData::loadScene(const char* sceneFile)
 {
 	::loadScene(sceneFile, scene_);
 
+	// parents precede their children, so global transforms are updated in one linear pass
+	sortSceneByDepth(scene_);
+
+	createShapes();
+}
+
+void GLSceneData::createShapes()
+{
 	// prepare draw data buffer
 	for (const auto& c: scene_.meshes_)
 	{
@@ -54,7 +224,9 @@ void GLSceneData::loadScene(const char* sceneFile)
 		}
 	}
 
+	// instances of the same mesh and material become adjacent draw commands
+	sortDrawDataForInstancing(shapes_);
+
 	// force recalculation of all global transformations
-	markAsChanged(scene_, 0);
-	recalculateGlobalTransforms(scene_);
+	recalculateAllGlobalTransforms(scene_);
 }
@@ -1,27 +1,76 @@
 ﻿#pragma once
 
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+
 #include "shared/scene/Scene.h"
 #include "shared/scene/Material.h"
 #include "shared/scene/VtxData.h"
 #include "shared/glFramework/GLShader.h"
 #include "shared/glFramework/GLTexture.h"
+#include "shared/ChromeTrace.h"
+#include <taskflow/taskflow.hpp>
 
 class GLSceneData
 {
 public:
+	/* The three files are read concurrently and the textures are decoded on worker threads. With 'asyncLoad' the constructor
+	   returns with placeholder textures and uploadLoadedTextures() swaps in the decoded ones, otherwise this thread creates
+	   the GL textures in the order they are decoded. Every phase is recorded into 'startupTrace_' (see writeStartupTrace()) */
 	GLSceneData(
 		const char* meshFile,
 		const char* sceneFile,
-		const char* materialFile);
+		const char* materialFile,
+		bool asyncLoad = false);
+	~GLSceneData();
+
+	const std::shared_ptr<GLTexture> dummyTexture_ = std::make_shared<GLTexture>(GL_TEXTURE_2D, "data/const1.bmp");
+
+	std::vector<std::string> textureFiles_;
+	std::vector<std::shared_ptr<GLTexture>> allMaterialTextures_;
 
-	std::vector<GLTexture> allMaterialTextures_;
+	uint32_t numResidentTextures_ = 0;
 
 	MeshFileHeader header_;
 	MeshData meshData_;
 
 	Scene scene_;
-	std::vector<MaterialDescription> materials_;
+	std::vector<MaterialDescription> materialsLoaded_; // materials loaded from scene
+	std::vector<MaterialDescription> materials_; // materials uploaded to GPU buffers
 	std::vector<DrawData> shapes_;
 
 	void loadScene(const char* sceneFile);
+
+	/* Creates one of the textures decoded since the last call and updates 'materials_' (upload them with GLMesh::updateMaterialsBuffer()).
+	   Returns false if there was nothing to upload */
+	bool uploadLoadedTextures();
+
+	/* Lane 0 is the thread which has created the scene data, the others are the loading threads */
+	CpuTraceRecorder startupTrace_;
+	bool writeStartupTrace(const char* fileName) const;
+
+private:
+	struct LoadedImageData
+	{
+		int index_ = 0;
+		int w_ = 0;
+		int h_ = 0;
+		// nullptr: the file is loaded by GLTexture itself (.ktx files and the fallback for broken files)
+		uint8_t* img_ = nullptr;
+	};
+
+	void createShapes();
+	void updateMaterials();
+	void uploadTexture(const LoadedImageData& data);
+
+	uint32_t getTraceLane() const;
+
+	std::vector<LoadedImageData> loadedFiles_;
+	std::mutex loadedFilesMutex_;
+	std::condition_variable loadedFilesCV_;
+
+	// the decoding tasks outlive the constructor, the executor waits for them when it is destroyed
+	tf::Taskflow taskflow_;
+	tf::Executor executor_;
 };
@@ -90,6 +90,9 @@ void GLSceneDataLazy::loadScene(const char* sceneFile)
 {
 	::loadScene(sceneFile, scene_);
 
+	// parents precede their children, so global transforms are updated in one linear pass
+	sortSceneByDepth(scene_);
+
 	// prepare draw data buffer
 	for (const auto& c: scene_.meshes_)
 	{
@@ -108,7 +111,9 @@ void GLSceneDataLazy::loadScene(const char* sceneFile)
 		}
 	}
 
+	// instances of the same mesh and material become adjacent draw commands
+	sortDrawDataForInstancing(shapes_);
+
 	// force recalculation of all global transformations
-	markAsChanged(scene_, 0);
-	recalculateGlobalTransforms(scene_);
+	recalculateAllGlobalTransforms(scene_);
 }
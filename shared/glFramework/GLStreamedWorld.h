@@ -0,0 +1,176 @@
+#pragma once
+
+#include <memory>
+
+#include "shared/glFramework/GLShader.h"
+#include "shared/scene/WorldStreaming.h"
+
+struct GLStreamedWorldStats
+{
+	// the last upload()
+	uint32_t numRanges_ = 0;
+	uint64_t uploadedBytes_ = 0;
+	// all the uploads
+	uint64_t totalUploadedBytes_ = 0;
+	uint32_t numDrawCommands_ = 0;
+};
+
+/**
+	GPU copies of the StreamedWorld vertex and index pools. The buffers are allocated once with the pool capacities,
+	sectors are uploaded into their ranges with glNamedBufferSubData() and indices stay relative to Mesh::vertexOffset,
+	so the streamed meshes are drawn with glMultiDrawElementsIndirect() like any other scene.
+	The draw commands, model matrices and materials are rebuilt when the scene changes, their buffers only grow.
+	Texture streaming is not handled here: the material texture handles are zero (see GL01_scene_IBL.frag)
+*/
+class GLStreamedWorldBuffers
+{
+public:
+	explicit GLStreamedWorldBuffers(const StreamedWorld& world)
+	: vertices_(std::max<GLsizeiptr>(world.meshData_.vertexData_.size() * sizeof(float), sizeof(float)), nullptr, GL_DYNAMIC_STORAGE_BIT)
+	, indices_(std::max<GLsizeiptr>(world.meshData_.indexData_.size() * sizeof(uint32_t), sizeof(uint32_t)), nullptr, GL_DYNAMIC_STORAGE_BIT)
+	{
+		glCreateVertexArrays(1, &vao_);
+		glVertexArrayElementBuffer(vao_, indices_.getHandle());
+		glVertexArrayVertexBuffer(vao_, 0, vertices_.getHandle(), 0, kVertexSize);
+		// position
+		glEnableVertexArrayAttrib(vao_, 0);
+		glVertexArrayAttribFormat(vao_, 0, 3, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribBinding(vao_, 0, 0);
+		// uv
+		glEnableVertexArrayAttrib(vao_, 1);
+		glVertexArrayAttribFormat(vao_, 1, 2, GL_FLOAT, GL_FALSE, sizeof(vec3));
+		glVertexArrayAttribBinding(vao_, 1, 0);
+		// normal
+		glEnableVertexArrayAttrib(vao_, 2);
+		glVertexArrayAttribFormat(vao_, 2, 3, GL_FLOAT, GL_TRUE, sizeof(vec3) + sizeof(vec2));
+		glVertexArrayAttribBinding(vao_, 2, 0);
+	}
+
+	~GLStreamedWorldBuffers()
+	{
+		glDeleteVertexArrays(1, &vao_);
+	}
+
+	GLStreamedWorldBuffers(const GLStreamedWorldBuffers&) = delete;
+
+	/* Only the ranges written by StreamedWorld::update() since the last call are uploaded */
+	void upload(StreamedWorld& world)
+	{
+		stats_.numRanges_ = 0;
+		stats_.uploadedBytes_ = 0;
+
+		for (const auto& u: world.takeUploads())
+		{
+			if (u.indices_)
+				glNamedBufferSubData(indices_.getHandle(), u.offset_ * sizeof(uint32_t), u.count_ * sizeof(uint32_t), &world.meshData_.indexData_[u.offset_]);
+			else
+				glNamedBufferSubData(vertices_.getHandle(), u.offset_ * kVertexSize, u.count_ * kVertexSize, &world.meshData_.vertexData_[u.offset_ * 8]);
+
+			stats_.numRanges_++;
+			stats_.uploadedBytes_ += u.count_ * (u.indices_ ? sizeof(uint32_t) : kVertexSize);
+		}
+
+		stats_.totalUploadedBytes_ += stats_.uploadedBytes_;
+	}
+
+	/* One command per mesh node, call after StreamedWorld::update() has returned true and global transforms are recalculated */
+	void updateDrawData(const StreamedWorld& world)
+	{
+		commands_.clear();
+		matrices_.clear();
+
+		for (const auto& c: world.scene_.meshes_)
+		{
+			const auto material = world.scene_.materialForNode_.find(c.first);
+			if (material == world.scene_.materialForNode_.end())
+				continue;
+
+			const Mesh& m = world.meshData_.meshes_[c.second];
+
+			commands_.push_back({
+				.count_ = m.getLODIndicesCount(0),
+				.instanceCount_ = 1,
+				.firstIndex_ = m.indexOffset,
+				.baseVertex_ = m.vertexOffset,
+				.baseInstance_ = material->second + ((uint32_t)matrices_.size() << 16)
+			});
+			matrices_.push_back(world.scene_.globalTransform_[c.first]);
+		}
+
+		materials_ = world.materials_;
+
+		for (auto& mtl: materials_)
+		{
+			mtl.ambientOcclusionMap_ = 0;
+			mtl.emissiveMap_ = 0;
+			mtl.albedoMap_ = 0;
+			mtl.metallicRoughnessMap_ = 0;
+			mtl.normalMap_ = 0;
+		}
+
+		uploadGrowing(commandsBuffer_, commandsCapacity_, commands_);
+		uploadGrowing(matricesBuffer_, matricesCapacity_, matrices_);
+		uploadGrowing(materialsBuffer_, materialsCapacity_, materials_);
+
+		stats_.numDrawCommands_ = (uint32_t)commands_.size();
+	}
+
+	void draw(GLuint matricesBinding, GLuint materialsBinding) const
+	{
+		if (commands_.empty())
+			return;
+
+		glBindVertexArray(vao_);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, materialsBinding, materialsBuffer_->getHandle());
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, matricesBinding, matricesBuffer_->getHandle());
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandsBuffer_->getHandle());
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, (GLsizei)commands_.size(), 0);
+	}
+
+	inline const GLStreamedWorldStats& getStats() const { return stats_; }
+
+private:
+	static constexpr GLsizeiptr kVertexSize = 8 * sizeof(float);
+
+	// the layout of DrawElementsIndirectCommand
+	struct DrawCommand
+	{
+		GLuint count_;
+		GLuint instanceCount_;
+		GLuint firstIndex_;
+		GLuint baseVertex_;
+		GLuint baseInstance_;
+	};
+
+	/* The buffer is reallocated with twice the size only when the data does not fit */
+	template <typename T>
+	static void uploadGrowing(std::unique_ptr<GLBuffer>& buffer, size_t& capacity, const std::vector<T>& data)
+	{
+		if (!buffer || data.size() > capacity)
+		{
+			capacity = std::max(data.size(), 2 * capacity);
+			buffer = std::make_unique<GLBuffer>(std::max<GLsizeiptr>(capacity * sizeof(T), sizeof(T)), nullptr, GL_DYNAMIC_STORAGE_BIT);
+		}
+
+		if (!data.empty())
+			glNamedBufferSubData(buffer->getHandle(), 0, data.size() * sizeof(T), data.data());
+	}
+
+	GLuint vao_ = 0;
+
+	GLBuffer vertices_;
+	GLBuffer indices_;
+
+	std::vector<DrawCommand> commands_;
+	std::vector<mat4> matrices_;
+	std::vector<MaterialDescription> materials_;
+
+	std::unique_ptr<GLBuffer> commandsBuffer_;
+	std::unique_ptr<GLBuffer> matricesBuffer_;
+	std::unique_ptr<GLBuffer> materialsBuffer_;
+	size_t commandsCapacity_ = 0;
+	size_t matricesCapacity_ = 0;
+	size_t materialsCapacity_ = 0;
+
+	GLStreamedWorldStats stats_;
+};
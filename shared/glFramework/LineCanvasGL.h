@@ -1,10 +1,13 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <memory>
 
 #include "shared/glFramework/GLShader.h"
 #include "shared/glFramework/GLTexture.h"
 #include "shared/scene/VtxData.h"
+#include "shared/DebugShapes.h"
 
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -96,36 +99,82 @@ public:
 class CanvasGL
 {
 public:
-	void line(const vec3& p1, const vec3& p2, const vec4& c)
-	{
-		lines_.push_back({ .position = p1, .color = c });
-		lines_.push_back({ .position = p2, .color = c });
+	CanvasGL() { glCreateVertexArrays(1, &vao_); }
+	~CanvasGL() { glDeleteVertexArrays(1, &vao_); }
+
+	void line(const vec3& p1, const vec3& p2, const vec4& c) { list_.line(p1, p2, c); }
+	void box(const mat4& m, const BoundingBox& box, const vec4& c) { list_.box(m, box, c); }
+	void frustum(const mat4& view, const mat4& proj, const vec4& c) { list_.frustum(view, proj, c); }
+	void plane(const vec3& orig, const vec3& v1, const vec3& v2, int n1, int n2, float s1, float s2, const vec4& color, const vec4& outlineColor) {
+		list_.plane(orig, v1, v2, n1, n2, s1, s2, color, outlineColor);
 	}
+
 	void flush()
 	{
-		if (lines_.empty())
+		if (list_.empty())
 			return;
 
-		assert(lines_.size() < kMaxLines);
+		glBindVertexArray(vao_);
+
+		if (!list_.lines_.empty())
+		{
+			const uint32_t size = uint32_t(list_.lines_.size() * sizeof(DebugLineVertex));
+			reserve(linesBuffer_, linesCapacity_, size);
+			glNamedBufferSubData(linesBuffer_->getHandle(), 0, size, list_.lines_.data());
+
+			progLines_.useProgram();
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, linesBuffer_->getHandle());
+			glDrawArrays(GL_LINES, 0, (GLsizei)list_.lines_.size());
+		}
+
+		const uint32_t numBoxes = (uint32_t)list_.boxes_.size();
+		const uint32_t numPlanes = (uint32_t)list_.planes_.size();
 
-		glNamedBufferSubData(mesh_.bufferVertices_->getHandle(), 0, uint32_t(lines_.size() * sizeof(VertexData)), lines_.data());
-		progLines_.useProgram();
-		mesh_.drawArrays(GL_LINES, 0, (GLint)lines_.size());
+		if (numBoxes + numPlanes)
+		{
+			// planes follow the boxes, gl_BaseInstance selects them
+			reserve(shapesBuffer_, shapesCapacity_, uint32_t((numBoxes + numPlanes) * sizeof(DebugShapeInstance)));
+			if (numBoxes)
+				glNamedBufferSubData(shapesBuffer_->getHandle(), 0, numBoxes * sizeof(DebugShapeInstance), list_.boxes_.data());
+			if (numPlanes)
+				glNamedBufferSubData(shapesBuffer_->getHandle(), numBoxes * sizeof(DebugShapeInstance), numPlanes * sizeof(DebugShapeInstance), list_.planes_.data());
+
+			progShapes_.useProgram();
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, shapesBuffer_->getHandle());
+			if (numBoxes)
+				glDrawArraysInstancedBaseInstance(GL_LINES, 0, DebugDrawList::VerticesPerBox, numBoxes, 0);
+			if (numPlanes)
+				glDrawArraysInstancedBaseInstance(GL_LINES, 0, list_.getVerticesPerPlane(), numPlanes, numBoxes);
+		}
 
-		lines_.clear();
+		list_.clear();
 	}
 
 private:
-	static constexpr uint32_t kMaxLines = 1024*1024;
-	struct VertexData {
-		vec3 position;
-		vec4 color;
-	};
-	std::vector<VertexData> lines_;
+	/* Buffers grow on demand, doubling their size */
+	static void reserve(std::unique_ptr<GLBuffer>& buffer, uint32_t& capacity, uint32_t size)
+	{
+		if (buffer && size <= capacity)
+			return;
+
+		capacity = std::max(size, 2 * capacity);
+		buffer = std::make_unique<GLBuffer>(capacity, nullptr, GL_DYNAMIC_STORAGE_BIT);
+	}
+
+	DebugDrawList list_;
+
+	GLuint vao_;
+
+	std::unique_ptr<GLBuffer> linesBuffer_;
+	std::unique_ptr<GLBuffer> shapesBuffer_;
+	uint32_t linesCapacity_ = 0;
+	uint32_t shapesCapacity_ = 0;
+
 	GLShader shdLinesVertex_ = GLShader("data/shaders/chapter08/GL01_lines.vert");
+	GLShader shdShapesVertex_ = GLShader("data/shaders/chapter08/GL01_DebugShapes.vert");
 	GLShader shdLinesFragment_ = GLShader("data/shaders/chapter08/GL01_lines.frag");
 	GLProgram progLines_ = GLProgram(shdLinesVertex_, shdLinesFragment_);
-	GLMeshPVP mesh_ = GLMeshPVP({}, nullptr, sizeof(VertexData) * kMaxLines);
+	GLProgram progShapes_ = GLProgram(shdShapesVertex_, shdLinesFragment_);
 };
 
 inline void renderCameraFrustumGL(CanvasGL& canvas, const mat4& camView, const mat4& camProj, const vec4& color, int numSegments = 1)
@@ -148,24 +197,12 @@ inline void renderCameraFrustumGL(CanvasGL& canvas, const mat4& camView, const m
 		pp[i] = glm::vec3(q) / q.w;
 	}
 
-	canvas.line(pp[0], pp[4], color);
-	canvas.line(pp[1], pp[5], color);
-	canvas.line(pp[2], pp[6], color);
-	canvas.line(pp[3], pp[7], color);
-	// near
-	canvas.line(pp[0], pp[1], color);
-	canvas.line(pp[1], pp[2], color);
-	canvas.line(pp[2], pp[3], color);
-	canvas.line(pp[3], pp[0], color);
+	// the edges of the frustum
+	canvas.frustum(camView, camProj, color);
+
 	// x
 	canvas.line(pp[0], pp[2], color);
 	canvas.line(pp[1], pp[3], color);
-	// far
-	canvas.line(pp[4], pp[5], color);
-	canvas.line(pp[5], pp[6], color);
-	canvas.line(pp[6], pp[7], color);
-	canvas.line(pp[7], pp[4], color);
-	// x
 	canvas.line(pp[4], pp[6], color);
 	canvas.line(pp[5], pp[7], color);
 
@@ -211,32 +248,5 @@ inline void renderCameraFrustumGL(CanvasGL& canvas, const mat4& camView, const m
 
 inline void drawBox3dGL(CanvasGL& canvas, const mat4& m, const BoundingBox& box, const vec4& c)
 {
-	std::array<vec3, 8> pts = {
-		vec3(box.max_.x, box.max_.y, box.max_.z),
-		vec3(box.max_.x, box.max_.y, box.min_.z),
-		vec3(box.max_.x, box.min_.y, box.max_.z),
-		vec3(box.max_.x, box.min_.y, box.min_.z),
-		vec3(box.min_.x, box.max_.y, box.max_.z),
-		vec3(box.min_.x, box.max_.y, box.min_.z),
-		vec3(box.min_.x, box.min_.y, box.max_.z),
-		vec3(box.min_.x, box.min_.y, box.min_.z),
-	};
-
-	for (auto& p: pts)
-		p = vec3(m * vec4(p, 1.f));
-
-	canvas.line(pts[0], pts[1], c);
-	canvas.line(pts[2], pts[3], c);
-	canvas.line(pts[4], pts[5], c);
-	canvas.line(pts[6], pts[7], c);
-
-	canvas.line(pts[0], pts[2], c);
-	canvas.line(pts[1], pts[3], c);
-	canvas.line(pts[4], pts[6], c);
-	canvas.line(pts[5], pts[7], c);
-
-	canvas.line(pts[0], pts[4], c);
-	canvas.line(pts[1], pts[5], c);
-	canvas.line(pts[2], pts[6], c);
-	canvas.line(pts[3], pts[7], c);
+	canvas.box(m, box, c);
 }
@@ -2,6 +2,8 @@
 #include "shared/scene/MergeUtil.h"
 
 #include <map>
+#include <set>
+#include <tuple>
 
 static uint32_t shiftMeshIndices(MeshData& meshData, const std::vector<uint32_t>& meshesToMerge)
 {
@@ -23,6 +25,8 @@ static uint32_t shiftMeshIndices(MeshData& meshData, const std::vector<uint32_t>
 			meshData.indexData_[m.indexOffset + ii] += delta;
 
 		m.vertexOffset = minVtxOffset;
+		// LOD0 vertices now end at delta + lodVertexCount[0]
+		m.lodVertexCount[0] += delta;
 
 		// sum all the deleted meshes' indices
 		mergeCount += idxCount;
@@ -67,6 +71,8 @@ static void mergeIndexArray(MeshData& md, const std::vector<uint32_t>& meshesToM
 	lastMesh.lodOffset[0] = copyOffset;
 	lastMesh.lodOffset[1] = mergeOffset;
 	lastMesh.lodCount = 1;
+	for (auto i: meshesToMerge)
+		lastMesh.lodVertexCount[0] = std::max(lastMesh.lodVertexCount[0], md.meshes_[i].lodVertexCount[0]);
 	md.meshes_.push_back(lastMesh);
 }
 
@@ -107,3 +113,464 @@ void mergeScene(Scene& scene, MeshData& meshData, const std::string& materialNam
 
 	deleteSceneNodes(scene, toDelete);
 }
+
+namespace
+{
+
+// position, texture coordinates, normal (see convertAIMesh() in SceneConverter)
+constexpr uint32_t kFloatsPerVertex = 8;
+
+uint32_t getLODIndexStart(const Mesh& mesh, uint32_t lod)
+{
+	return mesh.indexOffset + mesh.lodOffset[lod] - mesh.lodOffset[0];
+}
+
+// the vertices [first_, first_ + count_) used by a LOD of the mesh, 'count_' is 0 for an empty LOD
+struct VertexRange
+{
+	uint32_t first_ = 0;
+	uint32_t count_ = 0;
+};
+
+VertexRange getLODVertexRange(const MeshData& meshData, const Mesh& mesh, uint32_t lod)
+{
+	const uint32_t count = mesh.getLODIndicesCount(lod);
+
+	if (!count)
+		return VertexRange {};
+
+	const uint32_t* indices = &meshData.indexData_[getLODIndexStart(mesh, lod)];
+	const auto range = std::minmax_element(indices, indices + count);
+
+	return VertexRange { .first_ = *range.first, .count_ = *range.second - *range.first + 1 };
+}
+
+// the scene graph levels are not reliable after merging scenes, so the transforms are accumulated through the parents
+mat4 getGlobalTransform(const Scene& scene, int node)
+{
+	mat4 m = scene.localTransform_[node];
+
+	for (int p = scene.hierarchy_[node].parent_ ; p != -1 ; p = scene.hierarchy_[p].parent_)
+		m = scene.localTransform_[p] * m;
+
+	return m;
+}
+
+void getSceneDrawStats(const Scene& scene, const MeshData& meshData, uint32_t& numDraws, uint64_t& numTriangles)
+{
+	numDraws = (uint32_t)scene.meshes_.size();
+	numTriangles = 0;
+
+	for (const auto& n: scene.meshes_)
+		numTriangles += meshData.meshes_[n.second].getLODIndicesCount(0) / 3;
+}
+
+/* Every LOD of the batch gets the transformed vertex ranges of the same LOD of all the meshes */
+void addBatchMesh(const Scene& scene, const MeshData& src, const std::vector<uint32_t>& nodes, MeshData& dst)
+{
+	uint32_t lodCount = 1;
+
+	for (uint32_t n: nodes)
+		lodCount = std::max(lodCount, src.meshes_[scene.meshes_.at(n)].lodCount);
+
+	const uint32_t stride = kFloatsPerVertex * sizeof(float);
+
+	Mesh batch = {
+		.lodCount = lodCount,
+		.streamCount = 1,
+		.indexOffset = (uint32_t)dst.indexData_.size(),
+		.vertexOffset = (uint32_t)(dst.vertexData_.size() / kFloatsPerVertex),
+		.streamOffset = { (uint32_t)(dst.vertexData_.size() / kFloatsPerVertex) * stride },
+		.streamElementSize = { stride }
+	};
+
+	uint32_t numIndices = 0;
+	uint32_t numVertices = 0;
+
+	for (uint32_t l = 0 ; l != lodCount ; l++)
+	{
+		batch.lodOffset[l] = numIndices;
+		batch.lodVertexOffset[l] = numVertices;
+
+		for (uint32_t n: nodes)
+		{
+			const Mesh& mesh = src.meshes_[scene.meshes_.at(n)];
+			const uint32_t lod = std::min(l, mesh.lodCount - 1);
+
+			const uint32_t count = mesh.getLODIndicesCount(lod);
+
+			if (!count)
+				continue;
+
+			const uint32_t* indices = &src.indexData_[getLODIndexStart(mesh, lod)];
+			const VertexRange range = getLODVertexRange(src, mesh, lod);
+			const uint32_t first = range.first_;
+			const uint32_t last = range.first_ + range.count_ - 1;
+
+			const mat4& m = scene.globalTransform_[n];
+			const glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(m));
+
+			for (uint32_t v = first ; v <= last ; v++)
+			{
+				const float* in = &src.vertexData_[(mesh.vertexOffset + v) * kFloatsPerVertex];
+
+				const vec3 p = vec3(m * vec4(in[0], in[1], in[2], 1.0f));
+				const vec3 nrm = glm::normalize(normalMatrix * vec3(in[5], in[6], in[7]));
+
+				dst.vertexData_.insert(dst.vertexData_.end(), { p.x, p.y, p.z, in[3], in[4], nrm.x, nrm.y, nrm.z });
+			}
+
+			// mirroring transforms flip the winding order
+			const bool flip = glm::determinant(glm::mat3(m)) < 0.0f;
+
+			for (uint32_t i = 0 ; i != count ; i++)
+			{
+				const uint32_t j = (flip && (i % 3) != 0) ? (i - i % 3) + 3 - i % 3 : i;
+				dst.indexData_.push_back(indices[j] - first + numVertices);
+			}
+
+			numVertices += range.count_;
+			numIndices += count;
+		}
+
+		batch.lodVertexCount[l] = numVertices - batch.lodVertexOffset[l];
+	}
+
+	batch.lodOffset[lodCount] = numIndices;
+	batch.vertexCount = numVertices;
+
+	dst.meshes_.push_back(batch);
+}
+
+uint64_t getMeshDataSize(const MeshData& meshData)
+{
+	return meshData.indexData_.size() * sizeof(uint32_t) + meshData.vertexData_.size() * sizeof(float);
+}
+
+uint32_t countMeshMaterialPairs(const Scene& scene)
+{
+	std::set<std::pair<uint32_t, uint32_t>> draws;
+
+	for (const auto& n: scene.meshes_)
+		if (scene.materialForNode_.contains(n.first))
+			draws.insert({ n.second, scene.materialForNode_.at(n.first) });
+
+	return (uint32_t)draws.size();
+}
+
+BoundingBox getPositionBounds(const MeshData& meshData, const Mesh& mesh)
+{
+	if (!mesh.vertexCount)
+		return BoundingBox(vec3(0.0f), vec3(0.0f));
+
+	vec3 vmin(std::numeric_limits<float>::max());
+	vec3 vmax(std::numeric_limits<float>::lowest());
+
+	for (uint32_t v = 0 ; v != mesh.vertexCount ; v++)
+	{
+		const vec3 p = glm::make_vec3(&meshData.vertexData_[(mesh.vertexOffset + v) * kFloatsPerVertex]);
+		vmin = glm::min(vmin, p);
+		vmax = glm::max(vmax, p);
+	}
+
+	return BoundingBox(vmin, vmax);
+}
+
+/* The LOD structure and the indices, which have to match exactly (FNV-1a) */
+uint64_t hashMeshTopology(const MeshData& meshData, const Mesh& mesh)
+{
+	uint64_t h = 14695981039346656037ull;
+
+	auto add = [&h](uint32_t v) { h = (h ^ v) * 1099511628211ull; };
+
+	add(mesh.lodCount);
+	add(mesh.vertexCount);
+
+	for (uint32_t l = 0 ; l <= mesh.lodCount ; l++)
+		add(mesh.lodOffset[l] - mesh.lodOffset[0]);
+
+	const uint32_t* indices = &meshData.indexData_[mesh.indexOffset];
+
+	for (uint32_t i = 0 ; i != mesh.lodOffset[mesh.lodCount] - mesh.lodOffset[0] ; i++)
+		add(indices[i]);
+
+	return h;
+}
+
+bool isSameGeometry(const MeshData& meshData, const Mesh& a, const vec3& originA, const Mesh& b, const vec3& originB, float tolerance)
+{
+	if (a.lodCount != b.lodCount || a.vertexCount != b.vertexCount)
+		return false;
+
+	for (uint32_t l = 0 ; l <= a.lodCount ; l++)
+		if (a.lodOffset[l] - a.lodOffset[0] != b.lodOffset[l] - b.lodOffset[0])
+			return false;
+
+	for (uint32_t l = 0 ; l != a.lodCount ; l++)
+		if (a.lodVertexOffset[l] != b.lodVertexOffset[l] || a.lodVertexCount[l] != b.lodVertexCount[l])
+			return false;
+
+	const uint32_t numIndices = a.lodOffset[a.lodCount] - a.lodOffset[0];
+
+	if (!std::equal(&meshData.indexData_[a.indexOffset], &meshData.indexData_[a.indexOffset] + numIndices, &meshData.indexData_[b.indexOffset]))
+		return false;
+
+	for (uint32_t v = 0 ; v != a.vertexCount ; v++)
+	{
+		const float* va = &meshData.vertexData_[(a.vertexOffset + v) * kFloatsPerVertex];
+		const float* vb = &meshData.vertexData_[(b.vertexOffset + v) * kFloatsPerVertex];
+
+		for (uint32_t k = 0 ; k != kFloatsPerVertex ; k++)
+		{
+			const float d = (k < 3) ? (va[k] - originA[k]) - (vb[k] - originB[k]) : va[k] - vb[k];
+			if (std::fabs(d) > tolerance)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+} // namespace
+
+uint32_t copyMesh(const MeshData& src, uint32_t meshIndex, MeshData& dst)
+{
+	Mesh mesh = src.meshes_[meshIndex];
+
+	const uint32_t numIndices = mesh.lodOffset[mesh.lodCount] - mesh.lodOffset[0];
+	const uint32_t* indices = &src.indexData_[mesh.indexOffset];
+	const auto range = std::minmax_element(indices, indices + numIndices);
+	const uint32_t first = numIndices ? *range.first : 0;
+	const uint32_t numVertices = numIndices ? *range.second - first + 1 : 0;
+	const auto firstVertex = src.vertexData_.begin() + (mesh.vertexOffset + first) * kFloatsPerVertex;
+
+	mesh.indexOffset = (uint32_t)dst.indexData_.size();
+	mesh.vertexOffset = (uint32_t)(dst.vertexData_.size() / kFloatsPerVertex);
+	mesh.streamOffset[0] = mesh.vertexOffset * mesh.streamElementSize[0];
+
+	for (uint32_t i = 0 ; i != numIndices ; i++)
+		dst.indexData_.push_back(indices[i] - first);
+
+	// the vertex ranges follow the indices
+	mesh.vertexCount = numVertices;
+
+	for (uint32_t l = 0 ; l != mesh.lodCount ; l++)
+	{
+		if (!mesh.lodVertexCount[l])
+			continue;
+
+		const uint32_t begin = std::max(mesh.lodVertexOffset[l], first);
+		const uint32_t end = std::min(mesh.lodVertexOffset[l] + mesh.lodVertexCount[l], first + numVertices);
+
+		mesh.lodVertexOffset[l] = begin - first;
+		mesh.lodVertexCount[l] = (end > begin) ? end - begin : 0;
+	}
+
+	dst.vertexData_.insert(dst.vertexData_.end(), firstVertex, firstVertex + numVertices * kFloatsPerVertex);
+	dst.meshes_.push_back(mesh);
+
+	return (uint32_t)dst.meshes_.size() - 1;
+}
+
+MeshInstancingStats deduplicateMeshes(Scene& scene, MeshData& meshData, float tolerance)
+{
+	MeshInstancingStats stats;
+
+	const uint32_t numMeshes = (uint32_t)meshData.meshes_.size();
+
+	stats.meshesBefore_ = numMeshes;
+	stats.bytesBefore_ = getMeshDataSize(meshData);
+	stats.drawsBefore_ = (uint32_t)std::count_if(scene.meshes_.begin(), scene.meshes_.end(),
+		[&scene](const auto& n) { return scene.materialForNode_.contains(n.first); });
+
+	// the translation of a mesh is the minimum of its positions, candidates with the same key are resolved by comparing the vertices
+	std::vector<vec3> origins(numMeshes);
+	std::vector<uint32_t> canonical(numMeshes);
+	// (topology, cell of the extent) -> meshes
+	std::map<std::tuple<uint64_t, int, int, int>, std::vector<uint32_t>> buckets;
+
+	// copies within the tolerance have extents within the tolerance, so they are in the same or in neighbouring cells
+	const float cellSize = std::max(16.0f * tolerance, 0.001f);
+
+	for (uint32_t i = 0 ; i != numMeshes ; i++)
+	{
+		const Mesh& mesh = meshData.meshes_[i];
+		const BoundingBox bounds = getPositionBounds(meshData, mesh);
+
+		origins[i] = bounds.min_;
+		canonical[i] = i;
+
+		const uint64_t topology = hashMeshTopology(meshData, mesh);
+		const glm::ivec3 cell = glm::ivec3(glm::floor(bounds.getSize() / cellSize));
+
+		for (int n = 0 ; n != 27 && canonical[i] == i ; n++)
+		{
+			const auto candidates = buckets.find({ topology, cell.x + n % 3 - 1, cell.y + (n / 3) % 3 - 1, cell.z + n / 9 - 1 });
+
+			if (candidates == buckets.end())
+				continue;
+
+			for (uint32_t c: candidates->second)
+			{
+				if (isSameGeometry(meshData, meshData.meshes_[c], origins[c], mesh, origins[i], tolerance))
+				{
+					canonical[i] = c;
+					break;
+				}
+			}
+		}
+
+		if (canonical[i] == i)
+			buckets[{ topology, cell.x, cell.y, cell.z }].push_back(i);
+	}
+
+	MeshData newData;
+	std::vector<uint32_t> oldToNew(numMeshes);
+
+	for (uint32_t i = 0 ; i != numMeshes ; i++)
+		if (canonical[i] == i)
+			oldToNew[i] = copyMesh(meshData, i, newData);
+
+	for (auto& n: scene.meshes_)
+	{
+		const uint32_t c = canonical[n.second];
+
+		if (c != n.second)
+			scene.localTransform_[n.first] = scene.localTransform_[n.first] * glm::translate(mat4(1.0f), origins[n.second] - origins[c]);
+
+		n.second = oldToNew[c];
+	}
+
+	meshData = std::move(newData);
+	recalculateBoundingBoxes(meshData);
+
+	stats.meshesAfter_ = (uint32_t)meshData.meshes_.size();
+	stats.bytesAfter_ = getMeshDataSize(meshData);
+	stats.drawsAfter_ = countMeshMaterialPairs(scene);
+
+	return stats;
+}
+
+StaticBatchingStats batchStaticMeshes(Scene& scene, MeshData& meshData, const StaticBatchingParams& params)
+{
+	StaticBatchingStats stats;
+
+	getSceneDrawStats(scene, meshData, stats.drawsBefore_, stats.trianglesBefore_);
+
+	for (size_t i = 0 ; i != scene.hierarchy_.size() ; i++)
+		scene.globalTransform_[i] = getGlobalTransform(scene, (int)i);
+
+	std::map<uint32_t, uint32_t> numInstances;
+
+	for (const auto& n: scene.meshes_)
+		numInstances[n.second]++;
+
+	// (material, cell) -> nodes, std::map keeps the output deterministic
+	std::map<std::tuple<uint32_t, int, int, int>, std::vector<uint32_t>> groups;
+
+	for (const auto& n: scene.meshes_)
+	{
+		const uint32_t node = n.first;
+
+		if (scene.hierarchy_[node].firstChild_ != -1 || !scene.materialForNode_.contains(node))
+			continue;
+
+		if (params.minInstancesToKeep_ && numInstances[n.second] >= params.minInstancesToKeep_)
+			continue;
+
+		if (std::find(params.dynamicNodes_.begin(), params.dynamicNodes_.end(), getNodeName(scene, node)) != params.dynamicNodes_.end())
+			continue;
+
+		const BoundingBox box = meshData.boxes_[n.second].getTransformed(scene.globalTransform_[node]);
+		const glm::ivec3 cell = glm::ivec3(glm::floor(0.5f * (box.min_ + box.max_) / params.cellSize_));
+
+		groups[{ scene.materialForNode_.at(node), cell.x, cell.y, cell.z }].push_back(node);
+	}
+
+	// split the groups into batches, a single node is not worth a batch
+	std::vector<std::pair<uint32_t, std::vector<uint32_t>>> batches; // (material, nodes)
+
+	for (auto& g: groups)
+	{
+		std::sort(g.second.begin(), g.second.end());
+
+		std::vector<uint32_t> nodes;
+		// vertices of every LOD of the batch (see addBatchMesh())
+		uint32_t lodVertices[kMaxLODs] = {};
+		uint32_t lodCount = 1;
+
+		auto flush = [&]()
+		{
+			if (nodes.size() > 1)
+				batches.emplace_back(std::get<0>(g.first), nodes);
+			nodes.clear();
+			std::fill(std::begin(lodVertices), std::end(lodVertices), 0u);
+			lodCount = 1;
+		};
+
+		for (uint32_t n: g.second)
+		{
+			const Mesh& mesh = meshData.meshes_[scene.meshes_.at(n)];
+
+			// the LODs a mesh does not have get its coarsest one
+			uint32_t meshVertices[kMaxLODs];
+			for (uint32_t l = 0 ; l != kMaxLODs ; l++)
+				meshVertices[l] = (l == 0 || l < mesh.lodCount) ? getLODVertexRange(meshData, mesh, l).count_ : meshVertices[l - 1];
+
+			uint32_t numVertices = 0;
+			for (uint32_t l = 0 ; l != std::max(lodCount, mesh.lodCount) ; l++)
+				numVertices += lodVertices[l] + meshVertices[l];
+
+			if (!nodes.empty() && numVertices > params.maxVerticesPerBatch_)
+				flush();
+
+			nodes.push_back(n);
+			lodCount = std::max(lodCount, mesh.lodCount);
+			for (uint32_t l = 0 ; l != kMaxLODs ; l++)
+				lodVertices[l] += meshVertices[l];
+		}
+
+		flush();
+	}
+
+	std::vector<uint32_t> batchedNodes;
+
+	for (const auto& b: batches)
+		mergeVectors(batchedNodes, b.second);
+
+	std::sort(batchedNodes.begin(), batchedNodes.end());
+
+	// rebuild the mesh data: the meshes still used by the remaining nodes, then the batches
+	MeshData newData;
+	std::map<uint32_t, uint32_t> oldToNew;
+
+	for (auto& n: scene.meshes_)
+	{
+		if (std::binary_search(batchedNodes.begin(), batchedNodes.end(), n.first))
+			continue;
+
+		if (!oldToNew.contains(n.second))
+			oldToNew[n.second] = copyMesh(meshData, n.second, newData);
+
+		n.second = oldToNew[n.second];
+	}
+
+	for (const auto& b: batches)
+	{
+		addBatchMesh(scene, meshData, b.second, newData);
+
+		const int newNode = addNode(scene, 0, 1);
+		scene.meshes_[newNode] = (uint32_t)newData.meshes_.size() - 1;
+		scene.materialForNode_[newNode] = b.first;
+		setNodeName(scene, newNode, "StaticBatch_" + std::to_string(stats.numBatches_++));
+	}
+
+	deleteSceneNodes(scene, batchedNodes);
+
+	meshData = std::move(newData);
+	recalculateBoundingBoxes(meshData);
+
+	getSceneDrawStats(scene, meshData, stats.drawsAfter_, stats.trianglesAfter_);
+
+	return stats;
+}
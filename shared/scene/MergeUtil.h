@@ -4,3 +4,58 @@
 #include "shared/scene/VtxData.h"
 
 void mergeScene(Scene& scene, MeshData& meshData, const std::string& materialName);
+
+/*
+	Appends the vertex range [min index, max index] and the indices of the mesh to 'dst', returns the new mesh index.
+	The vertex count and the LOD vertex ranges of the copy are relative to the copied range
+*/
+uint32_t copyMesh(const MeshData& src, uint32_t meshIndex, MeshData& dst);
+
+struct StaticBatchingParams
+{
+	// nodes are grouped by material and by the cell of a uniform grid containing the centers of their bounding boxes,
+	// so the batches stay small enough for frustum and occlusion culling
+	float cellSize_ = 20.0f;
+	// a group is split into several batches when the vertices of all their LODs exceed this number (65536 keeps 16-bit indices, see Mesh::hasShortIndices())
+	uint32_t maxVerticesPerBatch_ = 65536;
+	// nodes with these names are not batched (i.e., the ones animated at runtime)
+	std::vector<std::string> dynamicNodes_;
+	// meshes used by at least this many nodes are left for instanced drawing (0 batches all of them)
+	uint32_t minInstancesToKeep_ = 4;
+};
+
+struct StaticBatchingStats
+{
+	uint32_t drawsBefore_ = 0;
+	uint32_t drawsAfter_ = 0;
+	uint64_t trianglesBefore_ = 0;
+	uint64_t trianglesAfter_ = 0;
+	uint32_t numBatches_ = 0;
+};
+
+/**
+	Static batching: the meshes of static leaf nodes with the same material in the same grid cell are merged into one mesh,
+	global transforms of the nodes are baked into the vertices. Every LOD of a batch is made of the same LOD of all its meshes
+	(or the coarsest one a mesh has) and has its own vertex range. Batched nodes are replaced by new children of the root node,
+	meshData is rebuilt without the meshes which are no longer used and bounding boxes are recalculated
+*/
+StaticBatchingStats batchStaticMeshes(Scene& scene, MeshData& meshData, const StaticBatchingParams& params);
+
+struct MeshInstancingStats
+{
+	uint32_t meshesBefore_ = 0;
+	uint32_t meshesAfter_ = 0;
+	uint64_t bytesBefore_ = 0;
+	uint64_t bytesAfter_ = 0;
+	// nodes with meshes and materials before, unique (mesh, material) pairs (i.e., instanced draw commands) after
+	uint32_t drawsBefore_ = 0;
+	uint32_t drawsAfter_ = 0;
+};
+
+/**
+	Automatic instancing: meshes with the same indices, texture coordinates and normals whose positions differ
+	only by a translation (up to 'tolerance' per component) are replaced by the first one of them.
+	The nodes of removed meshes get the translation in their local transforms,
+	meshData is rebuilt without the duplicates and bounding boxes are recalculated
+*/
+MeshInstancingStats deduplicateMeshes(Scene& scene, MeshData& meshData, float tolerance = 0.0001f);
@@ -0,0 +1,146 @@
+#include "shared/scene/MeshLods.h"
+
+#include <stdio.h>
+
+#include <meshoptimizer.h>
+
+namespace
+{
+
+struct LodStats
+{
+	float acmr_ = 0.0f;
+	float atvr_ = 0.0f;
+	float overdraw_ = 0.0f;
+	uint32_t numVertices_ = 0;
+};
+
+/* ATVR is calculated using the number of referenced vertices, so it does not depend on the size of the vertex range */
+LodStats getLodStats(const std::vector<uint32_t>& indices, const float* vertices, size_t vertexCount, size_t stride)
+{
+	const meshopt_VertexCacheStatistics cache = meshopt_analyzeVertexCache(indices.data(), indices.size(), vertexCount, 16, 0, 0);
+	const meshopt_OverdrawStatistics overdraw = meshopt_analyzeOverdraw(indices.data(), indices.size(), vertices, vertexCount, stride);
+
+	std::vector<bool> used(vertexCount, false);
+	uint32_t numUsed = 0;
+
+	for (uint32_t i: indices)
+	{
+		numUsed += used[i] ? 0 : 1;
+		used[i] = true;
+	}
+
+	return LodStats {
+		.acmr_ = cache.acmr,
+		.atvr_ = numUsed ? (float)cache.vertices_transformed / (float)numUsed : 0.0f,
+		.overdraw_ = overdraw.overdraw,
+		.numVertices_ = (uint32_t)vertexCount
+	};
+}
+
+void printLodStats(uint32_t lod, size_t numIndices, const LodStats& before, const LodStats& after, bool sloppy)
+{
+	printf("\n   LOD%u: %u indices, vertex range %u -> %u, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, overdraw %.3f -> %.3f %s",
+		lod, (uint32_t)numIndices, before.numVertices_, after.numVertices_,
+		before.acmr_, after.acmr_, before.atvr_, after.atvr_, before.overdraw_, after.overdraw_, sloppy ? "[sloppy]" : "");
+}
+
+} // namespace
+
+void processLods(std::vector<float>& vertices, uint32_t numFloats, const std::vector<uint32_t>& indices, bool calculateLODs,
+	std::vector<std::vector<uint32_t>>& outLods, Mesh& mesh)
+{
+	const size_t stride = numFloats * sizeof(float);
+	const size_t vertexCountIn = vertices.size() / numFloats;
+
+	// LOD0: vertex cache, overdraw, then vertex fetch (which also drops unreferenced vertices)
+	std::vector<uint32_t> lod0(indices);
+
+	const LodStats before0 = getLodStats(lod0, vertices.data(), vertexCountIn, stride);
+
+	meshopt_optimizeVertexCache(lod0.data(), lod0.data(), lod0.size(), vertexCountIn);
+	meshopt_optimizeOverdraw(lod0.data(), lod0.data(), lod0.size(), vertices.data(), vertexCountIn, stride, 1.05f);
+
+	const size_t vertexCount0 = meshopt_optimizeVertexFetch(vertices.data(), lod0.data(), lod0.size(), vertices.data(), vertexCountIn, stride);
+	vertices.resize(vertexCount0 * numFloats);
+
+	printLodStats(0, lod0.size(), before0, getLodStats(lod0, vertices.data(), vertexCount0, stride), false);
+
+	mesh.lodVertexOffset[0] = 0;
+	mesh.lodVertexCount[0] = (uint32_t)vertexCount0;
+
+	outLods.push_back(lod0);
+
+	if (!calculateLODs)
+		return;
+
+	// simplified LODs index LOD0 vertices until they are compacted
+	std::vector<uint32_t> lod(lod0);
+	size_t targetIndicesCount = lod.size();
+
+	uint32_t LOD = 1;
+
+	// the last lodOffset[] is a marker
+	while (targetIndicesCount > 1024 && LOD < kMaxLODs - 1)
+	{
+		targetIndicesCount = lod.size() / 2;
+
+		bool sloppy = false;
+
+		size_t numOptIndices = meshopt_simplify(
+			lod.data(),
+			lod.data(), (uint32_t)lod.size(),
+			vertices.data(), vertexCount0,
+			stride,
+			targetIndicesCount, 0.02f);
+
+		// cannot simplify further
+		if (static_cast<size_t>(numOptIndices * 1.1f) > lod.size())
+		{
+			if (LOD > 1)
+			{
+				// try harder
+				numOptIndices = meshopt_simplifySloppy(
+					lod.data(),
+					lod.data(), lod.size(),
+					vertices.data(), vertexCount0,
+					stride,
+					targetIndicesCount, 0.02f, nullptr);
+				sloppy = true;
+				if (numOptIndices == lod.size()) break;
+			}
+			else
+				break;
+		}
+
+		lod.resize(numOptIndices);
+
+		meshopt_optimizeVertexCache(lod.data(), lod.data(), lod.size(), vertexCount0);
+		meshopt_optimizeOverdraw(lod.data(), lod.data(), lod.size(), vertices.data(), vertexCount0, stride, 1.05f);
+
+		const LodStats before = getLodStats(lod, vertices.data(), vertexCount0, stride);
+
+		// compact copy of the referenced vertices in the order of first use
+		std::vector<uint32_t> remap(vertexCount0);
+		const size_t lodVertexCount = meshopt_optimizeVertexFetchRemap(remap.data(), lod.data(), lod.size(), vertexCount0);
+
+		std::vector<uint32_t> lodIndices(lod.size());
+		meshopt_remapIndexBuffer(lodIndices.data(), lod.data(), lod.size(), remap.data());
+
+		const size_t lodVertexOffset = vertices.size() / numFloats;
+		vertices.resize((lodVertexOffset + lodVertexCount) * numFloats);
+		meshopt_remapVertexBuffer(&vertices[lodVertexOffset * numFloats], vertices.data(), vertexCount0, stride, remap.data());
+
+		printLodStats(LOD, lod.size(), before, getLodStats(lodIndices, &vertices[lodVertexOffset * numFloats], lodVertexCount, stride), sloppy);
+
+		for (uint32_t& i: lodIndices)
+			i += (uint32_t)lodVertexOffset;
+
+		mesh.lodVertexOffset[LOD] = (uint32_t)lodVertexOffset;
+		mesh.lodVertexCount[LOD] = (uint32_t)lodVertexCount;
+
+		outLods.push_back(lodIndices);
+
+		LOD++;
+	}
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "shared/scene/VtxData.h"
+
+/**
+	Index and vertex reordering for the mesh converters (Chapter5/MeshConvert, Chapter7/SceneConverter)
+
+	LOD0 is optimized for the post-transform vertex cache, overdraw and vertex fetch (its vertices are reordered in the order of first use).
+	Every coarser LOD gets a compact copy of the vertices it references appended after LOD0,
+	so a distant LOD of a large mesh fetches a small contiguous vertex range instead of vertices scattered over the whole mesh.
+	Vertex cache, vertex fetch and overdraw statistics of every LOD are printed before and after.
+*/
+
+/* 'vertices' are interleaved, 'numFloats' floats per vertex with the position first.
+   On return 'vertices' contain the vertex ranges of all LODs one after another, the indices in 'outLods' are relative to the beginning of 'vertices'
+   and mesh.lodVertexOffset[] / mesh.lodVertexCount[] describe the ranges. Only LOD0 is generated if 'calculateLODs' is false */
+void processLods(std::vector<float>& vertices, uint32_t numFloats, const std::vector<uint32_t>& indices, bool calculateLODs,
+	std::vector<std::vector<uint32_t>>& outLods, Mesh& mesh);
@@ -1,6 +1,8 @@
 ﻿#include "shared/scene/Scene.h"
 #include "shared/Utils.h"
 
+#include <assert.h>
+
 #include <algorithm>
 #include <numeric>
 
@@ -72,7 +74,7 @@ int findNodeByName(const Scene& scene, const std::string& name)
 int getNodeLevel(const Scene& scene, int n)
 {
 	int level = -1;
-	for (int p = 0 ; p != -1 ; p = scene.hierarchy_[p].parent_, level++);
+	for (int p = n ; p != -1 ; p = scene.hierarchy_[p].parent_, level++);
 	return level;
 }
 
@@ -82,22 +84,80 @@ void fprintfMat4(FILE* f, const glm::mat4& m);
 // CPU version of global transform update []
 void recalculateGlobalTransforms(Scene& scene)
 {
+	const bool trackNodes = !scene.allTransformsChanged_;
+
 	if (!scene.changedAtThisFrame_[0].empty())
 	{
 		int c = scene.changedAtThisFrame_[0][0];
 		scene.globalTransform_[c] = scene.localTransform_[c];
+		if (trackNodes)
+			scene.recalculatedNodes_.push_back(c);
 		scene.changedAtThisFrame_[0].clear();
 	}
 
-	for (int i = 1 ; i < MAX_NODE_LEVEL && (!scene.changedAtThisFrame_[i].empty()); i++ )
+	// a level without changes does not end the update: the changed subtrees may start deeper
+	for (int i = 1 ; i < MAX_NODE_LEVEL ; i++ )
 	{
 		for (const int& c: scene.changedAtThisFrame_[i])
 		{
 			int p = scene.hierarchy_[c].parent_;
 			scene.globalTransform_[c] = scene.globalTransform_[p] * scene.localTransform_[c];
 		}
+		if (trackNodes)
+			scene.recalculatedNodes_.insert(scene.recalculatedNodes_.end(), scene.changedAtThisFrame_[i].begin(), scene.changedAtThisFrame_[i].end());
 		scene.changedAtThisFrame_[i].clear();
 	}
+
+	// nobody takes the list, do not let it grow beyond the scene
+	if (scene.recalculatedNodes_.size() > scene.hierarchy_.size())
+	{
+		scene.recalculatedNodes_.clear();
+		scene.allTransformsChanged_ = true;
+	}
+}
+
+bool takeRecalculatedNodes(Scene& scene, std::vector<int>& nodes)
+{
+	nodes.clear();
+	nodes.swap(scene.recalculatedNodes_);
+
+	const bool allChanged = scene.allTransformsChanged_;
+	scene.allTransformsChanged_ = false;
+
+	return !allChanged;
+}
+
+// a single pass: the parent of every node has been updated before the node itself
+void recalculateAllGlobalTransforms(Scene& scene)
+{
+	assert(isSceneDepthSorted(scene));
+
+	const size_t numNodes = scene.hierarchy_.size();
+
+	for (size_t i = 0 ; i != numNodes ; i++)
+	{
+		const int p = scene.hierarchy_[i].parent_;
+		scene.globalTransform_[i] = (p > -1) ? scene.globalTransform_[p] * scene.localTransform_[i] : scene.localTransform_[i];
+	}
+
+	for (auto& c: scene.changedAtThisFrame_)
+		c.clear();
+
+	scene.recalculatedNodes_.clear();
+	scene.allTransformsChanged_ = true;
+}
+
+bool isSceneDepthSorted(const Scene& scene)
+{
+	for (size_t i = 0 ; i != scene.hierarchy_.size() ; i++)
+	{
+		const Hierarchy& h = scene.hierarchy_[i];
+
+		if (h.parent_ >= (int)i || (i > 0 && h.level_ < scene.hierarchy_[i - 1].level_))
+			return false;
+	}
+
+	return true;
 }
 
 void loadMap(FILE* f, std::unordered_map<uint32_t, uint32_t>& map)
@@ -410,95 +470,333 @@ void dumpSceneToDot(const char* fileName, const Scene& scene, int* visited)
 	fclose(f);
 }
 
-/** A rather long algorithm (and the auxiliary routines) to delete a number of scene nodes from the hierarchy */
-/* */
+static void shiftMapIndices(std::unordered_map<uint32_t, uint32_t>& items, const std::vector<int>& newIndices)
+{
+	std::unordered_map<uint32_t, uint32_t> newItems;
+	newItems.reserve(items.size());
+	for (const auto& m: items) {
+		int newIndex = newIndices[m.first];
+		if (newIndex != -1)
+			newItems[newIndex] = m.second;
+	}
+	items = std::move(newItems);
+}
 
-// Add an index to a sorted index array
-static void addUniqueIdx(std::vector<uint32_t>& v, uint32_t index)
+static void appendMapItems(std::unordered_map<uint32_t, uint32_t>& items, const std::unordered_map<uint32_t, uint32_t>& src, int keyOffset, int valueOffset)
 {
-	if (!std::binary_search(v.begin(), v.end(), index))
-		v.push_back(index);
+	for (const auto& m: src)
+		items[m.first + keyOffset] = m.second + valueOffset;
 }
 
-// Recurse down from a node and collect all nodes which are already marked for deletion
-static void collectNodesToDelete(const Scene& scene, int node, std::vector<uint32_t>& nodes)
+// O(N + M) (N = scene.size, M = the number of edits): every step is a linear pass over the nodes
+std::vector<int> applySceneEdits(Scene& scene, const SceneEditBatch& edits, std::vector<int>* insertedRoots)
 {
-	for (int n = scene.hierarchy_[node].firstChild_; n != - 1 ; n = scene.hierarchy_[n].nextSibling_) {
-		addUniqueIdx(nodes, n);
-		collectNodesToDelete(scene, n, nodes);
+	const int numNodes = (int)scene.hierarchy_.size();
+
+	const bool wasSorted = isSceneDepthSorted(scene);
+
+	// 1) Parents after reparenting
+	std::vector<int> parents(numNodes);
+	for (int i = 0 ; i != numNodes ; i++)
+		parents[i] = scene.hierarchy_[i].parent_;
+
+	for (const auto& r: edits.reparentedNodes_)
+		parents[r.first] = (int)r.second;
+
+	// 2) Children of every node in index order (a counting sort by parents)
+	std::vector<int> childStart(numNodes + 1, 0);
+	for (int p: parents)
+		if (p != -1)
+			childStart[p + 1]++;
+
+	std::partial_sum(childStart.begin(), childStart.end(), childStart.begin());
+
+	std::vector<int> children(childStart[numNodes]);
+	{
+		std::vector<int> pos(childStart.begin(), childStart.end() - 1);
+		for (int i = 0 ; i != numNodes ; i++)
+			if (parents[i] != -1)
+				children[pos[parents[i]]++] = i;
+	}
+
+	// 3) Deletion flags are propagated down from the roots, the nodes of a reparenting cycle are never reached
+	std::vector<bool> deleted(numNodes, false);
+	for (uint32_t n: edits.deletedNodes_)
+		deleted[n] = true;
+
+	std::vector<int> queue;
+	queue.reserve(numNodes);
+
+	for (int i = 0 ; i != numNodes ; i++)
+		if (parents[i] == -1)
+			queue.push_back(i);
+
+	for (size_t q = 0 ; q != queue.size() ; q++)
+	{
+		const int n = queue[q];
+		for (int c = childStart[n] ; c != childStart[n + 1] ; c++)
+		{
+			deleted[children[c]] = deleted[children[c]] || deleted[n];
+			queue.push_back(children[c]);
+		}
+	}
+
+	if ((int)queue.size() != numNodes)
+	{
+		printf("applySceneEdits(): reparenting makes a node its own ancestor\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// 4) Compact the arrays in place (new indices never exceed the old ones)
+	std::vector<int> newIndices(numNodes, -1);
+	int numRemaining = 0;
+	for (int i = 0 ; i != numNodes ; i++)
+		if (!deleted[i])
+			newIndices[i] = numRemaining++;
+
+	for (int i = 0 ; i != numNodes ; i++)
+	{
+		const int j = newIndices[i];
+		if (j == -1)
+			continue;
+		scene.localTransform_[j] = scene.localTransform_[i];
+		scene.globalTransform_[j] = scene.globalTransform_[i];
+		parents[j] = (parents[i] != -1) ? newIndices[parents[i]] : -1;
+	}
+
+	parents.resize(numRemaining);
+	scene.localTransform_.resize(numRemaining);
+	scene.globalTransform_.resize(numRemaining);
+
+	shiftMapIndices(scene.meshes_, newIndices);
+	shiftMapIndices(scene.materialForNode_, newIndices);
+	shiftMapIndices(scene.nameForNode_, newIndices);
+
+	// 5) Append the inserted subtrees (a subtree attached to a deleted node is dropped)
+	std::vector<int> changedNodes;
+
+	if (insertedRoots)
+		insertedRoots->clear();
+
+	for (const auto& r: edits.reparentedNodes_)
+		if (newIndices[r.first] != -1)
+			changedNodes.push_back(newIndices[r.first]);
+
+	for (const auto& s: edits.insertedSubtrees_)
+	{
+		const int parent = newIndices[s.second];
+
+		if (insertedRoots)
+			insertedRoots->push_back((parent != -1) ? (int)parents.size() : -1);
+
+		if (parent == -1)
+			continue;
+
+		const Scene& src = *s.first;
+		const int offs = (int)parents.size();
+
+		for (const auto& h: src.hierarchy_)
+		{
+			if (h.parent_ == -1)
+				changedNodes.push_back((int)parents.size());
+			parents.push_back((h.parent_ != -1) ? h.parent_ + offs : parent);
+		}
+
+		mergeVectors(scene.localTransform_, src.localTransform_);
+		mergeVectors(scene.globalTransform_, src.globalTransform_);
+
+		appendMapItems(scene.meshes_,          src.meshes_,          offs, 0);
+		appendMapItems(scene.materialForNode_, src.materialForNode_, offs, 0);
+		appendMapItems(scene.nameForNode_,     src.nameForNode_,     offs, (int)scene.names_.size());
+
+		mergeVectors(scene.names_, src.names_);
+	}
+
+	// 6) Rebuild the links: children are appended in index order, the first child caches the last one (as in addNode())
+	const int numNewNodes = (int)parents.size();
+	scene.hierarchy_.assign(numNewNodes, Hierarchy { .parent_ = -1, .firstChild_ = -1, .nextSibling_ = -1, .lastSibling_ = -1, .level_ = 0 });
+
+	for (int i = 0 ; i != numNewNodes ; i++)
+	{
+		Hierarchy& h = scene.hierarchy_[i];
+		h.parent_ = parents[i];
+
+		if (h.parent_ == -1)
+			continue;
+
+		Hierarchy& p = scene.hierarchy_[h.parent_];
+		if (p.firstChild_ == -1)
+		{
+			p.firstChild_ = i;
+			h.lastSibling_ = i;
+		}
+		else
+		{
+			Hierarchy& first = scene.hierarchy_[p.firstChild_];
+			scene.hierarchy_[first.lastSibling_].nextSibling_ = i;
+			first.lastSibling_ = i;
+		}
 	}
+
+	// 7) Levels are recalculated (breadth-first, so every parent is visited before its children)
+	queue.clear();
+	for (int i = 0 ; i != numNewNodes ; i++)
+		if (parents[i] == -1)
+			queue.push_back(i);
+
+	for (size_t q = 0 ; q != queue.size() ; q++)
+	{
+		const int n = queue[q];
+		for (int s = scene.hierarchy_[n].firstChild_ ; s != -1 ; s = scene.hierarchy_[s].nextSibling_)
+		{
+			scene.hierarchy_[s].level_ = scene.hierarchy_[n].level_ + 1;
+			queue.push_back(s);
+		}
+	}
+
+	if (!queue.empty() && scene.hierarchy_[queue.back()].level_ >= MAX_NODE_LEVEL)
+	{
+		printf("applySceneEdits(): the scene is deeper than MAX_NODE_LEVEL\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// 8) The pending changes of the remaining nodes are moved to their new indices and levels,
+	//    reparented and inserted nodes are marked together with their subtrees
+	std::vector<bool> dirty(numNewNodes, false);
+
+	for (const auto& c: scene.changedAtThisFrame_)
+		for (int n: c)
+			if (newIndices[n] != -1)
+				dirty[newIndices[n]] = true;
+
+	for (int n: changedNodes)
+		dirty[n] = true;
+
+	for (auto& c: scene.changedAtThisFrame_)
+		c.clear();
+
+	for (int n: queue)
+	{
+		const int p = scene.hierarchy_[n].parent_;
+		if (p != -1 && dirty[p])
+			dirty[n] = true;
+		if (dirty[n])
+			scene.changedAtThisFrame_[scene.hierarchy_[n].level_].push_back(n);
+	}
+
+	// node indices have changed
+	scene.recalculatedNodes_.clear();
+	scene.allTransformsChanged_ = true;
+
+	// 9) Reparented and appended nodes may precede their new parents or break the level order
+	if (wasSorted && !isSceneDepthSorted(scene))
+	{
+		const std::vector<int> sortedIndices = sortSceneByDepth(scene);
+
+		for (int& n: newIndices)
+			if (n != -1)
+				n = sortedIndices[n];
+
+		if (insertedRoots)
+			for (int& n: *insertedRoots)
+				if (n != -1)
+					n = sortedIndices[n];
+	}
+
+	return newIndices;
 }
 
-int findLastNonDeletedItem(const Scene& scene, const std::vector<int>& newIndices, int node)
+void deleteSceneNodes(Scene& scene, const std::vector<uint32_t>& nodesToDelete)
 {
-	// we have to be more subtle:
-	//   if the (newIndices[firstChild_] == -1), we should follow the link and extract the last non-removed item
-	//   ..
-	if (node == -1)
-		return -1;
-
-	return (newIndices[node] == -1) ?
-		findLastNonDeletedItem(scene, newIndices, scene.hierarchy_[node].nextSibling_) :
-		newIndices[node];
+	SceneEditBatch edits;
+	edits.deletedNodes_ = nodesToDelete;
+	applySceneEdits(scene, edits);
 }
 
-void shiftMapIndices(std::unordered_map<uint32_t, uint32_t>& items, const std::vector<int>& newIndices)
+void compactSceneNames(Scene& scene)
 {
-	std::unordered_map<uint32_t, uint32_t> newItems;
-	for (const auto& m: items) {
-		int newIndex = newIndices[m.first];
-		if (newIndex != -1)
-			newItems[newIndex] = m.second;
+	std::vector<int> newIds(scene.names_.size(), -1);
+
+	for (const auto& n: scene.nameForNode_)
+		newIds[n.second] = 0;
+
+	std::vector<std::string> names;
+
+	for (size_t i = 0 ; i != scene.names_.size() ; i++)
+	{
+		if (newIds[i] == -1)
+			continue;
+
+		newIds[i] = (int)names.size();
+		names.push_back(std::move(scene.names_[i]));
 	}
-	items = newItems;
+
+	for (auto& n: scene.nameForNode_)
+		n.second = newIds[n.second];
+
+	scene.names_ = std::move(names);
 }
 
-// Approximately an O ( N * Log(N) * Log(M)) algorithm (N = scene.size, M = nodesToDelete.size) to delete a collection of nodes from scene graph
-void deleteSceneNodes(Scene& scene, const std::vector<uint32_t>& nodesToDelete)
+// breadth-first order: levels are contiguous, the children of a node are contiguous and keep their sibling order
+std::vector<int> sortSceneByDepth(Scene& scene)
 {
-	// 0) Add all the nodes down below in the hierarchy
-	auto indicesToDelete = nodesToDelete;
-	for (auto i: indicesToDelete)
-		collectNodesToDelete(scene, i, indicesToDelete);
-
-	// aux array with node indices to keep track of the moved ones [moved = [](node) { return (node != nodes[node]); ]
-	std::vector<int> nodes(scene.hierarchy_.size());
-	std::iota(nodes.begin(), nodes.end(), 0);
-
-	// 1.a) Move all the indicesToDelete to the end of 'nodes' array (and cut them off, a variation of swap'n'pop for multiple elements)
-	auto oldSize = nodes.size();
-	eraseSelected(nodes, indicesToDelete);
-
-	// 1.b) Make a newIndices[oldIndex] mapping table
-	std::vector<int> newIndices(oldSize, -1);
-	for(int i = 0 ; i < nodes.size() ; i++)
-		newIndices[nodes[i]] = i;
-
-	// 2) Replace all non-null parent/firstChild/nextSibling pointers in all the nodes by new positions
-	auto nodeMover = [&scene, &newIndices](Hierarchy& h) {
-		return Hierarchy {
-			.parent_ = (h.parent_ != -1) ? newIndices[h.parent_] : -1,
-			.firstChild_ = findLastNonDeletedItem(scene, newIndices, h.firstChild_),
-			.nextSibling_ = findLastNonDeletedItem(scene, newIndices, h.nextSibling_),
-			.lastSibling_ = findLastNonDeletedItem(scene, newIndices, h.lastSibling_)
-		};
-	};
-	std::transform(scene.hierarchy_.begin(), scene.hierarchy_.end(), scene.hierarchy_.begin(), nodeMover);
+	const int numNodes = (int)scene.hierarchy_.size();
+
+	std::vector<int> order;
+	order.reserve(numNodes);
 
-	// 3) Finally throw away the hierarchy items
-	eraseSelected(scene.hierarchy_, indicesToDelete);
+	for (int i = 0 ; i != numNodes ; i++)
+		if (scene.hierarchy_[i].parent_ == -1)
+			order.push_back(i);
+
+	for (size_t q = 0 ; q != order.size() ; q++)
+		for (int s = scene.hierarchy_[order[q]].firstChild_ ; s != -1 ; s = scene.hierarchy_[s].nextSibling_)
+			order.push_back(s);
+
+	if ((int)order.size() != numNodes)
+	{
+		printf("sortSceneByDepth(): %d of %d nodes are reachable from the roots\n", (int)order.size(), numNodes);
+		exit(EXIT_FAILURE);
+	}
 
-	// 4) As in mergeScenes() routine we also have to adjust all the "components" (i.e., meshes, materials, names and transformations)
+	std::vector<int> newIndices(numNodes);
+	for (int i = 0 ; i != numNodes ; i++)
+		newIndices[order[i]] = i;
 
-	// 4a) Transformations are stored in arrays, so we just erase the items as we did with the scene.hierarchy_
-	eraseSelected(scene.localTransform_, indicesToDelete);
-	eraseSelected(scene.globalTransform_, indicesToDelete);
+	auto remap = [&newIndices](int n) { return n > -1 ? newIndices[n] : -1; };
+
+	std::vector<Hierarchy> hierarchy(numNodes);
+	std::vector<mat4> localTransform(numNodes);
+	std::vector<mat4> globalTransform(numNodes);
+
+	for (int i = 0 ; i != numNodes ; i++)
+	{
+		const Hierarchy& h = scene.hierarchy_[order[i]];
+		hierarchy[i] = Hierarchy {
+			.parent_ = remap(h.parent_),
+			.firstChild_ = remap(h.firstChild_),
+			.nextSibling_ = remap(h.nextSibling_),
+			.lastSibling_ = remap(h.lastSibling_),
+			.level_ = h.level_
+		};
+		localTransform[i] = scene.localTransform_[order[i]];
+		globalTransform[i] = scene.globalTransform_[order[i]];
+	}
+
+	scene.hierarchy_ = std::move(hierarchy);
+	scene.localTransform_ = std::move(localTransform);
+	scene.globalTransform_ = std::move(globalTransform);
 
-	// 4b) All the maps should change the key values with the newIndices[] array
 	shiftMapIndices(scene.meshes_, newIndices);
 	shiftMapIndices(scene.materialForNode_, newIndices);
 	shiftMapIndices(scene.nameForNode_, newIndices);
 
-	// 5) scene node names list is not modified, but in principle it can be (remove all non-used items and adjust the nameForNode_ map)
-	// 6) Material names list is not modified also, but if some materials fell out of use
+	for (auto& c: scene.changedAtThisFrame_)
+		for (int& n: c)
+			n = newIndices[n];
+
+	for (int& n: scene.recalculatedNodes_)
+		n = newIndices[n];
+
+	return newIndices;
 }
@@ -40,6 +40,11 @@ struct Scene
 	// list of nodes whose global transform must be recalculated
 	std::vector<int> changedAtThisFrame_[MAX_NODE_LEVEL];
 
+	// nodes whose global transforms were recalculated since the last takeRecalculatedNodes() call,
+	// not tracked while 'allTransformsChanged_' is set (set it after writing global transforms directly)
+	std::vector<int> recalculatedNodes_;
+	bool allTransformsChanged_ = true;
+
 	// Hierarchy component
 	std::vector<Hierarchy> hierarchy_;
 
@@ -82,6 +87,17 @@ int getNodeLevel(const Scene& scene, int n);
 
 void recalculateGlobalTransforms(Scene& scene);
 
+/* Hands over the nodes recalculated since the previous call (for uploading only the changed transforms).
+   Returns false if all the transforms have to be treated as changed, e.g. after recalculateAllGlobalTransforms() */
+bool takeRecalculatedNodes(Scene& scene, std::vector<int>& nodes);
+
+/* Recalculates every global transform in one linear pass, parents must precede their children (see sortSceneByDepth()).
+   The dirty lists are cleared */
+void recalculateAllGlobalTransforms(Scene& scene);
+
+/* True if every parent precedes its children and the levels are contiguous */
+bool isSceneDepthSorted(const Scene& scene);
+
 void loadScene(const char* fileName, Scene& scene);
 void saveScene(const char* fileName, const Scene& scene);
 
@@ -93,5 +109,43 @@ void dumpSceneToDot(const char* fileName, const Scene& scene, int* visited = nul
 void mergeScenes(Scene& scene, const std::vector<Scene*>& scenes, const std::vector<glm::mat4>& rootTransforms, const std::vector<uint32_t>& meshCounts,
 		bool mergeMeshes = true, bool mergeMaterials = true);
 
-// Delete a collection of nodes from a scenegraph
+/**
+	Batch scene editing: the edits are applied at once in linear time. Deleted subtrees are marked in a bitset,
+	transforms and components are compacted in one pass, then sibling links and node levels are rebuilt
+	(children are linked in the order of their indices). Node indices refer to the scene before editing
+*/
+struct SceneEditBatch
+{
+	// the node and all its descendants (after reparenting) are deleted
+	void deleteNode(uint32_t node) { deletedNodes_.push_back(node); }
+
+	void reparentNode(uint32_t node, uint32_t newParent) { reparentedNodes_.push_back({ node, newParent }); }
+
+	// the roots of 'subtree' become children of 'parent', mesh and material indices are copied as they are ('subtree' is read in applySceneEdits())
+	void insertSubtree(const Scene& subtree, uint32_t parent) { insertedSubtrees_.push_back({ &subtree, parent }); }
+
+	std::vector<uint32_t> deletedNodes_;
+	std::vector<std::pair<uint32_t, uint32_t>> reparentedNodes_;
+	std::vector<std::pair<const Scene*, uint32_t>> insertedSubtrees_;
+};
+
+/* Returns the new indices of the old nodes (-1 for the deleted ones), inserted nodes follow the remaining ones.
+   A depth-sorted scene stays depth-sorted: if the edits break the order, the nodes are rearranged with sortSceneByDepth().
+   'insertedRoots' receives the new index of node 0 of every inserted subtree (-1 if the subtree was dropped).
+   Reparented nodes and inserted subtrees are marked as changed, so recalculateGlobalTransforms() updates them.
+   The changes pending for the remaining nodes are kept (at their new indices and levels) */
+std::vector<int> applySceneEdits(Scene& scene, const SceneEditBatch& edits, std::vector<int>* insertedRoots = nullptr);
+
+// Delete a collection of nodes (with their subtrees) from a scenegraph
 void deleteSceneNodes(Scene& scene, const std::vector<uint32_t>& nodesToDelete);
+
+/* Removes the names no node refers to (e.g., the ones of deleted nodes), the remaining names keep their order */
+void compactSceneNames(Scene& scene);
+
+/**
+	Reorders the nodes in breadth-first order: the levels are contiguous and every parent precedes its children,
+	so recalculateAllGlobalTransforms() reads the parent transforms it needs from memory it has just written.
+	Transforms, links, components and dirty lists are remapped. Returns the new indices of the old nodes
+	which have to be applied to the node indices stored outside of the scene
+*/
+std::vector<int> sortSceneByDepth(Scene& scene);
@@ -0,0 +1,101 @@
+#include "shared/scene/TransformUploads.h"
+
+#include <algorithm>
+
+void TransformUploadTracker::mapNodesToShapes(const Scene& scene, const std::vector<DrawData>& shapes)
+{
+	const size_t numNodes = scene.hierarchy_.size();
+
+	firstShapeForNode_.assign(numNodes + 1, 0);
+
+	for (const auto& s: shapes)
+		firstShapeForNode_[s.transformIndex + 1]++;
+
+	for (size_t i = 0 ; i != numNodes ; i++)
+		firstShapeForNode_[i + 1] += firstShapeForNode_[i];
+
+	nodeShapes_.resize(shapes.size());
+
+	std::vector<uint32_t> next(firstShapeForNode_.begin(), firstShapeForNode_.end() - 1);
+
+	for (uint32_t i = 0 ; i != (uint32_t)shapes.size() ; i++)
+		nodeShapes_[next[shapes[i].transformIndex]++] = i;
+
+	numShapes_ = shapes.size();
+}
+
+const std::vector<TransformUploadRange>& TransformUploadTracker::update(Scene& scene, const std::vector<DrawData>& shapes, std::vector<mat4>& shapeTransforms)
+{
+	ranges_.clear();
+
+	bool fullUpload = !takeRecalculatedNodes(scene, nodes_);
+
+	if (firstShapeForNode_.size() != scene.hierarchy_.size() + 1 || numShapes_ != shapes.size())
+	{
+		mapNodesToShapes(scene, shapes);
+		fullUpload = true;
+	}
+
+	shapeTransforms.resize(shapes.size());
+
+	if (!fullUpload)
+	{
+		dirtyShapes_.clear();
+
+		for (int n: nodes_)
+			for (uint32_t i = firstShapeForNode_[n] ; i != firstShapeForNode_[n + 1] ; i++)
+				dirtyShapes_.push_back(nodeShapes_[i]);
+
+		// a node can be recalculated several times between the updates
+		std::sort(dirtyShapes_.begin(), dirtyShapes_.end());
+		dirtyShapes_.erase(std::unique(dirtyShapes_.begin(), dirtyShapes_.end()), dirtyShapes_.end());
+
+		uint32_t numCovered = 0;
+
+		for (uint32_t s: dirtyShapes_)
+		{
+			if (!ranges_.empty() && s - (ranges_.back().first_ + ranges_.back().count_) <= maxGap_)
+			{
+				numCovered += s + 1 - (ranges_.back().first_ + ranges_.back().count_);
+				ranges_.back().count_ = s + 1 - ranges_.back().first_;
+			}
+			else
+			{
+				ranges_.push_back({ .first_ = s, .count_ = 1 });
+				numCovered++;
+			}
+		}
+
+		fullUpload = (float)numCovered > fullUploadRatio_ * (float)shapes.size();
+	}
+
+	if (fullUpload)
+	{
+		ranges_.clear();
+
+		if (!shapes.empty())
+			ranges_.push_back({ .first_ = 0, .count_ = (uint32_t)shapes.size() });
+	}
+
+	stats_.numRanges_ = (uint32_t)ranges_.size();
+	stats_.numShapes_ = 0;
+	stats_.fullUpload_ = fullUpload;
+
+	for (const auto& r: ranges_)
+	{
+		for (uint32_t i = r.first_ ; i != r.first_ + r.count_ ; i++)
+			shapeTransforms[i] = scene.globalTransform_[shapes[i].transformIndex];
+
+		stats_.numShapes_ += r.count_;
+	}
+
+	stats_.uploadedBytes_ = (uint64_t)stats_.numShapes_ * sizeof(mat4);
+	stats_.totalUploadedBytes_ += stats_.uploadedBytes_;
+
+	if (fullUpload)
+		stats_.numFullUploads_++;
+	else if (!ranges_.empty())
+		stats_.numPartialUploads_++;
+
+	return ranges_;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "shared/scene/Scene.h"
+#include "shared/scene/VtxData.h"
+
+/**
+	Partial uploads of shape transforms
+
+	recalculateGlobalTransforms() records the nodes it has updated (see takeRecalculatedNodes()). The tracker maps them
+	to the shapes which use their transforms and coalesces the dirty shapes into sorted ranges, so a renderer uploads only
+	the ranges instead of the whole transform buffer. Dirty shapes separated by at most 'maxGap_' clean ones share a range.
+	If the ranges cover more than 'fullUploadRatio_' of all the shapes, or all the transforms have changed, the whole buffer
+	is uploaded as one range
+*/
+
+struct TransformUploadRange
+{
+	// in shapes
+	uint32_t first_;
+	uint32_t count_;
+};
+
+struct TransformUploadStats
+{
+	// the last update()
+	uint32_t numRanges_ = 0;
+	uint32_t numShapes_ = 0;
+	uint64_t uploadedBytes_ = 0;
+	bool fullUpload_ = false;
+
+	// all the updates
+	uint64_t totalUploadedBytes_ = 0;
+	uint32_t numFullUploads_ = 0;
+	uint32_t numPartialUploads_ = 0;
+};
+
+struct TransformUploadTracker final
+{
+	/* Fills 'shapeTransforms' within the returned ranges with the global transforms of the shapes.
+	   The node-to-shape map is rebuilt when the number of nodes or shapes changes */
+	const std::vector<TransformUploadRange>& update(Scene& scene, const std::vector<DrawData>& shapes, std::vector<mat4>& shapeTransforms);
+
+	inline const TransformUploadStats& getStats() const { return stats_; }
+
+	uint32_t maxGap_ = 8;
+	float fullUploadRatio_ = 0.5f;
+
+private:
+	void mapNodesToShapes(const Scene& scene, const std::vector<DrawData>& shapes);
+
+	// the shapes of node 'n' are nodeShapes_[firstShapeForNode_[n] ... firstShapeForNode_[n + 1] - 1]
+	std::vector<uint32_t> firstShapeForNode_;
+	std::vector<uint32_t> nodeShapes_;
+
+	size_t numShapes_ = 0;
+
+	std::vector<int> nodes_;
+	std::vector<uint32_t> dirtyShapes_;
+	std::vector<TransformUploadRange> ranges_;
+
+	TransformUploadStats stats_;
+};
@@ -2,10 +2,82 @@
 
 #include <algorithm>
 #include <assert.h>
+#include <atomic>
+#include <chrono>
 #include <stdio.h>
+#include <string.h>
 
-MeshFileHeader loadMeshData(const char* meshFile, MeshData& out)
+#include <meshoptimizer.h>
+#include <taskflow/taskflow.hpp>
+
+static double millisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static uint32_t getMeshIndexCount(const Mesh& mesh)
+{
+	return mesh.lodOffset[mesh.lodCount] - mesh.lodOffset[0];
+}
+
+/* Every mesh is encoded separately, so the index blocks of meshes have to cover the index data without gaps and contain whole triangles */
+static bool canEncodeIndices(const MeshData& m)
 {
+	std::vector<std::pair<uint32_t, uint32_t>> blocks;
+	blocks.reserve(m.meshes_.size());
+
+	for (const Mesh& mesh: m.meshes_)
+		blocks.emplace_back(mesh.indexOffset, getMeshIndexCount(mesh));
+
+	std::sort(blocks.begin(), blocks.end());
+
+	uint32_t end = 0;
+
+	for (const auto& b: blocks)
+	{
+		if (b.first != end || b.second % 3)
+			return false;
+		end += b.second;
+	}
+
+	return end == m.indexData_.size();
+}
+
+/* Meshes are loaded concurrently (scene data, world streaming), one pool of workers serves all of them */
+static tf::Executor& getDecodeExecutor()
+{
+	static tf::Executor executor;
+	return executor;
+}
+
+static void decodeIndices(MeshData& out, const std::vector<uint32_t>& offsets, const std::vector<uint8_t>& encoded)
+{
+	std::atomic<bool> failed = false;
+
+	tf::Taskflow taskflow;
+
+	taskflow.for_each_index(0u, (uint32_t)out.meshes_.size(), 1u, [&](int i)
+		{
+			const Mesh& mesh = out.meshes_[i];
+
+			if (meshopt_decodeIndexBuffer(&out.indexData_[mesh.indexOffset], getMeshIndexCount(mesh), sizeof(uint32_t),
+				&encoded[offsets[i]], offsets[i + 1] - offsets[i]) != 0)
+				failed = true;
+		});
+
+	getDecodeExecutor().run(taskflow).wait();
+
+	if (failed)
+	{
+		printf("Unable to decode index data\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+MeshFileHeader loadMeshData(const char* meshFile, MeshData& out, MeshLoadStats* stats)
+{
+	const auto start = std::chrono::high_resolution_clock::now();
+
 	MeshFileHeader header;
 
 	FILE* f = fopen(meshFile, "rb");
@@ -24,6 +96,13 @@ MeshFileHeader loadMeshData(const char* meshFile, MeshData& out)
 		exit(EXIT_FAILURE);
 	}
 
+	// the size of Mesh changes with the file format
+	if (header.dataBlockStartOffset != sizeof(MeshFileHeader) + header.meshCount * sizeof(Mesh))
+	{
+		printf("Outdated mesh file %s. Please run the mesh converter again\n", meshFile);
+		exit(EXIT_FAILURE);
+	}
+
 	out.meshes_.resize(header.meshCount);
 	if (fread(out.meshes_.data(), sizeof(Mesh), header.meshCount, f) != header.meshCount)
 	{
@@ -40,7 +119,15 @@ MeshFileHeader loadMeshData(const char* meshFile, MeshData& out)
 	out.indexData_.resize(header.indexDataSize / sizeof(uint32_t));
 	out.vertexData_.resize(header.vertexDataSize / sizeof(float));
 
-	if ((fread(out.indexData_.data(), 1, header.indexDataSize, f) != header.indexDataSize) ||
+	std::vector<uint32_t> offsets(header.encodedIndexDataSize ? header.meshCount + 1 : 0);
+	std::vector<uint8_t> encoded(header.encodedIndexDataSize);
+
+	const bool indicesRead = header.encodedIndexDataSize ?
+		(fread(offsets.data(), sizeof(uint32_t), offsets.size(), f) == offsets.size()) &&
+		(fread(encoded.data(), 1, header.encodedIndexDataSize, f) == header.encodedIndexDataSize) :
+		(fread(out.indexData_.data(), 1, header.indexDataSize, f) == header.indexDataSize);
+
+	if (!indicesRead ||
 		(fread(out.vertexData_.data(), 1, header.vertexDataSize, f) != header.vertexDataSize))
 	{
 		printf("Unable to read index/vertex data\n");
@@ -49,28 +136,98 @@ MeshFileHeader loadMeshData(const char* meshFile, MeshData& out)
 
 	fclose(f);
 
+	double decodeMs = 0.0;
+
+	if (header.encodedIndexDataSize)
+	{
+		const auto decodeStart = std::chrono::high_resolution_clock::now();
+
+		decodeIndices(out, offsets, encoded);
+
+		decodeMs = millisecondsSince(decodeStart);
+	}
+
+	if (stats)
+		*stats = MeshLoadStats { .loadMs_ = millisecondsSince(start), .decodeMs_ = decodeMs };
+
 	return header;
 }
 
-void saveMeshData(const char* fileName, const MeshData& m)
+void printMeshLoadStats(const char* meshFile, const MeshFileHeader& header, const MeshLoadStats& stats)
+{
+	if (header.encodedIndexDataSize)
+		printf("Loaded %s in %.1f ms: indices %u KB -> %u KB decoded in %.1f ms\n", meshFile, stats.loadMs_,
+			header.encodedIndexDataSize / 1024, header.indexDataSize / 1024, stats.decodeMs_);
+	else
+		printf("Loaded %s in %.1f ms\n", meshFile, stats.loadMs_);
+}
+
+void saveMeshData(const char* fileName, const MeshData& m, bool encodeIndices)
 {
 	FILE *f = fopen(fileName, "wb");
 
+	std::vector<uint32_t> offsets;
+	std::vector<uint8_t> encoded;
+
+	if (encodeIndices && canEncodeIndices(m))
+	{
+		offsets.reserve(m.meshes_.size() + 1);
+
+		for (const Mesh& mesh: m.meshes_)
+		{
+			const uint32_t* indices = m.indexData_.data() + mesh.indexOffset;
+			const uint32_t numIndices = getMeshIndexCount(mesh);
+			const uint32_t numVertices = numIndices ? *std::max_element(indices, indices + numIndices) + 1 : 0;
+
+			offsets.push_back((uint32_t)encoded.size());
+
+			std::vector<uint8_t> buffer(meshopt_encodeIndexBufferBound(numIndices, numVertices));
+			buffer.resize(meshopt_encodeIndexBuffer(buffer.data(), buffer.size(), indices, numIndices));
+
+			mergeVectors(encoded, buffer);
+		}
+
+		offsets.push_back((uint32_t)encoded.size());
+	}
+	else if (encodeIndices)
+	{
+		printf("%s: meshes are not triangle lists covering all the indices, the indices are not encoded\n", fileName);
+	}
+
 	const MeshFileHeader header = {
 		.magicValue = 0x12345678,
 		.meshCount = (uint32_t)m.meshes_.size(),
 		.dataBlockStartOffset = (uint32_t )(sizeof(MeshFileHeader) + m.meshes_.size() * sizeof(Mesh)),
 		.indexDataSize = (uint32_t)(m.indexData_.size() * sizeof(uint32_t)),
-		.vertexDataSize = (uint32_t)(m.vertexData_.size() * sizeof(float))
+		.vertexDataSize = (uint32_t)(m.vertexData_.size() * sizeof(float)),
+		.encodedIndexDataSize = (uint32_t)encoded.size()
 	};
 
 	fwrite(&header, 1, sizeof(header), f);
 	fwrite(m.meshes_.data(), sizeof(Mesh), header.meshCount, f);
 	fwrite(m.boxes_.data(), sizeof(BoundingBox), header.meshCount, f);
-	fwrite(m.indexData_.data(), 1, header.indexDataSize, f);
+	if (header.encodedIndexDataSize)
+	{
+		fwrite(offsets.data(), sizeof(uint32_t), offsets.size(), f);
+		fwrite(encoded.data(), 1, encoded.size(), f);
+	}
+	else
+	{
+		fwrite(m.indexData_.data(), 1, header.indexDataSize, f);
+	}
 	fwrite(m.vertexData_.data(), 1, header.vertexDataSize, f);
 
 	fclose(f);
+
+	if (header.encodedIndexDataSize)
+	{
+		const uint32_t numShort = (uint32_t)std::count_if(m.meshes_.begin(), m.meshes_.end(), [](const Mesh& mesh) { return mesh.hasShortIndices(); });
+		const PackedIndexData packed = packIndexData(m);
+
+		printf("Saved %s: indices %u KB -> %u KB encoded, %u of %u meshes fit 16-bit indices (GPU index buffer %u KB -> %u KB)\n", fileName,
+			header.indexDataSize / 1024, header.encodedIndexDataSize / 1024, numShort, header.meshCount,
+			header.indexDataSize / 1024, (uint32_t)(packed.data_.size() * sizeof(uint32_t) / 1024));
+	}
 }
 
 void saveBoundingBoxes(const char* fileName, const std::vector<BoundingBox>& boxes)
@@ -126,14 +283,15 @@ MeshFileHeader mergeMeshData(MeshData& m, const std::vector<MeshData*> md)
 
 		uint32_t vtxOffset = totalVertexDataSize / 8;  /* 8 is the number of per-vertex attributes: position, normal + UV */
 
+		// m.vertexCount, m.lodCount and m.streamCount do not change
+		// indices stay relative to m.vertexOffset, so the meshes keep their 16-bit index ranges (see Mesh::hasShortIndices())
 		for (size_t j = 0 ; j < (uint32_t)i->meshes_.size() ; j++)
-			// m.vertexCount, m.lodCount and m.streamCount do not change
-			// m.vertexOffset also does not change, because vertex offsets are local (i.e., baked into the indices)
-			m.meshes_[offs + j].indexOffset += totalIndexDataSize;
-
-		// shift individual indices
-		for(size_t j = 0 ; j < i->indexData_.size() ; j++)
-			m.indexData_[totalIndexDataSize + j] += vtxOffset;
+		{
+			Mesh& mesh = m.meshes_[offs + j];
+			mesh.indexOffset += totalIndexDataSize;
+			mesh.vertexOffset += vtxOffset;
+			mesh.streamOffset[0] += vtxOffset * mesh.streamElementSize[0];
+		}
 
 		offs += (uint32_t)i->meshes_.size();
 
@@ -146,7 +304,8 @@ MeshFileHeader mergeMeshData(MeshData& m, const std::vector<MeshData*> md)
 		.meshCount = (uint32_t)offs,
 		.dataBlockStartOffset = (uint32_t )(sizeof(MeshFileHeader) + offs * sizeof(Mesh)),
 		.indexDataSize = static_cast<uint32_t>(totalIndexDataSize * sizeof(uint32_t)),
-		.vertexDataSize = static_cast<uint32_t>(totalVertexDataSize * sizeof(float))
+		.vertexDataSize = static_cast<uint32_t>(totalVertexDataSize * sizeof(float)),
+		.encodedIndexDataSize = 0
 	};
 }
 
@@ -172,3 +331,66 @@ void recalculateBoundingBoxes(MeshData& m)
 		m.boxes_.emplace_back(vmin, vmax);
 	}
 }
+
+PackedIndexData packIndexData(const MeshData& m)
+{
+	PackedIndexData p;
+	p.meshIndexOffsets_.resize(m.meshes_.size());
+
+	for (const Mesh& mesh: m.meshes_)
+		(mesh.hasShortIndices() ? p.numShortIndices_ : p.numLongIndices_) += getMeshIndexCount(mesh);
+
+	// the 32-bit indices start at a word boundary
+	const uint32_t longIndicesStart = (p.numShortIndices_ + 1) / 2;
+	p.data_.resize(longIndicesStart + p.numLongIndices_, 0);
+
+	uint32_t shortOffset = 0;
+	uint32_t longOffset = longIndicesStart;
+
+	for (size_t i = 0 ; i != m.meshes_.size() ; i++)
+	{
+		const Mesh& mesh = m.meshes_[i];
+		const uint32_t* indices = m.indexData_.data() + mesh.indexOffset;
+		const uint32_t numIndices = getMeshIndexCount(mesh);
+
+		if (mesh.hasShortIndices())
+		{
+			p.meshIndexOffsets_[i] = shortOffset;
+			for (uint32_t j = 0 ; j != numIndices ; j++, shortOffset++)
+			{
+				assert(indices[j] <= 0xFFFF);
+				p.data_[shortOffset / 2] |= indices[j] << (16 * (shortOffset % 2));
+			}
+		}
+		else
+		{
+			p.meshIndexOffsets_[i] = longOffset;
+			memcpy(p.data_.data() + longOffset, indices, numIndices * sizeof(uint32_t));
+			longOffset += numIndices;
+		}
+	}
+
+	return p;
+}
+
+void sortDrawDataForInstancing(std::vector<DrawData>& shapes)
+{
+	std::sort(shapes.begin(), shapes.end(), [](const DrawData& a, const DrawData& b)
+		{
+			if (a.meshIndex != b.meshIndex) return a.meshIndex < b.meshIndex;
+			if (a.LOD != b.LOD) return a.LOD < b.LOD;
+			if (a.materialIndex != b.materialIndex) return a.materialIndex < b.materialIndex;
+			return a.transformIndex < b.transformIndex;
+		});
+}
+
+uint32_t getInstancedDrawCount(const std::vector<DrawData>& shapes)
+{
+	uint32_t count = 0;
+
+	for (size_t i = 0 ; i != shapes.size() ; i++)
+		if (i == 0 || !canDrawAsInstances(shapes[i - 1], shapes[i]))
+			count++;
+
+	return count;
+}
@@ -36,6 +36,20 @@ struct Mesh final
 		return lodOffset[lod + 1] - lodOffset[lod];
 	}
 
+	/* Vertex range of every LOD relative to vertexOffset (indices are relative to vertexOffset as well).
+	   Coarser LODs reference their own compact copies of the vertices they use (see shared/scene/MeshLods.h) */
+	uint32_t lodVertexOffset[kMaxLODs] = { 0 };
+	uint32_t lodVertexCount[kMaxLODs] = { 0 };
+
+	/* Indices are relative to vertexOffset, so the meshes with up to 65536 vertices can be drawn with 16-bit indices
+	   (meshes without LOD vertex ranges are checked by their vertex count) */
+	inline bool hasShortIndices() const {
+		uint32_t numVertices = 0;
+		for (uint32_t l = 0 ; l != lodCount ; l++)
+			numVertices = std::max(numVertices, lodVertexOffset[l] + lodVertexCount[l]);
+		return (numVertices ? numVertices : vertexCount) <= 65536;
+	}
+
 	/* All the data "pointers" for all the streams */
 	uint32_t streamOffset[kMaxStreams] = { 0 };
 
@@ -59,12 +73,16 @@ struct MeshFileHeader
 	/* The offset to combined mesh data (this is the base from which the offsets in individual meshes start) */
 	uint32_t dataBlockStartOffset;
 
-	/* How much space index data takes */
+	/* How much space index data takes (decoded 32-bit indices) */
 	uint32_t indexDataSize;
 
 	/* How much space vertex data takes */
 	uint32_t vertexDataSize;
 
+	/* How much space index data encoded with meshopt_encodeIndexBuffer() takes in the file (0 if the indices are stored as is).
+	   The encoded indices are preceded by (meshCount + 1) offsets of the index blocks of individual meshes */
+	uint32_t encodedIndexDataSize;
+
 	/* According to your needs, you may add additional metadata fields */
 };
 
@@ -89,10 +107,54 @@ struct MeshData
 static_assert(sizeof(DrawData) == sizeof(uint32_t) * 6);
 static_assert(sizeof(BoundingBox) == sizeof(float) * 6);
 
-MeshFileHeader loadMeshData(const char* meshFile, MeshData& out);
-void saveMeshData(const char* fileName, const MeshData& m);
+struct MeshLoadStats
+{
+	double loadMs_ = 0.0;
+	// 0 if the indices are not encoded
+	double decodeMs_ = 0.0;
+};
+
+/* Index blocks of meshes are decoded on worker threads shared by all the calls */
+MeshFileHeader loadMeshData(const char* meshFile, MeshData& out, MeshLoadStats* stats = nullptr);
+void printMeshLoadStats(const char* meshFile, const MeshFileHeader& header, const MeshLoadStats& stats);
+/* Falls back to plain 32-bit indices if the meshes do not split the index data into triangle lists */
+void saveMeshData(const char* fileName, const MeshData& m, bool encodeIndices = true);
 
 void recalculateBoundingBoxes(MeshData& m);
 
 // Combine a list of meshes to a single mesh container
 MeshFileHeader mergeMeshData(MeshData& m, const std::vector<MeshData*> md);
+
+/**
+	GPU index data with every mesh in the smallest index type it fits (see Mesh::hasShortIndices()).
+	The 16-bit indices come first (two per 32-bit word, the lower half first), the 32-bit indices follow.
+	The first index of every mesh is counted in elements of its own index type from the beginning of the data,
+	so it is the 'firstIndex' of a draw command with that index type
+*/
+struct PackedIndexData
+{
+	std::vector<uint32_t> data_;
+	std::vector<uint32_t> meshIndexOffsets_;
+
+	uint32_t numShortIndices_ = 0;
+	uint32_t numLongIndices_ = 0;
+
+	/* 'indexOffset' in the decoded 32-bit data (e.g. DrawData::indexOffset) of mesh 'meshIndex' in the packed data */
+	inline uint32_t getFirstIndex(const MeshData& m, uint32_t meshIndex, uint32_t indexOffset) const {
+		return meshIndexOffsets_[meshIndex] + indexOffset - m.meshes_[meshIndex].indexOffset;
+	}
+};
+
+PackedIndexData packIndexData(const MeshData& m);
+
+/* Shapes with the same mesh, LOD and material can be drawn by one command with several instances */
+inline bool canDrawAsInstances(const DrawData& a, const DrawData& b)
+{
+	return a.meshIndex == b.meshIndex && a.LOD == b.LOD && a.materialIndex == b.materialIndex;
+}
+
+/* Puts the instances of every mesh and material next to each other (sorted by transform index within a group) */
+void sortDrawDataForInstancing(std::vector<DrawData>& shapes);
+
+/* The number of instanced draw commands for sorted shapes */
+uint32_t getInstancedDrawCount(const std::vector<DrawData>& shapes);
@@ -0,0 +1,656 @@
+#include "shared/scene/WorldStreaming.h"
+#include "shared/scene/MergeUtil.h"
+#include "shared/Utils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+
+void saveStringList(FILE* f, const std::vector<std::string>& lines);
+void loadStringList(FILE* f, std::vector<std::string>& lines);
+
+namespace
+{
+
+constexpr uint32_t kFloatsPerVertex = 8;
+
+constexpr uint64_t kVertexSize = kFloatsPerVertex * sizeof(float);
+constexpr uint64_t kIndexSize = sizeof(uint32_t);
+
+/* The BoundingBox constructor sorts its corners, so an empty box for combinePoint() is made here */
+BoundingBox getEmptyBox()
+{
+	BoundingBox box;
+	box.min_ = vec3(std::numeric_limits<float>::max());
+	box.max_ = vec3(std::numeric_limits<float>::lowest());
+	return box;
+}
+
+mat4 getGlobalTransform(const Scene& scene, int node)
+{
+	mat4 m = scene.localTransform_[node];
+
+	for (int p = scene.hierarchy_[node].parent_ ; p > -1 ; p = scene.hierarchy_[p].parent_)
+		m = scene.localTransform_[p] * m;
+
+	return m;
+}
+
+uint64_t remapTexture(uint64_t texture, const std::vector<std::string>& srcFiles, std::vector<std::string>& dstFiles)
+{
+	if (texture == INVALID_TEXTURE || texture >= srcFiles.size())
+		return INVALID_TEXTURE;
+
+	const int idx = addUnique(dstFiles, srcFiles[texture]);
+
+	return idx < 0 ? INVALID_TEXTURE : (uint64_t)idx;
+}
+
+void remapTextures(MaterialDescription& m, const std::vector<std::string>& srcFiles, std::vector<std::string>& dstFiles)
+{
+	m.ambientOcclusionMap_  = remapTexture(m.ambientOcclusionMap_,  srcFiles, dstFiles);
+	m.emissiveMap_          = remapTexture(m.emissiveMap_,          srcFiles, dstFiles);
+	m.albedoMap_            = remapTexture(m.albedoMap_,            srcFiles, dstFiles);
+	m.metallicRoughnessMap_ = remapTexture(m.metallicRoughnessMap_, srcFiles, dstFiles);
+	m.normalMap_            = remapTexture(m.normalMap_,            srcFiles, dstFiles);
+	m.opacityMap_           = remapTexture(m.opacityMap_,           srcFiles, dstFiles);
+}
+
+/* The budget is split between the pools in the proportion of the vertex and index data of the whole world */
+uint32_t getPoolCapacity(const WorldDescription& world, uint64_t budget, bool indices)
+{
+	uint64_t vertexBytes = 0;
+	uint64_t indexBytes = 0;
+
+	for (const auto& s: world.sectors_)
+	{
+		vertexBytes += s.vertexCount_ * kVertexSize;
+		indexBytes += s.indexCount_ * kIndexSize;
+	}
+
+	if (vertexBytes + indexBytes == 0)
+		return 0;
+
+	const double share = (double)(indices ? indexBytes : vertexBytes) / (double)(vertexBytes + indexBytes);
+
+	return (uint32_t)std::min<uint64_t>((uint64_t)(share * (double)budget) / (indices ? kIndexSize : kVertexSize), UINT32_MAX);
+}
+
+} // namespace
+
+void saveWorld(const char* fileName, const WorldDescription& world)
+{
+	FILE* f = fopen(fileName, "wb");
+
+	if (!f)
+	{
+		printf("Cannot write world file '%s'\n", fileName);
+		exit(EXIT_FAILURE);
+	}
+
+	const uint32_t sz = (uint32_t)world.sectors_.size();
+	fwrite(&sz, sizeof(sz), 1, f);
+	fwrite(&world.sectorSize_, sizeof(float), 1, f);
+	fwrite(world.sectors_.data(), sizeof(WorldSector), sz, f);
+	saveStringList(f, world.sectorFiles_);
+
+	fclose(f);
+}
+
+void loadWorld(const char* fileName, WorldDescription& world)
+{
+	FILE* f = fopen(fileName, "rb");
+
+	if (!f)
+	{
+		printf("Cannot open world file '%s'. Please run Ch10_Util01_WorldStreaming with the 'partition' argument\n", fileName);
+		exit(EXIT_FAILURE);
+	}
+
+	uint32_t sz = 0;
+	if (fread(&sz, sizeof(sz), 1, f) != 1 || fread(&world.sectorSize_, sizeof(float), 1, f) != 1)
+	{
+		printf("Unable to read world file '%s'\n", fileName);
+		exit(EXIT_FAILURE);
+	}
+
+	world.sectors_.resize(sz);
+	if (fread(world.sectors_.data(), sizeof(WorldSector), sz, f) != sz)
+	{
+		printf("Unable to read world sectors from '%s'\n", fileName);
+		exit(EXIT_FAILURE);
+	}
+	loadStringList(f, world.sectorFiles_);
+
+	fclose(f);
+
+	for (const auto& s: world.sectors_)
+		if (s.fileIndex_ >= world.sectorFiles_.size())
+		{
+			printf("Invalid sector file index %u in '%s'\n", s.fileIndex_, fileName);
+			exit(EXIT_FAILURE);
+		}
+}
+
+WorldDescription partitionWorld(const Scene& scene, const MeshData& meshData,
+	const std::vector<MaterialDescription>& materials, const std::vector<std::string>& textureFiles,
+	float sectorSize, const char* outputPrefix, int tilesX, int tilesZ)
+{
+	WorldDescription world;
+	world.sectorSize_ = sectorSize;
+
+	// (x, z) -> mesh nodes, std::map keeps the sector order deterministic
+	std::map<std::pair<int, int>, std::vector<int>> cells;
+	std::unordered_map<int, mat4> globals;
+
+	BoundingBox sceneBox = getEmptyBox();
+
+	for (const auto& n: scene.meshes_)
+	{
+		const mat4 m = getGlobalTransform(scene, n.first);
+		const BoundingBox box = meshData.boxes_[n.second].getTransformed(m);
+		const vec3 c = box.getCenter();
+
+		globals[n.first] = m;
+		sceneBox.combinePoint(box.min_);
+		sceneBox.combinePoint(box.max_);
+		cells[{ (int)floorf(c.x / sectorSize), (int)floorf(c.z / sectorSize) }].push_back(n.first);
+	}
+
+	std::vector<WorldSector> baseSectors;
+
+	for (auto& cell: cells)
+	{
+		auto& nodes = cell.second;
+		std::sort(nodes.begin(), nodes.end());
+
+		Scene s;
+		MeshData md;
+		std::vector<MaterialDescription> mats;
+		std::vector<std::string> files;
+		std::unordered_map<uint32_t, uint32_t> meshMap;
+		std::unordered_map<uint32_t, uint32_t> materialMap;
+
+		const std::string name = std::string(outputPrefix) + "_" + std::to_string(cell.first.first) + "_" + std::to_string(cell.first.second);
+
+		addNode(s, -1, 0);
+		setNodeName(s, 0, "Sector" + name.substr(name.find_last_of("/\\") + 1));
+
+		for (int node: nodes)
+		{
+			const uint32_t mesh = scene.meshes_.at(node);
+
+			if (!meshMap.contains(mesh))
+				meshMap[mesh] = copyMesh(meshData, mesh, md);
+
+			const int n = addNode(s, 0, 1);
+			s.localTransform_[n] = globals[node];
+			s.globalTransform_[n] = globals[node];
+			s.meshes_[n] = meshMap[mesh];
+
+			const auto mtl = scene.materialForNode_.find(node);
+			if (mtl != scene.materialForNode_.end())
+			{
+				if (!materialMap.contains(mtl->second))
+				{
+					MaterialDescription d = materials[mtl->second];
+					remapTextures(d, textureFiles, files);
+					materialMap[mtl->second] = (uint32_t)mats.size();
+					mats.push_back(d);
+				}
+				s.materialForNode_[n] = materialMap[mtl->second];
+			}
+
+			const std::string nodeName = getNodeName(scene, node);
+			if (!nodeName.empty())
+				setNodeName(s, n, nodeName);
+		}
+
+		recalculateBoundingBoxes(md);
+
+		BoundingBox box = getEmptyBox();
+		for (const auto& n: s.meshes_)
+		{
+			const BoundingBox b = md.boxes_[n.second].getTransformed(s.localTransform_[n.first]);
+			box.combinePoint(b.min_);
+			box.combinePoint(b.max_);
+		}
+
+		saveMeshData((name + ".meshes").c_str(), md);
+		saveScene((name + ".scene").c_str(), s);
+		saveMaterials((name + ".materials").c_str(), mats, files);
+
+		baseSectors.push_back(WorldSector {
+			.box_ = box,
+			.offset_ = vec3(0.0f),
+			.fileIndex_ = (uint32_t)world.sectorFiles_.size(),
+			.vertexCount_ = (uint32_t)(md.vertexData_.size() / kFloatsPerVertex),
+			.indexCount_ = (uint32_t)md.indexData_.size(),
+			.meshCount_ = (uint32_t)md.meshes_.size(),
+			.materialCount_ = (uint32_t)mats.size(),
+			.nodeCount_ = (uint32_t)s.hierarchy_.size()
+		});
+		world.sectorFiles_.push_back(name);
+	}
+
+	// tiles touch each other along X and Z
+	const vec3 tileSize = sceneBox.getSize();
+
+	for (int z = 0 ; z < tilesZ ; z++)
+		for (int x = 0 ; x < tilesX ; x++)
+			for (WorldSector s: baseSectors)
+			{
+				s.offset_ = vec3((float)x * tileSize.x, 0.0f, (float)z * tileSize.z);
+				s.box_ = BoundingBox(s.box_.min_ + s.offset_, s.box_.max_ + s.offset_);
+				world.sectors_.push_back(s);
+			}
+
+	return world;
+}
+
+bool RangeAllocator::allocate(uint32_t size, uint32_t& offset)
+{
+	for (auto i = freeRanges_.begin() ; i != freeRanges_.end() ; i++)
+	{
+		if (i->second < size)
+			continue;
+
+		offset = i->first;
+		i->first += size;
+		i->second -= size;
+
+		if (!i->second)
+			freeRanges_.erase(i);
+
+		return true;
+	}
+
+	return false;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t size)
+{
+	if (!size)
+		return;
+
+	auto next = std::lower_bound(freeRanges_.begin(), freeRanges_.end(), std::make_pair(offset, 0u));
+	auto i = freeRanges_.insert(next, { offset, size });
+
+	// merge with the next range and then with the previous one
+	if (i + 1 != freeRanges_.end() && i->first + i->second == (i + 1)->first)
+	{
+		i->second += (i + 1)->second;
+		freeRanges_.erase(i + 1);
+	}
+
+	if (i != freeRanges_.begin() && (i - 1)->first + (i - 1)->second == i->first)
+	{
+		(i - 1)->second += i->second;
+		freeRanges_.erase(i);
+	}
+}
+
+StreamedWorld::StreamedWorld(const WorldDescription& world, const WorldStreamingParams& params)
+: world_(world)
+, params_(params)
+, sectors_(world.sectors_.size())
+, vertexPool_(getPoolCapacity(world, params.memoryBudget_, false))
+, indexPool_(getPoolCapacity(world, params.memoryBudget_, true))
+{
+	meshData_.vertexData_.resize((size_t)vertexPool_.getCapacity() * kFloatsPerVertex);
+	meshData_.indexData_.resize(indexPool_.getCapacity());
+
+	addNode(scene_, -1, 0);
+	setNodeName(scene_, 0, "World");
+}
+
+StreamedWorld::~StreamedWorld()
+{
+	finishLoads();
+}
+
+void StreamedWorld::finishLoads()
+{
+	for (auto& s: sectors_)
+		if (s.loading_.valid())
+			s.loading_.wait();
+}
+
+float StreamedWorld::getSectorDistance(uint32_t sector, const vec3& p) const
+{
+	const BoundingBox& box = world_.sectors_[sector].box_;
+
+	return glm::length(glm::max(glm::max(box.min_ - p, p - box.max_), vec3(0.0f)));
+}
+
+uint64_t StreamedWorld::getSectorSize(uint32_t sector) const
+{
+	const WorldSector& s = world_.sectors_[sector];
+
+	return s.vertexCount_ * kVertexSize + s.indexCount_ * kIndexSize;
+}
+
+std::vector<WorldUpload> StreamedWorld::takeUploads()
+{
+	return std::move(uploads_);
+}
+
+uint32_t StreamedWorld::allocateSlot(std::vector<uint32_t>& freeSlots, uint32_t& count)
+{
+	if (freeSlots.empty())
+		return count++;
+
+	const uint32_t slot = freeSlots.back();
+	freeSlots.pop_back();
+
+	return slot;
+}
+
+bool StreamedWorld::reserve(uint32_t sector)
+{
+	const WorldSector& s = world_.sectors_[sector];
+	SectorSlot& slot = sectors_[sector];
+
+	if (stats_.reservedBytes_ + getSectorSize(sector) > params_.memoryBudget_)
+		return false;
+
+	if (!vertexPool_.allocate(s.vertexCount_, slot.vertexOffset_))
+		return false;
+
+	if (!indexPool_.allocate(s.indexCount_, slot.indexOffset_))
+	{
+		vertexPool_.free(slot.vertexOffset_, s.vertexCount_);
+		return false;
+	}
+
+	stats_.reservedBytes_ += getSectorSize(sector);
+
+	return true;
+}
+
+void StreamedWorld::release(uint32_t sector)
+{
+	const WorldSector& s = world_.sectors_[sector];
+	SectorSlot& slot = sectors_[sector];
+
+	vertexPool_.free(slot.vertexOffset_, s.vertexCount_);
+	indexPool_.free(slot.indexOffset_, s.indexCount_);
+	stats_.reservedBytes_ -= getSectorSize(sector);
+
+	for (uint32_t m: slot.meshes_)
+	{
+		meshData_.meshes_[m] = Mesh();
+		meshData_.boxes_[m] = BoundingBox();
+		freeMeshSlots_.push_back(m);
+	}
+
+	for (uint32_t m: slot.materials_)
+	{
+		materials_[m] = MaterialDescription();
+		freeMaterialSlots_.push_back(m);
+	}
+
+	slot.meshes_.clear();
+	slot.materials_.clear();
+	slot.rootNode_ = -1;
+	slot.state_ = eSectorState_Unloaded;
+}
+
+void StreamedWorld::splice(uint32_t sector, LoadedSector& loaded, SceneEditBatch& edits, std::vector<uint32_t>& insertedSectors)
+{
+	const WorldSector& s = world_.sectors_[sector];
+	SectorSlot& slot = sectors_[sector];
+
+	if (loaded.meshData_.vertexData_.size() != s.vertexCount_ * kFloatsPerVertex || loaded.meshData_.indexData_.size() != s.indexCount_ ||
+		loaded.scene_.hierarchy_.empty() || loaded.scene_.hierarchy_.size() != s.nodeCount_)
+	{
+		printf("Sector file '%s' does not match the world description\n", world_.sectorFiles_[s.fileIndex_].c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	std::copy(loaded.meshData_.vertexData_.begin(), loaded.meshData_.vertexData_.end(), meshData_.vertexData_.begin() + (size_t)slot.vertexOffset_ * kFloatsPerVertex);
+	std::copy(loaded.meshData_.indexData_.begin(), loaded.meshData_.indexData_.end(), meshData_.indexData_.begin() + slot.indexOffset_);
+
+	uploads_.push_back({ .indices_ = false, .offset_ = slot.vertexOffset_, .count_ = s.vertexCount_ });
+	uploads_.push_back({ .indices_ = true,  .offset_ = slot.indexOffset_,  .count_ = s.indexCount_ });
+
+	for (size_t i = 0 ; i != loaded.meshData_.meshes_.size() ; i++)
+	{
+		Mesh mesh = loaded.meshData_.meshes_[i];
+		mesh.vertexOffset += slot.vertexOffset_;
+		mesh.indexOffset += slot.indexOffset_;
+		mesh.streamOffset[0] = mesh.vertexOffset * mesh.streamElementSize[0];
+
+		const uint32_t m = allocateSlot(freeMeshSlots_, numMeshSlots_);
+		meshData_.meshes_.resize(numMeshSlots_);
+		meshData_.boxes_.resize(numMeshSlots_);
+		meshData_.meshes_[m] = mesh;
+		meshData_.boxes_[m] = i < loaded.meshData_.boxes_.size() ? loaded.meshData_.boxes_[i] : BoundingBox();
+		slot.meshes_.push_back(m);
+	}
+
+	for (auto& mtl: loaded.materials_)
+	{
+		remapTextures(mtl, loaded.textureFiles_, textureFiles_);
+
+		const uint32_t m = allocateSlot(freeMaterialSlots_, numMaterialSlots_);
+		materials_.resize(numMaterialSlots_);
+		materials_[m] = mtl;
+		slot.materials_.push_back(m);
+	}
+
+	for (auto& n: loaded.scene_.meshes_)
+		n.second = slot.meshes_[n.second];
+
+	for (auto& n: loaded.scene_.materialForNode_)
+		n.second = slot.materials_[n.second];
+
+	loaded.scene_.localTransform_[0] = glm::translate(mat4(1.0f), s.offset_) * loaded.scene_.localTransform_[0];
+
+	edits.insertSubtree(loaded.scene_, 0);
+	insertedSectors.push_back(sector);
+
+	slot.state_ = eSectorState_Resident;
+	stats_.numLoaded_++;
+}
+
+bool StreamedWorld::update(const vec3& cameraPos)
+{
+	SceneEditBatch edits;
+	// the loaded scenes are referenced by 'edits' until they are applied
+	std::vector<std::unique_ptr<LoadedSector>> finished;
+	std::vector<uint32_t> insertedSectors;
+
+	const uint32_t numSectors = (uint32_t)sectors_.size();
+
+	// 1. Splice the sectors whose files have been read
+	for (uint32_t i = 0 ; i != numSectors ; i++)
+	{
+		SectorSlot& slot = sectors_[i];
+
+		if (slot.state_ != eSectorState_Loading || slot.loading_.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			continue;
+
+		finished.push_back(slot.loading_.get());
+		splice(i, *finished.back(), edits, insertedSectors);
+	}
+
+	auto unload = [this, &edits](uint32_t i)
+	{
+		edits.deleteNode(sectors_[i].rootNode_);
+		release(i);
+		stats_.numUnloaded_++;
+	};
+
+	// 2. Unload the far sectors (the ones spliced above are not in the scene yet)
+	for (uint32_t i = 0 ; i != numSectors ; i++)
+		if (sectors_[i].state_ == eSectorState_Resident && sectors_[i].rootNode_ > -1 && getSectorDistance(i, cameraPos) > params_.unloadRadius_)
+			unload(i);
+
+	// 3. Start loading the nearest sectors, resident sectors farther than a candidate are evicted when the budget is exhausted
+	std::vector<std::pair<float, uint32_t>> candidates;
+	std::vector<std::pair<float, uint32_t>> evictable;
+	uint32_t numLoading = 0;
+
+	for (uint32_t i = 0 ; i != numSectors ; i++)
+	{
+		const float d = getSectorDistance(i, cameraPos);
+
+		if (sectors_[i].state_ == eSectorState_Unloaded && d <= params_.loadRadius_)
+			candidates.push_back({ d, i });
+		else if (sectors_[i].state_ == eSectorState_Resident && sectors_[i].rootNode_ > -1)
+			evictable.push_back({ d, i });
+		else if (sectors_[i].state_ == eSectorState_Loading)
+			numLoading++;
+	}
+
+	std::sort(candidates.begin(), candidates.end());
+	// the farthest ones are at the end
+	std::sort(evictable.begin(), evictable.end());
+
+	for (const auto& c: candidates)
+	{
+		if (numLoading >= params_.maxLoadsInFlight_)
+			break;
+
+		bool reserved = reserve(c.second);
+
+		while (!reserved && !evictable.empty() && evictable.back().first > c.first)
+		{
+			unload(evictable.back().second);
+			evictable.pop_back();
+			reserved = reserve(c.second);
+		}
+
+		if (!reserved)
+		{
+			stats_.numPostponed_++;
+			break;
+		}
+
+		SectorSlot& slot = sectors_[c.second];
+		slot.state_ = eSectorState_Loading;
+		slot.loading_ = std::async(std::launch::async, [](std::string fileName)
+			{
+				auto s = std::make_unique<LoadedSector>();
+				loadMeshData((fileName + ".meshes").c_str(), s->meshData_);
+				loadScene((fileName + ".scene").c_str(), s->scene_);
+				loadMaterials((fileName + ".materials").c_str(), s->materials_, s->textureFiles_);
+				return s;
+			}, world_.sectorFiles_[world_.sectors_[c.second].fileIndex_]);
+		numLoading++;
+	}
+
+	// 4. All the insertions and deletions of this frame are applied at once
+	const bool changed = !edits.deletedNodes_.empty() || !edits.insertedSubtrees_.empty();
+
+	if (changed)
+	{
+		std::vector<int> insertedRoots;
+		const std::vector<int> newIndices = applySceneEdits(scene_, edits, &insertedRoots);
+
+		for (auto& s: sectors_)
+			if (s.rootNode_ > -1)
+				s.rootNode_ = newIndices[s.rootNode_];
+
+		// one subtree per inserted sector, in the order of insertion
+		for (size_t i = 0 ; i != insertedSectors.size() ; i++)
+			sectors_[insertedSectors[i]].rootNode_ = insertedRoots[i];
+
+		// the names of the unloaded sectors, otherwise names_ grows with every load
+		if (!edits.deletedNodes_.empty())
+			compactSceneNames(scene_);
+	}
+
+	stats_.numResident_ = 0;
+	stats_.numLoading_ = numLoading;
+	stats_.residentBytes_ = 0;
+
+	for (uint32_t i = 0 ; i != numSectors ; i++)
+		if (sectors_[i].state_ == eSectorState_Resident)
+		{
+			stats_.numResident_++;
+			stats_.residentBytes_ += getSectorSize(i);
+		}
+
+	return changed;
+}
+
+bool StreamedWorld::checkConsistency() const
+{
+	if (scene_.hierarchy_.empty() || scene_.hierarchy_[0].parent_ != -1)
+	{
+		printf("StreamedWorld: node 0 is not the world root\n");
+		return false;
+	}
+
+	std::vector<bool> usedMeshes(meshData_.meshes_.size(), false);
+	std::vector<bool> usedMaterials(materials_.size(), false);
+	size_t numNodes = 1;
+	uint32_t numRoots = 0;
+	uint64_t reserved = 0;
+
+	for (uint32_t i = 0 ; i != sectors_.size() ; i++)
+	{
+		const SectorSlot& slot = sectors_[i];
+		const WorldSector& s = world_.sectors_[i];
+
+		if (slot.state_ != eSectorState_Unloaded)
+			reserved += getSectorSize(i);
+
+		if (slot.state_ != eSectorState_Resident)
+			continue;
+
+		if (slot.rootNode_ < 1 || slot.rootNode_ >= (int)scene_.hierarchy_.size() || scene_.hierarchy_[slot.rootNode_].parent_ != 0)
+		{
+			printf("StreamedWorld: the root node of sector %u is not a child of the world root\n", i);
+			return false;
+		}
+
+		if (slot.vertexOffset_ + s.vertexCount_ > vertexPool_.getCapacity() || slot.indexOffset_ + s.indexCount_ > indexPool_.getCapacity())
+		{
+			printf("StreamedWorld: sector %u is outside of the pools\n", i);
+			return false;
+		}
+
+		for (uint32_t m: slot.meshes_) usedMeshes[m] = true;
+		for (uint32_t m: slot.materials_) usedMaterials[m] = true;
+
+		numNodes += s.nodeCount_;
+		numRoots++;
+	}
+
+	if (numNodes != scene_.hierarchy_.size() || reserved != stats_.reservedBytes_ || reserved > params_.memoryBudget_)
+	{
+		printf("StreamedWorld: %zu nodes (expected %zu), %llu bytes reserved (expected %llu)\n",
+			scene_.hierarchy_.size(), numNodes, (unsigned long long)stats_.reservedBytes_, (unsigned long long)reserved);
+		return false;
+	}
+
+	uint32_t numChildren = 0;
+	for (int c = scene_.hierarchy_[0].firstChild_ ; c > -1 ; c = scene_.hierarchy_[c].nextSibling_)
+		numChildren++;
+
+	if (numChildren != numRoots)
+	{
+		printf("StreamedWorld: the world root has %u children, %u sectors are resident\n", numChildren, numRoots);
+		return false;
+	}
+
+	for (const auto& n: scene_.meshes_)
+		if (n.second >= usedMeshes.size() || !usedMeshes[n.second])
+		{
+			printf("StreamedWorld: node %u references the free mesh slot %u\n", n.first, n.second);
+			return false;
+		}
+
+	for (const auto& n: scene_.materialForNode_)
+		if (n.second >= usedMaterials.size() || !usedMaterials[n.second])
+		{
+			printf("StreamedWorld: node %u references the free material slot %u\n", n.first, n.second);
+			return false;
+		}
+
+	return true;
+}
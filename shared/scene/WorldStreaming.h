@@ -0,0 +1,196 @@
+#pragma once
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "shared/UtilsMath.h"
+#include "shared/scene/Material.h"
+#include "shared/scene/Scene.h"
+#include "shared/scene/VtxData.h"
+
+/**
+	Sector-based world streaming
+
+	A world is a grid of sectors. Every sector is a small scene (a root node with flattened mesh nodes) with its own
+	.meshes, .scene and .materials files, so it can be loaded without the rest of the world. The same sector files
+	can be placed several times with different offsets (e.g., a city made of Bistro tiles).
+
+	StreamedWorld keeps the sectors near the camera resident: files are read on worker threads, finished sectors are spliced
+	into one live Scene (see SceneEditBatch) and into fixed-size vertex and index pools. Renderers upload only the changed
+	ranges of the pools (see takeUploads() and GLStreamedWorldBuffers), so loading never reallocates GPU buffers.
+*/
+
+struct WorldSector
+{
+	// world space, 'offset_' applied
+	BoundingBox box_;
+	vec3 offset_;
+	uint32_t fileIndex_;
+	uint32_t vertexCount_;
+	uint32_t indexCount_;
+	uint32_t meshCount_;
+	uint32_t materialCount_;
+	uint32_t nodeCount_;
+};
+
+struct WorldDescription
+{
+	float sectorSize_ = 0.0f;
+	std::vector<WorldSector> sectors_;
+	// sector file names without extensions (".meshes", ".scene" and ".materials" are appended)
+	std::vector<std::string> sectorFiles_;
+};
+
+void saveWorld(const char* fileName, const WorldDescription& world);
+void loadWorld(const char* fileName, WorldDescription& world);
+
+/**
+	Mesh nodes are assigned to sectors of a 'sectorSize' grid in the XZ plane by the centers of their world space boxes.
+	Global transforms are baked into the local transforms of sector nodes, meshes and materials are copied into every sector
+	which uses them. Sector files are written as '<outputPrefix>_<x>_<z>.*'. The world consists of tilesX x tilesZ copies
+	of the scene placed next to each other
+*/
+WorldDescription partitionWorld(const Scene& scene, const MeshData& meshData,
+	const std::vector<MaterialDescription>& materials, const std::vector<std::string>& textureFiles,
+	float sectorSize, const char* outputPrefix, int tilesX = 1, int tilesZ = 1);
+
+/* First-fit allocator of element ranges in a pool, neighbouring free ranges are merged */
+class RangeAllocator
+{
+public:
+	explicit RangeAllocator(uint32_t capacity): capacity_(capacity), freeRanges_({ { 0, capacity } }) {}
+
+	// returns false if no free range is large enough
+	bool allocate(uint32_t size, uint32_t& offset);
+	void free(uint32_t offset, uint32_t size);
+
+	inline uint32_t getCapacity() const { return capacity_; }
+
+private:
+	uint32_t capacity_;
+	// (offset, size) sorted by offset
+	std::vector<std::pair<uint32_t, uint32_t>> freeRanges_;
+};
+
+struct WorldStreamingParams
+{
+	// sectors whose boxes are closer to the camera are loaded (nearest first)
+	float loadRadius_ = 150.0f;
+	// resident sectors farther than this are unloaded, the gap avoids reloading sectors on the boundary
+	float unloadRadius_ = 200.0f;
+	// vertex and index data of resident and loading sectors
+	uint64_t memoryBudget_ = 256ull * 1024 * 1024;
+	uint32_t maxLoadsInFlight_ = 4;
+};
+
+enum eSectorState
+{
+	eSectorState_Unloaded,
+	eSectorState_Loading,
+	eSectorState_Resident,
+};
+
+/* A range of the vertex (in vertices) or the index pool which has to be uploaded to the GPU */
+struct WorldUpload
+{
+	bool indices_;
+	uint32_t offset_;
+	uint32_t count_;
+};
+
+struct WorldStreamingStats
+{
+	uint32_t numResident_ = 0;
+	uint32_t numLoading_ = 0;
+	uint64_t residentBytes_ = 0;
+	uint64_t reservedBytes_ = 0;
+	uint32_t numLoaded_ = 0;
+	uint32_t numUnloaded_ = 0;
+	// loads postponed because the budget or the pools were full
+	uint32_t numPostponed_ = 0;
+};
+
+class StreamedWorld
+{
+public:
+	StreamedWorld(const WorldDescription& world, const WorldStreamingParams& params);
+	~StreamedWorld();
+
+	StreamedWorld(const StreamedWorld&) = delete;
+
+	/* Never waits for the disk: splices the finished sectors, unloads far ones and starts new loads.
+	   Returns true if scene_, meshData_ or materials_ changed: global transforms have to be recalculated and draw data rebuilt */
+	bool update(const vec3& cameraPos);
+
+	/* Waits for all the loads in flight (e.g., before exiting) */
+	void finishLoads();
+
+	inline eSectorState getSectorState(uint32_t sector) const { return sectors_[sector].state_; }
+	inline const WorldStreamingStats& getStats() const { return stats_; }
+	inline const WorldDescription& getWorld() const { return world_; }
+
+	/* The distance from 'p' to the box of the sector (0 inside) */
+	float getSectorDistance(uint32_t sector, const vec3& p) const;
+
+	/* Bytes of vertex and index data of the sector */
+	uint64_t getSectorSize(uint32_t sector) const;
+
+	/* The ranges written since the last call */
+	std::vector<WorldUpload> takeUploads();
+
+	/* Every resident sector is a child of node 0 with its nodes and components */
+	bool checkConsistency() const;
+
+	// node 0 is the world root, unused mesh and material slots have zero index counts and default values
+	Scene scene_;
+	// indexData_ and vertexData_ are the CPU copies of the pools
+	MeshData meshData_;
+	std::vector<MaterialDescription> materials_;
+	// texture files are never removed, so material texture indices stay valid
+	std::vector<std::string> textureFiles_;
+
+private:
+	struct LoadedSector
+	{
+		MeshData meshData_;
+		Scene scene_;
+		std::vector<MaterialDescription> materials_;
+		std::vector<std::string> textureFiles_;
+	};
+
+	struct SectorSlot
+	{
+		eSectorState state_ = eSectorState_Unloaded;
+		std::future<std::unique_ptr<LoadedSector>> loading_;
+		uint32_t vertexOffset_ = 0;
+		uint32_t indexOffset_ = 0;
+		// the node in scene_ and the slots in meshData_.meshes_ and materials_ while resident
+		int rootNode_ = -1;
+		std::vector<uint32_t> meshes_;
+		std::vector<uint32_t> materials_;
+	};
+
+	bool reserve(uint32_t sector);
+	void release(uint32_t sector);
+	void splice(uint32_t sector, LoadedSector& loaded, SceneEditBatch& edits, std::vector<uint32_t>& insertedSectors);
+
+	static uint32_t allocateSlot(std::vector<uint32_t>& freeSlots, uint32_t& count);
+
+	WorldDescription world_;
+	WorldStreamingParams params_;
+	WorldStreamingStats stats_;
+
+	std::vector<SectorSlot> sectors_;
+
+	RangeAllocator vertexPool_;
+	RangeAllocator indexPool_;
+
+	std::vector<uint32_t> freeMeshSlots_;
+	std::vector<uint32_t> freeMaterialSlots_;
+	uint32_t numMeshSlots_ = 0;
+	uint32_t numMaterialSlots_ = 0;
+
+	std::vector<WorldUpload> uploads_;
+};
@@ -18,13 +18,15 @@ LineCanvas::LineCanvas(VulkanRenderContext& ctx,
 	const size_t imgCount = ctx.vkDev.swapchainImages.size();
 
 	descriptorSets_.resize(imgCount);
-	storages_.resize(imgCount);
+	lineBuffers_.resize(imgCount);
+	shapeBuffers_.resize(imgCount);
 	uniforms_.resize(imgCount);
 
-	DescriptorSetInfo dsInfo = {
+	const DescriptorSetInfo dsInfo = {
 		.buffers = {
 			uniformBufferAttachment(VulkanBuffer {}, 0, sizeof(UniformBuffer), VK_SHADER_STAGE_VERTEX_BIT),
-			storageBufferAttachment(VulkanBuffer {}, 0, kMaxLinesDataSize,     VK_SHADER_STAGE_VERTEX_BIT)
+			storageBufferAttachment(VulkanBuffer {}, 0, 0, VK_SHADER_STAGE_VERTEX_BIT),
+			storageBufferAttachment(VulkanBuffer {}, 0, 0, VK_SHADER_STAGE_VERTEX_BIT)
 		}
 	};
 
@@ -34,26 +36,74 @@ LineCanvas::LineCanvas(VulkanRenderContext& ctx,
 	for(size_t i = 0 ; i < imgCount ; i++)
 	{
 		uniforms_[i] = ctx.resources.addUniformBuffer(sizeof(UniformBuffer));
-		storages_[i] = ctx.resources.addStorageBuffer(kMaxLinesDataSize);
-
-		dsInfo.buffers[0].buffer = uniforms_[i];
-		dsInfo.buffers[1].buffer = storages_[i];
+		lineBuffers_[i] = ctx.resources.addStorageBuffer(kInitialLinesCount * 2 * sizeof(DebugLineVertex), true);
+		shapeBuffers_[i] = ctx.resources.addStorageBuffer(kInitialShapesCount * sizeof(DebugShapeInstance), true);
 
 		descriptorSets_[i] = ctx.resources.addDescriptorSet(descriptorPool_, descriptorSetLayout_);
-		ctx.resources.updateDescriptorSet(descriptorSets_[i], dsInfo);
+		updateDescriptorSet(i);
 	}
 
-	initPipeline({ "data/shaders/chapter04/Lines.vert", "data/shaders/chapter04/Lines.frag" }, pInfo);
+	initPipeline({ "data/shaders/chapter08/VK01_Lines.vert", "data/shaders/chapter04/Lines.frag" }, pInfo);
+	shapesPipeline_ = ctx.resources.addPipeline(renderPass_.handle, pipelineLayout_, { "data/shaders/chapter08/VK01_DebugShapes.vert", "data/shaders/chapter04/Lines.frag" }, pInfo);
+}
+
+void LineCanvas::updateDescriptorSet(size_t currentImage)
+{
+	const VulkanBuffer& lines = lineBuffers_[currentImage];
+	const VulkanBuffer& shapes = shapeBuffers_[currentImage];
+
+	const DescriptorSetInfo dsInfo = {
+		.buffers = {
+			uniformBufferAttachment(uniforms_[currentImage], 0, sizeof(UniformBuffer), VK_SHADER_STAGE_VERTEX_BIT),
+			storageBufferAttachment(lines, 0, (uint32_t)lines.size, VK_SHADER_STAGE_VERTEX_BIT),
+			storageBufferAttachment(shapes, 0, (uint32_t)shapes.size, VK_SHADER_STAGE_VERTEX_BIT)
+		}
+	};
+
+	ctx_.resources.updateDescriptorSet(descriptorSets_[currentImage], dsInfo);
+}
+
+bool LineCanvas::reserve(std::vector<VulkanBuffer>& buffers, size_t currentImage, VkDeviceSize size)
+{
+	VulkanBuffer& buffer = buffers[currentImage];
+
+	if (size <= buffer.size)
+		return false;
+
+	VkDeviceSize newSize = buffer.size;
+	while (newSize < size)
+		newSize *= 2;
+
+	// safe to replace: VulkanApp waits for the device to become idle after every frame
+	ctx_.resources.freeBuffer(buffer);
+	buffer = ctx_.resources.addStorageBuffer(newSize, true);
+
+	return true;
 }
 
 void LineCanvas::updateBuffers(size_t currentImage)
 {
-	if (lines_.empty())
+	if (list_.empty())
 		return;
 
-	const VkDeviceSize bufferSize = lines_.size() * sizeof(VertexData);
+	const VkDeviceSize linesSize = list_.lines_.size() * sizeof(DebugLineVertex);
+	const VkDeviceSize boxesSize = list_.boxes_.size() * sizeof(DebugShapeInstance);
+	const VkDeviceSize planesSize = list_.planes_.size() * sizeof(DebugShapeInstance);
 
-	uploadBufferData(ctx_.vkDev, storages_[currentImage].memory, 0, lines_.data(), bufferSize);
+	const bool linesGrown = reserve(lineBuffers_, currentImage, linesSize);
+	const bool shapesGrown = reserve(shapeBuffers_, currentImage, boxesSize + planesSize);
+
+	if (linesGrown || shapesGrown)
+		updateDescriptorSet(currentImage);
+
+	uint8_t* shapes = (uint8_t*)shapeBuffers_[currentImage].ptr;
+
+	if (linesSize)
+		memcpy(lineBuffers_[currentImage].ptr, list_.lines_.data(), linesSize);
+	if (boxesSize)
+		memcpy(shapes, list_.boxes_.data(), boxesSize);
+	if (planesSize)
+		memcpy(shapes + boxesSize, list_.planes_.data(), planesSize);
 
 	const UniformBuffer ubo = {
 		.mvp = mvp_,
@@ -65,101 +115,37 @@ void LineCanvas::updateBuffers(size_t currentImage)
 
 void LineCanvas::fillCommandBuffer(VkCommandBuffer commandBuffer, size_t currentImage, VkFramebuffer fb, VkRenderPass rp)
 {
-	if (lines_.empty())
+	if (list_.empty())
 		return;
 
 	beginRenderPass((rp != VK_NULL_HANDLE) ? rp : renderPass_.handle, (fb != VK_NULL_HANDLE) ? fb : framebuffer_, commandBuffer, currentImage);
 
-	vkCmdDraw( commandBuffer, static_cast<uint32_t>(lines_.size()), 1, 0, 0 );
-	vkCmdEndRenderPass( commandBuffer );
-}
+	if (!list_.lines_.empty())
+		vkCmdDraw(commandBuffer, (uint32_t)list_.lines_.size(), 1, 0, 0);
 
-void LineCanvas::line(const vec3& p1, const vec3& p2, const vec4& c)
-{
-	lines_.push_back( { .position = p1, .color = c } );
-	lines_.push_back( { .position = p2, .color = c } );
-}
-
-void LineCanvas::plane3d(const vec3& o, const vec3& v1, const vec3& v2, int n1, int n2, float s1, float s2, const vec4& color, const vec4& outlineColor)
-{
-	line(o - s1 / 2.0f * v1 - s2 / 2.0f * v2, o - s1 / 2.0f * v1 + s2 / 2.0f * v2, outlineColor);
-	line(o + s1 / 2.0f * v1 - s2 / 2.0f * v2, o + s1 / 2.0f * v1 + s2 / 2.0f * v2, outlineColor);
+	const uint32_t numBoxes = (uint32_t)list_.boxes_.size();
+	const uint32_t numPlanes = (uint32_t)list_.planes_.size();
 
-	line(o - s1 / 2.0f * v1 + s2 / 2.0f * v2, o + s1 / 2.0f * v1 + s2 / 2.0f * v2, outlineColor);
-	line(o - s1 / 2.0f * v1 - s2 / 2.0f * v2, o + s1 / 2.0f * v1 - s2 / 2.0f * v2, outlineColor);
-
-	for (int i = 1; i < n1; i++)
+	if (numBoxes || numPlanes)
 	{
-		float t = ((float)i - (float)n1 / 2.0f) * s1 / (float)n1;
-		const vec3 o1 = o + t * v1;
-		line(o1 - s2 / 2.0f * v2, o1 + s2 / 2.0f * v2, color);
-	}
+		// the descriptor set stays bound, both pipelines share the layout
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, shapesPipeline_);
 
-	for (int i = 1; i < n2; i++)
-	{
-		const float t = ((float)i - (float)n2 / 2.0f) * s2 / (float)n2;
-		const vec3 o2 = o + t * v2;
-		line(o2 - s1 / 2.0f * v1, o2 + s1 / 2.0f * v1, color);
+		if (numBoxes)
+			vkCmdDraw(commandBuffer, DebugDrawList::VerticesPerBox, numBoxes, 0, 0);
+		if (numPlanes)
+			vkCmdDraw(commandBuffer, list_.getVerticesPerPlane(), numPlanes, 0, numBoxes);
 	}
-}
-
-static void drawBox3d_internal(LineCanvas& canvas, const glm::mat4& m, const glm::vec3& size, const glm::vec4& c)
-{
-	std::array<vec3, 8> pts = {
-		vec3(+size.x, +size.y, +size.z),
-		vec3(+size.x, +size.y, -size.z),
-		vec3(+size.x, -size.y, +size.z),
-		vec3(+size.x, -size.y, -size.z),
-		vec3(-size.x, +size.y, +size.z),
-		vec3(-size.x, +size.y, -size.z),
-		vec3(-size.x, -size.y, +size.z),
-		vec3(-size.x, -size.y, -size.z),
-	};
 
-	for (auto& p: pts)
-		p = vec3(m * vec4(p, 1.f));
-
-	canvas.line(pts[0], pts[1], c);
-	canvas.line(pts[2], pts[3], c);
-	canvas.line(pts[4], pts[5], c);
-	canvas.line(pts[6], pts[7], c);
-
-	canvas.line(pts[0], pts[2], c);
-	canvas.line(pts[1], pts[3], c);
-	canvas.line(pts[4], pts[6], c);
-	canvas.line(pts[5], pts[7], c);
-
-	canvas.line(pts[0], pts[4], c);
-	canvas.line(pts[1], pts[5], c);
-	canvas.line(pts[2], pts[6], c);
-	canvas.line(pts[3], pts[7], c);
+	vkCmdEndRenderPass(commandBuffer);
 }
 
 void drawBox3d(LineCanvas& canvas, const glm::mat4& m, const BoundingBox& box, const glm::vec4& color)
 {
-	drawBox3d_internal(canvas, m * glm::translate(glm::mat4(1.f), .5f * (box.min_ + box.max_)), 0.5f * vec3(box.max_ - box.min_), color);
+	canvas.box(m, box, color);
 }
 
-void renderCameraFrustum(LineCanvas& C, const mat4& camView, const mat4& camProj, const vec4& camColor)
+void renderCameraFrustum(LineCanvas& canvas, const mat4& camView, const mat4& camProj, const vec4& camColor)
 {
-	const vec3 corners[] = {
-		vec3(+1, -1, -1), vec3(+1, -1, +1),
-		vec3(+1, +1, -1), vec3(+1, +1, +1),
-		vec3(-1, +1, -1), vec3(-1, +1, +1),
-		vec3(-1, -1, -1), vec3(-1, -1, +1)
-	};
-	vec3 pp[8];
-
-	for(int i = 0 ; i < 8 ; i++) {
-		glm::vec4 q = glm::inverse(camView) * glm::inverse(camProj) * glm::vec4(corners[i], 1.0f);
-		pp[i] = glm::vec3(q.x / q.w, q.y / q.w, q.z / q.w);
-	}
-
-	for(int i = 0 ; i < 4 ; i++)
-	{
-		C.line(pp[i * 2 + 0], pp[i * 2 + 1], camColor);
-
-		for(int k = 0 ; k < 2 ; k++)
-			C.line(pp[k + i * 2], pp[k + ((i + 1) % 4) * 2], camColor);
-	}
+	canvas.frustum(camView, camProj, camColor);
 }
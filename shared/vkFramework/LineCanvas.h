@@ -1,5 +1,6 @@
 #pragma once
 
+#include "shared/DebugShapes.h"
 #include "shared/vkFramework/Renderer.h"
 
 struct LineCanvas: public Renderer
@@ -20,9 +21,13 @@ struct LineCanvas: public Renderer
 	void fillCommandBuffer(VkCommandBuffer cmdBuffer, size_t currentImage, VkFramebuffer fb = VK_NULL_HANDLE, VkRenderPass rp = VK_NULL_HANDLE) override;
 	void updateBuffers(size_t currentImage) override;
 
-	void clear() { lines_.clear(); }
-	void line(const vec3& p1, const vec3& p2, const vec4& c);
-	void plane3d(const vec3& orig, const vec3& v1, const vec3& v2, int n1, int n2, float s1, float s2, const vec4& color, const vec4& outlineColor);
+	void clear() { list_.clear(); }
+	void line(const vec3& p1, const vec3& p2, const vec4& c) { list_.line(p1, p2, c); }
+	void box(const mat4& m, const BoundingBox& box, const vec4& c) { list_.box(m, box, c); }
+	void frustum(const mat4& view, const mat4& proj, const vec4& c) { list_.frustum(view, proj, c); }
+	void plane3d(const vec3& orig, const vec3& v1, const vec3& v2, int n1, int n2, float s1, float s2, const vec4& color, const vec4& outlineColor) {
+		list_.plane(orig, v1, v2, n1, n2, s1, s2, color, outlineColor);
+	}
 
 	inline void setCameraMatrix(const glm::mat4& mvp) { mvp_ = mvp; }
 
@@ -34,18 +39,19 @@ private:
 		float time;
 	};
 
-	struct VertexData {
-		vec3 position;
-		vec4 color;
-	};
+	DebugDrawList list_;
+
+	// per swapchain image (the instances of boxes and frusta are followed by the planes), host-visible; they grow on demand (doubling their size)
+	std::vector<VulkanBuffer> lineBuffers_;
+	std::vector<VulkanBuffer> shapeBuffers_;
 
-	std::vector<VertexData> lines_;
+	VkPipeline shapesPipeline_ = VK_NULL_HANDLE;
 
-	// Storage Buffer with index and vertex data
-	std::vector<VulkanBuffer> storages_;
+	static constexpr uint32_t kInitialLinesCount = 4096;
+	static constexpr uint32_t kInitialShapesCount = 1024;
 
-	static constexpr unsigned kMaxLinesCount = 4 * 8 * 65536;
-	static constexpr unsigned kMaxLinesDataSize = kMaxLinesCount * sizeof(LineCanvas::VertexData) * 2;
+	bool reserve(std::vector<VulkanBuffer>& buffers, size_t currentImage, VkDeviceSize size);
+	void updateDescriptorSet(size_t currentImage);
 };
 
 void drawBox3d(LineCanvas& canvas, const glm::mat4& m, const BoundingBox& box, const glm::vec4& color);
@@ -15,67 +15,186 @@ VKSceneData::VKSceneData(VulkanRenderContext& ctx,
 , envMapIrradiance_(irradianceMap)
 , envMap_(envMap)
 {
+	const double startupUs = startupTrace_.getTimeUs();
+
+	// the three files are read concurrently, textures are decoded as soon as the list of texture files is known
+	MeshFileHeader header;
+
+	tf::Taskflow materialsTask;
+	materialsTask.emplace([&]()
+		{
+			const double t = startupTrace_.getTimeUs();
+			loadMaterials(materialFile, materials_, textureFiles_);
+			startupTrace_.addEvent("Read materials", "startup", getTraceLane(), t);
+		});
+
+	tf::Taskflow meshesTask;
+	meshesTask.emplace([&]()
+		{
+			const double t = startupTrace_.getTimeUs();
+			header = loadMeshData(meshFile, meshData_);
+			startupTrace_.addEvent("Read meshes", "startup", getTraceLane(), t);
+		});
+
+	tf::Taskflow sceneTask;
+	sceneTask.emplace([&]()
+		{
+			const double t = startupTrace_.getTimeUs();
+			::loadScene(sceneFile, scene_);
+			// parents precede their children, so global transforms are updated in one linear pass
+			sortSceneByDepth(scene_);
+			startupTrace_.addEvent("Read scene", "startup", getTraceLane(), t);
+		});
+
+	auto materialsLoaded = executor_.run(materialsTask);
+	auto meshesLoaded = executor_.run(meshesTask);
+	auto sceneLoaded = executor_.run(sceneTask);
+
+	materialsLoaded.wait();
+
+	const uint32_t numTextures = (uint32_t)textureFiles_.size();
+
+	loadedFiles_.reserve(numTextures);
+
+	taskflow_.for_each_index(0u, numTextures, 1u, [this, asyncLoad](int idx)
+		{
+			const double t = startupTrace_.getTimeUs();
+			int w, h;
+			const uint8_t* img = stbi_load(this->textureFiles_[idx].c_str(), &w, &h, nullptr, STBI_rgb_alpha);
+			// the synchronous path fails in the constructor
+			if (!img && asyncLoad)
+				img = genDefaultCheckerboardImage(&w, &h);
+			startupTrace_.addEvent("Decode " + textureFiles_[idx], "texture", getTraceLane(), t);
+			{
+				std::lock_guard lock(loadedFilesMutex_);
+				loadedFiles_.emplace_back(LoadedImageData { idx, w, h, img });
+			}
+			loadedFilesCV_.notify_one();
+		}
+	);
+
+	executor_.run(taskflow_);
+
+	// everything below overlaps with reading the files and decoding the textures
+	double t = startupTrace_.getTimeUs();
 	brdfLUT_ = ctx.resources.loadKTX("data/brdfLUT.ktx");
+	startupTrace_.addEvent("BRDF LUT", "startup", 0, t);
+
+	const uint32_t materialsSize = static_cast<uint32_t>(sizeof(MaterialDescription) * materials_.size());
+	material_ = ctx.resources.addStorageBuffer(materialsSize);
+	uploadBufferData(ctx.vkDev, material_.memory, 0, materials_.data(), materialsSize);
 
-	loadMaterials(materialFile, materials_, textureFiles_);
+	meshesLoaded.wait();
 
-	std::vector<VulkanTexture> textures;
-	for (const auto& f: textureFiles_) {
-		auto t = asyncLoad ? ctx.resources.addSolidRGBATexture() : ctx.resources.loadTexture2D(f.c_str());
-		textures.push_back(t);
-#if 0
-		if (t.image.image != nullptr)
-			setVkImageName(ctx.vkDev, t.image.image, f.c_str());
-#endif
-	}
+	t = startupTrace_.getTimeUs();
+	uploadMeshes(header);
+	// the GPU copies the geometry while the textures are being decoded
+	ctx.uploader.submit();
+	startupTrace_.addEvent("Geometry upload", "startup", 0, t);
+
+	sceneLoaded.wait();
+
+	t = startupTrace_.getTimeUs();
+	createShapes();
+	startupTrace_.addEvent("Shapes and transforms", "startup", 0, t);
+
+	std::vector<VulkanTexture> textures(numTextures);
+
+	t = startupTrace_.getTimeUs();
 
 	if (asyncLoad)
 	{
-		loadedFiles_.reserve(textureFiles_.size());
+		// decoded textures replace these later (see MultiRenderer::checkLoadedTextures())
+		for (auto& tex: textures)
+			tex = ctx.resources.addSolidRGBATexture();
+	}
+	else
+	{
+		// upload the textures in the order they are decoded
+		for (uint32_t i = 0 ; i != numTextures ; i++)
+		{
+			LoadedImageData data;
 
-		taskflow_.for_each_index(0u, (uint32_t)textureFiles_.size(), 1u, [this](int idx)
 			{
-				int w, h;
-				const uint8_t* img = stbi_load(this->textureFiles_[idx].c_str(), &w, &h, nullptr, STBI_rgb_alpha);
-				if (!img)
-					img = genDefaultCheckerboardImage(&w, &h);
-				std::lock_guard lock(loadedFilesMutex_);
-				loadedFiles_.emplace_back(LoadedImageData { idx, w, h, img });
+				std::unique_lock lock(loadedFilesMutex_);
+				loadedFilesCV_.wait(lock, [this]() { return !loadedFiles_.empty(); });
+				data = loadedFiles_.back();
+				loadedFiles_.pop_back();
+			}
+
+			if (!data.img_)
+			{
+				printf("Cannot load %s 2D texture file\n", textureFiles_[data.index_].c_str());
+				exit(EXIT_FAILURE);
 			}
-		);
 
-		executor_.run(taskflow_);
+			const double u = startupTrace_.getTimeUs();
+			// pixels are copied into the staging ring right away
+			textures[data.index_] = ctx.resources.addRGBATexture(data.w_, data.h_, data.img_, ctx.uploader);
+			stbi_image_free((void*)data.img_);
+			startupTrace_.addEvent("Upload " + textureFiles_[data.index_], "texture", 0, u);
+		}
+
+		numResidentTextures_ = numTextures;
 	}
 
+	startupTrace_.addEvent(asyncLoad ? "Placeholder textures" : "Textures", "startup", 0, t);
+
 	allMaterialTextures = fsTextureArrayAttachment(textures);
 
-	const uint32_t materialsSize = static_cast<uint32_t>(sizeof(MaterialDescription) * materials_.size());
-	material_ = ctx.resources.addStorageBuffer(materialsSize);
-	uploadBufferData(ctx.vkDev, material_.memory, 0, materials_.data(), materialsSize);
+	// all textures go to the GPU in as few batches as the staging ring allows
+	ctx.uploader.submit();
+
+	startupTrace_.addEvent("VKSceneData", "startup", 0, startupUs);
+}
+
+uint32_t VKSceneData::getTraceLane() const
+{
+	// 0 is the thread which has created the scene data
+	return (uint32_t)(executor_.this_worker_id() + 1);
+}
 
-	loadMeshes(meshFile);
-	loadScene(sceneFile);
+void VKSceneData::markTextureResident(uint32_t index, double uploadStartUs)
+{
+	startupTrace_.addEvent("Upload " + textureFiles_[index], "texture", 0, uploadStartUs);
+
+	if (++numResidentTextures_ == textureFiles_.size())
+		startupTrace_.addEvent("All textures resident", "startup", 0, 0.0);
+}
+
+bool VKSceneData::writeStartupTrace(const char* fileName) const
+{
+	std::vector<std::string> lanes = { "Main thread" };
+
+	for (size_t i = 0 ; i != executor_.num_workers() ; i++)
+		lanes.push_back("Worker " + std::to_string(i));
+
+	return startupTrace_.write(fileName, lanes);
 }
 
 void VKSceneData::loadMeshes(const char* meshFile)
 {
-	MeshFileHeader header = loadMeshData(meshFile, meshData_);
+	uploadMeshes(loadMeshData(meshFile, meshData_));
+}
+
+void VKSceneData::uploadMeshes(const MeshFileHeader& header)
+{
+	// every mesh uses 16-bit indices if it fits (see fetchIndex() in VK01_VertCommon.h)
+	const PackedIndexData indices = packIndexData(meshData_);
+	meshIndexOffsets_ = indices.meshIndexOffsets_;
 
-	const uint32_t indexBufferSize = header.indexDataSize;
+	const uint32_t indexBufferSize = (uint32_t)(indices.data_.size() * sizeof(uint32_t));
 	uint32_t vertexBufferSize = header.vertexDataSize;
 
 	const uint32_t offsetAlignment = getVulkanBufferAlignment(ctx.vkDev);
 	if ((vertexBufferSize & (offsetAlignment - 1)) != 0)
 	{
 		const size_t numFloats = (offsetAlignment - (vertexBufferSize & (offsetAlignment - 1))) / sizeof(float);
-		for (size_t i = 0; i != numFloats; i++)
-			meshData_.vertexData_.push_back(0);
+		meshData_.vertexData_.resize(meshData_.vertexData_.size() + numFloats, 0.0f);
 		vertexBufferSize = (vertexBufferSize + offsetAlignment) & ~(offsetAlignment - 1);
 	}
 
-	VulkanBuffer storage = ctx.resources.addStorageBuffer(vertexBufferSize + indexBufferSize);
-	uploadBufferData(ctx.vkDev, storage.memory, 0, meshData_.vertexData_.data(), vertexBufferSize);
-	uploadBufferData(ctx.vkDev, storage.memory, vertexBufferSize, meshData_.indexData_.data(), indexBufferSize);
+	VulkanBuffer storage = ctx.resources.addVertexBuffer(indexBufferSize, indices.data_.data(), vertexBufferSize, meshData_.vertexData_.data(), ctx.uploader);
 
 	vertexBuffer_ = BufferAttachment { .dInfo = { .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .shaderStageFlags = VK_SHADER_STAGE_VERTEX_BIT }, .buffer = storage, .offset = 0, .size = vertexBufferSize };
 	indexBuffer_  = BufferAttachment { .dInfo = { .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .shaderStageFlags = VK_SHADER_STAGE_VERTEX_BIT }, .buffer = storage, .offset = vertexBufferSize, .size = indexBufferSize };
@@ -85,6 +204,14 @@ void VKSceneData::loadScene(const char* sceneFile)
 {
 	::loadScene(sceneFile, scene_);
 
+	// parents precede their children, so global transforms are updated in one linear pass
+	sortSceneByDepth(scene_);
+
+	createShapes();
+}
+
+void VKSceneData::createShapes()
+{
 	// prepare draw data buffer
 	for (const auto& c : scene_.meshes_)
 	{
@@ -97,14 +224,18 @@ void VKSceneData::loadScene(const char* sceneFile)
 				.meshIndex = c.second,
 				.materialIndex = material->second,
 				.LOD = 0,
-				.indexOffset = meshData_.meshes_[c.second].indexOffset,
+				.indexOffset = meshIndexOffsets_[c.second] | (meshData_.meshes_[c.second].hasShortIndices() ? kShortIndicesBit : 0u),
 				.vertexOffset = meshData_.meshes_[c.second].vertexOffset,
 				.transformIndex = c.first
 			});
 	}
 
+	// MultiRenderer draws the instances of the same mesh and material with one command
+	sortDrawDataForInstancing(shapes_);
+
 	shapeTransforms_.resize(shapes_.size());
-	transforms_ = ctx.resources.addStorageBuffer(shapes_.size() * sizeof(glm::mat4));
+	// stays mapped, only the changed ranges are written
+	transforms_ = ctx.resources.addStorageBuffer(shapes_.size() * sizeof(glm::mat4), true);
 
 	recalculateAllTransforms();
 	uploadGlobalTransforms();
@@ -115,25 +246,20 @@ void VKSceneData::updateMaterial(int matIdx)
 	uploadBufferData(ctx.vkDev, material_.memory, matIdx * sizeof(MaterialDescription), materials_.data() + matIdx, sizeof(MaterialDescription));
 }
 
-void VKSceneData::convertGlobalToShapeTransforms()
-{
-	// fill the shapeTransforms_ array from globalTransforms_
-	size_t i = 0;
-	for (const auto& c : shapes_)
-		shapeTransforms_[i++] = scene_.globalTransform_[c.transformIndex];
-}
-
 void VKSceneData::recalculateAllTransforms()
 {
 	// force recalculation of global transformations
-	markAsChanged(scene_, 0);
-	recalculateGlobalTransforms(scene_);
+	recalculateAllGlobalTransforms(scene_);
 }
 
-void VKSceneData::uploadGlobalTransforms()
+const std::vector<TransformUploadRange>& VKSceneData::uploadGlobalTransforms()
 {
-	convertGlobalToShapeTransforms();
- 	uploadBufferData(ctx.vkDev, transforms_.memory, 0, shapeTransforms_.data(), transforms_.size);
+	const auto& ranges = transformUploads_.update(scene_, shapes_, shapeTransforms_);
+
+	for (const auto& r: ranges)
+		memcpy((glm::mat4*)transforms_.ptr + r.first_, shapeTransforms_.data() + r.first_, r.count_ * sizeof(glm::mat4));
+
+	return ranges;
 }
 
 MultiRenderer::MultiRenderer(
@@ -153,9 +279,10 @@ MultiRenderer::MultiRenderer(
 	const uint32_t indirectDataSize = (uint32_t)sceneData_.shapes_.size() * sizeof(VkDrawIndirectCommand);
 
 	const size_t imgCount = ctx.vkDev.swapchainImages.size();
-	uniforms_.resize(imgCount);
 	shape_.resize(imgCount);
 	indirect_.resize(imgCount);
+	indirectShadow_.resize(imgCount);
+	numCommands_.resize(imgCount);
 
 	descriptorSets_.resize(imgCount);
 
@@ -175,7 +302,7 @@ MultiRenderer::MultiRenderer(
 
 	DescriptorSetInfo dsInfo = {
 		.buffers = {
-			uniformBufferAttachment(VulkanBuffer {},         0, uniformBufferSize, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT),
+			dynamicUniformBufferAttachment(ctx.frameRing.getBuffer(), uniformBufferSize, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT),
 			sceneData_.vertexBuffer_,
 			sceneData_.indexBuffer_,
 			storageBufferAttachment(VulkanBuffer {},         0, shapesSize, VK_SHADER_STAGE_VERTEX_BIT),
@@ -194,20 +321,21 @@ MultiRenderer::MultiRenderer(
 
 	for (size_t i = 0; i != imgCount; i++)
 	{
-		uniforms_[i] = ctx.resources.addUniformBuffer(uniformBufferSize);
-		indirect_[i] = ctx.resources.addIndirectBuffer(indirectDataSize);
+		indirect_[i] = ctx.resources.addIndirectBuffer(indirectDataSize, true);
 		updateIndirectBuffers(i);
 
 		shape_[i] = ctx.resources.addStorageBuffer(shapesSize);
 		uploadBufferData(ctx.vkDev, shape_[i].memory, 0, sceneData_.shapes_.data(), shapesSize);
 
-		dsInfo.buffers[0].buffer = uniforms_[i];
 		dsInfo.buffers[3].buffer = shape_[i];
 
 		descriptorSets_[i] = ctx.resources.addDescriptorSet(descriptorPool_, descriptorSetLayout_);
 		ctx.resources.updateDescriptorSet(descriptorSets_[i], dsInfo);
 	}
 
+	// the uniform buffer lives in the frame ring (binding 0 is the only dynamic one)
+	dynamicOffsets_ = { 0 };
+
 	initPipeline({ vertShaderFile, fragShaderFile }, pInfo);
 }
 
@@ -218,36 +346,59 @@ void MultiRenderer::fillCommandBuffer(VkCommandBuffer commandBuffer, size_t curr
 	/* For CountKHR (Vulkan 1.1) we may use indirect rendering with GPU-based object counter */
 	/// vkCmdDrawIndirectCountKHR(commandBuffer, indirectBuffers_[currentImage], 0, countBuffers_[currentImage], 0, shapes.size(), sizeof(VkDrawIndirectCommand));
 	/* For Vulkan 1.0 vkCmdDrawIndirect is enough */
-	vkCmdDrawIndirect(commandBuffer, indirect_[currentImage].buffer, 0, (uint32_t)sceneData_.shapes_.size(), sizeof(VkDrawIndirectCommand));
+	vkCmdDrawIndirect(commandBuffer, indirect_[currentImage].buffer, 0, numCommands_[currentImage], sizeof(VkDrawIndirectCommand));
 
 	vkCmdEndRenderPass(commandBuffer);
 }
 
 void MultiRenderer::updateBuffers(size_t imageIndex)
 {
-	updateUniformBuffer((uint32_t)imageIndex, 0, sizeof(ubo_), &ubo_);
+	dynamicOffsets_[0] = uploadDynamicUniform(&ubo_, sizeof(ubo_));
 }
 
 void MultiRenderer::updateIndirectBuffers(size_t currentImage, bool* visibility)
 {
-	VkDrawIndirectCommand* data = nullptr;
-	vkMapMemory(ctx_.vkDev.device, indirect_[currentImage].memory, 0, sizeof(VkDrawIndirectCommand), 0, (void**)&data);
+	VkDrawIndirectCommand* data = (VkDrawIndirectCommand*)indirect_[currentImage].ptr;
+
+	const auto& shapes = sceneData_.shapes_;
+	const uint32_t size = (uint32_t)shapes.size();
+
+	auto& shadow = indirectShadow_[currentImage];
+	const bool firstUpdate = shadow.empty();
+	shadow.resize(size);
+
+	auto isVisible = [visibility](uint32_t i) { return !visibility || visibility[i]; };
 
-	const uint32_t size = (uint32_t)sceneData_.shapes_.size();
+	// every run of visible instances of the same mesh and material is one command (shapes are sorted in VKSceneData::loadScene())
+	uint32_t numCommands = 0;
 
-	for (uint32_t i = 0; i != size; i++)
+	for (uint32_t i = 0; i != size; )
 	{
-		const uint32_t j = sceneData_.shapes_[i].meshIndex;
+		if (!isVisible(i))
+		{
+			i++;
+			continue;
+		}
+
+		const uint32_t first = i;
 
-		const uint32_t lod = sceneData_.shapes_[i].LOD;
-		data[i] = {
-			.vertexCount = sceneData_.meshData_.meshes_[j].getLODIndicesCount(lod),
-			.instanceCount = visibility ? (visibility[i] ? 1u : 0u) : 1u,
+		while (++i != size && canDrawAsInstances(shapes[first], shapes[i]) && isVisible(i)) {}
+
+		const VkDrawIndirectCommand cmd = {
+			.vertexCount = sceneData_.meshData_.meshes_[shapes[first].meshIndex].getLODIndicesCount(shapes[first].LOD),
+			.instanceCount = i - first,
 			.firstVertex = 0,
-			.firstInstance = i
+			.firstInstance = first
 		};
+
+		// the buffer is host-coherent, so writing only the changed commands is enough
+		if (firstUpdate || memcmp(&shadow[numCommands], &cmd, sizeof(cmd)))
+			data[numCommands] = shadow[numCommands] = cmd;
+
+		numCommands++;
 	}
-	vkUnmapMemory(ctx_.vkDev.device, indirect_[currentImage].memory);
+
+	numCommands_[currentImage] = numCommands;
 }
 
 bool MultiRenderer::checkLoadedTextures()
@@ -265,9 +416,14 @@ bool MultiRenderer::checkLoadedTextures()
 		sceneData_.loadedFiles_.pop_back();
 	}
 
-	this->updateTexture(data.index_, ctx_.resources.addRGBATexture(data.w_, data.h_, const_cast<uint8_t*>(data.img_)));
+	const double t = sceneData_.startupTrace_.getTimeUs();
+
+	// recorded into the uploader's batch which is submitted in VulkanRenderContext::updateBuffers()
+	this->updateTexture(data.index_, ctx_.resources.addRGBATexture(data.w_, data.h_, data.img_, ctx_.uploader));
 
 	stbi_image_free((void*)data.img_);
 
+	sceneData_.markTextureResident(data.index_, t);
+
 	return true;
 }
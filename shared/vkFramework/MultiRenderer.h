@@ -1,13 +1,25 @@
 #pragma once
 
 #include "shared/vkFramework/Renderer.h"
+#include "shared/ChromeTrace.h"
 #include "shared/scene/Scene.h"
 #include "shared/scene/Material.h"
+#include "shared/scene/TransformUploads.h"
 #include "shared/scene/VtxData.h"
 
+#include <condition_variable>
+
 #include <taskflow/taskflow.hpp>
 
-// Container of mesh data, material data and scene nodes with transformations
+/**
+	Container of mesh data, material data and scene nodes with transformations
+
+	Startup: the mesh, scene and material files are read concurrently on worker threads and the textures are decoded
+	on the workers as soon as the material file has been read. Meanwhile the constructor loads the BRDF LUT and
+	uploads the geometry. With 'asyncLoad' the constructor returns with placeholder textures and the renderers swap in
+	the decoded ones after the first frame, otherwise the textures are uploaded in the order they are decoded.
+	Every phase is recorded into 'startupTrace_' (see writeStartupTrace())
+*/
 struct VKSceneData
 {
 	VKSceneData(VulkanRenderContext& ctx,
@@ -39,14 +51,20 @@ struct VKSceneData
 
 	std::vector<glm::mat4> shapeTransforms_;
 
+	/* DrawData::indexOffset of the meshes with 16-bit indices has this bit set and is counted in 16-bit elements (see PackedIndexData) */
+	static constexpr uint32_t kShortIndicesBit = 0x80000000;
+
 	std::vector<DrawData> shapes_;
 
 	void loadScene(const char* sceneFile);
 	void loadMeshes(const char* meshFile);
 
-	void convertGlobalToShapeTransforms();
 	void recalculateAllTransforms();
-	void uploadGlobalTransforms();
+	/* Uploads the transforms of the shapes whose nodes were recalculated since the last upload (see TransformUploadTracker).
+	   Set scene_.allTransformsChanged_ after writing global transforms directly. Returns the uploaded ranges of shapes */
+	const std::vector<TransformUploadRange>& uploadGlobalTransforms();
+
+	TransformUploadTracker transformUploads_;
 
 	void updateMaterial(int matIdx);
 
@@ -62,8 +80,26 @@ struct VKSceneData
 	std::vector<std::string> textureFiles_;
 	std::vector<LoadedImageData> loadedFiles_;
 	std::mutex loadedFilesMutex_;
+	std::condition_variable loadedFilesCV_;
+
+	uint32_t numResidentTextures_ = 0;
+
+	/* Called by the renderers when a texture decoded in the background has been uploaded */
+	void markTextureResident(uint32_t index, double uploadStartUs);
+
+	/* Lane 0 is the thread which has created the scene data, the others are the loading threads */
+	CpuTraceRecorder startupTrace_;
+	bool writeStartupTrace(const char* fileName) const;
 
 private:
+	void uploadMeshes(const MeshFileHeader& header);
+	void createShapes();
+
+	/* The first index of every mesh in the index buffer */
+	std::vector<uint32_t> meshIndexOffsets_;
+
+	uint32_t getTraceLane() const;
+
 	tf::Taskflow taskflow_;
 	tf::Executor executor_;
 };
@@ -86,8 +122,11 @@ struct MultiRenderer: public Renderer
 	void fillCommandBuffer(VkCommandBuffer cmdBuffer, size_t currentImage, VkFramebuffer fb = VK_NULL_HANDLE, VkRenderPass rp = VK_NULL_HANDLE) override;
 	void updateBuffers(size_t currentImage) override;
 
+	/* Adjacent visible shapes with the same mesh and material are drawn as instances of one command (see gl_InstanceIndex in VK01.vert) */
 	void updateIndirectBuffers(size_t currentImage, bool* visibility = nullptr);
 
+	inline uint32_t getNumDrawCommands(size_t currentImage) const { return numCommands_[currentImage]; }
+
 	inline void setMatrices(const glm::mat4& proj, const glm::mat4& view) {
 		const glm::mat4 m1 = glm::scale(glm::mat4(1.f), glm::vec3(1.f, -1.f, 1.f));
 		ubo_.proj_ = proj;
@@ -109,6 +148,11 @@ private:
 	std::vector<VulkanBuffer> indirect_;
 	std::vector<VulkanBuffer> shape_;
 
+	// CPU-side copies of the persistently mapped indirect buffers: only changed commands are written
+	std::vector<std::vector<VkDrawIndirectCommand>> indirectShadow_;
+	// instanced commands written by updateIndirectBuffers()
+	std::vector<uint32_t> numCommands_;
+
 	struct UBO {
 		mat4 proj_;
 		mat4 view_;
@@ -14,7 +14,23 @@ struct Renderer
 	virtual void updateBuffers(size_t currentImage) {}
 
 	inline void updateUniformBuffer(uint32_t currentImage, const uint32_t offset, const uint32_t size, const void* data) {
-		uploadBufferData(ctx_.vkDev, uniforms_[currentImage].memory, offset, data, size);
+		// persistently mapped buffers (see VulkanResources::addBuffer) do not need vkMapMemory()/vkUnmapMemory()
+		if (uniforms_[currentImage].ptr)
+			memcpy((uint8_t*)uniforms_[currentImage].ptr + offset, data, size);
+		else
+			uploadBufferData(ctx_.vkDev, uniforms_[currentImage].memory, offset, data, size);
+	}
+
+	/* Copy the uniforms of this frame into VulkanRenderContext::frameRing and return their dynamic offset.
+	   Keeping the previous offset would let the GPU read memory reused by a newer frame, so a full ring is fatal */
+	inline uint32_t uploadDynamicUniform(const void* data, uint32_t size) {
+		const RingAllocation a = ctx_.frameRing.uploadUniform(data, size);
+		if (!a.isValid())
+		{
+			printf("Frame ring is full (%u bytes requested, %u bytes in use), increase DefaultFrameRingSize\n", size, (uint32_t)ctx_.frameRing.getUsedBytes());
+			exit(EXIT_FAILURE);
+		}
+		return (uint32_t)a.offset;
 	}
 
 	void initPipeline(const std::vector<const char*>& shaders, const PipelineInfo& pInfo, uint32_t vtxConstSize = 0, uint32_t fragConstSize = 0)
@@ -40,6 +56,7 @@ struct Renderer
 
 			outInfo.width = processingWidth;
 			outInfo.height = processingHeight;
+			outInfo.useColor = !(isDepthFormat(outputs[0].format) && (outputs.size() == 1));
 
 			renderPass_  = (renderPass.handle != VK_NULL_HANDLE) ? renderPass :
 					((isDepthFormat(outputs[0].format) && (outputs.size() == 1)) ? ctx_.resources.addDepthRenderPass(outputs) : ctx_.resources.addRenderPass(outputs, RenderPassCreateInfo(), true));
@@ -69,7 +86,8 @@ struct Renderer
 			renderPass_.info.clearColor_ ? &clearValues[0] : (renderPass_.info.clearDepth_ ? &clearValues[1] : nullptr));
 
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline_);
-		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout_, 0, 1, &descriptorSets_[currentImage], 0, nullptr);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout_, 0, 1, &descriptorSets_[currentImage],
+			(uint32_t)dynamicOffsets_.size(), dynamicOffsets_.empty() ? nullptr : dynamicOffsets_.data());
 	}
 
 	VkFramebuffer framebuffer_ = nullptr;
@@ -98,4 +116,7 @@ protected:
 	VkPipeline graphicsPipeline_ = nullptr;
 
 	std::vector<VulkanBuffer> uniforms_;
+
+	// Offsets of dynamic buffers (in binding order) inside VulkanRenderContext::frameRing for the current frame
+	std::vector<uint32_t> dynamicOffsets_;
 };
@@ -53,6 +53,40 @@ GLFWwindow* initVulkanApp(int width, int height, Resolution* resolution)
 	return result;
 }
 
+static void submitAndPresent(VulkanRenderDevice& vkDev, uint32_t imageIndex, uint32_t numCommandBuffers, const VkCommandBuffer* commandBuffers)
+{
+	const VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT }; // or even VERTEX_SHADER_STAGE
+
+	const VkSubmitInfo si =
+	{
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = nullptr,
+		.waitSemaphoreCount = 1,
+		.pWaitSemaphores = &vkDev.semaphore,
+		.pWaitDstStageMask = waitStages,
+		.commandBufferCount = numCommandBuffers,
+		.pCommandBuffers = commandBuffers,
+		.signalSemaphoreCount = 1,
+		.pSignalSemaphores = &vkDev.renderSemaphore
+	};
+
+	VK_CHECK(vkQueueSubmit(vkDev.graphicsQueue, 1, &si, nullptr));
+
+	const VkPresentInfoKHR pi =
+	{
+		.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+		.pNext = nullptr,
+		.waitSemaphoreCount = 1,
+		.pWaitSemaphores = &vkDev.renderSemaphore,
+		.swapchainCount = 1,
+		.pSwapchains = &vkDev.swapchain,
+		.pImageIndices = &imageIndex
+	};
+
+	VK_CHECK(vkQueuePresentKHR(vkDev.graphicsQueue, &pi));
+	VK_CHECK(vkDeviceWaitIdle(vkDev.device));
+}
+
 bool drawFrame(VulkanRenderDevice& vkDev, const std::function<void(uint32_t)>& updateBuffersFunc, const std::function<void(VkCommandBuffer, uint32_t)>& composeFrameFunc)
 {
 	uint32_t imageIndex = 0;
@@ -79,36 +113,24 @@ bool drawFrame(VulkanRenderDevice& vkDev, const std::function<void(uint32_t)>& u
 
 	VK_CHECK(vkEndCommandBuffer(commandBuffer));
 
-	const VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT }; // or even VERTEX_SHADER_STAGE
+	submitAndPresent(vkDev, imageIndex, 1, &commandBuffer);
 
-	const VkSubmitInfo si =
-	{
-		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-		.pNext = nullptr,
-		.waitSemaphoreCount = 1,
-		.pWaitSemaphores = &vkDev.semaphore,
-		.pWaitDstStageMask = waitStages,
-		.commandBufferCount = 1,
-		.pCommandBuffers = &vkDev.commandBuffers[imageIndex],
-		.signalSemaphoreCount = 1,
-		.pSignalSemaphores = &vkDev.renderSemaphore
-	};
+	return true;
+}
 
-	VK_CHECK(vkQueueSubmit(vkDev.graphicsQueue, 1, &si, nullptr));
+bool drawFrame(VulkanRenderDevice& vkDev, const std::function<void(uint32_t)>& updateBuffersFunc, const std::function<const std::vector<VkCommandBuffer>&(uint32_t)>& recordFrameFunc)
+{
+	uint32_t imageIndex = 0;
+	VkResult result = vkAcquireNextImageKHR(vkDev.device, vkDev.swapchain, 0, vkDev.semaphore, VK_NULL_HANDLE, &imageIndex);
+	VK_CHECK(vkResetCommandPool(vkDev.device, vkDev.commandPool, 0));
 
-	const VkPresentInfoKHR pi =
-	{
-		.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-		.pNext = nullptr,
-		.waitSemaphoreCount = 1,
-		.pWaitSemaphores = &vkDev.renderSemaphore,
-		.swapchainCount = 1,
-		.pSwapchains = &vkDev.swapchain,
-		.pImageIndices = &imageIndex
-	};
+	if (result != VK_SUCCESS) return false;
 
-	VK_CHECK(vkQueuePresentKHR(vkDev.graphicsQueue, &pi));
-	VK_CHECK(vkDeviceWaitIdle(vkDev.device));
+	updateBuffersFunc(imageIndex);
+
+	const std::vector<VkCommandBuffer>& commandBuffers = recordFrameFunc(imageIndex);
+
+	submitAndPresent(vkDev, imageIndex, (uint32_t)commandBuffers.size(), commandBuffers.data());
 
 	return true;
 }
@@ -118,10 +140,36 @@ void VulkanRenderContext::updateBuffers(uint32_t imageIndex)
 	for (auto& r : onScreenRenderers_)
 		if (r.enabled_)
 			r.renderer_.updateBuffers(imageIndex);
+
+	// uploads are submitted to the graphics queue before this frame's command buffer (or acquired there), so they are visible to it
+	uploader.submit();
+
+	frameRing.flush();
+}
+
+static double millisecondsSince(std::chrono::high_resolution_clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+static const char* rendererScopeName(const RenderItem& r, size_t index)
+{
+	if (r.name_)
+		return r.name_;
+
+	// the profiler keeps the pointers for a few frames, so the generated names are never freed
+	static std::deque<std::string> names;
+
+	while (names.size() <= index)
+		names.push_back("Renderer " + std::to_string(names.size()));
+
+	return names[index].c_str();
 }
 
 void VulkanRenderContext::composeFrame(VkCommandBuffer commandBuffer, uint32_t imageIndex)
 {
+	const auto frameStart = std::chrono::high_resolution_clock::now();
+
 	const VkRect2D defaultScreenRect {
 		.offset = { 0, 0 },
 		.extent = {.width = vkDev.framebufferWidth, .height = vkDev.framebufferHeight }
@@ -133,12 +181,22 @@ void VulkanRenderContext::composeFrame(VkCommandBuffer commandBuffer, uint32_t i
 		VkClearValue { .depthStencil = { 1.0f, 0 } }
 	};
 
+	gpuProfiler.beginFrame();
+	gpuProfiler.resetQueries(commandBuffer);
+
 	beginRenderPass(commandBuffer, clearRenderPass.handle, imageIndex, defaultScreenRect, VK_NULL_HANDLE, 2u, defaultClearValues);
 	vkCmdEndRenderPass( commandBuffer );
 
-	for (auto& r : onScreenRenderers_)
+	recordingTimesMs_.assign(onScreenRenderers_.size(), 0.0);
+
+	for (size_t i = 0 ; i != onScreenRenderers_.size() ; i++)
+	{
+		auto& r = onScreenRenderers_[i];
+
 		if (r.enabled_)
 		{
+			const auto start = std::chrono::high_resolution_clock::now();
+
 			RenderPass rp = r.useDepth_ ? screenRenderPass : screenRenderPass_NoDepth;
 			VkFramebuffer fb = (r.useDepth_ ? swapchainFramebuffers : swapchainFramebuffers_NoDepth)[imageIndex];
 
@@ -147,11 +205,91 @@ void VulkanRenderContext::composeFrame(VkCommandBuffer commandBuffer, uint32_t i
 			if (r.renderer_.framebuffer_ != VK_NULL_HANDLE)
 				fb = r.renderer_.framebuffer_;
 
+			const uint32_t scope = gpuProfiler.beginScope(commandBuffer, rendererScopeName(r, i));
 			r.renderer_.fillCommandBuffer(commandBuffer, imageIndex, fb, rp.handle);
+			gpuProfiler.endScope(commandBuffer, scope);
+
+			recordingTimesMs_[i] = millisecondsSince(start);
 		}
+	}
 
 	beginRenderPass(commandBuffer, finalRenderPass.handle, imageIndex, defaultScreenRect);
 	vkCmdEndRenderPass( commandBuffer );
+
+	frameRecordingTimeMs_ = millisecondsSince(frameStart);
+}
+
+const std::vector<VkCommandBuffer>& VulkanRenderContext::recordFrame(uint32_t imageIndex)
+{
+	const auto frameStart = std::chrono::high_resolution_clock::now();
+
+	const VkRect2D defaultScreenRect {
+		.offset = { 0, 0 },
+		.extent = {.width = vkDev.framebufferWidth, .height = vkDev.framebufferHeight }
+	};
+
+	static const VkClearValue defaultClearValues[2] =
+	{
+		VkClearValue { .color = { 1.0f, 1.0f, 1.0f, 1.0f } },
+		VkClearValue { .depthStencil = { 1.0f, 0 } }
+	};
+
+	std::vector<VulkanParallelRecorder::RecordFunc> jobs;
+	std::vector<size_t> jobRenderers; // onScreenRenderers_ index of every job
+
+	// the command buffer of the first job is submitted first, so the queries are reset there
+	gpuProfiler.beginFrame();
+
+	jobs.push_back([this, imageIndex, defaultScreenRect](VkCommandBuffer cmd)
+		{
+			gpuProfiler.resetQueries(cmd);
+
+			beginRenderPass(cmd, clearRenderPass.handle, imageIndex, defaultScreenRect, VK_NULL_HANDLE, 2u, defaultClearValues);
+			vkCmdEndRenderPass( cmd );
+		});
+
+	for (size_t i = 0 ; i != onScreenRenderers_.size() ; i++)
+		if (onScreenRenderers_[i].enabled_)
+		{
+			jobRenderers.push_back(i);
+
+			// not thread-safe, so the name is generated before recording
+			const char* scopeName = rendererScopeName(onScreenRenderers_[i], i);
+
+			jobs.push_back([this, imageIndex, i, scopeName](VkCommandBuffer cmd)
+				{
+					auto& r = onScreenRenderers_[i];
+
+					RenderPass rp = r.useDepth_ ? screenRenderPass : screenRenderPass_NoDepth;
+					VkFramebuffer fb = (r.useDepth_ ? swapchainFramebuffers : swapchainFramebuffers_NoDepth)[imageIndex];
+
+					if (r.renderer_.renderPass_.handle != VK_NULL_HANDLE)
+						rp = r.renderer_.renderPass_;
+					if (r.renderer_.framebuffer_ != VK_NULL_HANDLE)
+						fb = r.renderer_.framebuffer_;
+
+					const uint32_t scope = gpuProfiler.beginScope(cmd, scopeName);
+					r.renderer_.fillCommandBuffer(cmd, imageIndex, fb, rp.handle);
+					gpuProfiler.endScope(cmd, scope);
+				});
+		}
+
+	jobs.push_back([this, imageIndex, defaultScreenRect](VkCommandBuffer cmd)
+		{
+			beginRenderPass(cmd, finalRenderPass.handle, imageIndex, defaultScreenRect);
+			vkCmdEndRenderPass( cmd );
+		});
+
+	const std::vector<VkCommandBuffer>& commandBuffers = recorder.record(imageIndex, jobs);
+
+	recordingTimesMs_.assign(onScreenRenderers_.size(), 0.0);
+
+	for (size_t j = 0 ; j != jobRenderers.size() ; j++)
+		recordingTimesMs_[jobRenderers[j]] = recorder.getJobTimes()[j + 1];
+
+	frameRecordingTimeMs_ = millisecondsSince(frameStart);
+
+	return commandBuffers;
 }
 
 void VulkanApp::assignCallbacks()
@@ -200,6 +338,8 @@ void VulkanApp::assignCallbacks()
 
 void VulkanApp::updateBuffers(uint32_t imageIndex)
 {
+	ctx_.frameRing.beginFrame();
+
 	ImGuiIO& io = ImGui::GetIO();
 	io.DisplaySize = ImVec2((float)ctx_.vkDev.framebufferWidth, (float)ctx_.vkDev.framebufferHeight);
 	ImGui::NewFrame();
@@ -228,13 +368,21 @@ void VulkanApp::mainLoop()
 
 		fpsCounter_.tick(deltaSeconds);
 
-		bool frameRendered = drawFrame(ctx_.vkDev,
-			[this](uint32_t img) { this->updateBuffers(img); },
-			[this](auto cmd, auto img) { ctx_.composeFrame(cmd, img); }
-		);
+		const bool frameRendered = ctx_.parallelRecording_ ?
+			drawFrame(ctx_.vkDev,
+				[this](uint32_t img) { this->updateBuffers(img); },
+				[this](uint32_t img) -> const std::vector<VkCommandBuffer>& { return ctx_.recordFrame(img); }
+			) :
+			drawFrame(ctx_.vkDev,
+				[this](uint32_t img) { this->updateBuffers(img); },
+				[this](auto cmd, auto img) { ctx_.composeFrame(cmd, img); }
+			);
 
 		fpsCounter_.tick(deltaSeconds, frameRendered);
 
+		if (frameRendered)
+			framePresented();
+
 		glfwPollEvents();
 
 	} while (!glfwWindowShouldClose(window_));
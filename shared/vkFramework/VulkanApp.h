@@ -21,6 +21,10 @@
 #include "shared/UtilsFPS.h"
 
 #include "shared/vkFramework/VulkanResources.h"
+#include "shared/vkFramework/VulkanRingBuffer.h"
+#include "shared/vkFramework/VulkanUploader.h"
+#include "shared/vkFramework/VulkanParallelRecorder.h"
+#include "shared/vkFramework/VulkanGPUProfiler.h"
 
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
@@ -39,15 +43,21 @@ GLFWwindow* initVulkanApp(int width, int height, Resolution* resolution = nullpt
 
 bool drawFrame(VulkanRenderDevice& vkDev, const std::function<void(uint32_t)>& updateBuffersFunc, const std::function<void(VkCommandBuffer, uint32_t)>& composeFrameFunc);
 
+/* Same as above, but the frame consists of several command buffers which are submitted together in the returned order */
+bool drawFrame(VulkanRenderDevice& vkDev, const std::function<void(uint32_t)>& updateBuffersFunc, const std::function<const std::vector<VkCommandBuffer>&(uint32_t)>& recordFrameFunc);
+
 struct Renderer;
 
 struct RenderItem {
 	Renderer& renderer_;
 	bool enabled_ = true;
 	bool useDepth_ = true;
-	explicit RenderItem(Renderer& r, bool useDepth = true)
+	// GPU profiler scope name (a static string), "Renderer <index>" if null
+	const char* name_ = nullptr;
+	explicit RenderItem(Renderer& r, bool useDepth = true, const char* name = nullptr)
 	: renderer_(r)
 	, useDepth_(useDepth)
+	, name_(name)
 	{}
 };
 
@@ -58,9 +68,25 @@ struct VulkanRenderContext
 	VulkanContextCreator ctxCreator;
 	VulkanResources resources;
 
+	// Persistently mapped per-frame storage for uniforms, indirect commands and per-instance data
+	VulkanRingBuffer frameRing;
+
+	// Batched staging uploads (textures/geometry) submitted once per frame or explicitly via uploader.submit()
+	VulkanUploader uploader;
+
+	// Per-thread command pools for recordFrame()
+	VulkanParallelRecorder recorder;
+
+	// Timestamp queries around every on-screen renderer (and every pass of a VulkanRenderGraph), see gpuProfiler.enabled_
+	VulkanGPUProfiler gpuProfiler;
+
 	VulkanRenderContext(void* window, uint32_t screenWidth, uint32_t screenHeight, const VulkanContextFeatures& ctxFeatures = VulkanContextFeatures()):
 		ctxCreator(vk, vkDev, window, screenWidth, screenHeight, ctxFeatures),
 		resources(vkDev),
+		frameRing(vkDev, resources, DefaultFrameRingSize, (uint32_t)vkDev.swapchainImages.size()),
+		uploader(vkDev),
+		recorder(vkDev),
+		gpuProfiler(vkDev),
 
 		depthTexture(resources.addDepthTexture(vkDev.framebufferWidth, vkDev.framebufferHeight, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)),
 
@@ -78,6 +104,19 @@ struct VulkanRenderContext
 	void updateBuffers(uint32_t imageIndex);
 	void composeFrame(VkCommandBuffer commandBuffer, uint32_t imageIndex);
 
+	/* Parallel version of composeFrame(): every enabled renderer is recorded into its own command buffer on a worker thread */
+	const std::vector<VkCommandBuffer>& recordFrame(uint32_t imageIndex);
+
+	/*
+		Opt-in: use recordFrame() in VulkanApp::mainLoop(). The renderers' fillCommandBuffer() must not modify
+		state shared with other renderers (updateBuffers() is still called serially)
+	*/
+	bool parallelRecording_ = false;
+
+	// CPU time of the last fillCommandBuffer() of every onScreenRenderers_ item (0 for disabled ones) and of the whole frame, in milliseconds
+	std::vector<double> recordingTimesMs_;
+	double frameRecordingTimeMs_ = 0.0;
+
 	// For Chapter 8 & 9
 	inline PipelineInfo pipelineParametersForOutputs(const std::vector<VulkanTexture>& outputs) const {
 		return PipelineInfo {
@@ -137,6 +176,8 @@ struct VulkanApp
 
 	virtual void drawUI() {}
 	virtual void draw3D() = 0;
+	/* Called after a frame has been presented and the device is idle */
+	virtual void framePresented() {}
 
 	void mainLoop();
 
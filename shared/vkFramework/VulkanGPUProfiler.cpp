@@ -0,0 +1,362 @@
+#include "shared/vkFramework/VulkanGPUProfiler.h"
+#include "shared/EasyProfilerWrapper.h"
+
+#include <imgui/imgui.h>
+
+#include <algorithm>
+
+#if BUILD_WITH_EASY_PROFILER
+#	include <condition_variable>
+#	include <mutex>
+#	include <thread>
+
+/* EasyProfiler stores blocks into the calling thread, so the GPU lane is a thread of its own which only stores resolved scopes */
+struct EasyProfilerGPULane
+{
+	struct Block
+	{
+		std::string name;
+		profiler::timestamp_t begin, end;
+	};
+
+	EasyProfilerGPULane(): thread_([this]() { run(); }) {}
+
+	~EasyProfilerGPULane()
+	{
+		{
+			std::lock_guard lock(mutex_);
+			quit_ = true;
+		}
+		cv_.notify_one();
+		thread_.join();
+	}
+
+	void push(std::vector<Block>&& blocks)
+	{
+		{
+			std::lock_guard lock(mutex_);
+			queue_.insert(queue_.end(), std::make_move_iterator(blocks.begin()), std::make_move_iterator(blocks.end()));
+		}
+		cv_.notify_one();
+	}
+
+private:
+	std::mutex mutex_;
+	std::condition_variable cv_;
+	std::vector<Block> queue_;
+	bool quit_ = false;
+	std::thread thread_;
+
+	void run()
+	{
+		EASY_THREAD("GPU");
+
+		static const profiler::BaseBlockDescriptor* desc = profiler::registerDescription(profiler::ON,
+			"VulkanGPUProfiler_scope", "GPU", __FILE__, __LINE__, profiler::BlockType::Block, profiler::colors::Orange);
+
+		std::vector<Block> blocks;
+
+		for (;;)
+		{
+			{
+				std::unique_lock lock(mutex_);
+				cv_.wait(lock, [this]() { return quit_ || !queue_.empty(); });
+				if (quit_)
+					return;
+				blocks.swap(queue_);
+			}
+
+			for (const auto& b: blocks)
+				profiler::storeBlock(desc, b.name.c_str(), b.begin, b.end);
+
+			blocks.clear();
+		}
+	}
+};
+#endif // BUILD_WITH_EASY_PROFILER
+
+/* Current time of the CPU profiler clock and its ticks per microsecond */
+static int64_t profilerTicks()
+{
+#if BUILD_WITH_EASY_PROFILER
+	return (int64_t)profiler::now();
+#elif BUILD_WITH_OPTICK
+	return Optick::GetHighPrecisionTime();
+#else
+	return 0;
+#endif
+}
+
+#if BUILD_WITH_EASY_PROFILER || BUILD_WITH_OPTICK
+static double profilerTicksPerUs()
+{
+#if BUILD_WITH_EASY_PROFILER
+	return 1000.0 * 1e9 / (double)profiler::toNanoseconds(1000000000ull);
+#elif BUILD_WITH_OPTICK
+	return (double)Optick::GetHighPrecisionFrequency() / 1e6;
+#endif
+}
+#endif
+
+VulkanGPUProfiler::VulkanGPUProfiler(VulkanRenderDevice& vkDev, uint32_t maxScopesPerFrame, uint32_t latencyFrames)
+: vkDev_(vkDev)
+, maxScopes_(maxScopesPerFrame)
+, latencyFrames_(std::max(latencyFrames, 1u))
+, slots_(std::max(latencyFrames, 1u))
+{
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties(vkDev.physicalDevice, &props);
+
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(vkDev.physicalDevice, &familyCount, nullptr);
+	std::vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(vkDev.physicalDevice, &familyCount, families.data());
+
+	const uint32_t validBits = (vkDev.graphicsFamily < familyCount) ? families[vkDev.graphicsFamily].timestampValidBits : 0;
+
+	if (!validBits || props.limits.timestampPeriod <= 0.0f)
+	{
+		printf("VulkanGPUProfiler: timestamps are not supported by the graphics queue\n");
+		return;
+	}
+
+	timestampPeriod_ = props.limits.timestampPeriod;
+	timestampMask_ = (validBits >= 64) ? ~0ull : ((1ull << validBits) - 1);
+
+	const VkQueryPoolCreateInfo ci = {
+		.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = 0,
+		.queryType = VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = latencyFrames_ * maxScopes_ * 2,
+		.pipelineStatistics = 0
+	};
+
+	VK_CHECK(vkCreateQueryPool(vkDev.device, &ci, nullptr, &pool_));
+
+	for (auto& s: slots_)
+		s.names.resize(maxScopes_, nullptr);
+
+	results_.resize(maxScopes_ * 2);
+}
+
+VulkanGPUProfiler::~VulkanGPUProfiler()
+{
+	if (pool_ != VK_NULL_HANDLE)
+		vkDestroyQueryPool(vkDev_.device, pool_, nullptr);
+}
+
+void VulkanGPUProfiler::beginFrame()
+{
+	frameActive_ = enabled_ && isSupported();
+
+	if (!isSupported())
+		return;
+
+	currentSlot_ = (uint32_t)(frame_++ % latencyFrames_);
+
+	// the queries of this slot were written 'latencyFrames' frames ago
+	if (slots_[currentSlot_].pending)
+		resolve(currentSlot_);
+
+	FrameSlot& slot = slots_[currentSlot_];
+	slot.numScopes = 0;
+	slot.pending = frameActive_;
+	slot.cpuTicks = profilerTicks();
+}
+
+void VulkanGPUProfiler::resetQueries(VkCommandBuffer cmdBuffer)
+{
+	if (!frameActive_)
+		return;
+
+	vkCmdResetQueryPool(cmdBuffer, pool_, currentSlot_ * maxScopes_ * 2, maxScopes_ * 2);
+}
+
+uint32_t VulkanGPUProfiler::beginScope(VkCommandBuffer cmdBuffer, const char* name)
+{
+	if (!frameActive_)
+		return InvalidScope;
+
+	FrameSlot& slot = slots_[currentSlot_];
+
+	const uint32_t scope = slot.numScopes.fetch_add(1);
+
+	if (scope >= maxScopes_)
+		return InvalidScope;
+
+	slot.names[scope] = name;
+
+	vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pool_, (currentSlot_ * maxScopes_ + scope) * 2);
+
+	return scope;
+}
+
+void VulkanGPUProfiler::endScope(VkCommandBuffer cmdBuffer, uint32_t scope)
+{
+	if (scope == InvalidScope)
+		return;
+
+	vkCmdWriteTimestamp(cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, pool_, (currentSlot_ * maxScopes_ + scope) * 2 + 1);
+}
+
+void VulkanGPUProfiler::resolve(uint32_t slotIndex)
+{
+	FrameSlot& slot = slots_[slotIndex];
+	slot.pending = false;
+
+	const uint32_t numScopes = std::min(slot.numScopes.load(), maxScopes_);
+
+	if (!numScopes)
+		return;
+
+	// no VK_QUERY_RESULT_WAIT_BIT: VK_NOT_READY means the frame is still in flight and its results are dropped
+	const VkResult result = vkGetQueryPoolResults(vkDev_.device, pool_, slotIndex * maxScopes_ * 2, numScopes * 2,
+		numScopes * 2 * sizeof(uint64_t), results_.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+	if (result != VK_SUCCESS)
+		return;
+
+	if (!traceOrigin_)
+		traceOrigin_ = results_[0] & timestampMask_;
+
+	std::vector<TraceEvent> events;
+	events.reserve(numScopes);
+
+	for (uint32_t i = 0 ; i != numScopes ; i++)
+	{
+		const uint64_t begin = results_[i * 2 + 0] & timestampMask_;
+		const uint64_t end   = results_[i * 2 + 1] & timestampMask_;
+
+		const double durationUs = (double)((end - begin) & timestampMask_) * timestampPeriod_ / 1000.0;
+
+		addSample(slot.names[i], (float)(durationUs / 1000.0));
+
+		events.push_back(TraceEvent {
+			.name_ = slot.names[i],
+			.category_ = "gpu",
+			.threadId_ = 0,
+			.startUs_ = (double)((begin - traceOrigin_) & timestampMask_) * timestampPeriod_ / 1000.0,
+			.durationUs_ = durationUs
+		});
+	}
+
+	submitToProfiler(events, slot.cpuTicks);
+
+	traceFrames_.push_back(std::move(events));
+
+	while (traceFrames_.size() > MaxTraceFrames)
+		traceFrames_.pop_front();
+}
+
+void VulkanGPUProfiler::addSample(const char* name, float ms)
+{
+	auto i = statsIndex_.find(name);
+
+	if (i == statsIndex_.end())
+	{
+		i = statsIndex_.emplace(name, stats_.size()).first;
+		stats_.emplace_back();
+		stats_.back().name = name;
+	}
+
+	ScopeStats& s = stats_[i->second];
+
+	s.lastMs = ms;
+	s.samples[s.nextSample] = ms;
+	s.nextSample = (s.nextSample + 1) % StatsWindow;
+	s.numSamples = std::min(s.numSamples + 1, StatsWindow);
+
+	float sum = 0.0f;
+	s.maxMs = 0.0f;
+
+	for (uint32_t j = 0 ; j != s.numSamples ; j++)
+	{
+		sum += s.samples[j];
+		s.maxMs = std::max(s.maxMs, s.samples[j]);
+	}
+
+	s.avgMs = sum / (float)s.numSamples;
+}
+
+void VulkanGPUProfiler::submitToProfiler(const std::vector<TraceEvent>& events, int64_t cpuTicks)
+{
+#if BUILD_WITH_EASY_PROFILER || BUILD_WITH_OPTICK
+	if (events.empty())
+		return;
+
+	static const double ticksPerUs = profilerTicksPerUs();
+
+	// the first scope of the frame starts at the CPU time of beginFrame()
+	const double frameStartUs = events.front().startUs_;
+
+	auto toTicks = [cpuTicks, frameStartUs](double us) { return cpuTicks + (int64_t)((us - frameStartUs) * ticksPerUs); };
+#endif
+
+#if BUILD_WITH_EASY_PROFILER
+	static EasyProfilerGPULane lane;
+
+	std::vector<EasyProfilerGPULane::Block> blocks;
+	blocks.reserve(events.size());
+
+	for (const auto& e: events)
+		blocks.push_back(EasyProfilerGPULane::Block { e.name_,
+			(profiler::timestamp_t)toTicks(e.startUs_), (profiler::timestamp_t)toTicks(e.startUs_ + e.durationUs_) });
+
+	lane.push(std::move(blocks));
+#elif BUILD_WITH_OPTICK
+	static Optick::EventStorage* storage = Optick::RegisterStorage("GPU");
+	static std::unordered_map<std::string, Optick::EventDescription*> descriptions;
+
+	for (const auto& e: events)
+	{
+		Optick::EventDescription*& desc = descriptions[e.name_];
+		if (!desc)
+			desc = Optick::EventDescription::Create(e.name_.c_str(), __FILE__, __LINE__);
+
+		OPTICK_STORAGE_EVENT(storage, desc, toTicks(e.startUs_), toTicks(e.startUs_ + e.durationUs_));
+	}
+#else
+	(void)events;
+	(void)cpuTicks;
+#endif
+}
+
+void VulkanGPUProfiler::drawStatsTable() const
+{
+	if (!isSupported())
+	{
+		ImGui::Text("GPU timestamps are not supported");
+		return;
+	}
+
+	if (!ImGui::BeginTable("GPU scopes", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+		return;
+
+	ImGui::TableSetupColumn("Scope");
+	ImGui::TableSetupColumn("Last, ms");
+	ImGui::TableSetupColumn("Avg, ms");
+	ImGui::TableSetupColumn("Max, ms");
+	ImGui::TableHeadersRow();
+
+	for (const auto& s: stats_)
+	{
+		ImGui::TableNextRow();
+		ImGui::TableNextColumn(); ImGui::TextUnformatted(s.name.c_str());
+		ImGui::TableNextColumn(); ImGui::Text("%.3f", s.lastMs);
+		ImGui::TableNextColumn(); ImGui::Text("%.3f", s.avgMs);
+		ImGui::TableNextColumn(); ImGui::Text("%.3f", s.maxMs);
+	}
+
+	ImGui::EndTable();
+}
+
+bool VulkanGPUProfiler::exportChromeTrace(const char* fileName) const
+{
+	std::vector<TraceEvent> events;
+
+	for (const auto& f: traceFrames_)
+		events.insert(events.end(), f.begin(), f.end());
+
+	return writeChromeTrace(fileName, events, { "GPU" });
+}
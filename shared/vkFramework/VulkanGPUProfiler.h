@@ -0,0 +1,118 @@
+#pragma once
+
+#include "shared/ChromeTrace.h"
+#include "shared/UtilsVulkan.h"
+
+#include <atomic>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+	GPU timestamp profiler
+
+	Scopes are pairs of timestamp queries around a piece of a command buffer (VulkanRenderContext wraps every
+	on-screen renderer, VulkanRenderGraph every pass). Every frame uses its own range of the query pool; the range is read back
+	'latencyFrames' frames later with vkGetQueryPoolResults() without VK_QUERY_RESULT_WAIT_BIT, so the CPU never waits for the GPU
+	(a frame whose results are not ready by then is dropped).
+
+	Resolved scopes go to
+	  - rolling per-scope statistics (getStats(), drawStatsTable()),
+	  - a history of recent frames for exportChromeTrace(),
+	  - a "GPU" lane of EasyProfiler or Optick, whichever is enabled (see EasyProfilerWrapper.h).
+	GPU timestamps are mapped to the CPU clock at the moment beginFrame() was called, so the lane is offset by the submission latency.
+*/
+struct VulkanGPUProfiler final
+{
+	static constexpr uint32_t InvalidScope = ~0u;
+
+	explicit VulkanGPUProfiler(VulkanRenderDevice& vkDev, uint32_t maxScopesPerFrame = 256, uint32_t latencyFrames = 3);
+	~VulkanGPUProfiler();
+
+	VulkanGPUProfiler(const VulkanGPUProfiler&) = delete;
+	VulkanGPUProfiler& operator = (const VulkanGPUProfiler&) = delete;
+
+	/* No queries are written while disabled */
+	bool enabled_ = false;
+
+	/* CPU side of a new frame (before any command buffer of the frame is recorded): resolves the oldest frame */
+	void beginFrame();
+
+	/* Has to be recorded before all scopes of the frame (in submission order), outside of a render pass */
+	void resetQueries(VkCommandBuffer cmdBuffer);
+
+	/* Thread-safe. 'name' has to stay valid for 'latencyFrames' frames. Returns InvalidScope if disabled or out of queries */
+	uint32_t beginScope(VkCommandBuffer cmdBuffer, const char* name);
+	void endScope(VkCommandBuffer cmdBuffer, uint32_t scope);
+
+	static constexpr uint32_t StatsWindow = 64;
+
+	struct ScopeStats
+	{
+		std::string name;
+		float lastMs = 0.0f;
+		float avgMs = 0.0f;   // over the last StatsWindow frames in which the scope was present
+		float maxMs = 0.0f;
+
+		float samples[StatsWindow] = {};
+		uint32_t numSamples = 0;
+		uint32_t nextSample = 0;
+	};
+
+	/* Scopes in the order of their first appearance */
+	inline const std::vector<ScopeStats>& getStats() const { return stats_; }
+
+	/* ImGui table with the rolling averages (call between ImGui::Begin()/End()) */
+	void drawStatsTable() const;
+
+	/* The last MaxTraceFrames resolved frames */
+	bool exportChromeTrace(const char* fileName) const;
+
+	static constexpr uint32_t MaxTraceFrames = 300;
+
+	inline bool isSupported() const { return pool_ != VK_NULL_HANDLE; }
+
+private:
+	struct FrameSlot
+	{
+		std::atomic<uint32_t> numScopes { 0 };
+		std::vector<const char*> names;
+		bool pending = false;
+
+		// profiler clock (EasyProfiler/Optick ticks) at beginFrame()
+		int64_t cpuTicks = 0;
+	};
+
+	VulkanRenderDevice& vkDev_;
+
+	const uint32_t maxScopes_;
+	const uint32_t latencyFrames_;
+
+	VkQueryPool pool_ = VK_NULL_HANDLE;
+
+	// nanoseconds per timestamp tick and the mask of valid timestamp bits
+	double timestampPeriod_ = 1.0;
+	uint64_t timestampMask_ = ~0ull;
+
+	std::vector<FrameSlot> slots_;
+	uint64_t frame_ = 0;
+	uint32_t currentSlot_ = 0;
+
+	// enabled_ latched in beginFrame(), so toggling it in the middle of a frame is harmless
+	bool frameActive_ = false;
+
+	// the first resolved timestamp is the origin of the Chrome trace
+	uint64_t traceOrigin_ = 0;
+
+	std::vector<ScopeStats> stats_;
+	std::unordered_map<std::string, size_t> statsIndex_;
+
+	std::deque<std::vector<TraceEvent>> traceFrames_;
+
+	std::vector<uint64_t> results_;
+
+	void resolve(uint32_t slot);
+	void addSample(const char* name, float ms);
+	void submitToProfiler(const std::vector<TraceEvent>& events, int64_t cpuTicks);
+};
@@ -0,0 +1,95 @@
+#include "shared/vkFramework/VulkanParallelRecorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+VulkanParallelRecorder::VulkanParallelRecorder(VulkanRenderDevice& vkDev, uint32_t numThreads)
+: vkDev_(vkDev)
+, executor_(numThreads ? numThreads : std::max(std::thread::hardware_concurrency(), 1u))
+{
+	const VkCommandPoolCreateInfo ci = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+		.queueFamilyIndex = vkDev.graphicsFamily
+	};
+
+	pools_.resize(vkDev.swapchainImages.size());
+
+	for (auto& framePools: pools_)
+	{
+		framePools.resize(executor_.num_workers());
+
+		for (auto& p: framePools)
+			VK_CHECK(vkCreateCommandPool(vkDev.device, &ci, nullptr, &p.pool));
+	}
+}
+
+VulkanParallelRecorder::~VulkanParallelRecorder()
+{
+	// destroying a pool frees all of its command buffers
+	for (auto& framePools: pools_)
+		for (auto& p: framePools)
+			vkDestroyCommandPool(vkDev_.device, p.pool, nullptr);
+}
+
+const std::vector<VkCommandBuffer>& VulkanParallelRecorder::record(uint32_t imageIndex, const std::vector<RecordFunc>& jobs)
+{
+	std::vector<ThreadCommandPool>& framePools = pools_[imageIndex];
+
+	for (auto& p: framePools)
+	{
+		VK_CHECK(vkResetCommandPool(vkDev_.device, p.pool, 0));
+		p.numUsed = 0;
+	}
+
+	cmdBuffers_.assign(jobs.size(), VK_NULL_HANDLE);
+	jobTimesMs_.assign(jobs.size(), 0.0);
+
+	tf::Taskflow taskflow;
+
+	taskflow.for_each_index(0, (int)jobs.size(), 1, [this, &jobs, &framePools](int i)
+		{
+			const auto start = std::chrono::high_resolution_clock::now();
+
+			// only this worker uses its pool
+			ThreadCommandPool& p = framePools[executor_.this_worker_id()];
+
+			if (p.numUsed == p.buffers.size())
+			{
+				const VkCommandBufferAllocateInfo ai = {
+					.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+					.pNext = nullptr,
+					.commandPool = p.pool,
+					.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+					.commandBufferCount = 1
+				};
+
+				VkCommandBuffer cmd = VK_NULL_HANDLE;
+				VK_CHECK(vkAllocateCommandBuffers(vkDev_.device, &ai, &cmd));
+				p.buffers.push_back(cmd);
+			}
+
+			VkCommandBuffer cmd = p.buffers[p.numUsed++];
+
+			const VkCommandBufferBeginInfo bi = {
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+				.pNext = nullptr,
+				.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+				.pInheritanceInfo = nullptr
+			};
+
+			VK_CHECK(vkBeginCommandBuffer(cmd, &bi));
+			jobs[i](cmd);
+			VK_CHECK(vkEndCommandBuffer(cmd));
+
+			cmdBuffers_[i] = cmd;
+			jobTimesMs_[i] = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+	);
+
+	executor_.run(taskflow).wait();
+
+	return cmdBuffers_;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "shared/UtilsVulkan.h"
+
+#include <functional>
+#include <vector>
+
+#include <taskflow/taskflow.hpp>
+
+/**
+	Multithreaded command buffer recording
+
+	Jobs are recorded concurrently on the taskflow worker threads. Every worker has its own command pool
+	(per swapchain image), so no pool is ever touched by two threads.
+
+	vkCmdBeginRenderPass() is only allowed in primary command buffers and every Renderer begins its own render passes,
+	so instead of secondary command buffers each job gets a primary command buffer of its own.
+	The buffers are returned in job order and have to be submitted in that order in a single vkQueueSubmit():
+	pipeline barriers are ordered by submission, so the result is the same as recording everything into one buffer.
+*/
+struct VulkanParallelRecorder final
+{
+	using RecordFunc = std::function<void(VkCommandBuffer)>;
+
+	/* 0 threads means std::thread::hardware_concurrency() */
+	explicit VulkanParallelRecorder(VulkanRenderDevice& vkDev, uint32_t numThreads = 0);
+	~VulkanParallelRecorder();
+
+	VulkanParallelRecorder(const VulkanParallelRecorder&) = delete;
+	VulkanParallelRecorder& operator = (const VulkanParallelRecorder&) = delete;
+
+	/* The command buffers of the previous frame which used 'imageIndex' must have completed execution */
+	const std::vector<VkCommandBuffer>& record(uint32_t imageIndex, const std::vector<RecordFunc>& jobs);
+
+	/* CPU time of every job of the last record() call in milliseconds */
+	inline const std::vector<double>& getJobTimes() const { return jobTimesMs_; }
+
+	inline uint32_t getNumThreads() const { return (uint32_t)executor_.num_workers(); }
+
+private:
+	struct ThreadCommandPool
+	{
+		VkCommandPool pool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> buffers;
+		uint32_t numUsed = 0;
+	};
+
+	VulkanRenderDevice& vkDev_;
+
+	tf::Executor executor_;
+
+	// [imageIndex][worker]
+	std::vector<std::vector<ThreadCommandPool>> pools_;
+
+	std::vector<VkCommandBuffer> cmdBuffers_;
+	std::vector<double> jobTimesMs_;
+};
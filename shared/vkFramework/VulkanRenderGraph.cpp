@@ -0,0 +1,288 @@
+#include "shared/vkFramework/VulkanRenderGraph.h"
+#include "shared/TransientHeap.h"
+
+VulkanResourceState vulkanResourceState(eResourceUsage usage)
+{
+	const VkPipelineStageFlags shaderStages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	const VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+	switch (usage)
+	{
+	case eResourceUsage_ColorAttachment:
+		return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	case eResourceUsage_DepthAttachment:
+		return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, depthStages };
+	case eResourceUsage_DepthRead:
+		return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT, depthStages };
+	case eResourceUsage_ShaderRead:
+		return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, shaderStages };
+	case eResourceUsage_StorageRead:
+		return { VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_READ_BIT, shaderStages };
+	case eResourceUsage_StorageWrite:
+		return { VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_WRITE_BIT, shaderStages };
+	case eResourceUsage_StorageReadWrite:
+		return { VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, shaderStages };
+	case eResourceUsage_TransferSrc:
+		return { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT };
+	case eResourceUsage_TransferDst:
+		return { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT };
+	case eResourceUsage_IndirectArgs:
+		return { VK_IMAGE_LAYOUT_UNDEFINED, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT };
+	default:
+		return { VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT };
+	}
+}
+
+uint32_t VulkanRenderGraph::addTexture(const char* name, VulkanTexture tex, bool isExternal, eResourceUsage initialUsage, eResourceUsage finalUsage)
+{
+	resources_.push_back(GraphResource { .texture = tex, .buffer = {} });
+
+	return graph_.addResource(name, RenderGraphResourceDesc {
+		.isImage_ = true,
+		.isExternal_ = isExternal,
+		.initialUsage_ = initialUsage,
+		.finalUsage_ = finalUsage
+	});
+}
+
+uint32_t VulkanRenderGraph::addBuffer(const char* name, VulkanBuffer buffer, bool isExternal, eResourceUsage initialUsage, eResourceUsage finalUsage)
+{
+	resources_.push_back(GraphResource { .texture = {}, .buffer = buffer });
+
+	return graph_.addResource(name, RenderGraphResourceDesc {
+		.isImage_ = false,
+		.isExternal_ = isExternal,
+		.initialUsage_ = initialUsage,
+		.finalUsage_ = finalUsage
+	});
+}
+
+uint32_t VulkanRenderGraph::addTransientTexture(const char* name, const TransientTextureDesc& desc)
+{
+	const uint32_t resource = addTexture(name, VulkanTexture {}, false, eResourceUsage_Undefined, eResourceUsage_ShaderRead);
+	transientTextures_.emplace_back(resource, desc);
+	return resource;
+}
+
+void VulkanRenderGraph::allocateTransientTextures(bool alias)
+{
+	compileIfNeeded();
+
+	std::vector<TransientTextureDesc> descs;
+	descs.reserve(transientTextures_.size());
+
+	for (const auto& t: transientTextures_)
+	{
+		TransientTextureDesc d = t.second;
+
+		// unused textures get an empty range and may overlap anything
+		if (!graph_.getResourceLifetime(t.first, &d.firstStep, &d.lastStep))
+		{
+			d.firstStep = 1;
+			d.lastStep = 0;
+		}
+
+		descs.push_back(d);
+	}
+
+	TransientHeapLayout layout;
+	const std::vector<VulkanTexture> textures = ctx_.resources.addTransientColorTextures(descs, alias, &layout);
+
+	for (size_t i = 0 ; i != textures.size() ; i++)
+	{
+		const uint32_t resource = transientTextures_[i].first;
+		resources_[resource].texture = textures[i];
+		resources_[resource].isAliased = alias;
+
+		if (alias)
+			graph_.setResourceFinalUsage(resource, eResourceUsage_Undefined);
+
+		setVkImageName(ctx_.vkDev, textures[i].image.image, graph_.getResourceName(resource).c_str());
+	}
+
+	transientHeapSize_ = layout.heapSize_;
+	transientUnaliasedSize_ = layout.unaliasedSize_;
+}
+
+uint32_t VulkanRenderGraph::addPass(const char* name, Renderer& renderer, bool hasSideEffects)
+{
+	passRenderers_.push_back(&renderer);
+	return graph_.addPass(name, hasSideEffects);
+}
+
+uint32_t VulkanRenderGraph::addPass(const char* name, bool hasSideEffects)
+{
+	passRenderers_.push_back(nullptr);
+	return graph_.addPass(name, hasSideEffects);
+}
+
+void VulkanRenderGraph::compileIfNeeded()
+{
+	if (graph_.isCompiled())
+		return;
+
+	if (!graph_.compile())
+	{
+		printf("VulkanRenderGraph: cannot compile the graph\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+void VulkanRenderGraph::emitBarriers(VkCommandBuffer cmdBuffer, const std::vector<RenderGraphBarrier>& barriers) const
+{
+	if (barriers.empty())
+		return;
+
+	std::vector<VkImageMemoryBarrier> imageBarriers;
+	std::vector<VkBufferMemoryBarrier> bufferBarriers;
+
+	VkPipelineStageFlags srcStages = 0;
+	VkPipelineStageFlags dstStages = 0;
+
+	// writes of the previous texture living in aliased memory (the image barrier covers only the new image)
+	VkAccessFlags aliasDstAccess = 0;
+
+	for (const auto& b: barriers)
+	{
+		const VulkanResourceState before = vulkanResourceState(b.before_);
+		const VulkanResourceState after  = vulkanResourceState(b.after_);
+
+		srcStages |= before.stages;
+		dstStages |= after.stages;
+
+		const GraphResource& r = resources_[b.resource_];
+
+		// the memory may still be in use by another texture which lives in it
+		if (r.isAliased && b.before_ == eResourceUsage_Undefined)
+		{
+			srcStages |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+			aliasDstAccess |= after.access;
+		}
+
+		if (graph_.getResourceDesc(b.resource_).isImage_)
+		{
+			VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+			if (isDepthFormat(r.texture.format))
+				aspect = VK_IMAGE_ASPECT_DEPTH_BIT | (hasStencilComponent(r.texture.format) ? VK_IMAGE_ASPECT_STENCIL_BIT : 0);
+
+			imageBarriers.push_back(VkImageMemoryBarrier {
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+				.pNext = nullptr,
+				.srcAccessMask = before.access,
+				.dstAccessMask = after.access,
+				.oldLayout = before.layout,
+				.newLayout = after.layout,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.image = r.texture.image.image,
+				.subresourceRange = VkImageSubresourceRange {
+					.aspectMask = aspect,
+					.baseMipLevel = 0,
+					.levelCount = VK_REMAINING_MIP_LEVELS,
+					.baseArrayLayer = 0,
+					.layerCount = VK_REMAINING_ARRAY_LAYERS
+				}
+			});
+		}
+		else
+		{
+			bufferBarriers.push_back(VkBufferMemoryBarrier {
+				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+				.pNext = nullptr,
+				.srcAccessMask = before.access,
+				.dstAccessMask = after.access,
+				.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				.buffer = r.buffer.buffer,
+				.offset = 0,
+				.size = VK_WHOLE_SIZE
+			});
+		}
+	}
+
+	const VkMemoryBarrier aliasBarrier = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = aliasDstAccess
+	};
+
+	// all transitions in front of a pass go into a single call
+	vkCmdPipelineBarrier(cmdBuffer, srcStages, dstStages, 0,
+		aliasDstAccess ? 1u : 0u, aliasDstAccess ? &aliasBarrier : nullptr,
+		(uint32_t)bufferBarriers.size(), bufferBarriers.data(),
+		(uint32_t)imageBarriers.size(), imageBarriers.data());
+}
+
+void VulkanRenderGraph::fillCommandBuffer(VkCommandBuffer cmdBuffer, size_t currentImage, VkFramebuffer fb1, VkRenderPass rp1)
+{
+	compileIfNeeded();
+
+	for (const auto& step: graph_.getSteps())
+	{
+		emitBarriers(cmdBuffer, step.barriers_);
+
+		Renderer& r = *passRenderers_[step.pass_];
+
+		VkRenderPass rp = rp1;
+		VkFramebuffer fb = fb1;
+
+		if (r.renderPass_.handle != VK_NULL_HANDLE)
+			rp = r.renderPass_.handle;
+		if (r.framebuffer_ != VK_NULL_HANDLE)
+			fb = r.framebuffer_;
+
+		const uint32_t scope = ctx_.gpuProfiler.beginScope(cmdBuffer, graph_.getPassName(step.pass_).c_str());
+		r.fillCommandBuffer(cmdBuffer, currentImage, fb, rp);
+		ctx_.gpuProfiler.endScope(cmdBuffer, scope);
+	}
+
+	emitBarriers(cmdBuffer, graph_.getFinalBarriers());
+}
+
+void VulkanRenderGraph::updateBuffers(size_t currentImage)
+{
+	compileIfNeeded();
+
+	for (const auto& step: graph_.getSteps())
+		passRenderers_[step.pass_]->updateBuffers(currentImage);
+}
+
+void VulkanRenderGraph::dump(const char* dotFileName)
+{
+	compileIfNeeded();
+
+	graph_.print();
+	dumpRenderGraphToDot(dotFileName, graph_);
+}
+
+void VulkanRenderGraph::printMemoryReport(const char* chainName) const
+{
+	if (transientTextures_.empty())
+		return;
+
+	const double MB = 1024.0 * 1024.0;
+
+	printf("%s: %.1f MB of transient memory allocated (%.1f MB without aliasing)\n", chainName,
+		(double)transientHeapSize_ / MB, (double)transientUnaliasedSize_ / MB);
+
+	std::vector<TransientTarget> targets;
+
+	for (const auto& t: transientTextures_)
+	{
+		uint32_t firstStep = 1;
+		uint32_t lastStep = 0;
+		graph_.getResourceLifetime(t.first, &firstStep, &lastStep);
+
+		targets.push_back(TransientTarget {
+			.width_ = (uint32_t)t.second.width,
+			.height_ = (uint32_t)t.second.height,
+			.divisor_ = (uint32_t)t.second.divisor,
+			.bytesPerPixel_ = bytesPerTexFormat(t.second.format),
+			.firstStep_ = firstStep,
+			.lastStep_ = lastStep
+		});
+	}
+
+	printTransientMemoryReport(chainName, targets);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "shared/RenderGraph.h"
+#include "shared/vkFramework/Renderer.h"
+
+/// Vulkan image layout, access mask and pipeline stages corresponding to a graph usage
+struct VulkanResourceState
+{
+	VkImageLayout layout;
+	VkAccessFlags access;
+	VkPipelineStageFlags stages;
+};
+
+VulkanResourceState vulkanResourceState(eResourceUsage usage);
+
+/**
+	A replacement for CompositeRenderer with hand-placed Barriers.h renderers:
+	passes are Renderer instances which declare the textures and buffers they read and write.
+	Execution order, culling and merged pipeline barriers come from RenderGraph.
+
+	Textures are expected to be in SHADER_READ_ONLY_OPTIMAL between frames (the default for VulkanResources::addColorTexture()),
+	render passes are expected to keep attachments in the attachment layout (the default RenderPassCreateInfo).
+
+	Transient textures live only inside the graph and share memory when their lifetimes do not overlap.
+	Since the renderers need the textures in their constructors, an effect declares the graph first
+	(resources without textures, passes without renderers), calls allocateTransientTextures()
+	and attaches everything else with setTexture()/setPassRenderer() afterwards.
+*/
+struct VulkanRenderGraph: public Renderer
+{
+	explicit VulkanRenderGraph(VulkanRenderContext& c): Renderer(c) {}
+
+	uint32_t addTexture(const char* name, VulkanTexture tex, bool isExternal = false,
+		eResourceUsage initialUsage = eResourceUsage_ShaderRead, eResourceUsage finalUsage = eResourceUsage_ShaderRead);
+
+	uint32_t addBuffer(const char* name, VulkanBuffer buffer, bool isExternal = false,
+		eResourceUsage initialUsage = eResourceUsage_Undefined, eResourceUsage finalUsage = eResourceUsage_Undefined);
+
+	/* Initial state is Undefined (the contents are discarded at the first use), the graph leaves it in ShaderRead
+	   unless the memory is aliased: a final transition of a dead texture would overwrite the one living in its memory */
+	uint32_t addTransientTexture(const char* name, const TransientTextureDesc& desc = TransientTextureDesc());
+
+	/* Create all transient textures in one memory block; lifetimes come from the compiled graph, so all passes have to be declared */
+	void allocateTransientTextures(bool alias = true);
+
+	inline void setTexture(uint32_t resource, VulkanTexture tex) { resources_[resource].texture = tex; }
+	inline VulkanTexture getTexture(uint32_t resource) const { return resources_[resource].texture; }
+
+	/* The renderer's own render pass/framebuffer are used (same as in CompositeRenderer) */
+	uint32_t addPass(const char* name, Renderer& renderer, bool hasSideEffects = false);
+
+	/* The renderer is attached later with setPassRenderer() */
+	uint32_t addPass(const char* name, bool hasSideEffects = false);
+	inline void setPassRenderer(uint32_t pass, Renderer& renderer) { passRenderers_[pass] = &renderer; }
+
+	inline void read(uint32_t pass, uint32_t resource, eResourceUsage usage = eResourceUsage_ShaderRead, eResourceUsage leavesAs = eResourceUsage_Undefined) {
+		graph_.read(pass, resource, usage, leavesAs);
+	}
+
+	inline void write(uint32_t pass, uint32_t resource, eResourceUsage usage = eResourceUsage_ColorAttachment, eResourceUsage leavesAs = eResourceUsage_Undefined) {
+		graph_.write(pass, resource, usage, leavesAs);
+	}
+
+	/* The graph is recompiled lazily in the next fillCommandBuffer() */
+	inline void setPassEnabled(uint32_t pass, bool enabled) { graph_.setPassEnabled(pass, enabled); }
+
+	void fillCommandBuffer(VkCommandBuffer cmdBuffer, size_t currentImage, VkFramebuffer fb = VK_NULL_HANDLE, VkRenderPass rp = VK_NULL_HANDLE) override;
+
+	void updateBuffers(size_t currentImage) override;
+
+	/* Print the schedule and write a Graphviz file */
+	void dump(const char* dotFileName);
+
+	/* Allocated transient memory and the estimated savings at common resolutions */
+	void printMemoryReport(const char* chainName) const;
+
+	inline const RenderGraph& getGraph() const { return graph_; }
+
+protected:
+	RenderGraph graph_;
+
+private:
+	struct GraphResource
+	{
+		VulkanTexture texture;
+		VulkanBuffer buffer;
+		bool isAliased = false;
+	};
+
+	std::vector<GraphResource> resources_;
+	std::vector<Renderer*> passRenderers_;
+
+	std::vector<std::pair<uint32_t, TransientTextureDesc>> transientTextures_;
+
+	uint64_t transientHeapSize_ = 0;
+	uint64_t transientUnaliasedSize_ = 0;
+
+	void compileIfNeeded();
+
+	void emitBarriers(VkCommandBuffer cmdBuffer, const std::vector<RenderGraphBarrier>& barriers) const;
+};
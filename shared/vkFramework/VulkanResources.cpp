@@ -1,4 +1,6 @@
 #include "shared/vkFramework/VulkanResources.h"
+#include "shared/vkFramework/VulkanUploader.h"
+#include "shared/TransientHeap.h"
 
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -13,6 +15,8 @@
 
 #include <algorithm>
 
+#include <stb/stb_image.h>
+
 glslang_stage_t glslangShaderStageFromFileName(const char* fileName);
 
 VulkanResources::~VulkanResources()
@@ -23,6 +27,9 @@ VulkanResources::~VulkanResources()
 		vkDestroySampler(vkDev.device, t.sampler, nullptr);
 	}
 
+	for (auto m: allMemoryBlocks)
+		vkFreeMemory(vkDev.device, m, nullptr);
+
 	for (auto& b: allBuffers)
 	{
 		if (b.ptr != nullptr)
@@ -154,6 +161,54 @@ VulkanTexture VulkanResources::addRGBATexture(int texWidth, int texHeight, void*
 	return tex;
 }
 
+VulkanTexture VulkanResources::loadTexture2D(const char* filename, VulkanUploader& uploader)
+{
+	int texWidth, texHeight, texChannels;
+	stbi_uc* pixels = stbi_load(filename, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+
+	if (!pixels)
+	{
+		printf("Cannot load %s 2D texture file\n", filename);
+		exit(EXIT_FAILURE);
+	}
+
+	// pixels are copied into the staging ring right away, so they can be freed before the batch is submitted
+	VulkanTexture tex = addRGBATexture(texWidth, texHeight, pixels, uploader);
+
+	stbi_image_free(pixels);
+
+	return tex;
+}
+
+VulkanTexture VulkanResources::addRGBATexture(int texWidth, int texHeight, const void* data, VulkanUploader& uploader)
+{
+	VulkanTexture tex;
+	tex.width  = texWidth;
+	tex.height = texHeight;
+	tex.depth  = 1;
+	tex.format = VK_FORMAT_R8G8B8A8_UNORM;
+
+	if (!createImage(vkDev.device, vkDev.physicalDevice, texWidth, texHeight, tex.format,
+		VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, tex.image.image, tex.image.imageMemory))
+	{
+		printf("Cannot create 2d texture\n");
+		exit(EXIT_FAILURE);
+	}
+
+	uploader.uploadImage(tex.image.image, tex.format, texWidth, texHeight, 4, data);
+
+	if (!createImageView(vkDev.device, tex.image.image, tex.format, VK_IMAGE_ASPECT_COLOR_BIT, &tex.image.imageView))
+	{
+		printf("Cannot create image view for 2d texture\n");
+		exit(EXIT_FAILURE);
+	}
+
+	createTextureSampler(vkDev.device, &tex.sampler);
+	allTextures.push_back(tex);
+	return tex;
+}
+
 VulkanTexture VulkanResources::addSolidRGBATexture(uint32_t color)
 {
 	VulkanTexture tex;
@@ -212,6 +267,98 @@ VulkanTexture VulkanResources::addColorTexture(int texWidth, int texHeight, VkFo
 	return res;
 }
 
+std::vector<VulkanTexture> VulkanResources::addTransientColorTextures(const std::vector<TransientTextureDesc>& descs, bool alias, TransientHeapLayout* outLayout)
+{
+	std::vector<VulkanTexture> textures(descs.size());
+	std::vector<TransientAllocation> allocations(descs.size());
+
+	uint32_t memoryTypeBits = ~0u;
+
+	for (size_t i = 0 ; i != descs.size() ; i++)
+	{
+		const TransientTextureDesc& d = descs[i];
+		VulkanTexture& t = textures[i];
+
+		t.width  = (d.width  > 0) ? d.width  : std::max(vkDev.framebufferWidth  / (uint32_t)d.divisor, 1u);
+		t.height = (d.height > 0) ? d.height : std::max(vkDev.framebufferHeight / (uint32_t)d.divisor, 1u);
+		t.depth  = 1;
+		t.format = d.format;
+
+		// same usage as in createOffscreenImage(), but the memory is bound later
+		const VkImageCreateInfo imageInfo = {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = d.format,
+			.extent = VkExtent3D { .width = t.width, .height = t.height, .depth = 1 },
+			.mipLevels = 1,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			.queueFamilyIndexCount = 0,
+			.pQueueFamilyIndices = nullptr,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+		};
+
+		VK_CHECK(vkCreateImage(vkDev.device, &imageInfo, nullptr, &t.image.image));
+
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(vkDev.device, t.image.image, &memRequirements);
+
+		memoryTypeBits &= memRequirements.memoryTypeBits;
+
+		allocations[i] = TransientAllocation {
+			.size_ = memRequirements.size,
+			.alignment_ = memRequirements.alignment,
+			.firstStep_ = d.firstStep,
+			.lastStep_ = d.lastStep
+		};
+	}
+
+	if (!memoryTypeBits)
+	{
+		printf("Transient textures have no common memory type\n");
+		exit(EXIT_FAILURE);
+	}
+
+	const TransientHeapLayout layout = planTransientHeap(allocations, alias);
+
+	const VkMemoryAllocateInfo allocInfo = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.allocationSize = layout.heapSize_,
+		.memoryTypeIndex = findMemoryType(vkDev.physicalDevice, memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+	};
+
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VK_CHECK(vkAllocateMemory(vkDev.device, &allocInfo, nullptr, &memory));
+	allMemoryBlocks.push_back(memory);
+
+	for (size_t i = 0 ; i != descs.size() ; i++)
+	{
+		const TransientTextureDesc& d = descs[i];
+		VulkanTexture& t = textures[i];
+
+		VK_CHECK(vkBindImageMemory(vkDev.device, t.image.image, memory, layout.offsets_[i]));
+
+		createImageView(vkDev.device, t.image.image, d.format, VK_IMAGE_ASPECT_COLOR_BIT, &t.image.imageView);
+		createTextureSampler(vkDev.device, &t.sampler, d.minFilter, d.maxFilter, d.addressMode);
+
+		// a valid layout for the descriptors; the contents are discarded at the first step anyway
+		transitionImageLayout(vkDev, t.image.image, d.format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+		allTextures.push_back(t);
+	}
+
+	if (outLayout)
+		*outLayout = layout;
+
+	return textures;
+}
+
 VulkanTexture VulkanResources::addDepthTexture(int texWidth, int texHeight, VkImageLayout layout)
 {
 	const uint32_t w = (texWidth  > 0) ? texWidth  : vkDev.framebufferWidth;
@@ -264,6 +411,22 @@ VulkanBuffer VulkanResources::addBuffer(VkDeviceSize size, VkBufferUsageFlags us
 	return buffer;
 }
 
+void VulkanResources::freeBuffer(const VulkanBuffer& buffer)
+{
+	auto i = std::find_if(allBuffers.begin(), allBuffers.end(), [&buffer](const VulkanBuffer& b) { return b.buffer == buffer.buffer; });
+
+	if (i == allBuffers.end())
+		return;
+
+	if (buffer.ptr != nullptr)
+		vkUnmapMemory(vkDev.device, buffer.memory);
+
+	vkDestroyBuffer(vkDev.device, buffer.buffer, nullptr);
+	vkFreeMemory(vkDev.device, buffer.memory, nullptr);
+
+	allBuffers.erase(i);
+}
+
 VulkanBuffer VulkanResources::addVertexBuffer(uint32_t indexBufferSize, const void* indexData, uint32_t vertexBufferSize, const void* vertexData)
 {
 	VulkanBuffer result;
@@ -272,10 +435,32 @@ VulkanBuffer VulkanResources::addVertexBuffer(uint32_t indexBufferSize, const vo
 	return result;
 }
 
+VulkanBuffer VulkanResources::addVertexBuffer(uint32_t indexBufferSize, const void* indexData, uint32_t vertexBufferSize, const void* vertexData, VulkanUploader& uploader)
+{
+	VulkanBuffer result = { .buffer = VK_NULL_HANDLE, .size = (VkDeviceSize)vertexBufferSize + indexBufferSize, .memory = VK_NULL_HANDLE, .ptr = nullptr };
+
+	if (!createBuffer(vkDev.device, vkDev.physicalDevice, result.size,
+		VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, result.buffer, result.memory))
+	{
+		printf("Cannot allocate vertex buffer\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// same layout as allocateVertexBuffer(): vertices first, then indices
+	uploader.uploadBuffer(result.buffer, 0, vertexData, vertexBufferSize);
+	uploader.uploadBuffer(result.buffer, vertexBufferSize, indexData, indexBufferSize);
+
+	allBuffers.push_back(result);
+	return result;
+}
+
 VkDescriptorPool VulkanResources::addDescriptorPool(const DescriptorSetInfo& dsInfo, uint32_t dSetCount)
 {
 	uint32_t uniformBufferCount = 0;
 	uint32_t storageBufferCount = 0;
+	uint32_t dynamicUniformBufferCount = 0;
+	uint32_t dynamicStorageBufferCount = 0;
 	uint32_t samplerCount = static_cast<uint32_t>(dsInfo.textures.size());
 
 	for(const auto& ta : dsInfo.textureArrays)
@@ -287,6 +472,10 @@ VkDescriptorPool VulkanResources::addDescriptorPool(const DescriptorSetInfo& dsI
 			uniformBufferCount++;
 		if (b.dInfo.type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
 			storageBufferCount++;
+		if (b.dInfo.type == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC)
+			dynamicUniformBufferCount++;
+		if (b.dInfo.type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC)
+			dynamicStorageBufferCount++;
 	}
 
 	std::vector<VkDescriptorPoolSize> poolSizes;
@@ -299,6 +488,12 @@ VkDescriptorPool VulkanResources::addDescriptorPool(const DescriptorSetInfo& dsI
 	if (storageBufferCount)
 		poolSizes.push_back(VkDescriptorPoolSize{ .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = dSetCount * storageBufferCount });
 
+	if (dynamicUniformBufferCount)
+		poolSizes.push_back(VkDescriptorPoolSize{ .type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, .descriptorCount = dSetCount * dynamicUniformBufferCount });
+
+	if (dynamicStorageBufferCount)
+		poolSizes.push_back(VkDescriptorPoolSize{ .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, .descriptorCount = dSetCount * dynamicStorageBufferCount });
+
 	if (samplerCount)
 		poolSizes.push_back(VkDescriptorPoolSize{ .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = dSetCount * samplerCount });
 
@@ -357,7 +552,8 @@ bool VulkanResources::createGraphicsPipeline(
 	bool dynamicScissorState,
 	int32_t customWidth,
 	int32_t customHeight,
-	uint32_t numPatchControlPoints)
+	uint32_t numPatchControlPoints,
+	bool useColor)
 {
 	std::vector<ShaderModule> localShaderModules;
 	std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
@@ -451,8 +647,8 @@ bool VulkanResources::createGraphicsPipeline(
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
 		.logicOpEnable = VK_FALSE,
 		.logicOp = VK_LOGIC_OP_COPY,
-		.attachmentCount = 1,
-		.pAttachments = &colorBlendAttachment,
+		.attachmentCount = useColor ? 1u : 0u,
+		.pAttachments = useColor ? &colorBlendAttachment : nullptr,
 		.blendConstants = { 0.0f, 0.0f, 0.0f, 0.0f }
 	};
 
@@ -515,7 +711,7 @@ VkPipeline VulkanResources::addPipeline(VkRenderPass renderPass, VkPipelineLayou
 	VkPipeline pipeline;
 
 	if (!this->createGraphicsPipeline(vkDev, renderPass, pipelineLayout, shaderFiles,
-		&pipeline, ppInfo.topology, ppInfo.useDepth, ppInfo.useBlending, ppInfo.dynamicScissorState, ppInfo.width, ppInfo.height, ppInfo.patchControlPoints))
+		&pipeline, ppInfo.topology, ppInfo.useDepth, ppInfo.useBlending, ppInfo.dynamicScissorState, ppInfo.width, ppInfo.height, ppInfo.patchControlPoints, ppInfo.useColor))
 	{
 		printf("Cannot create graphics pipeline\n");
 		exit(EXIT_FAILURE);
@@ -8,6 +8,9 @@
 #include <utility>
 #include <string>
 
+struct VulkanUploader;
+struct TransientHeapLayout;
+
 /**
 	For more or less abstract descriptor set setup we need to describe individual items ("bindings").
 	These are buffers, textures (samplers, but we call them "textures" here) and arrays of textures.
@@ -100,6 +103,31 @@ inline BufferAttachment storageBufferAttachment(VulkanBuffer buffer, uint32_t of
 	return makeBufferAttachment(buffer, offset, size, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, shaderStageFlags);
 }
 
+/* Dynamic buffers are bound once to the whole ring buffer, the actual offset is passed in vkCmdBindDescriptorSets() */
+inline BufferAttachment dynamicUniformBufferAttachment(VulkanBuffer buffer, uint32_t size, VkShaderStageFlags shaderStageFlags) {
+	return makeBufferAttachment(buffer, 0, size, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, shaderStageFlags);
+}
+
+inline BufferAttachment dynamicStorageBufferAttachment(VulkanBuffer buffer, uint32_t size, VkShaderStageFlags shaderStageFlags) {
+	return makeBufferAttachment(buffer, 0, size, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, shaderStageFlags);
+}
+
+/** Color texture which shares its memory with other transient textures (see VulkanResources::addTransientColorTextures()) */
+struct TransientTextureDesc
+{
+	int width = 0;   // 0: framebuffer size divided by 'divisor'
+	int height = 0;
+	int divisor = 1;
+	VkFormat format = VK_FORMAT_B8G8R8A8_UNORM;
+	VkFilter minFilter = VK_FILTER_LINEAR;
+	VkFilter maxFilter = VK_FILTER_LINEAR;
+	VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+	/* Inclusive range of render graph steps which use the texture */
+	uint32_t firstStep = 0;
+	uint32_t lastStep = 0;
+};
+
 /** An aggregate structure with all the data for descriptor set (or descriptor set layout) allocation */
 struct DescriptorSetInfo
 {
@@ -120,6 +148,9 @@ struct PipelineInfo
 
 	bool useBlending = true;
 
+	/* false for depth-only render passes (no color blend attachment) */
+	bool useColor = true;
+
 	bool dynamicScissorState = false;
 
 	uint32_t patchControlPoints = 0;
@@ -151,6 +182,9 @@ struct VulkanResources
 
 	VulkanTexture loadTexture2D(const char* filename);
 
+	/* Same as above, but the pixel copy is recorded into the uploader's current batch instead of a blocking submit */
+	VulkanTexture loadTexture2D(const char* filename, VulkanUploader& uploader);
+
 	VulkanTexture loadCubeMap(const char* fileName, uint32_t mipLevels = 1);
 
 	VulkanTexture loadKTX(const char* fileName);
@@ -159,14 +193,24 @@ struct VulkanResources
 
 	VulkanTexture addColorTexture(int texWidth = 0, int texHeight = 0, VkFormat colorFormat = VK_FORMAT_B8G8R8A8_UNORM, VkFilter minFilter = VK_FILTER_LINEAR, VkFilter maxFilter = VK_FILTER_LINEAR, VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT);
 
+	/*
+		Color textures placed in a single memory block: textures with disjoint step ranges share memory (planTransientHeap()).
+		The contents of a texture are undefined at its first step (the render graph transitions it from UNDEFINED).
+	*/
+	std::vector<VulkanTexture> addTransientColorTextures(const std::vector<TransientTextureDesc>& descs, bool alias = true, TransientHeapLayout* outLayout = nullptr);
+
 	VulkanTexture addDepthTexture(int texWidth = 0, int texHeight = 0, VkImageLayout layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
 
 	VulkanTexture addSolidRGBATexture(uint32_t color = 0xFFFFFFFF);
 
 	VulkanTexture addRGBATexture(int texWidth, int texHeight, void* data);
+	VulkanTexture addRGBATexture(int texWidth, int texHeight, const void* data, VulkanUploader& uploader);
 
 	VulkanBuffer addBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, bool createMapping = false);
 
+	/* Destroys a buffer created by addBuffer() before the destructor does. The GPU must not be using it */
+	void freeBuffer(const VulkanBuffer& buffer);
+
 	inline VulkanBuffer addUniformBuffer(VkDeviceSize bufferSize, bool createMapping = false) {
 		return addBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, createMapping);
@@ -189,6 +233,7 @@ struct VulkanResources
 
 	/* Allocate and upload vertex & index buffer pair */
 	VulkanBuffer addVertexBuffer(uint32_t indexBufferSize, const void* indexData, uint32_t vertexBufferSize, const void* vertexData);
+	VulkanBuffer addVertexBuffer(uint32_t indexBufferSize, const void* indexData, uint32_t vertexBufferSize, const void* vertexData, VulkanUploader& uploader);
 
 	VkFramebuffer addFramebuffer(RenderPass renderPass, const std::vector<VulkanTexture>& images);
 
@@ -239,6 +284,9 @@ private:
 	std::vector<VulkanTexture> allTextures;
 	std::vector<VulkanBuffer> allBuffers;
 
+	// memory blocks shared by aliased textures (the textures themselves have no own memory)
+	std::vector<VkDeviceMemory> allMemoryBlocks;
+
 	std::vector<VkFramebuffer> allFramebuffers;
 	std::vector<VkRenderPass> allRenderPasses;
 
@@ -262,7 +310,8 @@ private:
 		bool dynamicScissorState,
 		int32_t customWidth,
 		int32_t customHeight,
-		uint32_t numPatchControlPoints);
+		uint32_t numPatchControlPoints,
+		bool useColor = true);
 };
 
 /* A helper function for inplace allocation of VulkanBuffers. Helpful to avoid multiline buffer initialization in constructors */
@@ -0,0 +1,102 @@
+#include "shared/vkFramework/VulkanRingBuffer.h"
+
+#include <algorithm>
+
+VulkanRingBuffer::VulkanRingBuffer(VulkanRenderDevice& vkDev, VulkanResources& resources, VkDeviceSize size, uint32_t framesInFlight)
+: vkDev_(vkDev)
+, buffer_(resources.addBuffer(size,
+	VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+	VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, true))
+, allocator_(size, framesInFlight)
+{
+	VkPhysicalDeviceProperties devProps;
+	vkGetPhysicalDeviceProperties(vkDev.physicalDevice, &devProps);
+
+	uniformAlignment_ = std::max<VkDeviceSize>(devProps.limits.minUniformBufferOffsetAlignment, 16);
+	storageAlignment_ = std::max<VkDeviceSize>(devProps.limits.minStorageBufferOffsetAlignment, 16);
+	nonCoherentAtomSize_ = std::max<VkDeviceSize>(devProps.limits.nonCoherentAtomSize, 1);
+
+	// find out which memory type was picked by createSharedBuffer() to see if we need explicit flushes
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(vkDev.device, buffer_.buffer, &memRequirements);
+
+	const uint32_t memType = findMemoryType(vkDev.physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+
+	VkPhysicalDeviceMemoryProperties memProperties;
+	vkGetPhysicalDeviceMemoryProperties(vkDev.physicalDevice, &memProperties);
+
+	isCoherent_ = (memProperties.memoryTypes[memType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+}
+
+void VulkanRingBuffer::beginFrame()
+{
+	allocator_.beginFrame();
+	dirtyRanges_.clear();
+	bytesThisFrame_ = 0;
+}
+
+RingAllocation VulkanRingBuffer::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+	const uint64_t offset = allocator_.allocate(size, alignment);
+
+	// no message here: the caller decides if it is fatal (see Renderer::uploadDynamicUniform())
+	if (offset == RingAllocator::InvalidOffset)
+	{
+		numFailedAllocations_++;
+		return RingAllocation {};
+	}
+
+	bytesThisFrame_ += size;
+
+	if (!isCoherent_)
+	{
+		// allocations are linear, so usually everything ends up in one or two (wrapped) ranges
+		if (!dirtyRanges_.empty() && dirtyRanges_.back().offset + dirtyRanges_.back().size == offset)
+			dirtyRanges_.back().size += size;
+		else
+			dirtyRanges_.push_back(VkMappedMemoryRange {
+				.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+				.pNext = nullptr,
+				.memory = buffer_.memory,
+				.offset = offset,
+				.size = size
+			});
+	}
+
+	return RingAllocation {
+		.buffer = buffer_.buffer,
+		.offset = offset,
+		.size = size,
+		.ptr = (uint8_t*)buffer_.ptr + offset
+	};
+}
+
+RingAllocation VulkanRingBuffer::upload(const void* data, VkDeviceSize size, VkDeviceSize alignment)
+{
+	RingAllocation a = allocate(size, alignment);
+
+	if (a.isValid())
+		memcpy(a.ptr, data, size);
+
+	return a;
+}
+
+void VulkanRingBuffer::flush()
+{
+	if (isCoherent_ || dirtyRanges_.empty())
+		return;
+
+	// flushed ranges have to be aligned to nonCoherentAtomSize
+	for (auto& r: dirtyRanges_)
+	{
+		const VkDeviceSize begin = (r.offset / nonCoherentAtomSize_) * nonCoherentAtomSize_;
+		const VkDeviceSize end = RingAllocator::alignUp(r.offset + r.size, nonCoherentAtomSize_);
+
+		r.offset = begin;
+		r.size = (end >= buffer_.size) ? VK_WHOLE_SIZE : (end - begin);
+	}
+
+	VK_CHECK(vkFlushMappedMemoryRanges(vkDev_.device, (uint32_t)dirtyRanges_.size(), dirtyRanges_.data()));
+
+	dirtyRanges_.clear();
+}
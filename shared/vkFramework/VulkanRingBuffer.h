@@ -0,0 +1,79 @@
+#pragma once
+
+#include "shared/RingAllocator.h"
+#include "shared/vkFramework/VulkanResources.h"
+
+/// A piece of the ring buffer valid for the current frame
+struct RingAllocation
+{
+	VkBuffer     buffer = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size   = 0;
+
+	/* CPU address of this allocation inside the persistently mapped buffer */
+	void*        ptr    = nullptr;
+
+	inline bool isValid() const { return ptr != nullptr; }
+};
+
+/**
+	One persistently mapped host-visible buffer used for all per-frame dynamic data
+	(uniforms, indirect commands, per-instance data)
+
+	Renderers grab sub-allocations in their updateBuffers() and bind them using dynamic descriptor offsets
+	or buffer offsets in vkCmdDraw*Indirect(). No vkMapMemory()/vkUnmapMemory() calls are made after construction.
+	Only the ranges written in the current frame are flushed (and only if the memory is not host-coherent).
+*/
+struct VulkanRingBuffer
+{
+	VulkanRingBuffer(VulkanRenderDevice& vkDev, VulkanResources& resources, VkDeviceSize size, uint32_t framesInFlight);
+
+	/* Release the allocations of the oldest frame in flight */
+	void beginFrame();
+
+	/* Returns an invalid allocation if the ring is full */
+	RingAllocation allocate(VkDeviceSize size, VkDeviceSize alignment);
+
+	inline RingAllocation allocateUniform(VkDeviceSize size) { return allocate(size, uniformAlignment_); }
+	inline RingAllocation allocateStorage(VkDeviceSize size) { return allocate(size, storageAlignment_); }
+
+	/* Allocate and copy data in one go */
+	RingAllocation upload(const void* data, VkDeviceSize size, VkDeviceSize alignment);
+
+	inline RingAllocation uploadUniform(const void* data, VkDeviceSize size) { return upload(data, size, uniformAlignment_); }
+	inline RingAllocation uploadStorage(const void* data, VkDeviceSize size) { return upload(data, size, storageAlignment_); }
+
+	/* Flush all ranges written since beginFrame() */
+	void flush();
+
+	inline const VulkanBuffer& getBuffer() const { return buffer_; }
+	inline bool isCoherent() const { return isCoherent_; }
+
+	inline VkDeviceSize getUniformAlignment() const { return uniformAlignment_; }
+	inline VkDeviceSize getStorageAlignment() const { return storageAlignment_; }
+
+	inline VkDeviceSize getBytesAllocatedThisFrame() const { return bytesThisFrame_; }
+	inline VkDeviceSize getUsedBytes() const { return allocator_.getUsedBytes(); }
+	inline uint32_t getNumFailedAllocations() const { return numFailedAllocations_; }
+
+private:
+	VulkanRenderDevice& vkDev_;
+
+	VulkanBuffer buffer_;
+	RingAllocator allocator_;
+
+	bool isCoherent_ = true;
+
+	VkDeviceSize uniformAlignment_ = 256;
+	VkDeviceSize storageAlignment_ = 256;
+	VkDeviceSize nonCoherentAtomSize_ = 256;
+
+	VkDeviceSize bytesThisFrame_ = 0;
+	uint32_t numFailedAllocations_ = 0;
+
+	/* [offset, offset+size) ranges written in the current frame, merged on the fly */
+	std::vector<VkMappedMemoryRange> dirtyRanges_;
+};
+
+/* Default size of the VulkanRenderContext's frame ring (shared by all frames in flight) */
+constexpr VkDeviceSize DefaultFrameRingSize = 8 * 1024 * 1024;
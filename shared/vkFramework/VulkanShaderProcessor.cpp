@@ -27,3 +27,40 @@ void VulkanShaderProcessor::fillCommandBuffer(VkCommandBuffer cmdBuffer, size_t
 	vkCmdDraw(cmdBuffer, static_cast<uint32_t>((indexBufferSize) / sizeof(uint32_t)), 1, 0, 0);
 	vkCmdEndRenderPass(cmdBuffer);
 }
+
+ComputeProcessor::ComputeProcessor(VulkanRenderContext& ctx, const DescriptorSetInfo& dsInfo, const char* shaderFile,
+	uint32_t numGroupsX, uint32_t numGroupsY, uint32_t numGroupsZ, bool waitForColorAttachments)
+	: Renderer(ctx)
+	, numGroupsX_(numGroupsX)
+	, numGroupsY_(numGroupsY)
+	, numGroupsZ_(numGroupsZ)
+	, waitForColorAttachments_(waitForColorAttachments)
+{
+	descriptorSetLayout_ = ctx.resources.addDescriptorSetLayout(dsInfo);
+
+	descriptorSets_.resize(1);
+	descriptorSets_[0] = ctx.resources.addDescriptorSet(ctx.resources.addDescriptorPool(dsInfo), descriptorSetLayout_);
+	ctx.resources.updateDescriptorSet(descriptorSets_[0], dsInfo);
+
+	pipelineLayout_ = ctx.resources.addPipelineLayout(descriptorSetLayout_);
+	computePipeline_ = ctx.resources.addComputePipeline(shaderFile, pipelineLayout_);
+}
+
+void ComputeProcessor::fillCommandBuffer(VkCommandBuffer cmdBuffer, size_t currentImage, VkFramebuffer fb, VkRenderPass rp)
+{
+	if (waitForColorAttachments_)
+	{
+		const VkMemoryBarrier barrier = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+			.pNext = nullptr,
+			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT
+		};
+
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline_);
+	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout_, 0, 1, &descriptorSets_[0], 0, nullptr);
+	vkCmdDispatch(cmdBuffer, numGroupsX_, numGroupsY_, numGroupsZ_);
+}
@@ -43,6 +43,27 @@ struct BufferProcessor: public VulkanShaderProcessor
 	{}
 };
 
+/*
+   @brief Compute shader dispatch with a single descriptor set (no render pass)
+
+   'waitForColorAttachments' adds a barrier for inputs rendered outside of a render graph: their barriers cover only the fragment stage
+*/
+struct ComputeProcessor: public Renderer
+{
+	ComputeProcessor(VulkanRenderContext& ctx, const DescriptorSetInfo& dsInfo, const char* shaderFile,
+		uint32_t numGroupsX, uint32_t numGroupsY = 1, uint32_t numGroupsZ = 1, bool waitForColorAttachments = false);
+
+	void fillCommandBuffer(VkCommandBuffer cmdBuffer, size_t currentImage, VkFramebuffer fb = VK_NULL_HANDLE, VkRenderPass rp = VK_NULL_HANDLE) override;
+
+private:
+	VkPipeline computePipeline_ = VK_NULL_HANDLE;
+
+	const uint32_t numGroupsX_;
+	const uint32_t numGroupsY_;
+	const uint32_t numGroupsZ_;
+	const bool waitForColorAttachments_;
+};
+
 /* Commonly used BufferProcessor for single mesh rendering */
 struct OffscreenMeshRenderer: public BufferProcessor
 {
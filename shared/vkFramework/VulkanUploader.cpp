@@ -0,0 +1,497 @@
+#include "shared/vkFramework/VulkanUploader.h"
+
+#include <algorithm>
+#include <cstring>
+
+static VkCommandPool createUploadCommandPool(VkDevice device, uint32_t family)
+{
+	const VkCommandPoolCreateInfo ci = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+		.queueFamilyIndex = family
+	};
+
+	VkCommandPool pool = VK_NULL_HANDLE;
+	VK_CHECK(vkCreateCommandPool(device, &ci, nullptr, &pool));
+	return pool;
+}
+
+static VkCommandBuffer allocateUploadCommandBuffer(VkDevice device, VkCommandPool pool)
+{
+	const VkCommandBufferAllocateInfo ai = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.pNext = nullptr,
+		.commandPool = pool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = 1
+	};
+
+	VkCommandBuffer cmd = VK_NULL_HANDLE;
+	VK_CHECK(vkAllocateCommandBuffers(device, &ai, &cmd));
+	return cmd;
+}
+
+static void beginUploadCommandBuffer(VkCommandBuffer cmd)
+{
+	const VkCommandBufferBeginInfo bi = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = nullptr,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+		.pInheritanceInfo = nullptr
+	};
+
+	VK_CHECK(vkBeginCommandBuffer(cmd, &bi));
+}
+
+/* Everything the renderers may do with uploaded data */
+static constexpr VkAccessFlags UploadedBufferAccess =
+	VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+	VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
+VulkanUploader::VulkanUploader(VulkanRenderDevice& vkDev, VkDeviceSize stagingSize, uint32_t maxBatchesInFlight)
+: vkDev_(vkDev)
+, dedicatedQueue_(vkDev.transferQueue != nullptr && vkDev.transferFamily != vkDev.graphicsFamily)
+, transferQueue_(dedicatedQueue_ ? vkDev.transferQueue : vkDev.graphicsQueue)
+, ring_(stagingSize, std::max(maxBatchesInFlight, 1u))
+, maxBatchesInFlight_(std::max(maxBatchesInFlight, 1u))
+{
+	transferPool_ = createUploadCommandPool(vkDev.device, dedicatedQueue_ ? vkDev.transferFamily : vkDev.graphicsFamily);
+
+	if (dedicatedQueue_)
+		graphicsPool_ = createUploadCommandPool(vkDev.device, vkDev.graphicsFamily);
+
+	if (!createBuffer(vkDev.device, vkDev.physicalDevice, stagingSize,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		stagingBuffer_, stagingMemory_))
+	{
+		printf("VulkanUploader: cannot allocate staging buffer\n");
+		exit(EXIT_FAILURE);
+	}
+
+	VK_CHECK(vkMapMemory(vkDev.device, stagingMemory_, 0, VK_WHOLE_SIZE, 0, (void**)&stagingPtr_));
+}
+
+VulkanUploader::~VulkanUploader()
+{
+	waitIdle();
+
+	auto destroyBatch = [this](Batch& b)
+	{
+		for (size_t i = 0 ; i != b.tempBuffers.size() ; i++)
+		{
+			vkDestroyBuffer(vkDev_.device, b.tempBuffers[i], nullptr);
+			vkFreeMemory(vkDev_.device, b.tempMemory[i], nullptr);
+		}
+		if (b.fence != VK_NULL_HANDLE)
+			vkDestroyFence(vkDev_.device, b.fence, nullptr);
+		if (b.semaphore != VK_NULL_HANDLE)
+			vkDestroySemaphore(vkDev_.device, b.semaphore, nullptr);
+	};
+
+	// an empty batch may still be open
+	if (isRecording_)
+		destroyBatch(current_);
+
+	for (auto& b: freeBatches_)
+		destroyBatch(b);
+
+	// command buffers are freed together with their pools
+	vkDestroyCommandPool(vkDev_.device, transferPool_, nullptr);
+	if (graphicsPool_ != VK_NULL_HANDLE)
+		vkDestroyCommandPool(vkDev_.device, graphicsPool_, nullptr);
+
+	vkUnmapMemory(vkDev_.device, stagingMemory_);
+	vkDestroyBuffer(vkDev_.device, stagingBuffer_, nullptr);
+	vkFreeMemory(vkDev_.device, stagingMemory_, nullptr);
+}
+
+void VulkanUploader::beginBatch()
+{
+	if (isRecording_)
+		return;
+
+	retireCompleted(false);
+
+	// the ring releases the staging memory of the oldest batch in beginFrame(), so that batch has to be finished
+	while (submitted_.size() >= maxBatchesInFlight_)
+	{
+		VK_CHECK(vkWaitForFences(vkDev_.device, 1, &submitted_.front().fence, VK_TRUE, UINT64_MAX));
+		retireCompleted(false);
+	}
+
+	ring_.beginFrame();
+
+	if (!freeBatches_.empty())
+	{
+		current_ = std::move(freeBatches_.back());
+		freeBatches_.pop_back();
+	}
+	else
+	{
+		current_ = Batch {};
+		current_.transferCmd = allocateUploadCommandBuffer(vkDev_.device, transferPool_);
+
+		if (dedicatedQueue_)
+		{
+			current_.acquireCmd = allocateUploadCommandBuffer(vkDev_.device, graphicsPool_);
+			VK_CHECK(createSemaphore(vkDev_.device, &current_.semaphore));
+		}
+
+		const VkFenceCreateInfo fci = {
+			.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+			.pNext = nullptr,
+			.flags = 0
+		};
+		VK_CHECK(vkCreateFence(vkDev_.device, &fci, nullptr, &current_.fence));
+	}
+
+	current_.id = nextBatchId_;
+
+	beginUploadCommandBuffer(current_.transferCmd);
+
+	isRecording_ = true;
+}
+
+void VulkanUploader::allocateStaging(VkDeviceSize size, VkDeviceSize alignment, VkBuffer* buffer, VkDeviceSize* offset, void** ptr)
+{
+	beginBatch();
+
+	uint64_t off = ring_.allocate(size, alignment);
+
+	// the ring is full: flush what we have and try again in a new batch
+	if (off == RingAllocator::InvalidOffset && current_.numCopies > 0)
+	{
+		submit();
+		beginBatch();
+		off = ring_.allocate(size, alignment);
+	}
+
+	if (off != RingAllocator::InvalidOffset)
+	{
+		*buffer = stagingBuffer_;
+		*offset = off;
+		*ptr = stagingPtr_ + off;
+		return;
+	}
+
+	// larger than the whole ring: use a dedicated staging buffer released together with the batch
+	VkBuffer tempBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory tempMemory = VK_NULL_HANDLE;
+
+	if (!createBuffer(vkDev_.device, vkDev_.physicalDevice, size,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		tempBuffer, tempMemory))
+	{
+		printf("VulkanUploader: cannot allocate %u bytes of staging memory\n", (uint32_t)size);
+		exit(EXIT_FAILURE);
+	}
+
+	VK_CHECK(vkMapMemory(vkDev_.device, tempMemory, 0, VK_WHOLE_SIZE, 0, ptr));
+
+	current_.tempBuffers.push_back(tempBuffer);
+	current_.tempMemory.push_back(tempMemory);
+
+	*buffer = tempBuffer;
+	*offset = 0;
+}
+
+void VulkanUploader::uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+	if (size == 0)
+		return;
+
+	VkBuffer src;
+	VkDeviceSize srcOffset;
+	void* ptr;
+	allocateStaging(size, 16, &src, &srcOffset, &ptr);
+
+	memcpy(ptr, data, size);
+
+	const VkBufferCopy copyRegion = {
+		.srcOffset = srcOffset,
+		.dstOffset = dstOffset,
+		.size = size
+	};
+
+	vkCmdCopyBuffer(current_.transferCmd, src, dst, 1, &copyRegion);
+
+	current_.bufferBarriers.push_back(VkBufferMemoryBarrier {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = UploadedBufferAccess,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = dst,
+		.offset = dstOffset,
+		.size = size
+	});
+
+	current_.numCopies++;
+}
+
+void VulkanUploader::uploadImage(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t bytesPerPixel, const void* data, uint32_t layerCount, uint32_t mipLevels)
+{
+	VkDeviceSize dataSize = 0;
+	for (uint32_t i = 0, w = width, h = height ; i != mipLevels ; i++, w = std::max(w >> 1, 1u), h = std::max(h >> 1, 1u))
+		dataSize += (VkDeviceSize)w * h * layerCount * bytesPerPixel;
+
+	if (dataSize == 0)
+		return;
+
+	// bufferOffset has to be a multiple of both 4 and the texel size
+	VkBuffer src;
+	VkDeviceSize srcOffset;
+	void* ptr;
+	allocateStaging(dataSize, std::max(bytesPerPixel, 1u) * 4, &src, &srcOffset, &ptr);
+
+	memcpy(ptr, data, dataSize);
+
+	const VkImageSubresourceRange range = {
+		.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+		.baseMipLevel = 0,
+		.levelCount = mipLevels,
+		.baseArrayLayer = 0,
+		.layerCount = layerCount
+	};
+
+	const VkImageMemoryBarrier toTransfer = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = 0,
+		.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image,
+		.subresourceRange = range
+	};
+
+	vkCmdPipelineBarrier(current_.transferCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+	std::vector<VkBufferImageCopy> regions(mipLevels);
+
+	VkDeviceSize offset = srcOffset;
+	for (uint32_t i = 0, w = width, h = height ; i != mipLevels ; i++, w = std::max(w >> 1, 1u), h = std::max(h >> 1, 1u))
+	{
+		regions[i] = VkBufferImageCopy {
+			.bufferOffset = offset,
+			.bufferRowLength = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource = VkImageSubresourceLayers {
+				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+				.mipLevel = i,
+				.baseArrayLayer = 0,
+				.layerCount = layerCount
+			},
+			.imageOffset = VkOffset3D { .x = 0, .y = 0, .z = 0 },
+			.imageExtent = VkExtent3D { .width = w, .height = h, .depth = 1 }
+		};
+
+		offset += (VkDeviceSize)w * h * layerCount * bytesPerPixel;
+	}
+
+	vkCmdCopyBufferToImage(current_.transferCmd, src, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, (uint32_t)regions.size(), regions.data());
+
+	current_.imageBarriers.push_back(VkImageMemoryBarrier {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+		.pNext = nullptr,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+		.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image,
+		.subresourceRange = range
+	});
+
+	current_.numCopies++;
+}
+
+uint64_t VulkanUploader::submit()
+{
+	if (!isRecording_ || current_.numCopies == 0)
+		return 0;
+
+	Batch& b = current_;
+
+	if (dedicatedQueue_)
+	{
+		// queue family ownership transfer: release on the transfer queue...
+		std::vector<VkBufferMemoryBarrier> bufferRelease = b.bufferBarriers;
+		std::vector<VkImageMemoryBarrier>  imageRelease  = b.imageBarriers;
+
+		for (auto& r: bufferRelease)
+		{
+			r.dstAccessMask = 0;
+			r.srcQueueFamilyIndex = vkDev_.transferFamily;
+			r.dstQueueFamilyIndex = vkDev_.graphicsFamily;
+		}
+		for (auto& r: imageRelease)
+		{
+			r.dstAccessMask = 0;
+			r.srcQueueFamilyIndex = vkDev_.transferFamily;
+			r.dstQueueFamilyIndex = vkDev_.graphicsFamily;
+		}
+
+		vkCmdPipelineBarrier(b.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr, (uint32_t)bufferRelease.size(), bufferRelease.data(), (uint32_t)imageRelease.size(), imageRelease.data());
+
+		VK_CHECK(vkEndCommandBuffer(b.transferCmd));
+
+		const VkSubmitInfo transferSI = {
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.pNext = nullptr,
+			.waitSemaphoreCount = 0,
+			.pWaitSemaphores = nullptr,
+			.pWaitDstStageMask = nullptr,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &b.transferCmd,
+			.signalSemaphoreCount = 1,
+			.pSignalSemaphores = &b.semaphore
+		};
+
+		VK_CHECK(vkQueueSubmit(transferQueue_, 1, &transferSI, VK_NULL_HANDLE));
+
+		// ...and acquire on the graphics queue
+		for (auto& a: b.bufferBarriers)
+		{
+			a.srcAccessMask = 0;
+			a.srcQueueFamilyIndex = vkDev_.transferFamily;
+			a.dstQueueFamilyIndex = vkDev_.graphicsFamily;
+		}
+		for (auto& a: b.imageBarriers)
+		{
+			a.srcAccessMask = 0;
+			a.srcQueueFamilyIndex = vkDev_.transferFamily;
+			a.dstQueueFamilyIndex = vkDev_.graphicsFamily;
+		}
+
+		beginUploadCommandBuffer(b.acquireCmd);
+		vkCmdPipelineBarrier(b.acquireCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+			0, nullptr, (uint32_t)b.bufferBarriers.size(), b.bufferBarriers.data(), (uint32_t)b.imageBarriers.size(), b.imageBarriers.data());
+		VK_CHECK(vkEndCommandBuffer(b.acquireCmd));
+
+		const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+		const VkSubmitInfo acquireSI = {
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.pNext = nullptr,
+			.waitSemaphoreCount = 1,
+			.pWaitSemaphores = &b.semaphore,
+			.pWaitDstStageMask = &waitStage,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &b.acquireCmd,
+			.signalSemaphoreCount = 0,
+			.pSignalSemaphores = nullptr
+		};
+
+		VK_CHECK(vkQueueSubmit(vkDev_.graphicsQueue, 1, &acquireSI, b.fence));
+	}
+	else
+	{
+		// one merged barrier for all uploads of this batch
+		vkCmdPipelineBarrier(b.transferCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+			0, nullptr, (uint32_t)b.bufferBarriers.size(), b.bufferBarriers.data(), (uint32_t)b.imageBarriers.size(), b.imageBarriers.data());
+
+		VK_CHECK(vkEndCommandBuffer(b.transferCmd));
+
+		const VkSubmitInfo si = {
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+			.pNext = nullptr,
+			.waitSemaphoreCount = 0,
+			.pWaitSemaphores = nullptr,
+			.pWaitDstStageMask = nullptr,
+			.commandBufferCount = 1,
+			.pCommandBuffers = &b.transferCmd,
+			.signalSemaphoreCount = 0,
+			.pSignalSemaphores = nullptr
+		};
+
+		VK_CHECK(vkQueueSubmit(transferQueue_, 1, &si, b.fence));
+	}
+
+	const uint64_t id = nextBatchId_++;
+
+	submitted_.push_back(std::move(current_));
+	current_ = Batch {};
+	isRecording_ = false;
+
+	return id;
+}
+
+void VulkanUploader::retireCompleted(bool wait)
+{
+	while (!submitted_.empty())
+	{
+		Batch& b = submitted_.front();
+
+		if (wait)
+		{
+			VK_CHECK(vkWaitForFences(vkDev_.device, 1, &b.fence, VK_TRUE, UINT64_MAX));
+		}
+		else if (vkGetFenceStatus(vkDev_.device, b.fence) != VK_SUCCESS)
+			break;
+
+		recycle(b);
+		submitted_.pop_front();
+	}
+}
+
+void VulkanUploader::recycle(Batch& b)
+{
+	lastCompletedId_ = std::max(lastCompletedId_, b.id);
+
+	for (size_t i = 0 ; i != b.tempBuffers.size() ; i++)
+	{
+		vkDestroyBuffer(vkDev_.device, b.tempBuffers[i], nullptr);
+		vkFreeMemory(vkDev_.device, b.tempMemory[i], nullptr);
+	}
+
+	b.tempBuffers.clear();
+	b.tempMemory.clear();
+	b.bufferBarriers.clear();
+	b.imageBarriers.clear();
+	b.numCopies = 0;
+
+	VK_CHECK(vkResetFences(vkDev_.device, 1, &b.fence));
+	VK_CHECK(vkResetCommandBuffer(b.transferCmd, 0));
+	if (b.acquireCmd != VK_NULL_HANDLE)
+		VK_CHECK(vkResetCommandBuffer(b.acquireCmd, 0));
+
+	freeBatches_.push_back(std::move(b));
+}
+
+bool VulkanUploader::isComplete(uint64_t batchId)
+{
+	if (batchId <= lastCompletedId_)
+		return true;
+
+	retireCompleted(false);
+
+	return batchId <= lastCompletedId_;
+}
+
+void VulkanUploader::wait(uint64_t batchId)
+{
+	// waiting for the batch which is still being recorded
+	if (batchId >= nextBatchId_ && hasPendingUploads())
+		submit();
+
+	while (!submitted_.empty() && submitted_.front().id <= batchId)
+	{
+		VK_CHECK(vkWaitForFences(vkDev_.device, 1, &submitted_.front().fence, VK_TRUE, UINT64_MAX));
+		retireCompleted(false);
+	}
+}
+
+void VulkanUploader::waitIdle()
+{
+	submit();
+	retireCompleted(true);
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "shared/RingAllocator.h"
+#include "shared/UtilsVulkan.h"
+
+#include <deque>
+#include <vector>
+
+/**
+	Batched staging uploader
+
+	Buffer and image uploads are recorded into one command buffer per batch instead of
+	a beginSingleTimeCommands()/vkQueueWaitIdle() round-trip per resource.
+	All staging data lives in one persistently mapped host-visible buffer which is sub-allocated with a RingAllocator
+	(one "frame" of the ring is one batch). A batch is retired only when its fence is signalled,
+	so the CPU never stalls unless all 'maxBatchesInFlight' batches are still pending.
+
+	If the device exposes a dedicated transfer queue (see findDedicatedTransferFamily()), copies are executed there
+	and the ownership of every destination resource is released to the graphics queue family.
+	The matching acquire barriers are submitted to the graphics queue waiting on a semaphore,
+	so everything rendered after submit() on the graphics queue sees the uploaded data.
+*/
+struct VulkanUploader final
+{
+	explicit VulkanUploader(VulkanRenderDevice& vkDev, VkDeviceSize stagingSize = DefaultStagingSize, uint32_t maxBatchesInFlight = 4);
+	~VulkanUploader();
+
+	VulkanUploader(const VulkanUploader&) = delete;
+	VulkanUploader& operator = (const VulkanUploader&) = delete;
+
+	/*
+		Copy 'size' bytes into a device-local buffer created with VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+		Meant for initial uploads: with a dedicated transfer queue the buffer must not be in use by the graphics queue
+	*/
+	void uploadBuffer(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+	/*
+		Fill all mip levels (and array layers) of a freshly created image; the image ends up in SHADER_READ_ONLY_OPTIMAL.
+		Data layout is the same as in copyMIPBufferToImage(): mip 0 of all layers, then mip 1 etc.
+	*/
+	void uploadImage(VkImage image, VkFormat format, uint32_t width, uint32_t height, uint32_t bytesPerPixel, const void* data, uint32_t layerCount = 1, uint32_t mipLevels = 1);
+
+	/* Submit all pending uploads. Returns the batch id (0 if there was nothing to submit) */
+	uint64_t submit();
+
+	/* Non-blocking check */
+	bool isComplete(uint64_t batchId);
+
+	void wait(uint64_t batchId);
+	void waitIdle();
+
+	inline bool hasPendingUploads() const { return current_.numCopies > 0; }
+	inline bool usesDedicatedQueue() const { return dedicatedQueue_; }
+
+	/* Id which will be returned by the next submit() */
+	inline uint64_t getNextBatchId() const { return nextBatchId_; }
+
+	static constexpr VkDeviceSize DefaultStagingSize = 64 * 1024 * 1024;
+
+private:
+	struct Batch
+	{
+		uint64_t id = 0;
+
+		VkCommandBuffer transferCmd = VK_NULL_HANDLE;
+		VkCommandBuffer acquireCmd  = VK_NULL_HANDLE; // graphics queue, only with a dedicated transfer queue
+		VkFence         fence       = VK_NULL_HANDLE;
+		VkSemaphore     semaphore   = VK_NULL_HANDLE;
+
+		/* Uploads which did not fit into the staging ring */
+		std::vector<VkBuffer>       tempBuffers;
+		std::vector<VkDeviceMemory> tempMemory;
+
+		/* Post-copy barriers: release on the transfer queue, acquire on the graphics queue */
+		std::vector<VkBufferMemoryBarrier> bufferBarriers;
+		std::vector<VkImageMemoryBarrier>  imageBarriers;
+
+		uint32_t numCopies = 0;
+	};
+
+	VulkanRenderDevice& vkDev_;
+
+	bool dedicatedQueue_ = false;
+	VkQueue transferQueue_ = VK_NULL_HANDLE;
+
+	VkCommandPool transferPool_ = VK_NULL_HANDLE;
+	VkCommandPool graphicsPool_ = VK_NULL_HANDLE;
+
+	VkBuffer       stagingBuffer_ = VK_NULL_HANDLE;
+	VkDeviceMemory stagingMemory_ = VK_NULL_HANDLE;
+	uint8_t*       stagingPtr_    = nullptr;
+
+	RingAllocator ring_;
+	uint32_t maxBatchesInFlight_ = 4;
+
+	uint64_t nextBatchId_ = 1;
+	uint64_t lastCompletedId_ = 0;
+
+	Batch current_;
+	bool isRecording_ = false;
+
+	std::deque<Batch> submitted_;
+	std::vector<Batch> freeBatches_;
+
+	/* Start recording if needed (may block waiting for the oldest batch) */
+	void beginBatch();
+
+	/* Find a place for 'size' bytes of staging data: ring first, then a temporary buffer owned by the batch */
+	void allocateStaging(VkDeviceSize size, VkDeviceSize alignment, VkBuffer* buffer, VkDeviceSize* offset, void** ptr);
+
+	void retireCompleted(bool wait);
+	void recycle(Batch& b);
+};
@@ -1,7 +1,7 @@
 #pragma once
 #include "shared/vkFramework/effects/LuminanceCalculator.h"
 
-#include "shared/vkFramework/Barriers.h"
+#include <memory>
 
 struct HDRUniformBuffer
 {
@@ -11,37 +11,41 @@ struct HDRUniformBuffer
 	float adaptationSpeed;
 };
 
-/** Apply bloom to input buffer */
-struct HDRProcessor: public CompositeRenderer
-{
-	HDRProcessor(VulkanRenderContext& c, VulkanTexture input, VulkanTexture avgLuminance, BufferAttachment uniformBuffer): CompositeRenderer(c),
+/* The bloom mip chain stops at the first level narrower than this (or at MaxBloomLevels), so the halo has a similar size in uv at any resolution */
+const int BloomMinLevelWidth = 64;
+const int MaxBloomLevels = 8;
 
-		brightnessTex(c.resources.addColorTexture(0, 0, LuminosityFormat, VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)),
+/**
+	Apply bloom to input buffer
 
-		adaptedLuminanceTex1(c.resources.addColorTexture(1, 1, LuminosityFormat, VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)),
-		adaptedLuminanceTex2(c.resources.addColorTexture(1, 1, LuminosityFormat, VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)),
-
-		bloomX1Tex(c.resources.addColorTexture(0, 0, LuminosityFormat, VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)),
-		bloomY1Tex(c.resources.addColorTexture(0, 0, LuminosityFormat, VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)),
-		bloomX2Tex(c.resources.addColorTexture(0, 0, LuminosityFormat, VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)),
-		bloomY2Tex(c.resources.addColorTexture(0, 0, LuminosityFormat, VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)),
+	The bright pass writes a half-resolution texture which is progressively downsampled (4 bilinear taps, see VK03_BloomDownsample.frag)
+	and then upsampled back with a 3x3 tent filter, blending every level with the accumulated coarser ones (see VK03_BloomUpsample.frag).
+	Every level has a quarter of the pixels of the previous one and the streaks are applied to the half-resolution result,
+	so all bloom passes write as many pixels as ~1.2 full-resolution passes (instead of 7 full-resolution blur and streak passes).
+*/
+struct HDRProcessor: public VulkanRenderGraph
+{
+	/* With 'aliasIntermediates' the bloom and streaks targets share memory, so only the last one of each memory slot is valid after the graph */
+	HDRProcessor(VulkanRenderContext& c, VulkanTexture input, VulkanTexture avgLuminance, BufferAttachment uniformBuffer, bool aliasIntermediates = true): VulkanRenderGraph(c),
 
-		streaks1Tex(c.resources.addColorTexture(0, 0, LuminosityFormat, VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)),
-		streaks2Tex(c.resources.addColorTexture(0, 0, LuminosityFormat, VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)),
+		ids_(declareGraph(aliasIntermediates)),
 
 		// Output is an 8-bit RGB framebuffer
 		streaksPatternTex(c.resources.loadTexture2D("data/StreaksRotationPattern.bmp")),
 
+		brightnessTex(getTexture(ids_.bright)),
+
+		adaptedLuminanceTex1(c.resources.addColorTexture(1, 1, LuminosityFormat, VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)),
+		adaptedLuminanceTex2(c.resources.addColorTexture(1, 1, LuminosityFormat, VK_FILTER_LINEAR, VK_FILTER_LINEAR, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE)),
+
+		streaks1Tex(getTexture(ids_.streaks1)),
+		streaks2Tex(getTexture(ids_.streaks2)),
+
 		resultTex(c.resources.addColorTexture()),
 
 		brightness(c, DescriptorSetInfo { .textures = { fsTextureAttachment(input) } }, { brightnessTex }, "data/shaders/chapter08/VK03_BrightPass.frag"),
 
-		bloomX1(c, DescriptorSetInfo { .textures = { fsTextureAttachment(brightnessTex) } }, { bloomX1Tex }, "data/shaders/chapter08/VK03_BloomX.frag"),
-		bloomY1(c, DescriptorSetInfo { .textures = { fsTextureAttachment(   bloomX1Tex) } }, { bloomY1Tex }, "data/shaders/chapter08/VK03_BloomY.frag"),
-		bloomX2(c, DescriptorSetInfo { .textures = { fsTextureAttachment(   bloomY1Tex) } }, { bloomX2Tex }, "data/shaders/chapter08/VK03_BloomX.frag"),
-		bloomY2(c, DescriptorSetInfo { .textures = { fsTextureAttachment(   bloomX2Tex) } }, { bloomY2Tex }, "data/shaders/chapter08/VK03_BloomY.frag"),
-
-		streaks1(c, DescriptorSetInfo { .textures = { fsTextureAttachment(  bloomY2Tex), fsTextureAttachment(streaksPatternTex) } }, { streaks1Tex }, "data/shaders/chapter08/VK03_Streaks.frag"),
+		streaks1(c, DescriptorSetInfo { .textures = { fsTextureAttachment(getTexture(ids_.bloomUp[0])), fsTextureAttachment(streaksPatternTex) } }, { streaks1Tex }, "data/shaders/chapter08/VK03_Streaks.frag"),
 		streaks2(c, DescriptorSetInfo { .textures = { fsTextureAttachment( streaks1Tex), fsTextureAttachment(streaksPatternTex) } }, { streaks2Tex }, "data/shaders/chapter08/VK03_Streaks.frag"),
 
 		adaptationEven(c, DescriptorSetInfo { .buffers = { uniformBuffer }, .textures = { fsTextureAttachment(avgLuminance), fsTextureAttachment(adaptedLuminanceTex1) } },
@@ -49,84 +53,41 @@ struct HDRProcessor: public CompositeRenderer
 		adaptationOdd(c, DescriptorSetInfo { .buffers = { uniformBuffer }, .textures = { fsTextureAttachment(avgLuminance), fsTextureAttachment(adaptedLuminanceTex2) } },
 			{ adaptedLuminanceTex1 }, "data/shaders/chapter08/VK03_LightAdaptation.frag"),
 
-		adaptation1ToColor(c, adaptedLuminanceTex1),
-		adaptation1ToShader(c, adaptedLuminanceTex1),
-
-		adaptation2ToColor(c, adaptedLuminanceTex2),
-		adaptation2ToShader(c, adaptedLuminanceTex2),
-
 		composerEven(c, DescriptorSetInfo { .buffers = { uniformBuffer }, .textures = { fsTextureAttachment(input), fsTextureAttachment(adaptedLuminanceTex2), fsTextureAttachment(streaks2Tex) } },
 			{ resultTex }, "data/shaders/chapter08/VK03_HDR.frag"),
 		composerOdd (c, DescriptorSetInfo { .buffers = { uniformBuffer }, .textures = { fsTextureAttachment(input), fsTextureAttachment(adaptedLuminanceTex1), fsTextureAttachment(streaks2Tex) } },
-			{ resultTex }, "data/shaders/chapter08/VK03_HDR.frag"),
-
-		bloomX1ToColor(c, bloomX1Tex),
-		bloomX1ToShader(c, bloomX1Tex),
-		bloomX2ToColor(c, bloomX2Tex),
-		bloomX2ToShader(c, bloomX2Tex),
-
-		bloomY1ToColor(c, bloomY1Tex),
-		bloomY1ToShader(c, bloomY1Tex),
-		bloomY2ToColor(c, bloomY2Tex),
-		bloomY2ToShader(c, bloomY2Tex),
-
-		streaks1ToColor(c, streaks1Tex),
-		streaks1ToShader(c, streaks1Tex),
-		streaks2ToColor(c, streaks2Tex),
-		streaks2ToShader(c, streaks2Tex),
-
-		brightnessToColor(c, brightnessTex),
-		brightnessToShader(c, brightnessTex),
-
-		resultToColor(c, resultTex),
-		resultToShader(c, resultTex)
+			{ resultTex }, "data/shaders/chapter08/VK03_HDR.frag")
 	{
-		renderers_.emplace_back(brightnessToColor, false);
-		renderers_.emplace_back(brightness, false);
-		renderers_.emplace_back(brightnessToShader, false);
-
-		renderers_.emplace_back(bloomX1ToColor, false);
-		renderers_.emplace_back(bloomX1, false);
-		renderers_.emplace_back(bloomX1ToShader, false);
+		setTexture(ids_.input, input);
+		setTexture(ids_.avgLum, avgLuminance);
+		setTexture(ids_.pattern, streaksPatternTex);
+		setTexture(ids_.result, resultTex);
 
-		renderers_.emplace_back(bloomY1ToColor, false);
-		renderers_.emplace_back(bloomY1, false);
-		renderers_.emplace_back(bloomY1ToShader, false);
+		setPassRenderer(ids_.brightPass, brightness);
 
-		renderers_.emplace_back(bloomX2ToColor, false);
-		renderers_.emplace_back(bloomX2, false);
-		renderers_.emplace_back(bloomX2ToShader, false);
+		// level 0 is the output of the bright pass, the coarsest level is not upsampled
+		const size_t numLevels = ids_.bloomDown.size();
 
-		renderers_.emplace_back(bloomY2ToColor, false);
-		renderers_.emplace_back(bloomY2, false);
-		renderers_.emplace_back(bloomY2ToShader, false);
+		for (size_t i = 1 ; i != numLevels ; i++)
+		{
+			bloomDown.push_back(std::make_unique<QuadProcessor>(c, DescriptorSetInfo { .textures = { fsTextureAttachment(getTexture(ids_.bloomDown[i - 1])) } },
+				std::vector<VulkanTexture> { getTexture(ids_.bloomDown[i]) }, "data/shaders/chapter08/VK03_BloomDownsample.frag"));
+			setPassRenderer(ids_.bloomDownPass[i - 1], *bloomDown.back());
+		}
 
-		renderers_.emplace_back(streaks1ToColor, false);
-		renderers_.emplace_back(streaks1, false);
-		renderers_.emplace_back(streaks1ToShader, false);
+		for (size_t i = numLevels - 1 ; i-- > 0 ; )
+		{
+			const uint32_t coarser = (i + 1 == numLevels - 1) ? ids_.bloomDown[i + 1] : ids_.bloomUp[i + 1];
+			bloomUp.push_back(std::make_unique<QuadProcessor>(c,
+				DescriptorSetInfo { .textures = { fsTextureAttachment(getTexture(coarser)), fsTextureAttachment(getTexture(ids_.bloomDown[i])) } },
+				std::vector<VulkanTexture> { getTexture(ids_.bloomUp[i]) }, "data/shaders/chapter08/VK03_BloomUpsample.frag"));
+			setPassRenderer(ids_.bloomUpPass[i], *bloomUp.back());
+		}
 
-		renderers_.emplace_back(streaks2ToColor, false);
-		renderers_.emplace_back(streaks2, false);
-		renderers_.emplace_back(streaks2ToShader, false);
+		setPassRenderer(ids_.streaks1Pass, streaks1);
+		setPassRenderer(ids_.streaks2Pass, streaks2);
 
-		renderers_.emplace_back(adaptation2ToColor, false);  // 21
-		renderers_.emplace_back(adaptationEven, false);      // 22
-		renderers_.emplace_back(adaptation2ToShader, false); // 23
-
-		renderers_.emplace_back(adaptation1ToColor, false);  // 24
-		renderers_.emplace_back(adaptationOdd, false);       // 25
-		renderers_.emplace_back(adaptation1ToShader, false); // 26
-
-		renderers_[21].enabled_ = false; // disable adaptationProcessor at the beginning
-		renderers_[22].enabled_ = false;
-		renderers_[23].enabled_ = false;
-
-		renderers_.emplace_back(resultToColor, false); // 27
-		renderers_.emplace_back(composerEven, false);  // 28
-		renderers_.emplace_back(composerOdd, false);   // 29
-		renderers_[29].enabled_ = false; // disable composerOdd at the beginning
-
-		renderers_.emplace_back(resultToShader, false);
+		updateAdaptationPasses();
 
 		// Convert 32.0 to S5.10 fixed point format (half-float) manually for RGB channels, Set alpha to 1.0
 //		const uint16_t brightPixel[4] = { 0x5400, 0x5400, 0x5400, 0x3C00 }; // 64.0 as initial value
@@ -138,15 +99,18 @@ struct HDRProcessor: public CompositeRenderer
 	void fillCommandBuffer(VkCommandBuffer cmdBuffer, size_t currentImage, VkFramebuffer fb1 = VK_NULL_HANDLE, VkRenderPass rp1 = VK_NULL_HANDLE) override
 	{
 		// Call base method
-		CompositeRenderer::fillCommandBuffer(cmdBuffer, currentImage, fb1, rp1);
-		// Swap avgLuminance inputs for adaptation and composer
-		static const std::vector<int> switchIndices { 21, 22, 23, 24, 25, 26, 28, 29 };
-		for (auto i: switchIndices)
-			renderers_[i].enabled_ = !renderers_[i].enabled_;
+		VulkanRenderGraph::fillCommandBuffer(cmdBuffer, currentImage, fb1, rp1);
+		// Swap the adapted luminances for the next frame
+		oddFrame_ = !oddFrame_;
+		updateAdaptationPasses();
 	}
 
-	inline VulkanTexture getBloom1() const { return bloomY1Tex; }
-	inline VulkanTexture getBloom2() const { return bloomY2Tex; }
+	// transient targets: with aliasing the bloom textures are overwritten later in the chain, only the streaks keep their contents after the graph
+	// the coarsest downsampled level and the upsampled half-resolution bloom
+	inline VulkanTexture getBloom1() const { return getTexture(ids_.bloomDown.back()); }
+	inline VulkanTexture getBloom2() const { return getTexture(ids_.bloomUp[0]); }
+
+	inline uint32_t getNumBloomLevels() const { return (uint32_t)ids_.bloomDown.size(); }
 
 	inline VulkanTexture getBrightness() const { return brightnessTex; }
 
@@ -159,6 +123,24 @@ struct HDRProcessor: public CompositeRenderer
 	inline VulkanTexture getResult() const { return resultTex; }
 
 private:
+	struct GraphIds
+	{
+		// the adapted luminance of the previous frame and the one written in this frame (swapped every frame)
+		uint32_t input, avgLum, pattern, adaptedPrev, adaptedCur, result;
+		uint32_t bright, streaks1, streaks2;
+
+		// bloomDown[0] is 'bright', bloomUp[i] has the size of bloomDown[i] (the last level is not upsampled)
+		std::vector<uint32_t> bloomDown, bloomUp;
+
+		uint32_t brightPass, streaks1Pass, streaks2Pass;
+		// bloomDownPass[i] writes bloomDown[i + 1], bloomUpPass[i] writes bloomUp[i]
+		std::vector<uint32_t> bloomDownPass, bloomUpPass;
+		uint32_t adaptationPass, composerPass;
+	};
+
+	// declared first: the transient textures have to exist before all the QuadProcessors
+	GraphIds ids_;
+
 	// Static texture with rotation pattern
 	VulkanTexture streaksPatternTex;
 
@@ -168,14 +150,6 @@ private:
 	// The ping-pong texture pair for adapted luminances
 	VulkanTexture adaptedLuminanceTex1, adaptedLuminanceTex2;
 
-	// First pass of blurring
-	VulkanTexture bloomX1Tex;
-	VulkanTexture bloomY1Tex;
-
-	// Second pass of blurring
-	VulkanTexture bloomX2Tex;
-	VulkanTexture bloomY2Tex;
-
 	VulkanTexture streaks1Tex;
 	VulkanTexture streaks2Tex;
 
@@ -184,47 +158,113 @@ private:
 
 	QuadProcessor brightness;
 
-	QuadProcessor bloomX1;
-	QuadProcessor bloomY1;
-	QuadProcessor bloomX2;
-	QuadProcessor bloomY2;
+	// the mip chain depends on the framebuffer size
+	std::vector<std::unique_ptr<QuadProcessor>> bloomDown;
+	std::vector<std::unique_ptr<QuadProcessor>> bloomUp;
 
 	QuadProcessor streaks1;
 	QuadProcessor streaks2;
 
-	// Light Adaptation processing
+	// Light Adaptation processing (even frames write adaptedLuminanceTex2, odd frames adaptedLuminanceTex1)
 	QuadProcessor adaptationEven;
 	QuadProcessor adaptationOdd;
 
-	ShaderOptimalToColorBarrier adaptation1ToColor;
-	ColorToShaderOptimalBarrier adaptation1ToShader;
-
-	ShaderOptimalToColorBarrier adaptation2ToColor;
-	ColorToShaderOptimalBarrier adaptation2ToShader;
-
-	// Final composition
+	// Final composition with the luminance adapted in the same frame
 	QuadProcessor composerEven;
 	QuadProcessor composerOdd;
 
-	// barriers
-	ShaderOptimalToColorBarrier bloomX1ToColor;
-	ColorToShaderOptimalBarrier bloomX1ToShader;
-	ShaderOptimalToColorBarrier bloomX2ToColor;
-	ColorToShaderOptimalBarrier bloomX2ToShader;
-
-	ShaderOptimalToColorBarrier bloomY1ToColor;
-	ColorToShaderOptimalBarrier bloomY1ToShader;
-	ShaderOptimalToColorBarrier bloomY2ToColor;
-	ColorToShaderOptimalBarrier bloomY2ToShader;
+	bool oddFrame_ = true;
 
-	ShaderOptimalToColorBarrier streaks1ToColor;
-	ColorToShaderOptimalBarrier streaks1ToShader;
-	ShaderOptimalToColorBarrier streaks2ToColor;
-	ColorToShaderOptimalBarrier streaks2ToShader;
+	/* Only the textures and the renderers of the ping-pong passes change, the compiled graph stays the same */
+	void updateAdaptationPasses()
+	{
+		setTexture(ids_.adaptedPrev, oddFrame_ ? adaptedLuminanceTex2 : adaptedLuminanceTex1);
+		setTexture(ids_.adaptedCur,  oddFrame_ ? adaptedLuminanceTex1 : adaptedLuminanceTex2);
 
-	ShaderOptimalToColorBarrier brightnessToColor;
-	ColorToShaderOptimalBarrier brightnessToShader;
+		setPassRenderer(ids_.adaptationPass, oddFrame_ ? adaptationOdd : adaptationEven);
+		setPassRenderer(ids_.composerPass,   oddFrame_ ? composerOdd : composerEven);
+	}
 
-	ShaderOptimalToColorBarrier resultToColor;
-	ColorToShaderOptimalBarrier resultToShader;
+	/* Resources and passes without textures/renderers: enough to compute the lifetimes of the transient textures */
+	GraphIds declareGraph(bool aliasIntermediates)
+	{
+		GraphIds g;
+
+		// input and output are used outside, the adapted luminances and the pattern are carried over to the next frame
+		g.input    = addTexture("input", VulkanTexture {}, true);
+		g.avgLum   = addTexture("avgLuminance", VulkanTexture {}, true);
+		g.pattern  = addTexture("streaksPattern", VulkanTexture {}, true);
+		g.adaptedPrev = addTexture("adaptedLuminancePrev", VulkanTexture {}, true);
+		g.adaptedCur  = addTexture("adaptedLuminance", VulkanTexture {}, true);
+		g.result   = addTexture("result", VulkanTexture {}, true);
+
+		const int width = (int)ctx_.vkDev.framebufferWidth;
+
+		int numLevels = 2;
+		while (numLevels < MaxBloomLevels && (width >> (numLevels + 1)) >= BloomMinLevelWidth)
+			numLevels++;
+
+		// relative to the framebuffer, so the memory report scales to other resolutions
+		auto levelDesc = [](int level)
+		{
+			return TransientTextureDesc {
+				.divisor = 1 << (level + 1),
+				.format = LuminosityFormat };
+		};
+
+		char name[32];
+
+		for (int i = 0 ; i != numLevels ; i++)
+		{
+			snprintf(name, sizeof(name), "bloomDown%d", i);
+			g.bloomDown.push_back(i ? addTransientTexture(name, levelDesc(i)) : addTransientTexture("brightness", levelDesc(0)));
+		}
+
+		g.bloomUp.resize(numLevels - 1);
+		for (int i = numLevels - 2 ; i >= 0 ; i--)
+		{
+			snprintf(name, sizeof(name), "bloomUp%d", i);
+			g.bloomUp[i] = addTransientTexture(name, levelDesc(i));
+		}
+
+		g.bright   = g.bloomDown[0];
+		g.streaks1 = addTransientTexture("streaks1", levelDesc(0));
+		g.streaks2 = addTransientTexture("streaks2", levelDesc(0));
+
+		auto addFilter = [this](const char* name, std::initializer_list<uint32_t> inputs, uint32_t output)
+		{
+			const uint32_t pass = addPass(name);
+			for (auto i: inputs)
+				read(pass, i);
+			write(pass, output);
+			return pass;
+		};
+
+		g.brightPass = addFilter("BrightPass", { g.input }, g.bright);
+
+		for (int i = 1 ; i != numLevels ; i++)
+		{
+			snprintf(name, sizeof(name), "BloomDown%d", i);
+			g.bloomDownPass.push_back(addFilter(name, { g.bloomDown[i - 1] }, g.bloomDown[i]));
+		}
+
+		g.bloomUpPass.resize(numLevels - 1);
+		for (int i = numLevels - 2 ; i >= 0 ; i--)
+		{
+			snprintf(name, sizeof(name), "BloomUp%d", i);
+			const uint32_t coarser = (i == numLevels - 2) ? g.bloomDown[i + 1] : g.bloomUp[i + 1];
+			g.bloomUpPass[i] = addFilter(name, { coarser, g.bloomDown[i] }, g.bloomUp[i]);
+		}
+
+		g.streaks1Pass = addFilter("Streaks1", { g.bloomUp[0], g.pattern }, g.streaks1);
+		g.streaks2Pass = addFilter("Streaks2", { g.streaks1, g.pattern }, g.streaks2);
+
+		// ping-pong light adaptation: the two textures are swapped every frame (see updateAdaptationPasses())
+		g.adaptationPass = addFilter("Adaptation", { g.avgLum, g.adaptedPrev }, g.adaptedCur);
+		g.composerPass   = addFilter("Composer", { g.input, g.adaptedCur, g.streaks2 }, g.result);
+
+		allocateTransientTextures(aliasIntermediates);
+
+		return g;
+	}
 };
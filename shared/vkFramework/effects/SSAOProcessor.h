@@ -1,68 +1,70 @@
 #pragma once
-#include "shared/vkFramework/CompositeRenderer.h"
+#include "shared/vkFramework/VulkanRenderGraph.h"
 #include "shared/vkFramework/VulkanShaderProcessor.h"
 
-#include "shared/vkFramework/Barriers.h"
+#include <algorithm>
+#include <memory>
 
-const int SSAOWidth = 0; // smaller SSAO buffer can be used 512
-const int SSAOHeight = 0; // 512;
+/**
+	Size of the SSAO buffers relative to the framebuffer
 
-struct SSAOProcessor: public CompositeRenderer
+	At lower resolutions the depth buffer is downsampled with a checkerboard min/max filter (see VK02_SSAODownsampleDepth.frag),
+	the SSAO and the blur passes run at the lower resolution and VK02_SSAOFinal.frag upsamples the result with a depth-aware bilateral filter
+*/
+enum eSSAOResolution : uint32_t
 {
-	SSAOProcessor(VulkanRenderContext&ctx, VulkanTexture colorTex, VulkanTexture depthTex, VulkanTexture outputTex):
-		CompositeRenderer(ctx),
+	eSSAOResolution_Full = 1,
+	eSSAOResolution_Half = 2,
+	eSSAOResolution_Quarter = 4
+};
+
+struct SSAOProcessor: public VulkanRenderGraph
+{
+	SSAOProcessor(VulkanRenderContext&ctx, VulkanTexture colorTex, VulkanTexture depthTex, VulkanTexture outputTex,
+		eSSAOResolution resolution = eSSAOResolution_Half):
+		VulkanRenderGraph(ctx),
+
+		ids_(declareGraph(resolution)),
 
 		rotateTex(ctx.resources.loadTexture2D("data/rot_texture.bmp")),
-		SSAOTex(ctx.resources.addColorTexture(SSAOWidth, SSAOHeight)),
-		SSAOBlurXTex(ctx.resources.addColorTexture(SSAOWidth, SSAOHeight)),
-		SSAOBlurYTex(ctx.resources.addColorTexture(SSAOWidth, SSAOHeight)),
+		depthSSAOTex(resolution == eSSAOResolution_Full ? depthTex : getTexture(ids_.depthSSAO)),
+		SSAOTex(getTexture(ids_.ssao)),
+		SSAOBlurXTex(getTexture(ids_.blurX)),
+		SSAOBlurYTex(getTexture(ids_.blurY)),
 
 		SSAOParamBuffer(mappedUniformBufferAttachment(ctx.resources, &params, VK_SHADER_STAGE_FRAGMENT_BIT)),
 
-		SSAO(ctx,  { .buffers = { SSAOParamBuffer }, .textures = { fsTextureAttachment(depthTex), fsTextureAttachment(rotateTex) } },
+		SSAO(ctx,  { .buffers = { SSAOParamBuffer }, .textures = { fsTextureAttachment(depthSSAOTex), fsTextureAttachment(rotateTex) } },
 			{ SSAOTex }, "data/shaders/chapter08/VK02_SSAO.frag"),
 		BlurX(ctx, { .textures = { fsTextureAttachment(SSAOTex) } },
 			{ SSAOBlurXTex }, "data/shaders/chapter08/VK02_SSAOBlurX.frag"),
 		BlurY(ctx, { .textures = { fsTextureAttachment(SSAOBlurXTex) } },
 			{ SSAOBlurYTex }, "data/shaders/chapter08/VK02_SSAOBlurY.frag"),
-		SSAOFinal(ctx, { .buffers = { SSAOParamBuffer }, .textures = { fsTextureAttachment(colorTex), fsTextureAttachment(SSAOBlurYTex) } },
-			{ outputTex }, "data/shaders/chapter08/VK02_SSAOFinal.frag"),
-
-		ssaoColorToShader(ctx_, SSAOTex),
-		ssaoShaderToColor(ctx_, SSAOTex),
-
-		blurXColorToShader(ctx_, SSAOBlurXTex),
-		blurXShaderToColor(ctx_, SSAOBlurXTex),
-
-		blurYColorToShader(ctx_, SSAOBlurYTex),
-		blurYShaderToColor(ctx_, SSAOBlurYTex),
-
-		finalColorToShader(ctx_, outputTex),
-		finalShaderToColor(ctx_, outputTex)
+		SSAOFinal(ctx, { .buffers = { SSAOParamBuffer }, .textures = { fsTextureAttachment(colorTex), fsTextureAttachment(SSAOBlurYTex),
+			fsTextureAttachment(depthTex), fsTextureAttachment(depthSSAOTex) } },
+			{ outputTex }, "data/shaders/chapter08/VK02_SSAOFinal.frag")
 	{
 		setVkImageName(ctx_.vkDev, rotateTex.image.image, "rotateTex");
-		setVkImageName(ctx_.vkDev, SSAOTex.image.image, "SSAO");
-		setVkImageName(ctx_.vkDev, SSAOBlurXTex.image.image, "SSAOBlurX");
-		setVkImageName(ctx_.vkDev, SSAOBlurYTex.image.image, "SSAOBlurY");
-
-		renderers_.emplace_back(ssaoShaderToColor, false);
-		renderers_.emplace_back(blurXShaderToColor, false);
-		renderers_.emplace_back(blurYShaderToColor, false);
-		renderers_.emplace_back(finalShaderToColor, false);
-
-		renderers_.emplace_back(SSAO, false);
-		renderers_.emplace_back(ssaoColorToShader, false);
 
-		renderers_.emplace_back(BlurX, false);
-		renderers_.emplace_back(blurXColorToShader, false);
-
-		renderers_.emplace_back(BlurY, false);
-		renderers_.emplace_back(blurYColorToShader, false);
-
-		renderers_.emplace_back(SSAOFinal, false);
-		renderers_.emplace_back(finalColorToShader, false);
+		setTexture(ids_.color, colorTex);
+		setTexture(ids_.depth, depthTex);
+		setTexture(ids_.rotate, rotateTex);
+		setTexture(ids_.output, outputTex);
+
+		if (resolution != eSSAOResolution_Full)
+		{
+			downsampleDepth_ = std::make_unique<QuadProcessor>(ctx, DescriptorSetInfo { .textures = { fsTextureAttachment(depthTex) } },
+				std::vector<VulkanTexture> { depthSSAOTex }, "data/shaders/chapter08/VK02_SSAODownsampleDepth.frag");
+			setPassRenderer(ids_.downsamplePass, *downsampleDepth_);
+		}
+
+		setPassRenderer(ids_.ssaoPass, SSAO);
+		setPassRenderer(ids_.blurXPass, BlurX);
+		setPassRenderer(ids_.blurYPass, BlurY);
+		setPassRenderer(ids_.finalPass, SSAOFinal);
 	}
 
+	inline VulkanTexture getDepthSSAO() const { return depthSSAOTex; }
 	inline VulkanTexture getSSAO()   const { return SSAOTex; }
 	inline VulkanTexture getBlurX()  const { return SSAOBlurXTex; }
 	inline VulkanTexture getBlurY()  const { return SSAOBlurYTex; }
@@ -79,22 +81,81 @@ struct SSAOProcessor: public CompositeRenderer
 	} *params;
 
 private:
+	struct GraphIds
+	{
+		uint32_t color, depth, rotate, output;
+		// 'depthSSAO' is 'depth' at full resolution (no downsampling pass)
+		uint32_t depthSSAO, ssao, blurX, blurY;
+		uint32_t downsamplePass, ssaoPass, blurXPass, blurYPass, finalPass;
+	};
+
+	// declared first: the transient textures have to exist before the QuadProcessors
+	GraphIds ids_;
+
 	VulkanTexture rotateTex;
+	VulkanTexture depthSSAOTex;
 	VulkanTexture SSAOTex, SSAOBlurXTex, SSAOBlurYTex;
 
 	BufferAttachment SSAOParamBuffer;
 
 	QuadProcessor SSAO, BlurX, BlurY, SSAOFinal;
 
-	ColorToShaderOptimalBarrier ssaoColorToShader;
-	ShaderOptimalToColorBarrier ssaoShaderToColor;
+	std::unique_ptr<QuadProcessor> downsampleDepth_;
 
-	ColorToShaderOptimalBarrier blurXColorToShader;
-	ShaderOptimalToColorBarrier blurXShaderToColor;
-
-	ColorToShaderOptimalBarrier blurYColorToShader;
-	ShaderOptimalToColorBarrier blurYShaderToColor;
-
-	ColorToShaderOptimalBarrier finalColorToShader;
-	ShaderOptimalToColorBarrier finalShaderToColor;
+	GraphIds declareGraph(eSSAOResolution resolution)
+	{
+		GraphIds g;
+
+		g.color  = addTexture("color", VulkanTexture {}, true);
+		g.depth  = addTexture("depth", VulkanTexture {}, true);
+		g.rotate = addTexture("rotateTex", VulkanTexture {}, true);
+		g.output = addTexture("output", VulkanTexture {}, true);
+
+		// relative to the framebuffer, so the memory report scales to other resolutions
+		const TransientTextureDesc desc { .divisor = (int)resolution, .addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT };
+
+		g.depthSSAO = g.depth;
+		g.downsamplePass = 0;
+
+		if (resolution != eSSAOResolution_Full)
+		{
+			// min and max depths alternate, so they are never interpolated
+			g.depthSSAO = addTransientTexture("depthSSAO", TransientTextureDesc {
+				.divisor = (int)resolution, .format = VK_FORMAT_R32_SFLOAT, .minFilter = VK_FILTER_NEAREST, .maxFilter = VK_FILTER_NEAREST });
+
+			g.downsamplePass = addPass("DownsampleDepth");
+			read(g.downsamplePass, g.depth);
+			write(g.downsamplePass, g.depthSSAO);
+		}
+
+		// SSAO and SSAOBlurY share memory: the blurred buffer (displayed in the demos) is still valid after the graph
+		g.ssao  = addTransientTexture("SSAO", desc);
+		g.blurX = addTransientTexture("SSAOBlurX", desc);
+		g.blurY = addTransientTexture("SSAOBlurY", desc);
+
+		g.ssaoPass = addPass("SSAO");
+		read(g.ssaoPass, g.depthSSAO);
+		read(g.ssaoPass, g.rotate);
+		write(g.ssaoPass, g.ssao);
+
+		g.blurXPass = addPass("BlurX");
+		read(g.blurXPass, g.ssao);
+		write(g.blurXPass, g.blurX);
+
+		g.blurYPass = addPass("BlurY");
+		read(g.blurYPass, g.blurX);
+		write(g.blurYPass, g.blurY);
+
+		g.finalPass = addPass("SSAOFinal");
+		read(g.finalPass, g.color);
+		read(g.finalPass, g.blurY);
+		read(g.finalPass, g.depth);
+		if (g.depthSSAO != g.depth)
+			read(g.finalPass, g.depthSSAO);
+		write(g.finalPass, g.output);
+
+		allocateTransientTextures();
+
+		return g;
+	}
 };
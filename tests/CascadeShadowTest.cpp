@@ -0,0 +1,147 @@
+#include "shared/UtilsMath.h"
+
+#include "TestUtils.h"
+
+static bool isNear(float a, float b, float eps = 1e-3f)
+{
+	return std::fabs(a - b) <= eps * std::max(1.0f, std::fabs(b));
+}
+
+/* The splits go from near to far, lambda blends the uniform and the logarithmic schemes */
+static void testSplits()
+{
+	const float nearZ = 0.1f;
+	const float farZ = 100.0f;
+
+	for (uint32_t numCascades = 1 ; numCascades <= 4 ; numCascades++)
+	{
+		for (float lambda : { 0.0f, 0.5f, 0.95f, 1.0f })
+		{
+			float splits[5];
+			getCascadeSplits(nearZ, farZ, numCascades, lambda, splits);
+
+			CHECK(splits[0] == nearZ);
+			CHECK(splits[numCascades] == farZ);
+
+			for (uint32_t i = 0 ; i != numCascades ; i++)
+				CHECK(splits[i] < splits[i + 1]);
+		}
+
+		float uniform[5], logarithmic[5];
+		getCascadeSplits(nearZ, farZ, numCascades, 0.0f, uniform);
+		getCascadeSplits(nearZ, farZ, numCascades, 1.0f, logarithmic);
+
+		for (uint32_t i = 0 ; i != numCascades ; i++)
+		{
+			CHECK(isNear(uniform[i + 1] - uniform[i], (farZ - nearZ) / (float)numCascades));
+			CHECK(isNear(logarithmic[i + 1] / logarithmic[i], std::pow(farZ / nearZ, 1.0f / (float)numCascades)));
+		}
+	}
+}
+
+/* The slice corners are on the frustum edges at the view-space distances of the split */
+static void testSliceCorners()
+{
+	const float nearZ = 0.5f;
+	const float farZ = 200.0f;
+
+	const glm::mat4 proj = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, nearZ, farZ);
+	const glm::mat4 view = glm::lookAt(vec3(3.0f, 5.0f, -7.0f), vec3(10.0f, 2.0f, 4.0f), vec3(0.0f, 1.0f, 0.0f));
+
+	vec4 frustumCorners[8];
+	getFrustumCorners(proj * view, frustumCorners);
+
+	const float splitNear = 7.0f;
+	const float splitFar = 42.0f;
+
+	vec3 slice[8];
+	getFrustumSliceCorners(frustumCorners, nearZ, farZ, splitNear, splitFar, slice);
+
+	for (int i = 0 ; i != 8 ; i++)
+	{
+		const float depth = -(view * vec4(slice[i], 1.0f)).z;
+		CHECK(isNear(depth, (i < 4) ? splitNear : splitFar));
+
+		// the same NDC x and y as the corresponding frustum corner
+		const vec4 clip = proj * view * vec4(slice[i], 1.0f);
+		const vec4 corner = proj * view * frustumCorners[i];
+
+		CHECK(isNear(clip.x / clip.w, corner.x / corner.w));
+		CHECK(isNear(clip.y / clip.w, corner.y / corner.w));
+	}
+}
+
+// the origin of an orthographic projection in light space (see getCascadeProjection())
+static float getOriginX(const glm::mat4& cascadeProj) { return -cascadeProj[3][0] / cascadeProj[0][0]; }
+static float getOriginY(const glm::mat4& cascadeProj) { return -cascadeProj[3][1] / cascadeProj[1][1]; }
+
+static bool isWholeTexel(float x, float texelSize)
+{
+	const float t = x / texelSize;
+	return std::fabs(t - std::round(t)) < 1e-2f;
+}
+
+/*
+	The cascade covers its slice and the depth range of the scene, its size does not change when the camera rotates
+	and its origin is snapped to whole texels
+*/
+static void testCascadeProjection()
+{
+	const float nearZ = 0.5f;
+	const float farZ = 200.0f;
+	const uint32_t resolution = 1024;
+
+	const glm::mat4 proj = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, nearZ, farZ);
+	const glm::mat4 lightView = glm::lookAt(vec3(50.0f, 100.0f, 20.0f), vec3(0.0f), vec3(0.0f, 1.0f, 0.0f));
+	const BoundingBox sceneBox(vec3(-60.0f, -5.0f, -60.0f), vec3(60.0f, 30.0f, 60.0f));
+
+	float radius = 0.0f;
+
+	for (int step = 0 ; step != 16 ; step++)
+	{
+		// the camera moves and rotates inside the scene
+		const vec3 eye(0.37f * (float)step, 2.0f, -0.21f * (float)step);
+		const glm::mat4 view = glm::lookAt(eye, eye + vec3(std::cos(0.4f * (float)step), -0.1f, std::sin(0.4f * (float)step)), vec3(0.0f, 1.0f, 0.0f));
+
+		vec4 frustumCorners[8];
+		getFrustumCorners(proj * view, frustumCorners);
+
+		vec3 slice[8];
+		getFrustumSliceCorners(frustumCorners, nearZ, farZ, 5.0f, 20.0f, slice);
+
+		const glm::mat4 cascadeProj = getCascadeProjection(slice, lightView, sceneBox, resolution);
+		const glm::mat4 viewProj = cascadeProj * lightView;
+
+		for (int i = 0 ; i != 8 ; i++)
+		{
+			const vec4 p = viewProj * vec4(slice[i], 1.0f);
+			CHECK(std::fabs(p.x) <= 1.0f && std::fabs(p.y) <= 1.0f);
+		}
+
+		// every caster of the scene is inside the depth range
+		for (int i = 0 ; i != 8 ; i++)
+		{
+			const vec3 c((i & 1) ? sceneBox.max_.x : sceneBox.min_.x, (i & 2) ? sceneBox.max_.y : sceneBox.min_.y, (i & 4) ? sceneBox.max_.z : sceneBox.min_.z);
+			CHECK(std::fabs((viewProj * vec4(c, 1.0f)).z) <= 1.0f + 1e-4f);
+		}
+
+		const float r = 1.0f / cascadeProj[0][0];
+		if (step == 0)
+			radius = r;
+
+		CHECK(r == radius);
+
+		const float texelSize = 2.0f * r / (float)resolution;
+		CHECK(isWholeTexel(getOriginX(cascadeProj), texelSize));
+		CHECK(isWholeTexel(getOriginY(cascadeProj), texelSize));
+	}
+}
+
+int main()
+{
+	testSplits();
+	testSliceCorners();
+	testCascadeProjection();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,177 @@
+#include "shared/DrawCompaction.h"
+#include "shared/UtilsMath.h"
+
+#include "TestUtils.h"
+
+#include <numeric>
+#include <random>
+
+// the layout of DrawElementsIndirectCommand and of DrawCommand in GL02_FrustumCullingCompact.comp
+struct DrawCommand
+{
+	uint32_t count_;
+	uint32_t instanceCount_;
+	uint32_t firstIndex_;
+	uint32_t baseVertex_;
+	uint32_t baseInstance_;
+};
+
+/*
+	What GL02_FrustumCullingCompact.comp does, with the invocations in a random order:
+	every visible command takes the next free element of its bucket with atomicAdd()
+*/
+static void runCullingShader(const std::vector<DrawCommand>& in, const std::vector<uint8_t>& visible, const DrawBuckets& buckets,
+	std::mt19937& rng, std::vector<DrawCommand>& out, std::vector<uint32_t>& counts)
+{
+	std::vector<uint32_t> invocations(in.size());
+	std::iota(invocations.begin(), invocations.end(), 0);
+	std::shuffle(invocations.begin(), invocations.end(), rng);
+
+	// the output buffer is not cleared between frames
+	out.assign(in.size(), DrawCommand { 0xDEAD, 0xDEAD, 0xDEAD, 0xDEAD, 0xDEAD });
+	counts.assign(buckets.getNumBuckets(), 0);
+
+	for (uint32_t idx: invocations)
+	{
+		if (!visible[idx])
+			continue;
+
+		const uint32_t bucket = buckets.bucketOfCommand_[idx];
+		out[buckets.offsets_[bucket] + counts[bucket]++] = in[idx];
+	}
+}
+
+static void testBuckets()
+{
+	const DrawBuckets b = makeDrawBuckets({ 2, 0, 2, 3, 0, 2 }, 4);
+
+	CHECK(b.getNumBuckets() == 4);
+	CHECK(b.sizes_ == std::vector<uint32_t>({ 2, 0, 3, 1 }));
+	CHECK(b.offsets_ == std::vector<uint32_t>({ 0, 2, 2, 5 }));
+
+	const DrawBuckets single = makeDrawBuckets(5);
+	CHECK(single.getNumBuckets() == 1 && single.sizes_[0] == 5 && single.offsets_[0] == 0);
+}
+
+/*
+	Random scenes culled against a camera frustum, bucketed like GL02_CullingGPU (by material and index type):
+	the shader's output matches the reference compaction in every bucket
+*/
+static void testAgainstShader()
+{
+	std::mt19937 rng(33);
+
+	uint32_t totalVisible = 0;
+	uint32_t totalCommands = 0;
+
+	for (int iter = 0 ; iter != 200 ; iter++)
+	{
+		const uint32_t numCommands = 1 + rng() % 500;
+		const uint32_t numMaterials = 1 + rng() % 8;
+		const uint32_t numShortCommands = rng() % (numCommands + 1);
+
+		std::vector<DrawCommand> commands(numCommands);
+		std::vector<BoundingBox> boxes(numCommands);
+		std::vector<uint32_t> bucketOfCommand(numCommands);
+
+		for (uint32_t i = 0 ; i != numCommands ; i++)
+		{
+			// the shape index is in the upper 16 bits of baseInstance (see GLMesh)
+			const uint32_t shape = (i * 7919) % numCommands;
+
+			commands[i] = DrawCommand { 3 * (1 + rng() % 1000), 1, rng() % 100000, rng() % 100000, shape << 16 };
+
+			const vec3 center((float)(rng() % 200) - 100.0f, (float)(rng() % 20), (float)(rng() % 200) - 100.0f);
+			boxes[shape] = BoundingBox(center - vec3(1.0f), center + vec3(1.0f));
+
+			bucketOfCommand[i] = 2 * (rng() % numMaterials) + (i < numShortCommands ? 0 : 1);
+		}
+
+		const DrawBuckets buckets = makeDrawBuckets(bucketOfCommand, 2 * numMaterials);
+
+		const glm::mat4 proj = glm::perspective(glm::radians(45.0f), 1.5f, 0.1f, 1000.0f);
+		const glm::mat4 view = glm::lookAt(vec3(0.0f, 5.0f, 0.0f), vec3(std::cos((float)iter), 5.0f, std::sin((float)iter)), vec3(0.0f, 1.0f, 0.0f));
+
+		glm::vec4 frustumPlanes[6];
+		glm::vec4 frustumCorners[8];
+		getFrustumPlanes(proj * view, frustumPlanes);
+		getFrustumCorners(proj * view, frustumCorners);
+
+		std::vector<uint8_t> visible(numCommands);
+		uint32_t numVisible = 0;
+
+		for (uint32_t i = 0 ; i != numCommands ; i++)
+		{
+			visible[i] = isBoxInFrustum(frustumPlanes, frustumCorners, boxes[commands[i].baseInstance_ >> 16]) ? 1 : 0;
+			numVisible += visible[i];
+		}
+
+		std::vector<DrawCommand> expected, actual;
+		std::vector<uint32_t> expectedCounts, actualCounts;
+
+		compactDrawCommands(commands, visible, buckets, expected, expectedCounts);
+		runCullingShader(commands, visible, buckets, rng, actual, actualCounts);
+
+		CHECK(verifyCompactedDrawCommands(buckets, expected, expectedCounts, actual, actualCounts) == 0);
+		CHECK(std::accumulate(expectedCounts.begin(), expectedCounts.end(), 0u) == numVisible);
+
+		// the reference keeps the input order inside every bucket
+		std::vector<uint32_t> next(buckets.offsets_);
+
+		for (uint32_t i = 0 ; i != numCommands ; i++)
+			if (visible[i])
+				CHECK(!memcmp(&expected[next[bucketOfCommand[i]]++], &commands[i], sizeof(DrawCommand)));
+
+		totalVisible += numVisible;
+		totalCommands += numCommands;
+	}
+
+	// the frustum has to cull something, but not everything
+	CHECK(totalVisible > 0 && totalVisible < totalCommands);
+}
+
+/* A lost command, a changed command and a command in the wrong bucket are found */
+static void testMismatches()
+{
+	const std::vector<DrawCommand> commands = {
+		{ 3, 1, 0, 0, 0 << 16 }, { 6, 1, 3, 0, 1 << 16 }, { 9, 1, 9, 0, 2 << 16 }, { 12, 1, 18, 0, 3 << 16 } };
+	const std::vector<uint8_t> visible = { 1, 1, 0, 1 };
+	const DrawBuckets buckets = makeDrawBuckets({ 0, 1, 0, 1 }, 2);
+
+	std::vector<DrawCommand> expected;
+	std::vector<uint32_t> expectedCounts;
+	compactDrawCommands(commands, visible, buckets, expected, expectedCounts);
+
+	CHECK(expectedCounts == std::vector<uint32_t>({ 1, 2 }));
+	CHECK(verifyCompactedDrawCommands(buckets, expected, expectedCounts, expected, expectedCounts) == 0);
+
+	// the order inside a bucket does not matter
+	std::vector<DrawCommand> actual = expected;
+	std::swap(actual[2], actual[3]);
+	CHECK(verifyCompactedDrawCommands(buckets, expected, expectedCounts, actual, expectedCounts) == 0);
+
+	std::vector<uint32_t> actualCounts = { 1, 1 };
+	CHECK(verifyCompactedDrawCommands(buckets, expected, expectedCounts, expected, actualCounts) == 1);
+
+	actual = expected;
+	actual[3].firstIndex_++;
+	CHECK(verifyCompactedDrawCommands(buckets, expected, expectedCounts, actual, expectedCounts) == 1);
+
+	// a command of bucket 1 in bucket 0
+	actual = expected;
+	std::swap(actual[0], actual[2]);
+	CHECK(verifyCompactedDrawCommands(buckets, expected, expectedCounts, actual, expectedCounts) == 2);
+
+	// more commands than the bucket has
+	actualCounts = { 1, 3 };
+	CHECK(verifyCompactedDrawCommands(buckets, expected, expectedCounts, expected, actualCounts) == 1);
+}
+
+int main()
+{
+	testBuckets();
+	testAgainstShader();
+	testMismatches();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,99 @@
+#include "shared/scene/VtxData.h"
+
+#include "TestUtils.h"
+
+#include <random>
+
+/* What the GPU reads: 'firstIndex' + i in elements of the mesh's index type (see fetchIndex() in VK01_VertCommon.h) */
+static uint32_t fetchIndex(const PackedIndexData& p, bool isShort, uint32_t firstIndex, uint32_t i)
+{
+	if (!isShort)
+		return p.data_[firstIndex + i];
+
+	const uint32_t idx = firstIndex + i;
+	return (p.data_[idx >> 1] >> (16 * (idx & 1))) & 0xFFFF;
+}
+
+static void addMesh(MeshData& m, std::mt19937& rng, uint32_t numVertices, uint32_t numTriangles, bool hasLodRanges)
+{
+	Mesh mesh = {
+		.lodCount = 1,
+		.indexOffset = (uint32_t)m.indexData_.size(),
+		.vertexCount = numVertices,
+		.lodOffset = { 0, numTriangles * 3 }
+	};
+
+	if (hasLodRanges)
+		mesh.lodVertexCount[0] = numVertices;
+
+	for (uint32_t i = 0 ; i != numTriangles * 3 ; i++)
+		m.indexData_.push_back(rng() % numVertices);
+
+	// the last vertex is referenced, so the largest index is known
+	m.indexData_.back() = numVertices - 1;
+
+	m.meshes_.push_back(mesh);
+}
+
+/* Every mesh decodes to its original indices, only the meshes with more than 65536 vertices keep 32-bit indices */
+static void testPacking()
+{
+	std::mt19937 rng(42);
+
+	MeshData m;
+
+	addMesh(m, rng, 3, 1, true);        // odd number of 16-bit indices
+	addMesh(m, rng, 70000, 1000, true); // 32-bit
+	addMesh(m, rng, 65536, 333, true);  // the largest mesh with 16-bit indices
+	addMesh(m, rng, 65537, 10, true);   // 32-bit
+	addMesh(m, rng, 100, 7, false);     // no LOD vertex ranges: the vertex count decides
+	addMesh(m, rng, 1000, 5000, true);
+
+	const bool expectedShort[] = { true, false, true, false, true, true };
+
+	const PackedIndexData p = packIndexData(m);
+
+	CHECK(p.meshIndexOffsets_.size() == m.meshes_.size());
+	CHECK(p.numShortIndices_ + p.numLongIndices_ == (uint32_t)m.indexData_.size());
+	CHECK(p.numLongIndices_ == 1000 * 3 + 10 * 3);
+	CHECK(p.data_.size() == (p.numShortIndices_ + 1) / 2 + p.numLongIndices_);
+
+	for (uint32_t i = 0 ; i != (uint32_t)m.meshes_.size() ; i++)
+	{
+		const Mesh& mesh = m.meshes_[i];
+		CHECK(mesh.hasShortIndices() == expectedShort[i]);
+
+		// an offset into the mesh (e.g. a LOD) stays relative to the mesh
+		for (uint32_t j : { 0u, 3u })
+		{
+			if (j >= mesh.getLODIndicesCount(0))
+				continue;
+
+			const uint32_t firstIndex = p.getFirstIndex(m, i, mesh.indexOffset + j);
+			uint32_t numMismatches = 0;
+
+			for (uint32_t k = 0 ; k + j != mesh.getLODIndicesCount(0) ; k++)
+				numMismatches += (fetchIndex(p, mesh.hasShortIndices(), firstIndex, k) != m.indexData_[mesh.indexOffset + j + k]) ? 1 : 0;
+
+			CHECK(numMismatches == 0);
+		}
+	}
+
+	printf("Index data: %u KB with 32-bit indices, %u KB packed\n",
+		(uint32_t)(m.indexData_.size() * sizeof(uint32_t) / 1024), (uint32_t)(p.data_.size() * sizeof(uint32_t) / 1024));
+}
+
+static void testEmpty()
+{
+	const PackedIndexData p = packIndexData(MeshData {});
+	CHECK(p.data_.empty());
+	CHECK(p.meshIndexOffsets_.empty());
+}
+
+int main()
+{
+	testPacking();
+	testEmpty();
+
+	return TEST_RESULT();
+}
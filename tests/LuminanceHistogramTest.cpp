@@ -0,0 +1,130 @@
+#include "shared/LuminanceHistogram.h"
+
+#include <math.h>
+#include <algorithm>
+
+#include "TestUtils.h"
+
+static bool isNear(float a, float b, float eps = 1e-4f)
+{
+	return fabsf(a - b) <= eps * std::max(1.0f, fabsf(b));
+}
+
+/* 'numPixels' pixels of the same gray level */
+static void addPixels(std::vector<float>& rgba, uint32_t numPixels, float lum)
+{
+	for (uint32_t i = 0 ; i != numPixels ; i++)
+		rgba.insert(rgba.end(), { lum, lum, lum, 1.0f });
+}
+
+/* Black pixels and pixels darker than exp2(minLog2Lum_) go to bin 0 */
+static void testBlackPixels()
+{
+	const LuminanceHistogramParams params;
+
+	CHECK(getLuminanceBin(0.0f, params) == 0);
+	CHECK(getLuminanceBin(0.5f * exp2f(params.minLog2Lum_), params) == 0);
+	CHECK(getLuminanceBin(exp2f(params.minLog2Lum_), params) == 1);
+
+	std::vector<float> rgba;
+	addPixels(rgba, 10, 0.0f);
+	// a very dark red
+	rgba.insert(rgba.end(), { 1e-4f, 0.0f, 0.0f, 1.0f });
+
+	std::vector<uint32_t> bins;
+	buildLuminanceHistogram(rgba.data(), (uint32_t)(rgba.size() / 4), params, bins);
+
+	CHECK(bins.size() == LuminanceHistogramBins);
+	CHECK(bins[0] == 11);
+}
+
+/* Luminances above the range go to the last bin */
+static void testClamping()
+{
+	const LuminanceHistogramParams params;
+	const float maxLum = exp2f(params.minLog2Lum_ + params.log2LumRange_);
+
+	CHECK(getLuminanceBin(maxLum, params) == LuminanceHistogramBins - 1);
+	CHECK(getLuminanceBin(4.0f * maxLum, params) == LuminanceHistogramBins - 1);
+	CHECK(getLuminanceBin(1e30f, params) == LuminanceHistogramBins - 1);
+	CHECK(getLuminanceBin(1.01f * exp2f(params.minLog2Lum_), params) == 1);
+}
+
+/* The center of every bin is mapped back to that bin, the centers are evenly spaced */
+static void testBinCenters()
+{
+	const LuminanceHistogramParams params;
+	const float binSize = params.log2LumRange_ / (LuminanceHistogramBins - 1);
+
+	CHECK(isNear(getLuminanceBinCenter(1, params), params.minLog2Lum_ + 0.5f * binSize));
+	CHECK(isNear(getLuminanceBinCenter(LuminanceHistogramBins - 1, params), params.minLog2Lum_ + params.log2LumRange_ - 0.5f * binSize));
+
+	for (uint32_t i = 1 ; i != LuminanceHistogramBins ; i++)
+	{
+		CHECK(getLuminanceBin(exp2f(getLuminanceBinCenter(i, params)), params) == i);
+
+		if (i > 1)
+			CHECK(isNear(getLuminanceBinCenter(i, params) - getLuminanceBinCenter(i - 1, params), binSize));
+	}
+}
+
+/* A single very bright pixel is above the high percentile and does not move the mean */
+static void testPercentiles()
+{
+	const LuminanceHistogramParams params;
+	const float lum = 0.25f;
+
+	std::vector<float> rgba;
+	addPixels(rgba, 1000, lum);
+
+	std::vector<uint32_t> bins;
+	buildLuminanceHistogram(rgba.data(), (uint32_t)(rgba.size() / 4), params, bins);
+	const float average = getAverageLuminance(bins, params);
+
+	CHECK(isNear(average, exp2f(getLuminanceBinCenter(getLuminanceBin(lum, params), params))));
+
+	addPixels(rgba, 1, 1e6f);
+	buildLuminanceHistogram(rgba.data(), (uint32_t)(rgba.size() / 4), params, bins);
+
+	CHECK(bins[LuminanceHistogramBins - 1] == 1);
+	CHECK(isNear(getAverageLuminance(bins, params), average));
+
+	// black pixels are ignored
+	addPixels(rgba, 500, 0.0f);
+	buildLuminanceHistogram(rgba.data(), (uint32_t)(rgba.size() / 4), params, bins);
+
+	CHECK(isNear(getAverageLuminance(bins, params), average));
+
+	// without trimming the bright pixel is averaged in
+	const LuminanceHistogramParams all = { .lowPercentile_ = 0.0f, .highPercentile_ = 1.0f };
+	CHECK(getAverageLuminance(bins, all) > 1.001f * average);
+}
+
+/* An all-black image falls back to exp2(minLog2Lum_) */
+static void testAllBlack()
+{
+	const LuminanceHistogramParams params;
+
+	std::vector<float> rgba;
+	addPixels(rgba, 100, 0.0f);
+
+	std::vector<uint32_t> bins;
+	buildLuminanceHistogram(rgba.data(), (uint32_t)(rgba.size() / 4), params, bins);
+
+	CHECK(bins[0] == 100);
+	CHECK(getAverageLuminance(bins, params) == exp2f(params.minLog2Lum_));
+
+	buildLuminanceHistogram(rgba.data(), 0, params, bins);
+	CHECK(getAverageLuminance(bins, params) == exp2f(params.minLog2Lum_));
+}
+
+int main()
+{
+	testBlackPixels();
+	testClamping();
+	testBinCenters();
+	testPercentiles();
+	testAllBlack();
+
+	return TEST_RESULT();
+}
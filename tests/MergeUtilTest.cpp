@@ -0,0 +1,186 @@
+#include "shared/scene/MergeUtil.h"
+
+#include "TestUtils.h"
+
+// position, texture coordinates, normal
+static void addVertex(MeshData& m, float x, float y, float z)
+{
+	m.vertexData_.insert(m.vertexData_.end(), { x, y, z, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f });
+}
+
+/* A mesh with two LODs: LOD0 uses the vertices [first, first + lod0Vertices), LOD1 the next 'lod1Vertices' ones */
+static uint32_t addLODMesh(MeshData& m, uint32_t numUnused, uint32_t lod0Vertices, uint32_t lod1Vertices)
+{
+	const uint32_t vertexOffset = (uint32_t)(m.vertexData_.size() / 8);
+	const uint32_t numVertices = numUnused + lod0Vertices + lod1Vertices;
+
+	for (uint32_t v = 0 ; v != numVertices ; v++)
+		addVertex(m, (float)(v % 7), (float)(v % 5), (float)(v % 3));
+
+	Mesh mesh = {
+		.lodCount = 2,
+		.streamCount = 1,
+		.indexOffset = (uint32_t)m.indexData_.size(),
+		.vertexOffset = vertexOffset,
+		.vertexCount = numVertices,
+		.lodVertexOffset = { numUnused, numUnused + lod0Vertices },
+		.lodVertexCount = { lod0Vertices, lod1Vertices },
+		.streamOffset = { vertexOffset * 8 * (uint32_t)sizeof(float) },
+		.streamElementSize = { 8 * sizeof(float) }
+	};
+
+	// triangle fans over the ranges, every vertex of a range is referenced
+	auto addFan = [&m](uint32_t first, uint32_t count)
+	{
+		for (uint32_t v = first + 1 ; v + 1 < first + count ; v++)
+			m.indexData_.insert(m.indexData_.end(), { first, v, v + 1 });
+	};
+
+	addFan(numUnused, lod0Vertices);
+	mesh.lodOffset[1] = (uint32_t)m.indexData_.size() - mesh.indexOffset;
+	addFan(numUnused + lod0Vertices, lod1Vertices);
+	mesh.lodOffset[2] = (uint32_t)m.indexData_.size() - mesh.indexOffset;
+
+	m.meshes_.push_back(mesh);
+
+	return (uint32_t)m.meshes_.size() - 1;
+}
+
+/* The copy keeps only the used vertices, its LOD vertex ranges are relative to them */
+static void testCopyMesh()
+{
+	MeshData src;
+	addLODMesh(src, 3, 4, 5);
+	const uint32_t meshIndex = addLODMesh(src, 10, 6, 4);
+
+	MeshData dst;
+	addLODMesh(dst, 0, 3, 3);
+
+	const uint32_t copy = copyMesh(src, meshIndex, dst);
+	const Mesh& mesh = dst.meshes_[copy];
+
+	CHECK(copy == 1);
+	CHECK(mesh.vertexCount == 10);
+	CHECK(mesh.lodVertexOffset[0] == 0 && mesh.lodVertexCount[0] == 6);
+	CHECK(mesh.lodVertexOffset[1] == 6 && mesh.lodVertexCount[1] == 4);
+	CHECK(dst.vertexData_.size() == (6 + 10) * 8);
+	CHECK(mesh.hasShortIndices());
+
+	// every index stays inside the range of its LOD
+	for (uint32_t l = 0 ; l != mesh.lodCount ; l++)
+	{
+		for (uint32_t i = mesh.lodOffset[l] ; i != mesh.lodOffset[l + 1] ; i++)
+		{
+			const uint32_t idx = dst.indexData_[mesh.indexOffset + i];
+			CHECK(idx >= mesh.lodVertexOffset[l] && idx < mesh.lodVertexOffset[l] + mesh.lodVertexCount[l]);
+		}
+	}
+}
+
+/* The vertices of all LODs count towards the batch limit */
+static void testBatchLimit()
+{
+	MeshData meshData;
+	Scene scene;
+	addNode(scene, -1, 0);
+
+	// 40 + 20 vertices per mesh: two meshes per batch fit into 130 vertices, three would if only LOD0 was counted
+	for (uint32_t i = 0 ; i != 6 ; i++)
+	{
+		const int node = addNode(scene, 0, 1);
+		scene.meshes_[node] = addLODMesh(meshData, 0, 40, 20);
+		scene.materialForNode_[node] = 0;
+	}
+
+	recalculateBoundingBoxes(meshData);
+
+	const StaticBatchingParams params = {
+		.maxVerticesPerBatch_ = 130,
+		.minInstancesToKeep_ = 0
+	};
+
+	const StaticBatchingStats stats = batchStaticMeshes(scene, meshData, params);
+
+	CHECK(stats.numBatches_ == 3);
+	CHECK(stats.drawsAfter_ == 3);
+	CHECK(stats.trianglesAfter_ == stats.trianglesBefore_);
+
+	for (const Mesh& mesh: meshData.meshes_)
+	{
+		CHECK(mesh.lodCount == 2);
+		CHECK(mesh.vertexCount == 120);
+		CHECK(mesh.lodVertexCount[0] + mesh.lodVertexCount[1] == mesh.vertexCount);
+	}
+}
+
+static uint32_t addTriangle(MeshData& m, const vec3& offset, float z)
+{
+	const uint32_t vertexOffset = (uint32_t)(m.vertexData_.size() / 8);
+
+	addVertex(m, offset.x, offset.y, offset.z);
+	addVertex(m, offset.x + 1.0f, offset.y, offset.z);
+	addVertex(m, offset.x, offset.y + 1.0f, offset.z + z);
+
+	m.meshes_.push_back(Mesh {
+		.lodCount = 1,
+		.streamCount = 1,
+		.indexOffset = (uint32_t)m.indexData_.size(),
+		.vertexOffset = vertexOffset,
+		.vertexCount = 3,
+		.lodOffset = { 0, 3 },
+		.streamOffset = { vertexOffset * 8 * (uint32_t)sizeof(float) },
+		.streamElementSize = { 8 * sizeof(float) }
+	});
+
+	m.indexData_.insert(m.indexData_.end(), { 0, 1, 2 });
+
+	return (uint32_t)m.meshes_.size() - 1;
+}
+
+/* Translated copies are found even if their positions are rounded to different steps, different meshes are kept */
+static void testDeduplication()
+{
+	const float tolerance = 0.0001f;
+
+	MeshData meshData;
+	Scene scene;
+	addNode(scene, -1, 0);
+
+	// the copies differ by 0.2 * tolerance around a multiple of 0.5 * 16 * tolerance (the rounding boundary of a quantized hash)
+	const float z[] = { 0.00079f, 0.00081f, 0.0008f, 0.0005f };
+	const vec3 offsets[] = { vec3(0.0f), vec3(10.0f, 20.0f, 30.0f), vec3(-5.0f, 0.0f, 2.0f), vec3(1.0f) };
+
+	for (int i = 0 ; i != 4 ; i++)
+	{
+		const int node = addNode(scene, 0, 1);
+		scene.meshes_[node] = addTriangle(meshData, offsets[i], z[i]);
+		scene.materialForNode_[node] = 0;
+	}
+
+	recalculateBoundingBoxes(meshData);
+
+	const MeshInstancingStats stats = deduplicateMeshes(scene, meshData, tolerance);
+
+	CHECK(stats.meshesBefore_ == 4);
+	CHECK(stats.meshesAfter_ == 2);
+	CHECK(stats.drawsAfter_ == 2);
+
+	// the copies are moved to their original places
+	for (int i = 1 ; i != 3 ; i++)
+	{
+		CHECK(scene.meshes_[i + 1] == scene.meshes_[1]);
+		const vec3 t = vec3(scene.localTransform_[i + 1][3]);
+		CHECK(glm::length(t - offsets[i]) < tolerance);
+	}
+
+	CHECK(scene.meshes_[4] != scene.meshes_[1]);
+}
+
+int main()
+{
+	testCopyMesh();
+	testBatchLimit();
+	testDeduplication();
+
+	return TEST_RESULT();
+}
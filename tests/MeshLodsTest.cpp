@@ -0,0 +1,165 @@
+#include "shared/scene/MeshLods.h"
+
+#include <algorithm>
+#include <array>
+#include <math.h>
+#include <set>
+
+#include "TestUtils.h"
+
+// position, texture coordinates and normal (see SceneConverter)
+constexpr uint32_t kNumFloats = 8;
+
+using Vertex = std::array<float, kNumFloats>;
+// the positions of the vertices of a triangle, starting from the smallest one (the winding is kept)
+using Triangle = std::array<std::array<float, 3>, 3>;
+
+static Vertex getVertex(const std::vector<float>& vertices, uint32_t i)
+{
+	Vertex v;
+	std::copy_n(&vertices[i * kNumFloats], kNumFloats, v.begin());
+	return v;
+}
+
+static Triangle getTriangle(const std::vector<float>& vertices, const uint32_t* indices)
+{
+	Triangle t;
+	for (int k = 0 ; k != 3 ; k++)
+		std::copy_n(&vertices[indices[k] * kNumFloats], 3, t[k].begin());
+
+	std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+
+	return t;
+}
+
+/* A bumpy 'size' x 'size' quads grid with an unreferenced vertex at the end */
+static void makeGrid(uint32_t size, std::vector<float>& vertices, std::vector<uint32_t>& indices)
+{
+	for (uint32_t z = 0 ; z <= size ; z++)
+		for (uint32_t x = 0 ; x <= size ; x++)
+		{
+			const float u = (float)x / (float)size;
+			const float v = (float)z / (float)size;
+			vertices.insert(vertices.end(), { (float)x, sinf(0.3f * x) * cosf(0.2f * z), (float)z, u, v, 0.0f, 1.0f, 0.0f });
+		}
+
+	for (uint32_t z = 0 ; z != size ; z++)
+		for (uint32_t x = 0 ; x != size ; x++)
+		{
+			const uint32_t i = z * (size + 1) + x;
+			indices.insert(indices.end(), { i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2 });
+		}
+
+	vertices.insert(vertices.end(), { 100.0f, 100.0f, 100.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f });
+}
+
+/* Every LOD indexes only its own compact vertex range, the ranges follow each other */
+static void testVertexRanges()
+{
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices;
+	makeGrid(32, vertices, indices);
+
+	std::vector<std::vector<uint32_t>> lods;
+	Mesh mesh;
+	processLods(vertices, kNumFloats, indices, true, lods, mesh);
+
+	CHECK(lods.size() > 1);
+	CHECK(lods.size() < kMaxLODs);
+	CHECK(lods[0].size() == indices.size());
+
+	// the unreferenced vertex is dropped
+	CHECK(mesh.lodVertexOffset[0] == 0);
+	CHECK(mesh.lodVertexCount[0] == 33 * 33);
+
+	for (uint32_t l = 0 ; l != lods.size() ; l++)
+	{
+		const uint32_t first = mesh.lodVertexOffset[l];
+		const uint32_t count = mesh.lodVertexCount[l];
+
+		CHECK(!lods[l].empty());
+		CHECK(lods[l].size() % 3 == 0);
+
+		if (l > 0)
+		{
+			CHECK(first == mesh.lodVertexOffset[l - 1] + mesh.lodVertexCount[l - 1]);
+			CHECK(lods[l].size() < lods[l - 1].size());
+		}
+
+		std::vector<bool> used(count, false);
+
+		for (uint32_t i: lods[l])
+		{
+			CHECK(i >= first && i < first + count);
+			if (i >= first && i < first + count)
+				used[i - first] = true;
+		}
+
+		// compact: no unused vertices inside the range
+		CHECK(std::count(used.begin(), used.end(), false) == 0);
+	}
+
+	CHECK(vertices.size() == (size_t)(mesh.lodVertexOffset[lods.size() - 1] + mesh.lodVertexCount[lods.size() - 1]) * kNumFloats);
+}
+
+/* LOD0 draws the original triangles, the coarser LODs copy the original vertices */
+static void testRemappedTriangles()
+{
+	std::vector<float> original;
+	std::vector<uint32_t> indices;
+	makeGrid(32, original, indices);
+
+	std::vector<float> vertices(original);
+	std::vector<std::vector<uint32_t>> lods;
+	Mesh mesh;
+	processLods(vertices, kNumFloats, indices, true, lods, mesh);
+
+	std::multiset<Triangle> originalTriangles;
+	for (size_t i = 0 ; i < indices.size() ; i += 3)
+		originalTriangles.insert(getTriangle(original, &indices[i]));
+
+	std::multiset<Triangle> lod0Triangles;
+	for (size_t i = 0 ; i < lods[0].size() ; i += 3)
+		lod0Triangles.insert(getTriangle(vertices, &lods[0][i]));
+
+	CHECK(lod0Triangles == originalTriangles);
+
+	std::set<Vertex> originalVertices;
+	for (uint32_t i = 0 ; i != original.size() / kNumFloats ; i++)
+		originalVertices.insert(getVertex(original, i));
+
+	for (uint32_t i = 0 ; i != vertices.size() / kNumFloats ; i++)
+		CHECK(originalVertices.count(getVertex(vertices, i)) == 1);
+
+	for (uint32_t l = 1 ; l < lods.size() ; l++)
+		for (size_t i = 0 ; i < lods[l].size() ; i += 3)
+		{
+			const Triangle t = getTriangle(vertices, &lods[l][i]);
+			CHECK(t[0] != t[1] && t[1] != t[2] && t[2] != t[0]);
+		}
+}
+
+/* Without LODs only LOD0 is generated */
+static void testNoLods()
+{
+	std::vector<float> vertices;
+	std::vector<uint32_t> indices;
+	makeGrid(8, vertices, indices);
+
+	std::vector<std::vector<uint32_t>> lods;
+	Mesh mesh;
+	processLods(vertices, kNumFloats, indices, false, lods, mesh);
+
+	CHECK(lods.size() == 1);
+	CHECK(mesh.lodVertexCount[0] == 9 * 9);
+	CHECK(vertices.size() == 9 * 9 * kNumFloats);
+}
+
+int main()
+{
+	testVertexRanges();
+	testRemappedTriangles();
+	testNoLods();
+
+	return TEST_RESULT();
+}
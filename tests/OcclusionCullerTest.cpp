@@ -0,0 +1,114 @@
+#include "shared/OcclusionCuller.h"
+
+#include "TestUtils.h"
+
+static BoundingBox makeBox(float x0, float y0, float z0, float x1, float y1, float z1)
+{
+	return BoundingBox(vec3(x0, y0, z0), vec3(x1, y1, z1));
+}
+
+/* The camera at the origin looks down -Z with a 90 degree field of view: a point (x, y, z) is at x / -z in NDC */
+static glm::mat4 getViewProj()
+{
+	return glm::perspective(glm::radians(90.0f), 1.0f, 0.1f, 100.0f);
+}
+
+/* A 16 x 16 quad at z = -10 covering [-0.8, 0.8] of the screen */
+static std::vector<vec3> getQuadOccluder()
+{
+	const vec3 a(-8.0f, -8.0f, -10.0f);
+	const vec3 b( 8.0f, -8.0f, -10.0f);
+	const vec3 c( 8.0f,  8.0f, -10.0f);
+	const vec3 d(-8.0f,  8.0f, -10.0f);
+
+	return { a, b, c, a, c, d };
+}
+
+/* A box fully behind the quad is occluded, the same box in front of it is visible */
+static void testBehindAndInFront()
+{
+	OcclusionCuller culler(128, 128, 2);
+	culler.setOccluders(getQuadOccluder());
+	culler.renderOccluders(getViewProj());
+
+	CHECK(culler.getStats().numOccluderTriangles_ == 2);
+
+	CHECK(!culler.isBoxVisible(makeBox(-1.0f, -1.0f, -20.0f, 1.0f, 1.0f, -18.0f)));
+	CHECK(culler.isBoxVisible(makeBox(-1.0f, -1.0f, -6.0f, 1.0f, 1.0f, -5.0f)));
+	// crossing the quad
+	CHECK(culler.isBoxVisible(makeBox(-1.0f, -1.0f, -12.0f, 1.0f, 1.0f, -8.0f)));
+}
+
+/* Boxes crossing the near plane are always visible, even if most of the box is behind the occluder */
+static void testNearPlane()
+{
+	OcclusionCuller culler(128, 128, 2);
+	culler.setOccluders(getQuadOccluder());
+	culler.renderOccluders(getViewProj());
+
+	CHECK(culler.isBoxVisible(makeBox(-1.0f, -1.0f, -50.0f, 1.0f, 1.0f, 1.0f)));
+	CHECK(culler.isBoxVisible(makeBox(-0.5f, -0.5f, -0.5f, 0.5f, 0.5f, 0.5f)));
+}
+
+/* A box behind the quad but sticking out of its silhouette is visible */
+static void testPartlyCovered()
+{
+	OcclusionCuller culler(128, 128, 2);
+	culler.setOccluders(getQuadOccluder());
+	culler.renderOccluders(getViewProj());
+
+	// [0.7, 0.94] in NDC, the quad ends at 0.8
+	CHECK(culler.isBoxVisible(makeBox(14.0f, -1.0f, -20.0f, 17.0f, 1.0f, -18.0f)));
+	// the same box moved inside the silhouette
+	CHECK(!culler.isBoxVisible(makeBox(8.0f, -1.0f, -20.0f, 11.0f, 1.0f, -18.0f)));
+}
+
+/* cullBoxes() gives the same answers as isBoxVisible() and counts the occluded boxes */
+static void testCullBoxes()
+{
+	OcclusionCuller culler(128, 128, 4);
+	culler.setOccluders(getQuadOccluder());
+	culler.renderOccluders(getViewProj());
+
+	// more than one chunk of boxes, on both sides of the quad
+	std::vector<BoundingBox> boxes;
+	uint32_t seed = 12345;
+	auto random = [&seed](float from, float to)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return from + (to - from) * (float)(seed >> 8) / (float)(1u << 24);
+	};
+
+	for (int i = 0 ; i != 1000 ; i++)
+	{
+		const vec3 center(random(-30.0f, 30.0f), random(-30.0f, 30.0f), random(-40.0f, 2.0f));
+		const vec3 halfSize(random(0.1f, 3.0f), random(0.1f, 3.0f), random(0.1f, 3.0f));
+		boxes.push_back(BoundingBox(center - halfSize, center + halfSize));
+	}
+
+	std::vector<uint8_t> visible;
+	culler.cullBoxes(boxes, visible);
+
+	CHECK(visible.size() == boxes.size());
+
+	uint32_t numOccluded = 0;
+	for (size_t i = 0 ; i != boxes.size() ; i++)
+	{
+		CHECK(visible[i] == (culler.isBoxVisible(boxes[i]) ? 1 : 0));
+		numOccluded += visible[i] ? 0 : 1;
+	}
+
+	CHECK(numOccluded > 0);
+	CHECK(culler.getStats().numTestedBoxes_ == boxes.size());
+	CHECK(culler.getStats().numOccludedBoxes_ == numOccluded);
+}
+
+int main()
+{
+	testBehindAndInFront();
+	testNearPlane();
+	testPartlyCovered();
+	testCullBoxes();
+
+	return TEST_RESULT();
+}
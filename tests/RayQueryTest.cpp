@@ -0,0 +1,240 @@
+#include "shared/RayQuery.h"
+
+#include <math.h>
+
+#include "TestUtils.h"
+
+// position, texture coordinates and normal (see SceneConverter)
+constexpr uint32_t kNumFloats = 8;
+
+struct TestScene
+{
+	MeshData meshData_;
+	Scene scene_;
+};
+
+static uint32_t seed = 12345;
+
+static float random(float from, float to)
+{
+	seed = seed * 1664525u + 1013904223u;
+	return from + (to - from) * (float)(seed >> 8) / (float)(1u << 24);
+}
+
+/* A bumpy unit grid of 'size' x 'size' quads in the XZ plane */
+static void addGridMesh(MeshData& meshData, uint32_t size)
+{
+	Mesh mesh;
+	mesh.indexOffset = (uint32_t)meshData.indexData_.size();
+	mesh.vertexOffset = (uint32_t)(meshData.vertexData_.size() / kNumFloats);
+	mesh.vertexCount = (size + 1) * (size + 1);
+	mesh.lodCount = 1;
+	mesh.lodOffset[1] = size * size * 6;
+
+	for (uint32_t z = 0 ; z <= size ; z++)
+		for (uint32_t x = 0 ; x <= size ; x++)
+			meshData.vertexData_.insert(meshData.vertexData_.end(), { (float)x / size, random(-0.05f, 0.05f), (float)z / size, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f });
+
+	for (uint32_t z = 0 ; z != size ; z++)
+		for (uint32_t x = 0 ; x != size ; x++)
+		{
+			const uint32_t i = z * (size + 1) + x;
+			meshData.indexData_.insert(meshData.indexData_.end(), { i, i + size + 1, i + 1, i + 1, i + size + 1, i + size + 2 });
+		}
+
+	meshData.meshes_.push_back(mesh);
+}
+
+/* Grids of 4 sizes scattered, rotated and scaled under one root node */
+static void makeScene(TestScene& s)
+{
+	for (uint32_t i = 0 ; i != 4 ; i++)
+		addGridMesh(s.meshData_, 4 + i * 4);
+
+	addNode(s.scene_, -1, 0);
+
+	for (uint32_t i = 0 ; i != 100 ; i++)
+	{
+		const int node = addNode(s.scene_, 0, 1);
+		s.scene_.localTransform_[node] =
+			glm::translate(mat4(1.0f), vec3(random(-20.0f, 20.0f), random(-4.0f, 4.0f), random(-20.0f, 20.0f))) *
+			glm::rotate(mat4(1.0f), random(0.0f, 6.28f), vec3(0.3f, 1.0f, 0.2f)) *
+			glm::scale(mat4(1.0f), vec3(3.0f + (float)(i % 3)));
+		s.scene_.meshes_[node] = i % 4;
+	}
+
+	markAsChanged(s.scene_, 0);
+	recalculateGlobalTransforms(s.scene_);
+}
+
+/* Mostly downward rays above the scene, some of them with a limited [tMin, tMax] */
+static std::vector<Ray> makeRays(uint32_t numRays)
+{
+	std::vector<Ray> rays;
+
+	for (uint32_t i = 0 ; i != numRays ; i++)
+	{
+		Ray r = {
+			.origin_ = vec3(random(-20.0f, 20.0f), random(1.0f, 9.0f), random(-20.0f, 20.0f)),
+			.dir_ = 0.1f * vec3(random(-20.0f, 20.0f), -random(10.0f, 30.0f), random(-20.0f, 20.0f))
+		};
+
+		if (i % 5 == 0)
+			r.tMax_ = 1.0f;
+		if (i % 7 == 0)
+			r.tMin_ = 0.5f;
+
+		rays.push_back(r);
+	}
+
+	return rays;
+}
+
+static vec3 getVertex(const TestScene& s, int node, const Mesh& mesh, uint32_t index)
+{
+	const float* p = &s.meshData_.vertexData_[(mesh.vertexOffset + s.meshData_.indexData_[mesh.indexOffset + index]) * kNumFloats];
+	return vec3(s.scene_.globalTransform_[node] * vec4(p[0], p[1], p[2], 1.0f));
+}
+
+/* Moller-Trumbore against every world-space triangle */
+static RayHit traceBruteForce(const TestScene& s, const Ray& ray)
+{
+	RayHit hit;
+	hit.t_ = ray.tMax_;
+
+	for (const auto& n: s.scene_.meshes_)
+	{
+		const Mesh& mesh = s.meshData_.meshes_[n.second];
+
+		for (uint32_t i = 0 ; i != mesh.getLODIndicesCount(0) ; i += 3)
+		{
+			const vec3 v0 = getVertex(s, n.first, mesh, i);
+			const vec3 e1 = getVertex(s, n.first, mesh, i + 1) - v0;
+			const vec3 e2 = getVertex(s, n.first, mesh, i + 2) - v0;
+
+			const vec3 p = glm::cross(ray.dir_, e2);
+			const float det = glm::dot(e1, p);
+			if (fabsf(det) < 1e-12f)
+				continue;
+
+			const vec3 sv = ray.origin_ - v0;
+			const vec3 q = glm::cross(sv, e1);
+			const float u = glm::dot(sv, p) / det;
+			const float v = glm::dot(ray.dir_, q) / det;
+			const float t = glm::dot(e2, q) / det;
+
+			if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t >= ray.tMin_ && t < hit.t_)
+				hit = RayHit { .t_ = t, .node_ = n.first, .mesh_ = n.second, .triangle_ = i / 3, .u_ = u, .v_ = v };
+		}
+	}
+
+	return hit;
+}
+
+static bool isNear(float t, float expected)
+{
+	return fabsf(t - expected) <= 1e-3f * std::max(1.0f, fabsf(expected));
+}
+
+/* The hit point is on the reported triangle at the reported barycentrics */
+static bool isHitPointOnTriangle(const TestScene& s, const Ray& ray, const RayHit& hit)
+{
+	const Mesh& mesh = s.meshData_.meshes_[hit.mesh_];
+	const vec3 v0 = getVertex(s, hit.node_, mesh, hit.triangle_ * 3);
+	const vec3 v1 = getVertex(s, hit.node_, mesh, hit.triangle_ * 3 + 1);
+	const vec3 v2 = getVertex(s, hit.node_, mesh, hit.triangle_ * 3 + 2);
+
+	const vec3 p = v0 + hit.u_ * (v1 - v0) + hit.v_ * (v2 - v0);
+
+	return glm::length(p - (ray.origin_ + hit.t_ * ray.dir_)) <= 1e-3f * std::max(1.0f, hit.t_ * glm::length(ray.dir_));
+}
+
+/* Single rays and packets against brute force, closest and any hits */
+static void checkQueries(RayQuery& query, const TestScene& s, const std::vector<Ray>& rays)
+{
+	std::vector<RayHit> hits;
+	std::vector<uint8_t> occluded;
+	query.closestHits(rays, hits);
+	query.anyHits(rays, occluded);
+
+	CHECK(hits.size() == rays.size());
+	CHECK(occluded.size() == rays.size());
+
+	uint32_t numHits = 0;
+
+	for (size_t i = 0 ; i != rays.size() ; i++)
+	{
+		const RayHit expected = traceBruteForce(s, rays[i]);
+
+		RayHit hit;
+		CHECK(query.closestHit(rays[i], hit) == expected.isHit());
+		CHECK(hit.isHit() == expected.isHit());
+		CHECK(hits[i].isHit() == expected.isHit());
+		CHECK(query.anyHit(rays[i]) == expected.isHit());
+		CHECK((occluded[i] != 0) == expected.isHit());
+
+		if (!expected.isHit())
+			continue;
+
+		numHits++;
+
+		// the nodes may differ where two instances overlap
+		CHECK(isNear(hit.t_, expected.t_));
+		CHECK(isNear(hits[i].t_, expected.t_));
+		CHECK(isHitPointOnTriangle(s, rays[i], hit));
+		CHECK(isHitPointOnTriangle(s, rays[i], hits[i]));
+	}
+
+	// both outcomes are covered
+	CHECK(numHits > 0);
+	CHECK(numHits < rays.size());
+}
+
+/* A partial packet at the end: the number of rays is not a multiple of PacketSize */
+static void testQueries()
+{
+	TestScene s;
+	makeScene(s);
+
+	RayQuery query(2);
+	query.buildMeshes(s.meshData_);
+	query.buildInstances(s.scene_);
+
+	CHECK(query.getStats().numInstances_ == 100);
+
+	checkQueries(query, s, makeRays(RayQuery::PacketSize * 30 + 3));
+}
+
+/* refitInstances() takes the moved nodes without rebuilding the instance BVH */
+static void testRefit()
+{
+	TestScene s;
+	makeScene(s);
+
+	RayQuery query(2);
+	query.buildMeshes(s.meshData_);
+	query.buildInstances(s.scene_);
+
+	const uint32_t numInstanceNodes = query.getStats().numInstanceNodes_;
+
+	for (int i = 1 ; i < (int)s.scene_.hierarchy_.size() ; i += 3)
+	{
+		s.scene_.localTransform_[i] = glm::translate(mat4(1.0f), vec3(1.0f, 0.5f, -2.0f)) * s.scene_.localTransform_[i];
+		markAsChanged(s.scene_, i);
+	}
+
+	recalculateGlobalTransforms(s.scene_);
+	query.refitInstances(s.scene_);
+
+	CHECK(query.getStats().numInstanceNodes_ == numInstanceNodes);
+
+	checkQueries(query, s, makeRays(RayQuery::PacketSize * 30 + 3));
+}
+
+int main()
+{
+	testQueries();
+	testRefit();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,262 @@
+#include "shared/RenderGraph.h"
+
+#include "TestUtils.h"
+
+#include <algorithm>
+
+static uint32_t stepOf(const RenderGraph& g, uint32_t pass)
+{
+	const auto& steps = g.getSteps();
+
+	for (uint32_t s = 0 ; s != (uint32_t)steps.size() ; s++)
+		if (steps[s].pass_ == pass)
+			return s;
+
+	return ~0u;
+}
+
+static const RenderGraphBarrier* findBarrier(const RenderGraph& g, uint32_t pass, uint32_t resource)
+{
+	const uint32_t s = stepOf(g, pass);
+	if (s == ~0u)
+		return nullptr;
+
+	for (const auto& b: g.getSteps()[s].barriers_)
+		if (b.resource_ == resource)
+			return &b;
+
+	return nullptr;
+}
+
+/* Independent passes keep the declaration order, dependent ones follow the data flow */
+static void testOrder()
+{
+	RenderGraph g;
+
+	const uint32_t color = g.addResource("color");
+	const uint32_t blur  = g.addResource("blur");
+	const uint32_t out   = g.addResource("out", RenderGraphResourceDesc { .isExternal_ = true });
+	const uint32_t ui    = g.addResource("ui", RenderGraphResourceDesc { .isExternal_ = true });
+
+	const uint32_t scene     = g.addPass("Scene");
+	const uint32_t blurPass  = g.addPass("Blur");
+	const uint32_t uiPass    = g.addPass("UI");
+	const uint32_t composite = g.addPass("Composite");
+
+	g.write(scene, color);
+
+	g.read(blurPass, color);
+	g.write(blurPass, blur);
+
+	g.write(uiPass, ui);
+
+	g.read(composite, blur);
+	g.read(composite, color);
+	g.write(composite, out);
+
+	CHECK(g.compile());
+	CHECK(g.getSteps().size() == 4);
+	CHECK(stepOf(g, scene) < stepOf(g, blurPass));
+	CHECK(stepOf(g, blurPass) < stepOf(g, uiPass));
+	CHECK(stepOf(g, uiPass) < stepOf(g, composite));
+}
+
+/* Passes which do not contribute to an external resource or a pass with side effects are culled */
+static void testCulling()
+{
+	RenderGraph g;
+
+	const uint32_t a   = g.addResource("a");
+	const uint32_t b   = g.addResource("b");
+	const uint32_t out = g.addResource("out", RenderGraphResourceDesc { .isExternal_ = true });
+
+	const uint32_t pa    = g.addPass("A");
+	const uint32_t pb    = g.addPass("B");
+	const uint32_t pOut  = g.addPass("Out");
+	const uint32_t pSide = g.addPass("Readback", true);
+
+	g.write(pa, a);
+	g.write(pb, b);
+	g.read(pOut, a);
+	g.write(pOut, out);
+	g.read(pSide, a);
+
+	CHECK(g.compile());
+	CHECK(!g.isPassCulled(pa));
+	CHECK(g.isPassCulled(pb));
+	CHECK(!g.isPassCulled(pOut));
+	CHECK(!g.isPassCulled(pSide));
+	CHECK(stepOf(g, pb) == ~0u);
+}
+
+/* Write -> read needs a transition, read -> read in the same state does not, the final usage is restored at the end */
+static void testBarriers()
+{
+	RenderGraph g;
+
+	const uint32_t tex = g.addResource("tex", RenderGraphResourceDesc {
+		.isExternal_ = true, .initialUsage_ = eResourceUsage_ShaderRead, .finalUsage_ = eResourceUsage_ShaderRead });
+	const uint32_t out = g.addResource("out", RenderGraphResourceDesc { .isExternal_ = true });
+
+	const uint32_t write = g.addPass("Write");
+	const uint32_t read1 = g.addPass("Read1");
+	const uint32_t read2 = g.addPass("Read2");
+
+	g.write(write, tex, eResourceUsage_ColorAttachment);
+	g.read(read1, tex);
+	g.write(read1, out);
+	g.read(read2, tex);
+	g.write(read2, out);
+
+	CHECK(g.compile());
+
+	const RenderGraphBarrier* b0 = findBarrier(g, write, tex);
+	CHECK(b0 && b0->before_ == eResourceUsage_ShaderRead && b0->after_ == eResourceUsage_ColorAttachment);
+
+	const RenderGraphBarrier* b1 = findBarrier(g, read1, tex);
+	CHECK(b1 && b1->before_ == eResourceUsage_ColorAttachment && b1->after_ == eResourceUsage_ShaderRead);
+
+	CHECK(findBarrier(g, read2, tex) == nullptr);
+
+	// 'tex' ends in ShaderRead, 'out' has no final usage
+	CHECK(g.getFinalBarriers().empty());
+
+	// without the read passes the final transition is needed
+	g.setPassEnabled(read1, false);
+	g.setPassEnabled(read2, false);
+	CHECK(g.compile());
+	CHECK(g.getFinalBarriers().size() == 1);
+	CHECK(g.getFinalBarriers()[0].before_ == eResourceUsage_ColorAttachment && g.getFinalBarriers()[0].after_ == eResourceUsage_ShaderRead);
+
+	g.setResourceFinalUsage(tex, eResourceUsage_Undefined);
+	CHECK(!g.isCompiled());
+	CHECK(g.compile());
+	CHECK(g.getFinalBarriers().empty());
+}
+
+/* Transitions of all resources in front of a pass are merged into one step */
+static void testMergedBarriers()
+{
+	RenderGraph g;
+
+	const uint32_t a   = g.addResource("a");
+	const uint32_t b   = g.addResource("b");
+	const uint32_t out = g.addResource("out", RenderGraphResourceDesc { .isExternal_ = true });
+
+	const uint32_t pa = g.addPass("A");
+	const uint32_t pb = g.addPass("B");
+	const uint32_t pc = g.addPass("C");
+
+	g.write(pa, a);
+	g.write(pb, b);
+	g.read(pc, a);
+	g.read(pc, b);
+	g.write(pc, out);
+
+	CHECK(g.compile());
+	CHECK(g.getSteps()[stepOf(g, pc)].barriers_.size() == 3);
+}
+
+/*
+	A reader declared before all writers reads the previous frame: it must not depend on the writer and has to be scheduled before it
+	(so that the writer does not overwrite the contents first)
+*/
+static void testPreviousFrameInput()
+{
+	RenderGraph g;
+
+	const uint32_t history = g.addResource("history", RenderGraphResourceDesc {
+		.isExternal_ = true, .initialUsage_ = eResourceUsage_ShaderRead, .finalUsage_ = eResourceUsage_ShaderRead });
+	const uint32_t out = g.addResource("out", RenderGraphResourceDesc { .isExternal_ = true });
+
+	const uint32_t useHistory = g.addPass("UseHistory");
+	const uint32_t update     = g.addPass("UpdateHistory");
+
+	g.read(useHistory, history);
+	g.write(useHistory, out);
+
+	g.write(update, history);
+
+	CHECK(g.compile());
+	CHECK(stepOf(g, useHistory) < stepOf(g, update));
+
+	// no transition: the history is already in ShaderRead
+	CHECK(findBarrier(g, useHistory, history) == nullptr);
+}
+
+/* Ping-pong: the graph is declared once with "previous" and "current" resources, swapping the textures does not change it */
+static void testPingPong()
+{
+	RenderGraph g;
+
+	const RenderGraphResourceDesc persistent { .isExternal_ = true, .initialUsage_ = eResourceUsage_ShaderRead, .finalUsage_ = eResourceUsage_ShaderRead };
+
+	const uint32_t avg    = g.addResource("avg", persistent);
+	const uint32_t prev   = g.addResource("adaptedPrev", persistent);
+	const uint32_t cur    = g.addResource("adapted", persistent);
+	const uint32_t result = g.addResource("result", RenderGraphResourceDesc { .isExternal_ = true });
+
+	const uint32_t adaptation = g.addPass("Adaptation");
+	const uint32_t composer   = g.addPass("Composer");
+
+	g.read(adaptation, avg);
+	g.read(adaptation, prev);
+	g.write(adaptation, cur);
+
+	g.read(composer, cur);
+	g.write(composer, result);
+
+	CHECK(g.compile());
+	CHECK(g.getSteps().size() == 2);
+	CHECK(stepOf(g, adaptation) < stepOf(g, composer));
+
+	const RenderGraphBarrier* b = findBarrier(g, composer, cur);
+	CHECK(b && b->before_ == eResourceUsage_ColorAttachment && b->after_ == eResourceUsage_ShaderRead);
+
+	// every ping-pong texture starts and ends the frame in ShaderRead, so swapping them keeps the barriers valid
+	CHECK(g.getFinalBarriers().empty());
+	CHECK(g.isCompiled());
+}
+
+static void testLifetimes()
+{
+	RenderGraph g;
+
+	const uint32_t a   = g.addResource("a");
+	const uint32_t b   = g.addResource("b");
+	const uint32_t c   = g.addResource("c");
+	const uint32_t out = g.addResource("out", RenderGraphResourceDesc { .isExternal_ = true });
+
+	const uint32_t pa = g.addPass("A");
+	const uint32_t pb = g.addPass("B");
+	const uint32_t pc = g.addPass("C");
+	const uint32_t pd = g.addPass("D");
+
+	g.write(pa, a);
+	g.read(pb, a);
+	g.write(pb, b);
+	g.read(pc, b);
+	g.write(pc, c);
+	g.read(pd, c);
+	g.write(pd, out);
+
+	CHECK(g.compile());
+
+	uint32_t first = 0, last = 0;
+	CHECK(g.getResourceLifetime(a, &first, &last) && first == 0 && last == 1);
+	CHECK(g.getResourceLifetime(b, &first, &last) && first == 1 && last == 2);
+	CHECK(g.getResourceLifetime(c, &first, &last) && first == 2 && last == 3);
+}
+
+int main()
+{
+	testOrder();
+	testCulling();
+	testBarriers();
+	testMergedBarriers();
+	testPreviousFrameInput();
+	testPingPong();
+	testLifetimes();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,157 @@
+#include "shared/RingAllocator.h"
+
+#include "TestUtils.h"
+
+#include <random>
+#include <vector>
+
+static constexpr uint64_t Invalid = RingAllocator::InvalidOffset;
+
+static void testLinear()
+{
+	RingAllocator ring(1024, 2);
+
+	// no frame yet
+	CHECK(ring.allocate(16) == Invalid);
+
+	ring.beginFrame();
+
+	CHECK(ring.allocate(0) == Invalid);
+	CHECK(ring.allocate(2048) == Invalid);
+
+	CHECK(ring.allocate(10) == 0);
+	CHECK(ring.allocate(16, 16) == 16);
+	CHECK(ring.allocate(1, 256) == 256);
+	CHECK(ring.getHead() == 257);
+
+	// alignment padding is accounted too
+	CHECK(ring.getUsedBytes() == 257);
+}
+
+static void testFullAndRelease()
+{
+	RingAllocator ring(100, 2);
+
+	ring.beginFrame();
+	CHECK(ring.allocate(100) == 0);
+	CHECK(ring.getHead() == 0); // exactly at the end: the head wraps to 0
+	CHECK(ring.getUsedBytes() == 100);
+	CHECK(ring.allocate(1) == Invalid);
+
+	// the frame is still in flight
+	ring.beginFrame();
+	CHECK(ring.allocate(1) == Invalid);
+
+	// released after 'framesInFlight' newer frames have begun
+	ring.beginFrame();
+	CHECK(ring.getUsedBytes() == 0);
+	CHECK(ring.allocate(1) == 0);
+}
+
+static void testWrap()
+{
+	RingAllocator ring(100, 2);
+
+	ring.beginFrame(); // A
+	CHECK(ring.allocate(60) == 0);
+
+	ring.beginFrame(); // B
+	CHECK(ring.allocate(30) == 60);
+
+	// [90, 100) is too small and A still occupies [0, 60)
+	CHECK(ring.allocate(20) == Invalid);
+
+	ring.beginFrame(); // C, releases A
+	CHECK(ring.getTail() == 60);
+	CHECK(ring.getUsedBytes() == 30);
+
+	// wraps around: the skipped tail [90, 100) belongs to C
+	CHECK(ring.allocate(20) == 0);
+	CHECK(ring.getHead() == 20);
+	CHECK(ring.getUsedBytes() == 60);
+
+	// [20, 60) is free, B is in [60, 90)
+	CHECK(ring.allocate(41) == Invalid);
+	CHECK(ring.allocate(40) == 20);
+	CHECK(ring.allocate(1) == Invalid);
+
+	ring.beginFrame(); // D, releases B
+	CHECK(ring.getTail() == 90);
+	CHECK(ring.getUsedBytes() == 70);
+
+	ring.beginFrame(); // E, releases C (including the wasted tail)
+	CHECK(ring.getUsedBytes() == 0);
+	CHECK(ring.getHead() == 0 && ring.getTail() == 0);
+}
+
+/* Random sizes, alignments and frame lengths: allocations never overlap the ones of the frames still in flight */
+static void testRandom()
+{
+	struct Range { uint64_t begin, end; };
+
+	std::mt19937 rng(12345);
+
+	for (uint32_t framesInFlight = 1 ; framesInFlight <= 3 ; framesInFlight++)
+	{
+		const uint64_t capacity = 4096;
+		RingAllocator ring(capacity, framesInFlight);
+
+		// live ranges of the last 'framesInFlight' frames
+		std::vector<std::vector<Range>> frames;
+
+		uint32_t numAllocated = 0;
+		uint32_t numFailed = 0;
+
+		for (int frame = 0 ; frame != 2000 ; frame++)
+		{
+			ring.beginFrame();
+
+			frames.emplace_back();
+			if (frames.size() > framesInFlight)
+				frames.erase(frames.begin());
+
+			const int numAllocs = (int)(rng() % 12);
+
+			for (int i = 0 ; i != numAllocs ; i++)
+			{
+				const uint64_t size = 1 + rng() % 600;
+				const uint64_t alignment = 1ull << (rng() % 7);
+
+				const uint64_t offset = ring.allocate(size, alignment);
+
+				if (offset == Invalid)
+				{
+					numFailed++;
+					continue;
+				}
+
+				numAllocated++;
+
+				CHECK(offset % alignment == 0);
+				CHECK(offset + size <= capacity);
+
+				for (const auto& f: frames)
+					for (const auto& r: f)
+						CHECK(offset + size <= r.begin || r.end <= offset);
+
+				frames.back().push_back(Range { offset, offset + size });
+
+				CHECK(ring.getUsedBytes() <= capacity);
+			}
+		}
+
+		// the frames fit most of the time, but the ring has to fill up and wrap too
+		CHECK(numAllocated > 2 * numFailed);
+		CHECK(numFailed > 0);
+	}
+}
+
+int main()
+{
+	testLinear();
+	testFullAndRelease();
+	testWrap();
+	testRandom();
+
+	return TEST_RESULT();
+}
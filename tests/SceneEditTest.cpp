@@ -0,0 +1,356 @@
+#include "shared/scene/Scene.h"
+#include "shared/Utils.h"
+
+#include "TestUtils.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <random>
+
+/**
+	applySceneEdits() against the original deleteSceneNodes() (kept below as the reference) on random scenes,
+	and pending transform updates across edits.
+
+	Usage:
+		SceneEditTest [--benchmark]
+*/
+
+namespace reference
+{
+
+static void addUniqueIdx(std::vector<uint32_t>& v, uint32_t index)
+{
+	if (!std::binary_search(v.begin(), v.end(), index))
+		v.push_back(index);
+}
+
+static void collectNodesToDelete(const Scene& scene, int node, std::vector<uint32_t>& nodes)
+{
+	for (int n = scene.hierarchy_[node].firstChild_; n != - 1 ; n = scene.hierarchy_[n].nextSibling_) {
+		addUniqueIdx(nodes, n);
+		collectNodesToDelete(scene, n, nodes);
+	}
+}
+
+static int findLastNonDeletedItem(const Scene& scene, const std::vector<int>& newIndices, int node)
+{
+	if (node == -1)
+		return -1;
+
+	return (newIndices[node] == -1) ?
+		findLastNonDeletedItem(scene, newIndices, scene.hierarchy_[node].nextSibling_) :
+		newIndices[node];
+}
+
+static void shiftMapIndices(std::unordered_map<uint32_t, uint32_t>& items, const std::vector<int>& newIndices)
+{
+	std::unordered_map<uint32_t, uint32_t> newItems;
+	for (const auto& m: items) {
+		int newIndex = newIndices[m.first];
+		if (newIndex != -1)
+			newItems[newIndex] = m.second;
+	}
+	items = newItems;
+}
+
+// the implementation before SceneEditBatch: expects a sorted set of nodes which already contains their descendants
+static void deleteSceneNodes(Scene& scene, const std::vector<uint32_t>& nodesToDelete)
+{
+	auto indicesToDelete = nodesToDelete;
+	for (auto i: indicesToDelete)
+		collectNodesToDelete(scene, i, indicesToDelete);
+
+	std::vector<int> nodes(scene.hierarchy_.size());
+	std::iota(nodes.begin(), nodes.end(), 0);
+
+	auto oldSize = nodes.size();
+	eraseSelected(nodes, indicesToDelete);
+
+	std::vector<int> newIndices(oldSize, -1);
+	for(int i = 0 ; i < (int)nodes.size() ; i++)
+		newIndices[nodes[i]] = i;
+
+	auto nodeMover = [&scene, &newIndices](Hierarchy& h) {
+		return Hierarchy {
+			.parent_ = (h.parent_ != -1) ? newIndices[h.parent_] : -1,
+			.firstChild_ = findLastNonDeletedItem(scene, newIndices, h.firstChild_),
+			.nextSibling_ = findLastNonDeletedItem(scene, newIndices, h.nextSibling_),
+			.lastSibling_ = findLastNonDeletedItem(scene, newIndices, h.lastSibling_)
+		};
+	};
+	std::transform(scene.hierarchy_.begin(), scene.hierarchy_.end(), scene.hierarchy_.begin(), nodeMover);
+
+	eraseSelected(scene.hierarchy_, indicesToDelete);
+
+	eraseSelected(scene.localTransform_, indicesToDelete);
+	eraseSelected(scene.globalTransform_, indicesToDelete);
+
+	shiftMapIndices(scene.meshes_, newIndices);
+	shiftMapIndices(scene.materialForNode_, newIndices);
+	shiftMapIndices(scene.nameForNode_, newIndices);
+}
+
+} // namespace reference
+
+// deep enough to exercise the levels, shallow enough to stay below MAX_NODE_LEVEL after reparenting and insertion
+constexpr int MaxRandomLevel = 5;
+
+static int pickShallowNode(const Scene& scene, int node)
+{
+	while (scene.hierarchy_[node].level_ > MaxRandomLevel)
+		node = scene.hierarchy_[node].parent_;
+	return node;
+}
+
+static Scene makeRandomScene(std::mt19937& rng, int numNodes)
+{
+	Scene scene;
+
+	addNode(scene, -1, 0);
+
+	for (int i = 1 ; i < numNodes ; i++)
+	{
+		const int parent = pickShallowNode(scene, (int)(rng() % i));
+		const int n = addNode(scene, parent, scene.hierarchy_[parent].level_ + 1);
+
+		scene.localTransform_[n] = glm::translate(mat4(1.0f), glm::vec3((float)(rng() % 10), (float)(rng() % 10), (float)(rng() % 10)));
+
+		if (rng() % 2)
+			scene.meshes_[n] = rng() % 100;
+		if (rng() % 2)
+			scene.materialForNode_[n] = rng() % 100;
+		if (rng() % 3 == 0)
+			setNodeName(scene, n, std::to_string(n));
+	}
+
+	return scene;
+}
+
+static mat4 getReferenceGlobalTransform(const Scene& scene, int node)
+{
+	mat4 m = scene.localTransform_[node];
+	for (int p = scene.hierarchy_[node].parent_ ; p != -1 ; p = scene.hierarchy_[p].parent_)
+		m = scene.localTransform_[p] * m;
+	return m;
+}
+
+static bool isNear(const mat4& a, const mat4& b)
+{
+	for (int i = 0 ; i != 4 ; i++)
+		for (int j = 0 ; j != 4 ; j++)
+			if (fabsf(a[i][j] - b[i][j]) > 1e-3f)
+				return false;
+	return true;
+}
+
+static void collectSubtree(const Scene& scene, int node, std::vector<bool>& mask)
+{
+	mask[node] = true;
+	for (int s = scene.hierarchy_[node].firstChild_ ; s != -1 ; s = scene.hierarchy_[s].nextSibling_)
+		collectSubtree(scene, s, mask);
+}
+
+/* Deleting closed node sets gives the same scene as the original implementation */
+static void testDeleteAgainstReference()
+{
+	std::mt19937 rng(2024);
+
+	for (int iter = 0 ; iter != 500 ; iter++)
+	{
+		Scene a = makeRandomScene(rng, 2 + (int)(rng() % 200));
+		Scene b = a;
+
+		const int numNodes = (int)a.hierarchy_.size();
+
+		std::vector<bool> mask(numNodes, false);
+		for (int k = (int)(rng() % 4) ; k >= 0 ; k--)
+			collectSubtree(a, 1 + (int)(rng() % (numNodes - 1)), mask);
+
+		std::vector<uint32_t> toDelete;
+		for (int i = 0 ; i != numNodes ; i++)
+			if (mask[i])
+				toDelete.push_back(i);
+
+		reference::deleteSceneNodes(a, toDelete);
+		deleteSceneNodes(b, toDelete);
+
+		CHECK(a.hierarchy_.size() == b.hierarchy_.size());
+		if (a.hierarchy_.size() != b.hierarchy_.size())
+			continue;
+
+		for (size_t i = 0 ; i != a.hierarchy_.size() ; i++)
+		{
+			CHECK(a.hierarchy_[i].parent_ == b.hierarchy_[i].parent_);
+			CHECK(a.hierarchy_[i].firstChild_ == b.hierarchy_[i].firstChild_);
+			CHECK(a.hierarchy_[i].nextSibling_ == b.hierarchy_[i].nextSibling_);
+			CHECK(a.localTransform_[i] == b.localTransform_[i]);
+			// the reference implementation does not keep the levels
+			CHECK(b.hierarchy_[i].level_ == getNodeLevel(b, (int)i));
+		}
+
+		CHECK(a.meshes_ == b.meshes_);
+		CHECK(a.materialForNode_ == b.materialForNode_);
+		CHECK(a.nameForNode_ == b.nameForNode_);
+	}
+}
+
+/*
+	Transforms changed before the edits are still updated by recalculateGlobalTransforms() after them,
+	depth-sorted scenes stay depth-sorted
+*/
+static void testPendingChanges()
+{
+	std::mt19937 rng(777);
+
+	for (int iter = 0 ; iter != 1000 ; iter++)
+	{
+		Scene scene = makeRandomScene(rng, 2 + (int)(rng() % 200));
+		const Scene subtree = makeRandomScene(rng, 1 + (int)(rng() % 20));
+
+		const bool sorted = (iter % 2 == 0);
+		if (sorted)
+		{
+			sortSceneByDepth(scene);
+			recalculateAllGlobalTransforms(scene);
+		}
+		else
+		{
+			for (int i = 0 ; i != (int)scene.hierarchy_.size() ; i++)
+				scene.globalTransform_[i] = getReferenceGlobalTransform(scene, i);
+		}
+
+		const int numNodes = (int)scene.hierarchy_.size();
+
+		// pending local changes
+		for (int k = (int)(rng() % 5) ; k >= 0 ; k--)
+		{
+			const int n = (int)(rng() % numNodes);
+			scene.localTransform_[n] = glm::translate(scene.localTransform_[n], glm::vec3(1.0f, 2.0f, 3.0f));
+			markAsChanged(scene, n);
+		}
+
+		SceneEditBatch edits;
+
+		if (rng() % 2)
+			edits.deleteNode(1 + (int)(rng() % (numNodes - 1)));
+
+		// a parent with a lower index is never a descendant
+		if (numNodes > 2)
+		{
+			const int n = 2 + (int)(rng() % (numNodes - 2));
+			edits.reparentNode(n, pickShallowNode(scene, (int)(rng() % n)));
+		}
+
+		const int insertionParent = pickShallowNode(scene, (int)(rng() % numNodes));
+		if (rng() % 2)
+			edits.insertSubtree(subtree, insertionParent);
+
+		std::vector<int> insertedRoots;
+		const std::vector<int> newIndices = applySceneEdits(scene, edits, &insertedRoots);
+
+		CHECK(insertedRoots.size() == edits.insertedSubtrees_.size());
+		if (!insertedRoots.empty())
+		{
+			const int root = insertedRoots[0];
+			CHECK(root == -1 || scene.hierarchy_[root].parent_ == newIndices[insertionParent]);
+			CHECK(root == -1 || scene.localTransform_[root] == subtree.localTransform_[0]);
+		}
+
+		if (sorted)
+			CHECK(isSceneDepthSorted(scene));
+
+		recalculateGlobalTransforms(scene);
+
+		for (int i = 0 ; i != (int)scene.hierarchy_.size() ; i++)
+			CHECK(isNear(scene.globalTransform_[i], getReferenceGlobalTransform(scene, i)));
+
+		for (const auto& c: scene.changedAtThisFrame_)
+			CHECK(c.empty());
+	}
+}
+
+/* Deleted nodes leave no names behind, the remaining nodes keep theirs */
+static void testCompactNames()
+{
+	std::mt19937 rng(99);
+
+	for (int iter = 0 ; iter != 200 ; iter++)
+	{
+		Scene scene = makeRandomScene(rng, 2 + (int)(rng() % 200));
+		const int numNodes = (int)scene.hierarchy_.size();
+
+		// renaming leaves unused names too
+		for (int k = (int)(rng() % 3) ; k >= 0 ; k--)
+			setNodeName(scene, (int)(rng() % numNodes), "renamed");
+
+		std::vector<std::string> names(numNodes);
+		for (int i = 0 ; i != numNodes ; i++)
+			names[i] = getNodeName(scene, i);
+
+		SceneEditBatch edits;
+		edits.deleteNode(1 + (int)(rng() % (numNodes - 1)));
+		const std::vector<int> newIndices = applySceneEdits(scene, edits);
+
+		compactSceneNames(scene);
+
+		CHECK(scene.names_.size() == scene.nameForNode_.size());
+
+		for (int i = 0 ; i != numNodes ; i++)
+			if (newIndices[i] != -1)
+				CHECK(getNodeName(scene, newIndices[i]) == names[i]);
+	}
+}
+
+static double getMs(std::chrono::high_resolution_clock::time_point start)
+{
+	return 0.001 * std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+/* An 8-ary tree of ~1M nodes, 16 random subtrees are deleted */
+static void runBenchmark()
+{
+	Scene scene;
+	addNode(scene, -1, 0);
+
+	for (int i = 1 ; i != 1 << 20 ; i++)
+		addNode(scene, (i - 1) / 8, scene.hierarchy_[(i - 1) / 8].level_ + 1);
+
+	std::mt19937 rng(1);
+
+	std::vector<bool> mask(scene.hierarchy_.size(), false);
+	for (int k = 0 ; k != 16 ; k++)
+		collectSubtree(scene, 9 + (int)(rng() % 4096), mask);
+
+	std::vector<uint32_t> toDelete;
+	for (uint32_t i = 0 ; i != (uint32_t)mask.size() ; i++)
+		if (mask[i])
+			toDelete.push_back(i);
+
+	Scene copy = scene;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	reference::deleteSceneNodes(copy, toDelete);
+	const double oldMs = getMs(start);
+
+	start = std::chrono::high_resolution_clock::now();
+	deleteSceneNodes(scene, toDelete);
+	const double newMs = getMs(start);
+
+	printf("Deleting %u of %u nodes: %.1f ms (reference implementation: %.1f ms)\n",
+		(uint32_t)toDelete.size(), (uint32_t)mask.size(), newMs, oldMs);
+}
+
+int main(int argc, char* argv[])
+{
+	testDeleteAgainstReference();
+	testPendingChanges();
+	testCompactNames();
+
+	if (argc > 1 && !strcmp(argv[1], "--benchmark"))
+		runBenchmark();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+	Minimal checks for the GPU-free tests of the shared code (run with ctest)
+
+	A failed CHECK() prints the expression and the location and makes TEST_RESULT() return EXIT_FAILURE
+*/
+
+inline int& getNumFailedChecks()
+{
+	static int numFailed = 0;
+	return numFailed;
+}
+
+#define CHECK(expr) \
+	do { \
+		if (!(expr)) \
+		{ \
+			printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #expr); \
+			getNumFailedChecks()++; \
+		} \
+	} while (0)
+
+#define TEST_RESULT() (getNumFailedChecks() ? (printf("%d checks failed\n", getNumFailedChecks()), EXIT_FAILURE) : EXIT_SUCCESS)